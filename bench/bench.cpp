@@ -0,0 +1,382 @@
+// Copyright 2013, Poikos Ltd.
+// Author: David Evans
+
+// Measures botoc's own overhead (C++ and the Python bridge) against the
+// in-memory boto stand-in in bench/boto; nothing is sent to AWS.
+// See README.md for build instructions.
+
+#if defined(__APPLE__)
+#  include <Python/python.h>
+#else
+#  include <Python.h>
+#endif
+
+#include "botoc_sqs.h"
+#include "botoc_ddb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <algorithm>
+
+#if BOTOC_NATIVE
+#  error "bench measures the boto bridge; build it without BOTOC_NATIVE"
+#endif
+
+
+/* allocation counting */
+
+static volatile long long allocations = 0;
+
+#if defined(__GLIBC__)
+// every heap allocation (C++, botoc and Python's own) goes through malloc
+extern "C" {
+	void *__libc_malloc( size_t size );
+	void *__libc_calloc( size_t count, size_t size );
+	void *__libc_realloc( void *ptr, size_t size );
+	
+	void *malloc( size_t size ) throw( ) {
+		__sync_fetch_and_add( &allocations, 1 );
+		return __libc_malloc( size );
+	}
+	void *calloc( size_t count, size_t size ) throw( ) {
+		__sync_fetch_and_add( &allocations, 1 );
+		return __libc_calloc( count, size );
+	}
+	void *realloc( void *ptr, size_t size ) throw( ) {
+		__sync_fetch_and_add( &allocations, 1 );
+		return __libc_realloc( ptr, size );
+	}
+}
+#  define ALLOCATIONS_COUNTED "malloc/calloc/realloc"
+#else
+// only C++ allocations can be counted portably
+void *operator new( size_t size ) throw( std::bad_alloc ) {
+	__sync_fetch_and_add( &allocations, 1 );
+	void *p = malloc( size );
+	if( unlikely( p == NULL ) ) {
+		std::bad_alloc ex;
+		throw ex;
+	}
+	return p;
+}
+void *operator new[]( size_t size ) throw( std::bad_alloc ) {
+	return operator new( size );
+}
+void operator delete( void *p ) throw( ) {
+	free( p );
+}
+void operator delete[]( void *p ) throw( ) {
+	free( p );
+}
+#  define ALLOCATIONS_COUNTED "operator new"
+#endif
+
+
+/* prototypes */
+
+static long long clock_nanos( void ) throw( );
+static void report( const char *operation, size_t bytes, int attributes, std::vector<long long> &samples, long long allocs ) throw( );
+
+static void bench_sqs( int iterations, size_t bytes ) throw( );
+static void bench_ddb( int iterations, int attributes, size_t bytes ) throw( );
+static void bench_base64( int iterations, size_t bytes ) throw( );
+
+
+/* implementation */
+
+int main( int argc, char **argv ) {
+	const int iterations = (argc > 1) ? atoi( argv[1] ) : 2000;
+	const char *fake = getenv( "BOTOC_BENCH_FAKE" );
+	if( fake == NULL ) {
+		fake = "bench"; // run from the repository root
+	}
+	if( iterations <= 0 ) {
+		fprintf( stderr, "usage: %s [iterations]\n", argv[0] );
+		return 1;
+	}
+	
+	(void) botoc::set_region( "bench-region" );
+	(void) botoc::set_iam_user( "bench_key", "bench_secret" );
+	
+	// load the stand-in boto before botoc imports anything (and refuse to run
+	// against the real one)
+#if !BOTOC_THREADSAFE
+	Py_Initialize( );
+#endif
+	LOCALBLOCK {
+		botoc::py_gil gil;
+		char script[1024];
+		snprintf( script, sizeof( script ), "import sys\nsys.dont_write_bytecode = True\nsys.path.insert( 0, '%s' )\nimport boto\nif not getattr( boto, 'FAKE', False ):\n  raise ImportError( 'boto stand-in not found in %s' )\n", fake, fake );
+		if( PyRun_SimpleString( script ) != 0 ) {
+			return 1;
+		}
+	}
+	
+	fprintf( stdout, "botoc bench: %d iterations per row, allocations counted with %s\n\n", iterations, ALLOCATIONS_COUNTED );
+	fprintf( stdout, "%-16s %8s %6s %11s %9s %9s %10s\n", "operation", "bytes", "attrs", "ops/s", "p50 us", "p99 us", "allocs/op" );
+	
+	const size_t sizes[] = { 16, 1024, 16384, 65536 };
+	for( size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); ++ i ) {
+		bench_sqs( iterations, sizes[i] );
+	}
+	
+	const int attributes[] = { 1, 10, 50 };
+	const size_t values[] = { 16, 1024 };
+	for( size_t i = 0; i < sizeof( attributes ) / sizeof( attributes[0] ); ++ i ) {
+		for( size_t j = 0; j < sizeof( values ) / sizeof( values[0] ); ++ j ) {
+			bench_ddb( iterations, attributes[i], values[j] );
+		}
+	}
+	
+	fprintf( stdout, "\n%-16s %8s %6s %11s %11s\n", "operation", "bytes", "simd", "encode GB/s", "decode GB/s" );
+	const size_t blobs[] = { 64, 1024, 65536, 1048576 };
+	for( size_t i = 0; i < sizeof( blobs ) / sizeof( blobs[0] ); ++ i ) {
+		bench_base64( iterations, blobs[i] );
+	}
+	
+	botoc::sqs::disconnect( );
+	botoc::ddb::disconnect( );
+	return 0;
+}
+
+static long long clock_nanos( void ) throw( ) {
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return (long long) t.tv_sec * 1000000000ll + (long long) t.tv_nsec;
+}
+
+static void report( const char *operation, size_t bytes, int attributes, std::vector<long long> &samples, long long allocs ) throw( ) {
+	if( samples.empty( ) ) {
+		fprintf( stdout, "%-16s %8d %6s %11s (failed)\n", operation, (int) bytes, "-", "-" );
+		return;
+	}
+	long long total = 0;
+	for( size_t i = 0; i < samples.size( ); ++ i ) {
+		total += samples[i];
+	}
+	std::sort( samples.begin( ), samples.end( ) );
+	const size_t n = samples.size( );
+	char attrs[16];
+	if( attributes > 0 ) {
+		snprintf( attrs, sizeof( attrs ), "%d", attributes );
+	} else {
+		snprintf( attrs, sizeof( attrs ), "-" );
+	}
+	fprintf( stdout, "%-16s %8d %6s %11.0f %9.1f %9.1f %10.1f\n",
+		operation, (int) bytes, attrs,
+		(double) n * 1e9 / (double) total,
+		(double) samples[n / 2] / 1000.0,
+		(double) samples[(n * 99) / 100] / 1000.0,
+		(double) allocs / (double) n
+	);
+}
+
+static void bench_sqs( const int iterations, const size_t bytes ) throw( ) {
+	char queue[32];
+	snprintf( queue, sizeof( queue ), "bench-%d", (int) bytes );
+	const std::string payload( bytes, 'x' );
+	std::string body;
+	std::vector<long long> samples;
+	botoc::sqs::handle_list_t handles;
+	samples.reserve( (size_t) iterations );
+	handles.reserve( (size_t) iterations );
+	
+	// warm up (connects and imports)
+	for( int i = 0; i < 10; ++ i ) {
+		(void) botoc::sqs::put( queue, payload );
+		botoc::handle_t h = botoc::sqs::get( queue, body );
+		(void) botoc::sqs::remove( queue, h );
+	}
+	
+	long long allocs = allocations;
+	for( int i = 0; i < iterations; ++ i ) {
+		const long long t0 = clock_nanos( );
+		const bool ok = botoc::sqs::put( queue, payload );
+		const long long t1 = clock_nanos( );
+		if( ok ) {
+			samples.push_back( t1 - t0 );
+		}
+	}
+	report( "sqs::put", bytes, 0, samples, allocations - allocs );
+	
+	samples.clear( );
+	allocs = allocations;
+	for( int i = 0; i < iterations; ++ i ) {
+		const long long t0 = clock_nanos( );
+		botoc::handle_t h = botoc::sqs::get( queue, body );
+		const long long t1 = clock_nanos( );
+		if( h != NULL ) {
+			samples.push_back( t1 - t0 );
+			handles.push_back( h );
+		}
+	}
+	report( "sqs::get", bytes, 0, samples, allocations - allocs );
+	
+	samples.clear( );
+	allocs = allocations;
+	for( size_t i = 0; i < handles.size( ); ++ i ) {
+		const long long t0 = clock_nanos( );
+		const bool ok = botoc::sqs::remove( queue, handles[i] );
+		const long long t1 = clock_nanos( );
+		if( ok ) {
+			samples.push_back( t1 - t0 );
+		}
+	}
+	report( "sqs::remove", bytes, 0, samples, allocations - allocs );
+}
+
+static void bench_ddb( const int iterations, const int attributes, const size_t bytes ) throw( ) {
+	const std::string value( bytes, 'x' );
+	botoc::ddb::item_list_t items;
+	botoc::ddb::item_list_t loaded;
+	std::vector<long long> samples;
+	char name[32];
+	char key[32];
+	samples.reserve( (size_t) iterations );
+	for( int i = 0; i < attributes; ++ i ) {
+		snprintf( name, sizeof( name ), "attr%d", i );
+		items.push_back( botoc::ddb::item( name, value ) );
+	}
+	
+	// warm up (connects and imports)
+	for( int i = 0; i < 10; ++ i ) {
+		(void) botoc::ddb::update( "bench", "warmup", items );
+		loaded.clear( );
+		(void) botoc::ddb::get( "bench", "warmup", false, loaded );
+	}
+	
+	long long allocs = allocations;
+	for( int i = 0; i < iterations; ++ i ) {
+		snprintf( key, sizeof( key ), "k%d", i % 1000 );
+		const long long t0 = clock_nanos( );
+		const bool ok = botoc::ddb::update( "bench", key, items );
+		const long long t1 = clock_nanos( );
+		if( ok ) {
+			samples.push_back( t1 - t0 );
+		}
+	}
+	report( "ddb::update", bytes, attributes, samples, allocations - allocs );
+	
+	samples.clear( );
+	allocs = allocations;
+	for( int i = 0; i < iterations; ++ i ) {
+		snprintf( key, sizeof( key ), "k%d", i % 1000 );
+		loaded.clear( );
+		const long long t0 = clock_nanos( );
+		const bool ok = botoc::ddb::get( "bench", key, false, loaded );
+		const long long t1 = clock_nanos( );
+		if( ok && loaded.size( ) == (size_t) attributes + 1 ) { // (and the key)
+			samples.push_back( t1 - t0 );
+		}
+	}
+	report( "ddb::get", bytes, attributes, samples, allocations - allocs );
+	
+	// the same, decoded into an arena (reused between calls)
+	botoc::ddb::attribute_map record;
+	samples.clear( );
+	allocs = allocations;
+	for( int i = 0; i < iterations; ++ i ) {
+		snprintf( key, sizeof( key ), "k%d", i % 1000 );
+		const long long t0 = clock_nanos( );
+		const bool ok = botoc::ddb::get( "bench", key, false, record );
+		const long long t1 = clock_nanos( );
+		if( ok && record.size( ) == (size_t) attributes + 1 ) {
+			samples.push_back( t1 - t0 );
+		}
+	}
+	report( "ddb::get map", bytes, attributes, samples, allocations - allocs );
+	
+	// 50 keys per call, as a request handler might want
+	std::vector<std::string> keys;
+	botoc::ddb::item_map_t results;
+	botoc::ddb::item_map_t records;
+	for( int i = 0; i < 50; ++ i ) {
+		snprintf( key, sizeof( key ), "k%d", i );
+		keys.push_back( key );
+		records[key] = items;
+	}
+	samples.clear( );
+	allocs = allocations;
+	for( int i = 0, e = std::max( 1, iterations / 50 ); i < e; ++ i ) {
+		const long long t0 = clock_nanos( );
+		const size_t n = botoc::ddb::batch_put( "bench", records );
+		const long long t1 = clock_nanos( );
+		if( n == records.size( ) ) {
+			samples.push_back( t1 - t0 );
+		}
+	}
+	report( "ddb::batch_put50", bytes, attributes, samples, allocations - allocs );
+	
+	samples.clear( );
+	allocs = allocations;
+	for( int i = 0, e = std::max( 1, iterations / 50 ); i < e; ++ i ) {
+		const long long t0 = clock_nanos( );
+		const bool ok = botoc::ddb::batch_get( "bench", keys, botoc::ddb::item_list_t( ), false, results );
+		const long long t1 = clock_nanos( );
+		if( ok && results.size( ) == keys.size( ) ) {
+			samples.push_back( t1 - t0 );
+		}
+	}
+	report( "ddb::batch_get50", bytes, attributes, samples, allocations - allocs );
+	
+	// the same keys read repeatedly through the cache (after the first pass)
+	botoc::ddb::set_cache( 64 * 1024 * 1024, 60.0 );
+	samples.clear( );
+	allocs = allocations;
+	for( int i = 0; i < iterations; ++ i ) {
+		snprintf( key, sizeof( key ), "k%d", i % 50 );
+		loaded.clear( );
+		const long long t0 = clock_nanos( );
+		const bool ok = botoc::ddb::get( "bench", key, false, loaded );
+		const long long t1 = clock_nanos( );
+		if( ok && loaded.size( ) == (size_t) attributes + 1 ) {
+			samples.push_back( t1 - t0 );
+		}
+	}
+	botoc::ddb::set_cache( 0, 0.0 );
+	report( "ddb::get cached", bytes, attributes, samples, allocations - allocs );
+}
+
+static void bench_base64( const int iterations, const size_t bytes ) throw( ) {
+	static const char *const names[] = { "none", "ssse3", "avx2" };
+	std::vector<unsigned char> data( bytes );
+	std::vector<char> encoded( botoc::base64( &data[0], bytes, NULL ) + 1 );
+	std::vector<char> decoded( bytes + 1 );
+	srand( 1 );
+	for( size_t i = 0; i < bytes; ++ i ) {
+		data[i] = (unsigned char) rand( );
+	}
+	// keep each row to roughly the same amount of work
+	const long long rounds = std::max( 1ll, ((long long) iterations * 16384ll) / (long long) bytes );
+	
+	const int available = botoc::set_simd_level( botoc::SIMD_AVX2 );
+	for( int level = botoc::SIMD_NONE; level <= available; ++ level ) {
+		(void) botoc::set_simd_level( level );
+		size_t length = 0;
+		
+		long long t0 = clock_nanos( );
+		for( long long r = 0; r < rounds; ++ r ) {
+			length = botoc::base64( &data[0], bytes, &encoded[0] );
+		}
+		const long long encodeNanos = clock_nanos( ) - t0;
+		
+		size_t restored = 0;
+		t0 = clock_nanos( );
+		for( long long r = 0; r < rounds; ++ r ) {
+			restored = botoc::unbase64( (const unsigned char *) &encoded[0], length, &decoded[0] );
+		}
+		const long long decodeNanos = clock_nanos( ) - t0;
+		
+		if( restored != bytes || memcmp( &data[0], &decoded[0], bytes ) != 0 ) {
+			fprintf( stdout, "%-16s %8d %6s %11s (failed)\n", "base64", (int) bytes, names[level], "-" );
+			continue;
+		}
+		// bytes of binary data per nanosecond = GB/s
+		fprintf( stdout, "%-16s %8d %6s %11.2f %11.2f\n", "base64", (int) bytes, names[level],
+			(double) bytes * (double) rounds / (double) std::max( 1ll, encodeNanos ),
+			(double) bytes * (double) rounds / (double) std::max( 1ll, decodeNanos )
+		);
+	}
+	(void) botoc::set_simd_level( botoc::SIMD_AVX2 );
+}
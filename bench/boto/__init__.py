@@ -0,0 +1,5 @@
+# In-memory stand-in for the parts of boto which botoc uses, so the benchmark
+# (bench/bench.cpp) measures botoc and its Python bridge rather than the network.
+# Nothing here talks to AWS.
+
+FAKE = True
@@ -0,0 +1,267 @@
+# In-memory DynamoDB (2011-12-05 API): items are kept per table for the life of
+# the process. Supports the calls botoc makes (see botoc_ddb.h). Every table
+# has a string hash key named HASH_KEY (and a range key named RANGE_KEY when
+# one is given).
+
+import json
+import threading
+import zlib
+
+from boto import latency
+from boto.exception import DynamoDBResponseError
+
+HASH_KEY = 'key'
+RANGE_KEY = 'range'
+MAX_BATCH_GET = 100
+MAX_BATCH_WRITE = 25
+MAX_RESPONSE_BYTES = 1024 * 1024
+
+_tables = {}
+_lock = threading.RLock()
+
+
+def _error(name, message=''):
+    return DynamoDBResponseError(400, 'Bad Request', {
+        '__type': 'com.amazonaws.dynamodb.v20111205#' + name,
+        'message': message,
+    })
+
+
+def _key(key):
+    return tuple(sorted((k, tuple(v.items())) for k, v in key.items()))
+
+
+def _size(item):
+    n = 0
+    for name, value in item.items():
+        (typ, val), = value.items()
+        n += len(name) + sum(len(v) for v in (val if isinstance(val, list) else [val]))
+    return n
+
+
+def _segment(item, total):
+    # stable for the life of the table, like DDB's hash partitioning
+    return zlib.crc32(repr(sorted(item[HASH_KEY].items()))) % total
+
+
+def _range_value(value):
+    (typ, val), = value.items()
+    return float(val) if typ == 'N' else val
+
+
+def _compare(op, v, values):
+    if op == 'EQ':
+        return v == values[0]
+    if op == 'LE':
+        return v <= values[0]
+    if op == 'LT':
+        return v < values[0]
+    if op == 'GE':
+        return v >= values[0]
+    if op == 'GT':
+        return v > values[0]
+    if op == 'BEGINS_WITH':
+        return v.startswith(values[0])
+    if op == 'BETWEEN':
+        return values[0] <= v <= values[1]
+    raise _error('ValidationException', 'Unsupported ComparisonOperator ' + op)
+
+
+class Layer1(object):
+    def __init__(self, aws_access_key_id=None, aws_secret_access_key=None, region=None, **kw):
+        self.region = region
+
+    def describe_table(self, table_name):
+        latency.wait()
+        return {'Table': {
+            'TableName': table_name,
+            'TableStatus': 'ACTIVE',
+            'KeySchema': {'HashKeyElement': {'AttributeName': HASH_KEY, 'AttributeType': 'S'}},
+        }}
+
+    def batch_get_item(self, request_items, object_hook=None):
+        # like DDB, stops at MAX_RESPONSE_BYTES and returns the rest as UnprocessedKeys
+        latency.wait()
+        responses = {}
+        unprocessed = {}
+        total = 0
+        with _lock:
+            for table_name, request in request_items.items():
+                keys = request['Keys']
+                if len(keys) > MAX_BATCH_GET:
+                    raise _error('ValidationException', 'Too many items requested for the BatchGetItem call')
+                if len(set(_key(k) for k in keys)) != len(keys):
+                    raise _error('ValidationException', 'Provided list of item keys contains duplicates')
+                attributes = request.get('AttributesToGet')
+                consistent = request.get('ConsistentRead', False)
+                t = _tables.setdefault(table_name, {})
+                items = []
+                left = []
+                for k in keys:
+                    if total >= MAX_RESPONSE_BYTES:
+                        left.append(k)
+                        continue
+                    item = t.get(_key(k))
+                    if item is None:
+                        continue
+                    if attributes:
+                        item = dict((n, v) for n, v in item.items() if n in attributes)
+                    total += _size(item)
+                    items.append(item)
+                responses[table_name] = {
+                    'Items': items,
+                    'ConsumedCapacityUnits': len(items) * (1.0 if consistent else 0.5),
+                }
+                if left:
+                    r = dict(request)
+                    r['Keys'] = left
+                    unprocessed[table_name] = r
+        return {'Responses': responses, 'UnprocessedKeys': unprocessed}
+
+    def batch_write_item(self, request_items, object_hook=None):
+        latency.wait()
+        responses = {}
+        with _lock:
+            for table_name, requests in request_items.items():
+                if len(requests) > MAX_BATCH_WRITE:
+                    raise _error('ValidationException', 'Too many items requested for the BatchWriteItem call')
+                keys = []
+                for r in requests:
+                    if 'PutRequest' in r:
+                        keys.append(_key({'HashKeyElement': r['PutRequest']['Item'][HASH_KEY]}))
+                    else:
+                        keys.append(_key(r['DeleteRequest']['Key']))
+                if len(set(keys)) != len(keys):
+                    raise _error('ValidationException', 'Provided list of item keys contains duplicates')
+                t = _tables.setdefault(table_name, {})
+                for k, r in zip(keys, requests):
+                    if 'PutRequest' in r:
+                        t[k] = dict(r['PutRequest']['Item'])
+                    else:
+                        t.pop(k, None)
+                responses[table_name] = {'ConsumedCapacityUnits': float(len(requests))}
+        return {'Responses': responses, 'UnprocessedItems': {}}
+
+    def get_item(self, table_name, key, attributes_to_get=None, consistent_read=False, object_hook=None):
+        latency.wait()
+        with _lock:
+            item = _tables.setdefault(table_name, {}).get(_key(key))
+        r = {'ConsumedCapacityUnits': 1.0 if consistent_read else 0.5}
+        if item is not None:
+            if attributes_to_get:
+                item = dict((k, v) for k, v in item.items() if k in attributes_to_get)
+            r['Item'] = item
+        return r
+
+    def update_item(self, table_name, key, attribute_updates, expected=None, return_values=None, object_hook=None):
+        latency.wait()
+        with _lock:
+            t = _tables.setdefault(table_name, {})
+            k = _key(key)
+            item = t.get(k)
+            if item is None:
+                item = {HASH_KEY: key['HashKeyElement']}
+                if 'RangeKeyElement' in key:
+                    item[RANGE_KEY] = key['RangeKeyElement']
+            for name, e in (expected or {}).items():
+                if 'Exists' in e and not e['Exists']:
+                    if name in item:
+                        raise _error('ConditionalCheckFailedException', 'The conditional request failed')
+                elif item.get(name) != e.get('Value'):
+                    raise _error('ConditionalCheckFailedException', 'The conditional request failed')
+            item = dict(item)
+            for name, u in attribute_updates.items():
+                action = u.get('Action', 'PUT')
+                if action == 'DELETE' and 'Value' not in u:
+                    item.pop(name, None)
+                elif action == 'PUT':
+                    item[name] = u['Value']
+                elif action == 'ADD':
+                    (typ, val), = u['Value'].items()
+                    if typ == 'N':
+                        old = float(item.get(name, {'N': '0'})['N'])
+                        item[name] = {'N': str(int(old + float(val)))}
+                    else:
+                        old = item.get(name, {typ: []})[typ]
+                        item[name] = {typ: sorted(set(old) | set(val))}
+                elif action == 'DELETE':
+                    (typ, val), = u['Value'].items()
+                    if name in item:
+                        left = [v for v in item[name][typ] if v not in val]
+                        if left:
+                            item[name] = {typ: left}
+                        else:
+                            item.pop(name)
+            t[k] = item
+        return {'ConsumedCapacityUnits': 1.0}
+
+    def query(self, table_name, hash_key_value, range_key_conditions=None, attributes_to_get=None,
+              limit=None, consistent_read=False, scan_index_forward=True, exclusive_start_key=None,
+              object_hook=None, count=False):
+        # like DDB, stops at limit items or MAX_RESPONSE_BYTES and returns LastEvaluatedKey
+        latency.wait()
+        with _lock:
+            items = [i for i in _tables.setdefault(table_name, {}).values()
+                     if i.get(HASH_KEY) == hash_key_value and RANGE_KEY in i]
+        items.sort(key=lambda i: _range_value(i[RANGE_KEY]), reverse=not scan_index_forward)
+        if range_key_conditions:
+            op = range_key_conditions['ComparisonOperator']
+            values = [_range_value(v) for v in range_key_conditions['AttributeValueList']]
+            items = [i for i in items if _compare(op, _range_value(i[RANGE_KEY]), values)]
+        if exclusive_start_key:
+            start = _range_value(exclusive_start_key['RangeKeyElement'])
+            if scan_index_forward:
+                items = [i for i in items if _range_value(i[RANGE_KEY]) > start]
+            else:
+                items = [i for i in items if _range_value(i[RANGE_KEY]) < start]
+        page = []
+        total = 0
+        for item in items:
+            if (limit and len(page) >= limit) or total >= MAX_RESPONSE_BYTES:
+                break
+            total += _size(item)
+            page.append(item)
+        r = {'Count': len(page), 'ConsumedCapacityUnits': max(total / 4096, 1) * (1.0 if consistent_read else 0.5)}
+        if attributes_to_get:
+            page = [dict((n, v) for n, v in i.items() if n in attributes_to_get) for i in page]
+        r['Items'] = page
+        if len(page) < len(items):
+            last = items[len(page) - 1]
+            r['LastEvaluatedKey'] = {'HashKeyElement': last[HASH_KEY], 'RangeKeyElement': last[RANGE_KEY]}
+        return r
+
+    def make_request(self, action, body='', object_hook=None):
+        # only the calls botoc makes directly
+        if action != 'Scan':
+            raise _error('UnknownOperationException', action)
+        return self._scan(**json.loads(body))
+
+    def _scan(self, TableName, AttributesToGet=None, Limit=None, ExclusiveStartKey=None,
+              Segment=0, TotalSegments=1, **kw):
+        # like DDB, stops at Limit items or MAX_RESPONSE_BYTES and returns LastEvaluatedKey
+        latency.wait()
+        if not 0 <= Segment < TotalSegments:
+            raise _error('ValidationException', 'Segment must be less than TotalSegments')
+        with _lock:
+            items = sorted((k, i) for k, i in _tables.setdefault(str(TableName), {}).items()
+                           if _segment(i, TotalSegments) == Segment)
+        if ExclusiveStartKey:
+            start = _key(dict((str(n), {str(t): str(v) for t, v in e.items()}) for n, e in ExclusiveStartKey.items()))
+            items = [(k, i) for k, i in items if k > start]
+        page = []
+        total = 0
+        for k, item in items:
+            if (Limit and len(page) >= Limit) or total >= MAX_RESPONSE_BYTES:
+                break
+            total += _size(item)
+            page.append(item)
+        r = {'Count': len(page), 'ScannedCount': len(page), 'ConsumedCapacityUnits': max(total / 4096, 1) * 0.5}
+        if AttributesToGet:
+            page = [dict((n, v) for n, v in i.items() if n in AttributesToGet) for i in page]
+        r['Items'] = page
+        if len(page) < len(items):
+            last = items[len(page) - 1][1]
+            r['LastEvaluatedKey'] = {'HashKeyElement': last[HASH_KEY]}
+            if RANGE_KEY in last:
+                r['LastEvaluatedKey']['RangeKeyElement'] = last[RANGE_KEY]
+        return r
@@ -0,0 +1,19 @@
+class BotoServerError(Exception):
+    def __init__(self, status, reason, body=None):
+        Exception.__init__(self, status, reason, body)
+        self.status = status
+        self.reason = reason
+        self.body = body or {}
+        self.error_code = None
+
+
+class SQSError(BotoServerError):
+    pass
+
+
+class DynamoDBResponseError(BotoServerError):
+    def __init__(self, status, reason, body=None):
+        BotoServerError.__init__(self, status, reason, body)
+        self.error_code = self.body.get('__type')
+        if self.error_code:
+            self.error_code = self.error_code.split('#')[-1]
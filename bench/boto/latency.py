@@ -0,0 +1,10 @@
+import os
+import time
+
+# simulated round trip in milliseconds (BOTOC_BENCH_LATENCY_MS), 0 by default
+_latency = float(os.environ.get('BOTOC_BENCH_LATENCY_MS', '0')) / 1000.0
+
+
+def wait():
+    if _latency > 0:
+        time.sleep(_latency)
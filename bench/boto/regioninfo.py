@@ -0,0 +1,6 @@
+class RegionInfo(object):
+    def __init__(self, connection=None, name=None, endpoint=None, connection_cls=None):
+        self.connection = connection
+        self.name = name
+        self.endpoint = endpoint
+        self.connection_cls = connection_cls
@@ -0,0 +1,170 @@
+# In-memory SQS: messages are kept per queue name for the life of the process.
+# Supports the calls botoc makes (see botoc_sqs.h); bodies are base64 encoded
+# on the "wire", as with boto's default Message class.
+
+import base64
+import collections
+import itertools
+import threading
+import time
+
+from boto import latency
+
+_queues = {}
+_handles = itertools.count()
+_lock = threading.RLock()
+
+
+class ResultEntry(dict):
+    pass
+
+
+class BatchResults(object):
+    def __init__(self):
+        self.results = []
+        self.errors = []
+
+    def _error(self, id, code):
+        e = ResultEntry()
+        e['id'] = id
+        e['code'] = code
+        self.errors.append(e)
+
+    def _ok(self, id):
+        e = ResultEntry()
+        e['id'] = id
+        self.results.append(e)
+
+
+class Message(object):
+    def __init__(self, queue=None, body=''):
+        self.queue = queue
+        self._body = body
+        self.receipt_handle = None
+        self.id = None
+
+    def get_body(self):
+        return self._body
+
+    def set_body(self, body):
+        self._body = body
+
+    def get_body_encoded(self):
+        return base64.b64encode(self._body)
+
+    def delete(self):
+        return self.queue.delete_message(self)
+
+    def change_visibility(self, visibility_timeout):
+        return self.queue.connection.change_message_visibility(self.queue, self.receipt_handle, visibility_timeout)
+
+
+class Queue(object):
+    def __init__(self, connection, name):
+        self.connection = connection
+        self.name = name
+        self.pending = collections.deque()
+        self.inflight = {}
+        self.visibility_timeout = 30
+        self._next_expiry = float('inf')
+
+    def _expire(self):
+        now = time.time()
+        if now < self._next_expiry:
+            return
+        self._next_expiry = float('inf')
+        for h, (body, until) in list(self.inflight.items()):
+            if until <= now:
+                del self.inflight[h]
+                self.pending.append(body)
+            else:
+                self._next_expiry = min(self._next_expiry, until)
+
+    def new_message(self, body=''):
+        return Message(self, body)
+
+    def write(self, message, delay_seconds=None):
+        latency.wait()
+        with _lock:
+            self.pending.append(message.get_body_encoded())
+        return message
+
+    def write_batch(self, messages):
+        latency.wait()
+        r = BatchResults()
+        with _lock:
+            for (i, body, delay) in messages:
+                self.pending.append(body)
+                r._ok(i)
+        return r
+
+    def get_messages(self, num_messages=1, visibility_timeout=None, attributes=None, wait_time_seconds=None):
+        latency.wait()
+        out = []
+        with _lock:
+            self._expire()
+            until = time.time() + (visibility_timeout or self.visibility_timeout)
+            while self.pending and len(out) < num_messages:
+                body = self.pending.popleft()
+                m = Message(self, base64.b64decode(body))
+                m.receipt_handle = 'h%d' % next(_handles)
+                self.inflight[m.receipt_handle] = (body, until)
+                out.append(m)
+            if out:
+                self._next_expiry = min(self._next_expiry, until)
+        return out
+
+    def delete_message(self, message):
+        latency.wait()
+        with _lock:
+            return self.inflight.pop(message.receipt_handle, None) is not None
+
+    def delete_message_batch(self, messages):
+        latency.wait()
+        r = BatchResults()
+        with _lock:
+            for i, m in enumerate(messages):
+                if self.inflight.pop(m.receipt_handle, None) is not None:
+                    r._ok(str(i))
+                else:
+                    r._error(str(i), 'ReceiptHandleIsInvalid')
+        return r
+
+    def change_message_visibility_batch(self, messages):
+        latency.wait()
+        r = BatchResults()
+        with _lock:
+            for i, (m, t) in enumerate(messages):
+                if self.connection._change_visibility(self, m.receipt_handle, t):
+                    r._ok(str(i))
+                else:
+                    r._error(str(i), 'ReceiptHandleIsInvalid')
+        return r
+
+
+class SQSConnection(object):
+    def __init__(self, aws_access_key_id=None, aws_secret_access_key=None, region=None, **kw):
+        self.region = region
+
+    def get_queue(self, queue_name):
+        latency.wait()
+        with _lock:
+            q = _queues.get(queue_name)
+            if q is None:
+                q = _queues[queue_name] = Queue(self, queue_name)
+            return q
+
+    def change_message_visibility(self, queue, receipt_handle, visibility_timeout):
+        latency.wait()
+        with _lock:
+            return self._change_visibility(queue, receipt_handle, visibility_timeout)
+
+    def _change_visibility(self, queue, receipt_handle, visibility_timeout):
+        if receipt_handle not in queue.inflight:
+            return False
+        body, until = queue.inflight[receipt_handle]
+        until = time.time() + visibility_timeout
+        queue.inflight[receipt_handle] = (body, until)
+        queue._next_expiry = min(queue._next_expiry, until)
+        queue._expire()
+        return True
@@ -0,0 +1,762 @@
+// Copyright 2013, Poikos Ltd.
+// Author: David Evans
+
+// Checks the native backend (BOTOC_NATIVE) against the stand-in server in
+// bench/native/server.py: request signing (including the get-vanilla case
+// from the AWS Signature Version 4 test suite), then every botoc::sqs and
+// botoc::ddb call, and their botoc_async.h versions (and botoc_coro.h's, when
+// built as C++20). Nothing is sent to AWS.
+// See README.md for build instructions.
+
+#ifndef BOTOC_NATIVE
+#  define BOTOC_NATIVE 1
+#endif
+#ifndef BOTOC_THREADSAFE
+#  define BOTOC_THREADSAFE 1
+#endif
+
+#include "botoc_sqs.h"
+#include "botoc_ddb.h"
+#include "botoc_async.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#  include "botoc_coro.h"
+#  define CHECK_CORO 1
+#else
+#  define CHECK_CORO 0
+#endif
+
+#include <stdio.h>
+
+#if !BOTOC_NATIVE
+#  error "check tests the native backend; build it with BOTOC_NATIVE"
+#endif
+
+
+/* checks */
+
+static int failures = 0;
+
+#define CHECK(c) do { \
+	if( !(c) ) { \
+		fprintf( stdout, "  FAILED %s:%d: %s\n", __FILE__, __LINE__, #c ); \
+		++ failures; \
+	} \
+} while( false )
+
+
+/* prototypes */
+
+static void check_signing( void ) throw( );
+static void check_sqs( void ) throw( );
+static void check_ddb( void ) throw( );
+static void check_async( void ) throw( );
+#if CHECK_CORO
+static void check_coro( void ) throw( );
+#endif
+
+static bool count_page( botoc::ddb::record_list_t &page, void *context ) throw( );
+static void count_event( const botoc::ddb::metric_event &event, void *context ) throw( );
+static void *update_many( void *context ) throw( );
+static void count_completion( bool ok, size_t count, void *context ) throw( );
+
+#if CHECK_CORO
+// a coroutine which runs to completion on its own (nothing awaits it)
+struct detached {
+	struct promise_type {
+		detached get_return_object( void ) noexcept { return detached( ); }
+		std::suspend_never initial_suspend( void ) noexcept { return std::suspend_never( ); }
+		std::suspend_never final_suspend( void ) noexcept { return std::suspend_never( ); }
+		void return_void( void ) noexcept { }
+		void unhandled_exception( void ) noexcept { }
+	};
+};
+
+struct coro_results {
+	std::atomic<int> done;
+	std::atomic<int> good;
+	std::atomic<int> elsewhere; // resumed on a thread other than main's
+	pthread_t main;
+};
+
+// botoc::coro::executor which queues resumptions for the main thread
+struct resume_queue {
+	pthread_mutex_t mutex;
+	std::vector<std::pair<botoc::coro::resumer,void *> > queued;
+};
+
+static detached update_then_get( int n, coro_results *results ) throw( );
+static detached await_late( coro_results *results ) throw( );
+static detached use_queue( coro_results *results ) throw( );
+static void queue_resume( botoc::coro::resumer resume, void *frame, void *context ) throw( );
+static bool wait_for( coro_results &results, int done, resume_queue *queue ) throw( );
+#endif
+
+
+/* implementation */
+
+int main( int argc, char **argv ) {
+	if( argc < 2 ) {
+		fprintf( stderr, "usage: %s host:port (of bench/native/server.py)\n", argv[0] );
+		return 2;
+	}
+	
+	check_signing( );
+	
+	// the server's credentials
+	if( !botoc::set_region( "eu-west-1" ) || !botoc::set_iam_user( "k", "s" ) ) {
+		return 2;
+	}
+	if( !botoc::native::set_endpoint( "sqs", argv[1] ) || !botoc::native::set_endpoint( "dynamodb", argv[1] ) ) {
+		return 2;
+	}
+	
+	check_sqs( );
+	check_ddb( );
+	check_async( );
+#if CHECK_CORO
+	check_coro( );
+#endif
+	
+	botoc::sqs::disconnect( );
+	botoc::ddb::disconnect( );
+	
+	fprintf( stdout, "%s (%d failures).\n", (failures == 0) ? "ok" : "FAILED", failures );
+	return (failures == 0) ? 0 : 1;
+}
+
+static void check_signing( void ) throw( ) {
+	using namespace botoc;
+	fprintf( stdout, "signing\n" );
+	
+	LOCALBLOCK {
+		// FIPS 180-2 examples, split across updates to exercise buffering
+		const char *const inputs[] = { "", "abc", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq" };
+		const char *const digests[] = {
+			"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+			"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+			"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+		};
+		for( size_t i = 0; i < 3; ++ i ) {
+			const size_t n = strlen( inputs[i] );
+			native::sha256_state s;
+			native::sha256_init( s );
+			native::sha256_update( s, inputs[i], n / 3 );
+			native::sha256_update( s, inputs[i] + n / 3, n - n / 3 );
+			unsigned char digest[32];
+			native::sha256_final( s, digest );
+			string_t hex;
+			native::hex( digest, 32, hex );
+			CHECK( hex == digests[i] );
+		}
+	}
+	
+	LOCALBLOCK {
+		// AWS Signature Version 4 test suite: get-vanilla
+		client c( "AKIDEXAMPLE", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "us-east-1" );
+		client_scope use( c );
+		string_list_t headers;
+		headers.push_back( "host:example.amazonaws.com" );
+		headers.push_back( "x-amz-date:20150830T123600Z" );
+		string_t authorization;
+		CHECK( native::sign( "GET", "/", "", headers, "", "service", "20150830T123600Z", authorization ) );
+		CHECK( authorization == "AWS4-HMAC-SHA256 Credential=AKIDEXAMPLE/20150830/us-east-1/service/aws4_request, SignedHeaders=host;x-amz-date, Signature=5fa00fa31553b73ebf1942676e86291e8372ff2a2260956d9b8aae1d763fbf31" );
+	}
+	
+	LOCALBLOCK {
+		native::json_value j;
+		CHECK( native::json_parse( "{\"a\":[1,-2.5e3,\"x\\u00e9\\ud83d\\ude00\\n\"],\"b\":{\"c\":true,\"d\":null}}", j ) );
+		CHECK( j.get( "a" ) != NULL && j.get( "a" )->items.size( ) == 3 );
+		CHECK( j.get( "a" )->items[1].number( ) == -2500.0 );
+		CHECK( j.get( "a" )->items[2].text == "x\xc3\xa9\xf0\x9f\x98\x80\n" );
+		CHECK( j.get( "b" )->get( "c" )->text == "true" );
+		string_t s;
+		native::json_string( s, "q\"\\\x01", 4 );
+		CHECK( s == "\"q\\\"\\\\\\u0001\"" );
+	}
+}
+
+static void check_sqs( void ) throw( ) {
+	using namespace botoc;
+	fprintf( stdout, "botoc::sqs\n" );
+	
+	string_t body;
+	
+	// put, get, extend, remove
+	CHECK( !sqs::put( "missingqueue", "x" ) );
+	CHECK( sqs::put( "q", "hello <&> \xc3\xa9 \x01 world" ) );
+	handle_t handle = sqs::get( "q", body, 30 );
+	CHECK( handle != NULL && body == "hello <&> \xc3\xa9 \x01 world" );
+	CHECK( sqs::extend( "q", handle, 60 ) );
+	CHECK( sqs::remove( "q", handle ) );
+	CHECK( sqs::get( "q", body, 30 ) == NULL );
+	
+	// put_batch (the server refuses messages starting "fail"), get_batch,
+	// extend_batch, remove_batch
+	string_list_t messages;
+	for( int i = 0; i < 25; ++ i ) {
+		char message[32];
+		snprintf( message, sizeof( message ), (i == 7) ? "fail %d" : "message %d", i );
+		messages.push_back( message );
+	}
+	std::vector<bool> sent;
+	CHECK( sqs::put_batch( "q", messages, &sent ) == 24 );
+	CHECK( sent.size( ) == 25 && !sent[7] && sent[6] && sent[24] );
+	
+	sqs::message_list_t got;
+	sqs::handle_list_t all;
+	while( sqs::get_batch( "q", 10, 30, 0, got ) && !got.empty( ) ) {
+		for( size_t i = 0; i < got.size( ); ++ i ) {
+			all.push_back( got[i].handle );
+		}
+	}
+	CHECK( all.size( ) == 24 );
+	std::vector<bool> extended;
+	CHECK( sqs::extend_batch( "q", all, 0, &extended ) == 24 ); // visible again
+	
+	CHECK( sqs::get_batch( "q", 10, 30, 0, got ) && got.size( ) == 10 );
+	sqs::handle_list_t handles;
+	for( size_t i = 0; i < got.size( ); ++ i ) {
+		handles.push_back( got[i].handle );
+	}
+	handles.push_back( all[0] ); // (stale: the server rejects it)
+	std::vector<bool> removed;
+	CHECK( sqs::remove_batch( "q", handles, &removed ) == 10 );
+	CHECK( removed.size( ) == 11 && removed[0] && !removed[10] );
+	for( size_t i = 1; i < all.size( ); ++ i ) {
+		sqs::release( all[i] );
+	}
+	
+	// long polls return as soon as there are messages
+	const long long started = clock_micros( );
+	CHECK( sqs::get_batch( "q", 10, 30, 2, got ) && got.size( ) == 10 );
+	CHECK( clock_micros( ) - started < 1000000 );
+	for( size_t i = 0; i < got.size( ); ++ i ) {
+		sqs::release( got[i].handle );
+	}
+	
+	// consumer (4 messages are left)
+	LOCALBLOCK {
+		sqs::consumer consumer( "q", 20, 10, 1 );
+		CHECK( consumer.start( ) );
+		sqs::message message;
+		int count = 0;
+		while( consumer.pop( message, 2000 ) ) {
+			CHECK( consumer.ack( message.handle ) );
+			++ count;
+		}
+		consumer.stop( );
+		CHECK( count == 4 );
+		CHECK( consumer.failed_acks( ) == 0 && consumer.failed_extends( ) == 0 );
+		CHECK( sqs::get( "q", body, 30 ) == NULL );
+	}
+	
+	// every other request to a "flaky" queue fails with a 503, and is retried
+	LOCALBLOCK {
+		retry_stats before;
+		sqs::get_retry_stats( before );
+		for( int i = 0; i < 4; ++ i ) {
+			CHECK( sqs::put( "flakyq", "x" ) );
+		}
+		retry_stats after;
+		sqs::get_retry_stats( after );
+		CHECK( after.retries > before.retries );
+		CHECK( after.server > before.server );
+	}
+	
+	// other clients use their own credentials (and connections)
+	LOCALBLOCK {
+		client wrong( "k", "not the secret", "eu-west-1" );
+		client_scope use( wrong );
+		CHECK( !sqs::put( "q", "x" ) );
+	}
+	
+	LOCALBLOCK {
+		pool_stats stats;
+		sqs::get_pool_stats( stats );
+		CHECK( stats.opened > 0 && stats.reused > 0 );
+	}
+}
+
+static void check_ddb( void ) throw( ) {
+	using namespace botoc;
+	fprintf( stdout, "botoc::ddb\n" );
+	
+	unsigned long long events = 0;
+	ddb::set_metrics_sink( &count_event, &events );
+	
+	// update (with ADD and expected values) and get
+	LOCALBLOCK {
+		ddb::item_list_t items;
+		items.push_back( ddb::item( "name", "Ann \"quoted\"" ) );
+		items.push_back( ddb::item( "count", 2, ddb::ADD ) );
+		ddb::item tags( "tags", ddb::STRINGSET, ddb::ADD );
+		CHECK( tags.add_item( "a" ) && tags.add_item( "b" ) );
+		items.push_back( tags );
+		CHECK( ddb::update( "t", "k1", items ) );
+		CHECK( ddb::update( "t", "k1", items ) );
+		ddb::item_list_t expected;
+		expected.push_back( ddb::item( "name", "Bob" ) );
+		CHECK( !ddb::update( "t", "k1", items, &expected ) );
+		
+		ddb::item_list_t output;
+		CHECK( ddb::get( "t", "k1", true, output ) );
+		CHECK( output.size( ) == 4 ); // (and the hash key)
+		ddb::item_list_t some;
+		some.push_back( ddb::item( "count" ) );
+		some.push_back( ddb::item( "missing" ) );
+		CHECK( ddb::get( "t", "k1", false, some ) );
+		CHECK( some.size( ) == 1 && *some[0].value( ) == "4" );
+		CHECK( !ddb::get( "t", "nokey", false, output ) );
+		
+		ddb::attribute_map map;
+		CHECK( ddb::get( "t", "k1", true, map ) );
+		const ddb::attribute *name = map.find( "name" );
+		CHECK( name != NULL && name->value( ) != NULL && strcmp( name->value( )->data, "Ann \"quoted\"" ) == 0 );
+		const ddb::attribute *set = map.find( "tags" );
+		CHECK( set != NULL && set->type == ddb::STRINGSET && set->count == 2 );
+	}
+	
+	// range keys, and query
+	LOCALBLOCK {
+		for( int i = 0; i < 20; ++ i ) {
+			ddb::item_list_t items;
+			items.push_back( ddb::item( "v", i ) );
+			CHECK( ddb::update( "events", ddb::item_key( ddb::item( "", "user1" ), ddb::item( "", 1000 + i ) ), items ) );
+		}
+		ddb::item_list_t output;
+		output.push_back( ddb::item( "v" ) );
+		CHECK( ddb::get( "events", ddb::item_key( ddb::item( "", "user1" ), ddb::item( "", 1003 ) ), true, output ) );
+		CHECK( output.size( ) == 1 && *output[0].value( ) == "3" );
+		
+		size_t count = 0;
+		CHECK( ddb::query( "events", "user1", ddb::range_condition( ), 0, &count_page, &count ) );
+		CHECK( count == 20 ); // (3 pages)
+		count = 0;
+		CHECK( ddb::query( "events", "user1", ddb::range_condition( ddb::item( "", 1005 ), ddb::item( "", 1014 ) ), 0, &count_page, &count, true, false ) );
+		CHECK( count == 10 );
+		count = 0;
+		CHECK( ddb::query( "events", "user1", ddb::range_condition( ddb::GT, ddb::item( "", 1002 ) ), 9, &count_page, &count ) );
+		CHECK( count == 9 );
+	}
+	
+	// batch_put, batch_get and batch_delete (the server leaves some keys
+	// unprocessed each time)
+	LOCALBLOCK {
+		ddb::item_map_t records;
+		string_list_t keys;
+		for( int i = 0; i < 60; ++ i ) {
+			char key[16];
+			snprintf( key, sizeof( key ), "b%d", i );
+			ddb::item_list_t &items = records[key];
+			items.push_back( ddb::item( "a", key ) );
+			items.push_back( ddb::item( "n", i ) );
+			items.push_back( ddb::item( "bin", (const void *) "\x01\x00\x03", 3 ) );
+			keys.push_back( key );
+		}
+		keys.push_back( "b0" ); // (duplicate)
+		keys.push_back( "nokey" );
+		CHECK( ddb::batch_put( "bt", records, 3 ) == 60 );
+		
+		ddb::item_map_t results;
+		CHECK( ddb::batch_get( "bt", keys, ddb::item_list_t( ), true, results ) );
+		CHECK( results.size( ) == 60 );
+		string_t binary;
+		const ddb::item_list_t &b7 = results["b7"];
+		CHECK( b7.size( ) == 4 );
+		for( size_t i = 0; i < b7.size( ); ++ i ) {
+			if( b7[i].name( ) == "bin" ) {
+				CHECK( b7[i].get_binary( binary ) && binary == string_t( "\x01\x00\x03", 3 ) );
+			}
+		}
+		
+		size_t count = 0;
+		CHECK( ddb::parallel_scan( "bt", 4, NULL, &count_page, &count ) );
+		CHECK( count == 60 );
+		
+		CHECK( ddb::batch_delete( "bt", keys, 3 ) == keys.size( ) - 1 );
+		CHECK( ddb::batch_get( "bt", keys, ddb::item_list_t( ), false, results ) && results.empty( ) );
+	}
+	
+	// cache
+	LOCALBLOCK {
+		ddb::set_cache( 1 << 20, 60.0 );
+		ddb::item_list_t items;
+		items.push_back( ddb::item( "v", "1" ) );
+		CHECK( ddb::update( "t", "cached", items ) );
+		ddb::item_list_t output;
+		CHECK( ddb::get( "t", "cached", false, output ) );
+		output.clear( ); // (entries are per set of requested attributes)
+		CHECK( ddb::get( "t", "cached", false, output ) && output.size( ) == 2 );
+		ddb::cache_stats stats;
+		ddb::get_cache_stats( stats );
+		CHECK( stats.hits == 1 && stats.misses == 1 );
+		items[0] = ddb::item( "v", "2" );
+		CHECK( ddb::update( "t", "cached", items ) ); // (invalidates the entry)
+		output.clear( );
+		output.push_back( ddb::item( "v" ) );
+		CHECK( ddb::get( "t", "cached", false, output ) && *output[0].value( ) == "2" );
+		
+		// invalid keys are rejected without touching the cache
+		ddb::item set( "", ddb::STRINGSET );
+		CHECK( set.add_item( "a" ) );
+		CHECK( !ddb::get( "t", ddb::item_key( set ), false, output ) );
+		CHECK( !ddb::update( "t", ddb::item_key( set ), items ) );
+		CHECK( !ddb::get( "t", ddb::item_key( ddb::item( "" ) ), false, output ) );
+		ddb::clear_cache( );
+		ddb::set_cache( 0, 0.0 );
+	}
+	
+	// throttled and failing tables
+	LOCALBLOCK {
+		retry_stats before;
+		ddb::get_retry_stats( before );
+		ddb::item_list_t items;
+		items.push_back( ddb::item( "v", "1" ) );
+		for( int i = 0; i < 4; ++ i ) {
+			CHECK( ddb::update( "throttled", "k", items ) );
+		}
+		CHECK( !ddb::update( "down", "k", items ) );
+		retry_stats after;
+		ddb::get_retry_stats( after );
+		CHECK( after.throttled > before.throttled );
+		CHECK( after.exhausted > before.exhausted );
+	}
+	
+	// rate limits
+	LOCALBLOCK {
+		CHECK( ddb::set_rate_limit( "limited", 100.0, 20.0, 0.25 ) );
+		ddb::item_list_t items;
+		items.push_back( ddb::item( "v", "1" ) );
+		const long long started = clock_micros( );
+		for( int i = 0; i < 15; ++ i ) {
+			CHECK( ddb::update( "limited", "k", items ) );
+		}
+		CHECK( clock_micros( ) - started >= 400000 ); // 15 units at 20 a second, after a burst of 5
+		
+		// another client's requests to a table of the same name are not limited
+		LOCALBLOCK {
+			client other( "k", "s", "eu-west-1" );
+			client_scope use( other );
+			const long long unlimited = clock_micros( );
+			for( int i = 0; i < 15; ++ i ) {
+				CHECK( ddb::update( "limited", "k", items ) );
+			}
+			CHECK( clock_micros( ) - unlimited < 400000 );
+			ddb::clear_rate_limits( ); // (none of its own)
+		}
+		const long long again = clock_micros( );
+		for( int i = 0; i < 5; ++ i ) {
+			CHECK( ddb::update( "limited", "k", items ) );
+		}
+		CHECK( clock_micros( ) - again >= 150000 ); // still limited
+		ddb::clear_rate_limits( );
+	}
+	
+#if BOTOC_THREADSAFE
+	// limits can be changed and removed while requests wait on them
+	LOCALBLOCK {
+		pthread_t threads[4];
+		int updated[4] = { 0, 0, 0, 0 };
+		for( int i = 0; i < 4; ++ i ) {
+			CHECK( pthread_create( &threads[i], NULL, &update_many, &updated[i] ) == 0 );
+		}
+		for( int i = 0; i < 200; ++ i ) {
+			CHECK( ddb::set_rate_limit( "raced", 200.0, 200.0, 0.01 ) );
+			sleep_micros( 1000 );
+			if( (i % 2) == 0 ) {
+				CHECK( ddb::set_rate_limit( "raced", 0.0, 0.0 ) );
+			} else {
+				ddb::clear_rate_limits( );
+			}
+		}
+		for( int i = 0; i < 4; ++ i ) {
+			pthread_join( threads[i], NULL );
+			CHECK( updated[i] == 50 );
+		}
+	}
+#endif
+	
+	// metrics
+	LOCALBLOCK {
+		ddb::metrics_snapshot metrics;
+		CHECK( ddb::get_metrics( metrics ) );
+		CHECK( metrics.ops[ddb::OP_UPDATE].requests > 0 );
+		CHECK( metrics.ops[ddb::OP_QUERY].requests >= 3 );
+		CHECK( metrics.failures[ddb::FAIL_CONDITION] == 1 );
+		CHECK( metrics.tables["limited"].waitMicros > 0 );
+		CHECK( ddb::metric_percentile( metrics.ops[ddb::OP_GET], 0.5 ) > 0 );
+		CHECK( events > 0 );
+		ddb::set_metrics_sink( NULL );
+		ddb::reset_metrics( );
+	}
+	
+	LOCALBLOCK {
+		pool_stats stats;
+		ddb::get_pool_stats( stats );
+		CHECK( stats.opened > 0 && stats.reused > 0 );
+	}
+}
+
+static void check_async( void ) throw( ) {
+	using namespace botoc;
+	fprintf( stdout, "botoc::async\n" );
+	
+	// many requests in flight at once
+	LOCALBLOCK {
+		async::future updates[50];
+		for( int i = 0; i < 50; ++ i ) {
+			char key[16];
+			snprintf( key, sizeof( key ), "a%d", i );
+			ddb::item_list_t items;
+			items.push_back( ddb::item( "n", i ) );
+			CHECK( ddb::update_async( "async", key, items, NULL, updates[i] ) );
+		}
+		for( int i = 0; i < 50; ++ i ) {
+			CHECK( updates[i].wait( ) && updates[i].count( ) == 1 );
+		}
+		
+		async::future gets[50];
+		ddb::item_list_t output[50];
+		for( int i = 0; i < 50; ++ i ) {
+			char key[16];
+			snprintf( key, sizeof( key ), "a%d", i );
+			output[i].push_back( ddb::item( "n" ) );
+			CHECK( ddb::get_async( "async", key, true, output[i], gets[i] ) );
+		}
+		for( int i = 0; i < 50; ++ i ) {
+			char value[16];
+			snprintf( value, sizeof( value ), "%d", i );
+			CHECK( gets[i].wait( ) && output[i].size( ) == 1 && *output[i][0].value( ) == value );
+		}
+	}
+	
+	// sqs, and a future reused (but not while it is pending)
+	LOCALBLOCK {
+		async::future f;
+		CHECK( f.ready( ) && !f.ok( ) );
+		CHECK( sqs::put_async( "slowq", "first", f ) );
+		CHECK( !sqs::put_async( "slowq", "second", f ) ); // (still pending)
+		CHECK( f.wait( ) && f.ok( ) );
+		CHECK( sqs::put_async( "slowq", "second", f ) && f.wait( ) );
+		
+		string_t body;
+		handle_t handle = NULL;
+		CHECK( sqs::get_async( "slowq", body, handle, 30, 0, f ) && f.wait( ) );
+		CHECK( handle != NULL && body == "first" );
+		CHECK( sqs::remove_async( "slowq", handle, f ) && f.wait( ) );
+		
+		sqs::message_list_t got;
+		CHECK( sqs::get_batch_async( "slowq", 10, 30, 0, got, f ) && f.wait( ) && got.size( ) == 1 );
+		sqs::handle_list_t handles;
+		for( size_t i = 0; i < got.size( ); ++ i ) {
+			handles.push_back( got[i].handle );
+		}
+		std::vector<bool> removed;
+		CHECK( sqs::remove_batch_async( "slowq", handles, &removed, f ) && f.wait( ) && f.count( ) == 1 );
+		CHECK( !sqs::put_async( "missingqueue", "x", f ) || !f.wait( ) );
+	}
+	
+	// query and scan pages reach their callback on an I/O thread
+	LOCALBLOCK {
+		size_t completed = 0;
+		size_t count = 0;
+		async::future f( &count_completion, &completed );
+		CHECK( ddb::query_async( "events", "user1", ddb::range_condition( ), 0, &count_page, &count, f ) );
+		CHECK( f.wait( ) && count == 20 && f.count( ) == 20 );
+		count = 0;
+		CHECK( ddb::parallel_scan_async( "async", 4, NULL, &count_page, &count, f ) );
+		CHECK( f.wait( ) && count == 50 && f.count( ) == 50 );
+		CHECK( completed == 70 );
+	}
+	
+	// requests run under the client which was current when they were made
+	LOCALBLOCK {
+		client wrong( "k", "not the secret", "eu-west-1" );
+		async::future f;
+		LOCALBLOCK {
+			client_scope use( wrong );
+			CHECK( sqs::put_async( "q", "x", f ) );
+		}
+		CHECK( !f.wait( ) );
+	}
+	
+	// a pending future waits for its request when it is destroyed
+	LOCALBLOCK {
+		const long long started = clock_micros( );
+		LOCALBLOCK {
+			async::future f;
+			CHECK( sqs::put_async( "slowq", "x", f ) );
+		}
+		CHECK( clock_micros( ) - started >= 100000 );
+	}
+	
+	// shutdown waits for queued requests; the next call starts the threads again
+	LOCALBLOCK {
+		async::future puts[10];
+		for( int i = 0; i < 10; ++ i ) {
+			CHECK( sqs::put_async( "slowq", "x", puts[i] ) );
+		}
+		async::shutdown( );
+		for( int i = 0; i < 10; ++ i ) {
+			CHECK( puts[i].ready( ) && puts[i].ok( ) );
+		}
+		ddb::item_list_t output;
+		async::future f;
+		CHECK( ddb::get_async( "async", "a1", false, output, f ) && f.wait( ) && !output.empty( ) );
+		async::shutdown( );
+	}
+}
+
+#if CHECK_CORO
+static void check_coro( void ) throw( ) {
+	using namespace botoc;
+	fprintf( stdout, "botoc::coro\n" );
+	
+	coro_results results;
+	results.done = 0;
+	results.good = 0;
+	results.elsewhere = 0;
+	results.main = pthread_self( );
+	
+	// many coroutines suspended at once, resumed on the I/O threads
+	for( int i = 0; i < 200; ++ i ) {
+		update_then_get( i, &results );
+	}
+	CHECK( wait_for( results, 200, NULL ) );
+	CHECK( results.good == 200 );
+	
+	// a request which completes before it is awaited carries on without
+	// suspending (so stays on the main thread)
+	results.done = 0;
+	results.good = 0;
+	results.elsewhere = 0;
+	await_late( &results );
+	CHECK( results.done == 1 && results.good == 1 && results.elsewhere == 0 );
+	
+	// an operation which is never awaited waits for its request
+	LOCALBLOCK {
+		ddb::item_list_t output;
+		ddb::get_co never( "coro", "c1", true, output );
+	}
+	
+	// with an executor, coroutines resume wherever it runs them
+	LOCALBLOCK {
+		resume_queue queue;
+		pthread_mutex_init( &queue.mutex, NULL );
+		coro::set_executor( &queue_resume, &queue );
+		results.done = 0;
+		results.good = 0;
+		results.elsewhere = 0;
+		for( int i = 0; i < 20; ++ i ) {
+			use_queue( &results );
+		}
+		CHECK( wait_for( results, 20, &queue ) );
+		CHECK( results.good == 20 && results.elsewhere == 0 );
+		coro::set_executor( NULL );
+		pthread_mutex_destroy( &queue.mutex );
+	}
+	
+	async::shutdown( );
+}
+
+static detached update_then_get( const int n, coro_results *const results ) throw( ) {
+	char key[16];
+	snprintf( key, sizeof( key ), "c%d", n );
+	botoc::ddb::item_list_t items;
+	items.push_back( botoc::ddb::item( "n", n ) );
+	bool ok = co_await botoc::ddb::update_co( "coro", key, items );
+	botoc::ddb::item_list_t output;
+	output.push_back( botoc::ddb::item( "n" ) );
+	if( ok ) {
+		ok = co_await botoc::ddb::get_co( "coro", key, true, output );
+	}
+	char value[16];
+	snprintf( value, sizeof( value ), "%d", n );
+	if( ok && output.size( ) == 1 && *output[0].value( ) == value ) {
+		++ results->good;
+	}
+	++ results->done;
+}
+
+static detached await_late( coro_results *const results ) throw( ) {
+	botoc::ddb::item_list_t output;
+	botoc::ddb::get_co late( "coro", "c1", true, output );
+	botoc::sleep_micros( 300000 );
+	if( co_await late && !output.empty( ) ) {
+		++ results->good;
+	}
+	if( !pthread_equal( pthread_self( ), results->main ) ) {
+		++ results->elsewhere;
+	}
+	++ results->done;
+}
+
+static detached use_queue( coro_results *const results ) throw( ) {
+	botoc::string_t body;
+	const bool put = co_await botoc::sqs::put_co( "coroq", "x" );
+	botoc::handle_t handle = co_await botoc::sqs::get_co( "coroq", body );
+	if( !pthread_equal( pthread_self( ), results->main ) ) {
+		++ results->elsewhere;
+	}
+	if( put && handle != NULL && body == "x" && co_await botoc::sqs::remove_co( "coroq", handle ) ) {
+		++ results->good;
+	}
+	++ results->done;
+}
+
+static void queue_resume( const botoc::coro::resumer resume, void *const frame, void *const context ) throw( ) {
+	resume_queue &q = *(resume_queue *) context;
+	pthread_mutex_lock( &q.mutex );
+	q.queued.push_back( std::make_pair( resume, frame ) );
+	pthread_mutex_unlock( &q.mutex );
+}
+
+static bool wait_for( coro_results &results, const int done, resume_queue *const queue ) throw( ) {
+	// (running queued resumptions meanwhile)
+	for( int i = 0; i < 10000 && results.done < done; ++ i ) {
+		std::vector<std::pair<botoc::coro::resumer,void *> > ready;
+		if( queue != NULL ) {
+			pthread_mutex_lock( &queue->mutex );
+			ready.swap( queue->queued );
+			pthread_mutex_unlock( &queue->mutex );
+		}
+		for( size_t j = 0; j < ready.size( ); ++ j ) {
+			ready[j].first( ready[j].second );
+		}
+		if( ready.empty( ) ) {
+			botoc::sleep_micros( 1000 );
+		}
+	}
+	return results.done == done;
+}
+#endif
+
+static bool count_page( botoc::ddb::record_list_t &page, void *context ) throw( ) {
+	// (parallel_scan calls this from several threads)
+	(void) __sync_fetch_and_add( (size_t *) context, page.size( ) );
+	return true;
+}
+
+static void count_completion( bool ok, size_t count, void *context ) throw( ) {
+	if( ok ) {
+		*(size_t *) context += count;
+	}
+}
+
+static void count_event( const botoc::ddb::metric_event &event, void *context ) throw( ) {
+	(void) event;
+	(void) __sync_fetch_and_add( (unsigned long long *) context, 1 );
+}
+
+static void *update_many( void *context ) throw( ) {
+	// context counts the updates which succeeded
+	botoc::ddb::item_list_t items;
+	items.push_back( botoc::ddb::item( "v", 1, botoc::ddb::ADD ) );
+	for( int i = 0; i < 50; ++ i ) {
+		if( botoc::ddb::update( "raced", "k", items ) ) {
+			++ *(int *) context;
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,384 @@
+# In-memory SQS and DynamoDB (API 2011-12-05) over HTTP, for checking the
+# native backend (BOTOC_NATIVE) without an AWS account; see bench/native/check.cpp.
+#
+#     python3 bench/native/server.py [port] [idle timeout seconds]
+#
+# Every request's Signature Version 4 signature is checked against the
+# credentials below (key "k", secret "s", region "eu-west-1"), and refused the
+# way AWS refuses it if it does not match. GET / returns request and
+# connection counts as JSON.
+#
+# Only the calls botoc makes are supported, with a few quirks to exercise its
+# error handling:
+# * GetQueueUrl fails for queues whose names start with "missing".
+# * queues starting "slow" take 100ms per request; queues starting "flaky"
+#   answer every other request with a 503.
+# * SendMessageBatch refuses messages starting "fail".
+# * tables starting "throttle" throttle every other request, and tables
+#   starting "down" always fail with a 500.
+# * BatchGetItem reads 7 keys and BatchWriteItem writes 9 items per request,
+#   returning the rest as unprocessed; Scan and Query pages hold 7 items.
+# * every table has a string hash key "id" (items written with a range key
+#   also get it as "r").
+
+import base64
+import hashlib
+import hmac
+import html
+import itertools
+import json
+import socket
+import sys
+import threading
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qsl
+
+KEY, SECRET, REGION = 'k', 's', 'eu-west-1'
+
+lock = threading.Lock()
+queues = {}  # name => list of [id, body, receipt handle, visible at]
+tables = {}  # name => key => item (keys with a range key are JSON)
+stats = {'requests': 0, 'connections': 0}
+ids = itertools.count()
+
+
+def check_signature(headers, path, body, service):
+    auth = headers['Authorization']
+    credential = auth.split('Credential=')[1].split(',')[0]
+    signed = auth.split('SignedHeaders=')[1].split(',')[0]
+    signature = auth.split('Signature=')[1]
+    key, date, region, scope_service, terminator = credential.split('/')
+    if key != KEY or region != REGION or scope_service != service:
+        raise ValueError('bad credential scope ' + credential)
+    canonical = '\n'.join([
+        'POST', path, '',
+        ''.join('%s:%s\n' % (name, headers[name].strip()) for name in signed.split(';')),
+        signed, hashlib.sha256(body).hexdigest()])
+    to_sign = '\n'.join([
+        'AWS4-HMAC-SHA256', headers['X-Amz-Date'],
+        '/'.join([date, region, scope_service, terminator]),
+        hashlib.sha256(canonical.encode()).hexdigest()])
+    k = ('AWS4' + SECRET).encode()
+    for part in (date, region, scope_service, 'aws4_request'):
+        k = hmac.new(k, part.encode(), hashlib.sha256).digest()
+    if hmac.new(k, to_sign.encode(), hashlib.sha256).hexdigest() != signature:
+        raise ValueError('bad signature')
+
+
+def escape(s):
+    return html.escape(s, quote=True)
+
+
+def batch_entries(params, prefix):
+    """[prefix].[n].[field] parameters, as a list of dicts in order of n"""
+    entries = {}
+    for name, value in params.items():
+        if name.startswith(prefix + '.'):
+            _, n, field = name.split('.')
+            entries.setdefault(int(n), {})[field] = value
+    return [entries[n] for n in sorted(entries)]
+
+
+def table_key(key):
+    """The key under which an item is stored in tables[...]"""
+    if list(key) == ['HashKeyElement'] and 'S' in key['HashKeyElement']:
+        return key['HashKeyElement']['S']
+    return json.dumps(key, sort_keys=True)
+
+
+def range_value(value):
+    return float(value['N']) if 'N' in value else list(value.values())[0]
+
+
+def pick(item, names):
+    return {n: v for n, v in item.items() if not names or n in names}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, *args):
+        pass
+
+    def setup(self):
+        super().setup()
+        stats['connections'] += 1
+        self.connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    def reply(self, status, body, content_type):
+        body = body.encode()
+        self.send_response(status)
+        self.send_header('Content-Type', content_type)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        self.reply(200, json.dumps(stats), 'application/json')
+
+    def do_POST(self):
+        stats['requests'] += 1
+        body = self.rfile.read(int(self.headers['Content-Length']))
+        if 'X-Amz-Target' in self.headers:
+            try:
+                check_signature(self.headers, self.path, body, 'dynamodb')
+            except ValueError as e:
+                return self.reply(403, json.dumps({'__type': 'com.amazon.coral.service#InvalidSignatureException', 'message': str(e)}), 'application/x-amz-json-1.0')
+            return self.ddb(self.headers['X-Amz-Target'].split('.')[1], json.loads(body))
+        try:
+            check_signature(self.headers, self.path, body, 'sqs')
+        except ValueError as e:
+            return self.reply(403, '<ErrorResponse><Error><Code>SignatureDoesNotMatch</Code><Message>%s</Message></Error></ErrorResponse>' % escape(str(e)), 'text/xml')
+        params = dict(parse_qsl(body.decode(), keep_blank_values=True))
+        self.sqs(params['Action'], params)
+
+    # SQS (query API, XML responses)
+
+    def sqs(self, action, p):
+        def ok(inner):
+            self.reply(200, '<%sResponse><%sResult>%s</%sResult></%sResponse>' % (action, action, inner, action, action), 'text/xml')
+
+        def error(code, message, status=400):
+            self.reply(status, '<ErrorResponse><Error><Type>Sender</Type><Code>%s</Code><Message>%s</Message></Error></ErrorResponse>' % (code, escape(message)), 'text/xml')
+
+        if action == 'GetQueueUrl':
+            name = p['QueueName']
+            if name.startswith('missing'):
+                return error('AWS.SimpleQueueService.NonExistentQueue', 'The specified queue does not exist.')
+            with lock:
+                queues.setdefault(name, [])
+            return ok('<QueueUrl>http://localhost/123456789012/%s</QueueUrl>' % name)
+
+        name = self.path.rsplit('/', 1)[1]
+        if name.startswith('slow'):
+            time.sleep(0.1)
+        if name.startswith('flaky'):
+            with lock:
+                stats['flaky_sqs'] = stats.get('flaky_sqs', 0) + 1
+                n = stats['flaky_sqs']
+            if n % 2 == 1:
+                return error('ServiceUnavailable', 'busy', 503)
+        queue = queues[name]
+
+        def find(handle):
+            for m in queue:
+                if m[2] == handle:
+                    return m
+
+        if action == 'SendMessage':
+            with lock:
+                queue.append([next(ids), p['MessageBody'], None, 0])
+            return ok('<MessageId>x</MessageId>')
+        if action == 'SendMessageBatch':
+            out = ''
+            for e in batch_entries(p, 'SendMessageBatchRequestEntry'):
+                if base64.b64decode(e['MessageBody']).startswith(b'fail'):
+                    out += '<BatchResultErrorEntry><Id>%s</Id><Code>X</Code><Message>refused</Message><SenderFault>true</SenderFault></BatchResultErrorEntry>' % e['Id']
+                else:
+                    with lock:
+                        queue.append([next(ids), e['MessageBody'], None, 0])
+                    out += '<SendMessageBatchResultEntry><Id>%s</Id></SendMessageBatchResultEntry>' % e['Id']
+            return ok(out)
+        if action == 'ReceiveMessage':
+            count = int(p.get('MaxNumberOfMessages', 1))
+            visibility = int(p.get('VisibilityTimeout', 30))
+            end = time.time() + int(p.get('WaitTimeSeconds', 0))
+            while True:
+                got = []
+                with lock:
+                    for m in queue:
+                        if len(got) < count and m[3] <= time.time():
+                            m[2] = 'rh-%d-%d' % (m[0], next(ids))
+                            m[3] = time.time() + visibility
+                            got.append(m)
+                if got or time.time() >= end:
+                    break
+                time.sleep(0.05)
+            return ok(''.join('<Message><MessageId>%d</MessageId><ReceiptHandle>%s</ReceiptHandle><MD5OfBody>x</MD5OfBody><Body>%s</Body></Message>' % (m[0], escape(m[2]), escape(m[1])) for m in got))
+        if action == 'DeleteMessage':
+            with lock:
+                m = find(p['ReceiptHandle'])
+                if m is None:
+                    return error('ReceiptHandleIsInvalid', 'bad handle')
+                queue.remove(m)
+            return ok('')
+        if action == 'DeleteMessageBatch':
+            out = ''
+            for e in batch_entries(p, 'DeleteMessageBatchRequestEntry'):
+                with lock:
+                    m = find(e['ReceiptHandle'])
+                    if m is None:
+                        out += '<BatchResultErrorEntry><Id>%s</Id><Code>ReceiptHandleIsInvalid</Code></BatchResultErrorEntry>' % e['Id']
+                    else:
+                        queue.remove(m)
+                        out += '<DeleteMessageBatchResultEntry><Id>%s</Id></DeleteMessageBatchResultEntry>' % e['Id']
+            return ok(out)
+        if action == 'ChangeMessageVisibility':
+            with lock:
+                m = find(p['ReceiptHandle'])
+                if m is None:
+                    return error('ReceiptHandleIsInvalid', 'bad handle')
+                m[3] = time.time() + int(p['VisibilityTimeout'])
+            return ok('')
+        if action == 'ChangeMessageVisibilityBatch':
+            out = ''
+            for e in batch_entries(p, 'ChangeMessageVisibilityBatchRequestEntry'):
+                with lock:
+                    m = find(e['ReceiptHandle'])
+                    if m is None:
+                        out += '<BatchResultErrorEntry><Id>%s</Id><Code>ReceiptHandleIsInvalid</Code></BatchResultErrorEntry>' % e['Id']
+                    else:
+                        m[3] = time.time() + int(e['VisibilityTimeout'])
+                        out += '<ChangeMessageVisibilityBatchResultEntry><Id>%s</Id></ChangeMessageVisibilityBatchResultEntry>' % e['Id']
+            return ok(out)
+        return error('InvalidAction', action)
+
+    # DynamoDB (JSON API 2011-12-05)
+
+    def ddb(self, operation, d):
+        def ok(response):
+            self.reply(200, json.dumps(response), 'application/x-amz-json-1.0')
+
+        def error(kind, message):
+            self.reply(400, json.dumps({'__type': 'com.amazonaws.dynamodb.v20111205#' + kind, 'message': message}), 'application/x-amz-json-1.0')
+
+        name = d.get('TableName', '')
+        if name.startswith('throttle'):
+            with lock:
+                stats['flaky_ddb'] = stats.get('flaky_ddb', 0) + 1
+                n = stats['flaky_ddb']
+            if n % 2 == 1:
+                return error('ProvisionedThroughputExceededException', 'slow down')
+        if name.startswith('down'):
+            return self.reply(500, json.dumps({'__type': 'com.amazon.coral.service#InternalFailure', 'message': 'down'}), 'application/x-amz-json-1.0')
+
+        if operation == 'DescribeTable':
+            return ok({'Table': {'TableName': name, 'KeySchema': {'HashKeyElement': {'AttributeName': 'id', 'AttributeType': 'S'}}}})
+        if operation == 'BatchGetItem':
+            responses = {}
+            unprocessed = {}
+            for name, request in d['RequestItems'].items():
+                table = tables.setdefault(name, {})
+                keys = request['Keys']
+                if len(keys) > 100:
+                    return error('ValidationException', 'too many keys')
+                hashes = [k['HashKeyElement']['S'] for k in keys]
+                if len(set(hashes)) != len(hashes):
+                    return error('ValidationException', 'duplicate keys')
+                items = []
+                with lock:
+                    for k in hashes[:7]:
+                        if k in table:
+                            items.append(pick(table[k], request.get('AttributesToGet')))
+                responses[name] = {'Items': items, 'ConsumedCapacityUnits': len(items)}
+                if keys[7:]:
+                    unprocessed[name] = dict(request, Keys=keys[7:])
+            return ok({'Responses': responses, 'UnprocessedKeys': unprocessed})
+        if operation == 'BatchWriteItem':
+            responses = {}
+            unprocessed = {}
+            with lock:
+                for name, requests in d['RequestItems'].items():
+                    if len(requests) > 25:
+                        return error('ValidationException', 'too many items')
+                    table = tables.setdefault(name, {})
+                    keys = [r['PutRequest']['Item']['id']['S'] if 'PutRequest' in r else r['DeleteRequest']['Key']['HashKeyElement']['S'] for r in requests]
+                    if len(set(keys)) != len(keys):
+                        return error('ValidationException', 'duplicate keys')
+                    for k, r in list(zip(keys, requests))[:9]:
+                        if 'PutRequest' in r:
+                            table[k] = r['PutRequest']['Item']
+                        else:
+                            table.pop(k, None)
+                    responses[name] = {'ConsumedCapacityUnits': min(9, len(requests))}
+                    if requests[9:]:
+                        unprocessed[name] = requests[9:]
+            return ok({'Responses': responses, 'UnprocessedItems': unprocessed})
+        if operation == 'Scan':
+            table = tables.setdefault(name, {})
+            segment = d.get('Segment', 0)
+            segments = d.get('TotalSegments', 1)
+            with lock:
+                keys = sorted(k for k in table if zlib.crc32(k.encode()) % segments == segment)
+            if 'ExclusiveStartKey' in d:
+                start = table_key(d['ExclusiveStartKey'])
+                keys = [k for k in keys if k > start]
+            page = keys[:7]
+            response = {'Items': [pick(table[k], d.get('AttributesToGet')) for k in page], 'ConsumedCapacityUnits': 10.0}
+            if len(page) < len(keys):
+                last = page[-1]
+                response['LastEvaluatedKey'] = json.loads(last) if last.startswith('{') else {'HashKeyElement': {'S': last}}
+            return ok(response)
+        if operation == 'Query':
+            table = tables.setdefault(name, {})
+            forward = d.get('ScanIndexForward', True)
+            with lock:
+                ranges = [json.loads(k)['RangeKeyElement'] for k in table if k.startswith('{') and json.loads(k)['HashKeyElement'] == d['HashKeyValue']]
+            ranges.sort(key=range_value, reverse=not forward)
+            condition = d.get('RangeKeyCondition')
+            if condition:
+                values = [range_value(v) for v in condition['AttributeValueList']]
+                match = {
+                    'EQ': lambda v: v == values[0],
+                    'LE': lambda v: v <= values[0],
+                    'LT': lambda v: v < values[0],
+                    'GE': lambda v: v >= values[0],
+                    'GT': lambda v: v > values[0],
+                    'BETWEEN': lambda v: values[0] <= v <= values[1],
+                    'BEGINS_WITH': lambda v: v.startswith(values[0]),
+                }[condition['ComparisonOperator']]
+                ranges = [r for r in ranges if match(range_value(r))]
+            if 'ExclusiveStartKey' in d:
+                start = range_value(d['ExclusiveStartKey']['RangeKeyElement'])
+                ranges = [r for r in ranges if (range_value(r) > start if forward else range_value(r) < start)]
+            page = ranges[:min(d.get('Limit', 7), 7)]
+            items = [pick(table[table_key({'HashKeyElement': d['HashKeyValue'], 'RangeKeyElement': r})], d.get('AttributesToGet')) for r in page]
+            response = {'Items': items, 'Count': len(items), 'ConsumedCapacityUnits': 1.0}
+            if len(page) < len(ranges):
+                response['LastEvaluatedKey'] = {'HashKeyElement': d['HashKeyValue'], 'RangeKeyElement': page[-1]}
+            return ok(response)
+
+        table = tables.setdefault(name, {})
+        k = table_key(d['Key'])
+        with lock:
+            item = table.get(k)
+            if operation == 'GetItem':
+                if item is None:
+                    return ok({'ConsumedCapacityUnits': 0.5})
+                return ok({'Item': pick(item, d.get('AttributesToGet')), 'ConsumedCapacityUnits': 1.0 if d.get('ConsistentRead') else 0.5})
+            if operation == 'UpdateItem':
+                for attribute, expected in d.get('Expected', {}).items():
+                    current = (item or {}).get(attribute)
+                    if ('Exists' in expected and not expected['Exists'] and current is not None) or ('Value' in expected and current != expected['Value']):
+                        return error('ConditionalCheckFailedException', 'The conditional request failed')
+                if item is None:
+                    item = {'id': d['Key']['HashKeyElement']}
+                    if 'RangeKeyElement' in d['Key']:
+                        item['r'] = d['Key']['RangeKeyElement']
+                item = dict(item)
+                for attribute, update in d['AttributeUpdates'].items():
+                    action = update.get('Action', 'PUT')
+                    if action == 'DELETE' and 'Value' not in update:
+                        item.pop(attribute, None)
+                    elif action == 'ADD':
+                        (kind, value), = update['Value'].items()
+                        if kind == 'N':
+                            item[attribute] = {'N': str(int(float(item.get(attribute, {'N': '0'})['N']) + float(value)))}
+                        else:
+                            item[attribute] = {kind: sorted(set(item.get(attribute, {kind: []})[kind]) | set(value))}
+                    else:
+                        item[attribute] = update['Value']
+                table[k] = item
+                return ok({'ConsumedCapacityUnits': 1.0})
+        return error('UnknownOperationException', operation)
+
+
+if __name__ == '__main__':
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 8123
+    if len(sys.argv) > 2:
+        Handler.timeout = float(sys.argv[2])  # idle keep-alive connections are closed after this
+    ThreadingHTTPServer.daemon_threads = True
+    ThreadingHTTPServer.request_queue_size = 128
+    ThreadingHTTPServer(('127.0.0.1', port), Handler).serve_forever()
@@ -0,0 +1,923 @@
+// botoc_async.h: asynchronous versions of the SQS and DDB calls
+// Copyright 2013, Poikos Ltd.
+// Author: David Evans
+
+// usage:
+//  1: include python (first!), unless BOTOC_NATIVE is set
+//  2: include botoc_sqs.h and / or botoc_ddb.h, then this header
+//  3: call botoc::set_iam_user( key, secret ) and botoc::set_region( region )
+//  4: use as the synchronous calls, passing a botoc::async::future last:
+//       botoc::async::future f[( callback, context )];
+//       botoc::sqs::put_async( queue, message, f )
+//       botoc::sqs::put_batch_async( queue, messages, sent, f )
+//       botoc::sqs::get_async( queue, message, handle, lock, wait, f )
+//       botoc::sqs::get_batch_async( queue, max, lock, wait, messages, f )
+//       botoc::sqs::remove_async( queue, handle, f )
+//       botoc::sqs::remove_batch_async( queue, handles, removed, f )
+//       botoc::sqs::extend_async( queue, handle, lock, f )
+//       botoc::sqs::extend_batch_async( queue, handles, lock, extended, f )
+//       botoc::ddb::update_async( table, key, items, expected, f )
+//       botoc::ddb::get_async( table, key, consistent, items, f )
+//       botoc::ddb::batch_get_async( table, keys, attributes, consistent, results, f )
+//       botoc::ddb::batch_put_async( table, records, f )
+//       botoc::ddb::batch_delete_async( table, keys, f )
+//       botoc::ddb::query_async( table, hash, condition, limit, callback, context, f )
+//       botoc::ddb::parallel_scan_async( table, segments, attributes, callback, context, f )
+//       f.wait( ) / f.ready( ) / f.ok( ) / f.count( )
+//       botoc::async::set_threads( count )
+//       botoc::async::shutdown( )
+//  5: link with python (not needed with BOTOC_NATIVE)
+
+// inputs are copied when the call is made; outputs (and sent / removed /
+// extended) are written by an I/O thread, so they must stay valid (and
+// untouched) until the future completes. A future can be reused once it has
+// completed, and destroying a pending future waits for it. The page callbacks
+// of query_async and parallel_scan_async run on the I/O threads.
+
+// requests run on a pool of I/O threads (8 by default). Without
+// BOTOC_THREADSAFE there is only 1, and the rest of the program must not call
+// botoc while requests are outstanding (as with botoc::sqs::consumer).
+// Call shutdown( ) before exiting, disconnecting or changing credentials.
+
+#ifndef BOTOC_ASYNC_H_INCLUDED__
+#define BOTOC_ASYNC_H_INCLUDED__
+
+#include "botoc_common.h"
+
+#if !defined(BOTOC_SQS_H_INCLUDED__) && !defined(BOTOC_DDB_H_INCLUDED__)
+#  error "include botoc_sqs.h and / or botoc_ddb.h before botoc_async.h"
+#endif
+
+namespace botoc {
+	namespace async {
+		/* constants */
+		
+		enum defaults {
+			DEFAULT_THREADS = 8
+		};
+		
+		/* types */
+		
+		// called on an I/O thread when a request completes, before waiters wake;
+		// count is the number of items handled (for the batch calls)
+		typedef void (*completion)( bool ok, size_t count, void *context );
+		
+		/* classes */
+		
+		class future {
+		private:
+			completion _callback;
+			void *_context;
+			completion _notify;
+			void *_notifyContext;
+			pthread_mutex_t _mutex;
+			pthread_cond_t _completed;
+			bool _pending;
+			bool _ok;
+			size_t _count;
+			
+			future( const future & );
+			future &operator =( const future & );
+			
+		public:
+			inline explicit future( completion callback = NULL, void *context = NULL ) _noexcept :
+			_callback( callback ),
+			_context( context ),
+			_notify( NULL ),
+			_notifyContext( NULL ),
+			_pending( false ),
+			_ok( false ),
+			_count( 0 )
+			{
+				pthread_mutex_init( &_mutex, NULL );
+				pthread_cond_init( &_completed, NULL );
+			}
+			
+			inline ~future( void ) _noexcept {
+				(void) wait( );
+				pthread_cond_destroy( &_completed );
+				pthread_mutex_destroy( &_mutex );
+			}
+			
+			// true once the request has completed (or if none was made)
+			__attribute__((warn_unused_result))
+			inline bool ready( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				const bool r = !_pending;
+				pthread_mutex_unlock( &_mutex );
+				return r;
+			}
+			
+			// waits for the request to complete and returns ok( )
+			inline bool wait( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				while( _pending ) {
+					pthread_cond_wait( &_completed, &_mutex );
+				}
+				const bool r = _ok;
+				pthread_mutex_unlock( &_mutex );
+				return r;
+			}
+			
+			__attribute__((warn_unused_result))
+			inline bool ok( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				const bool r = !_pending && _ok;
+				pthread_mutex_unlock( &_mutex );
+				return r;
+			}
+			
+			// items handled by a batch call (1 or 0 for the others)
+			__attribute__((warn_unused_result))
+			inline size_t count( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				const size_t r = _pending ? 0 : _count;
+				pthread_mutex_unlock( &_mutex );
+				return r;
+			}
+			
+			// (used by submit)
+			__attribute__((warn_unused_result))
+			inline bool _begin( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				const bool idle = !_pending;
+				_pending = true;
+				_ok = false;
+				_count = 0;
+				pthread_mutex_unlock( &_mutex );
+				return idle;
+			}
+			
+			// (used by botoc_coro.h; called after waiters wake, so the future may
+			// already have been destroyed)
+			inline void _after( completion notify, void *context ) _noexcept {
+				_notify = notify;
+				_notifyContext = context;
+			}
+			
+			// (used by the I/O threads; the future may be destroyed as soon as
+			// waiters wake, so it is not touched after that)
+			inline void _finish( const bool ok, const size_t count ) _noexcept {
+				if( _callback != NULL ) {
+					_callback( ok, count, _context );
+				}
+				const completion notify = _notify;
+				void *const notifyContext = _notifyContext;
+				pthread_mutex_lock( &_mutex );
+				_ok = ok;
+				_count = count;
+				_pending = false;
+				pthread_cond_broadcast( &_completed );
+				pthread_mutex_unlock( &_mutex );
+				if( notify != NULL ) {
+					notify( ok, count, notifyContext );
+				}
+			}
+		};
+		
+		class task {
+		private:
+			task( const task & );
+			task &operator =( const task & );
+			
+		public:
+			future *result;
+			client *owner; // current when the call was made
+			task *next; // (queue link)
+			
+			inline task( void ) _noexcept :
+			result( NULL ),
+			owner( NULL ),
+			next( NULL )
+			{
+			}
+			
+			virtual ~task( void ) {
+			}
+			
+			// performs the request; count is 1 or 0 unless it is a batch call
+			virtual bool run( size_t &count ) _noexcept = 0;
+		};
+		
+		/* types */
+		
+		struct pool_state {
+			task *head;
+			task *tail;
+			std::vector<pthread_t> threads;
+			int wanted;
+			bool stopping;
+			pthread_mutex_t mutex;
+			pthread_cond_t work;
+			
+			inline pool_state( void ) _noexcept :
+			head( NULL ),
+			tail( NULL ),
+			threads( ),
+#if BOTOC_THREADSAFE
+			wanted( DEFAULT_THREADS ),
+#else
+			wanted( 1 ),
+#endif
+			stopping( false )
+			{
+				pthread_mutex_init( &mutex, NULL );
+				pthread_cond_init( &work, NULL );
+			}
+		};
+		
+		/* prototypes */
+		
+		// Sets the number of I/O threads (i.e. requests in flight at once);
+		// extra threads are started by the next call, but the pool only
+		// shrinks after shutdown( ). Always 1 without BOTOC_THREADSAFE.
+		__attribute__((unused))
+		static void set_threads( int count ) _noexcept;
+		
+		// Waits for all queued requests, then stops the I/O threads (they are
+		// started again by the next call).
+		__attribute__((unused))
+		static void shutdown( void ) _noexcept;
+		
+		/* internal prototypes */
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline pool_state &pool( void ) _noexcept;
+		
+		static void *worker( void *pool ) _noexcept;
+		
+		// queues t (taking ownership) to complete result
+		__attribute__((unused))
+		static bool submit( task *t, future &result ) _noexcept;
+		
+		// completes result as a failure without making a request
+		__attribute__((unused))
+		static bool fail( future &result ) _noexcept;
+		
+		/* implementation */
+		
+		static inline pool_state &pool( void ) _noexcept {
+			static pool_state state;
+			return state;
+		}
+		
+		static void *worker( void *const state ) _noexcept {
+			pool_state &p = *(pool_state *) state;
+			pthread_mutex_lock( &p.mutex );
+			while( true ) {
+				while( p.head == NULL && !p.stopping ) {
+					pthread_cond_wait( &p.work, &p.mutex );
+				}
+				if( p.head == NULL ) {
+					break; // stopping, and nothing left to do
+				}
+				task *t = p.head;
+				p.head = t->next;
+				if( p.head == NULL ) {
+					p.tail = NULL;
+				}
+				pthread_mutex_unlock( &p.mutex );
+				
+				size_t count = 0;
+				bool ok;
+				LOCALBLOCK {
+					client_scope use( *t->owner );
+					ok = t->run( count );
+				}
+				future *result = t->result;
+				delete t;
+				result->_finish( ok, count );
+				
+				pthread_mutex_lock( &p.mutex );
+			}
+			pthread_mutex_unlock( &p.mutex );
+			return NULL;
+		}
+		
+		static bool submit( task *const t, future &result ) _noexcept {
+			if( unlikely( !result._begin( ) ) ) {
+				fprintf( stderr, "botoc: future used for a second request before the first completed\n" );
+				delete t;
+				return false;
+			}
+			t->result = &result;
+			t->owner = &current_client( );
+			t->next = NULL;
+			
+			pool_state &p = pool( );
+			pthread_mutex_lock( &p.mutex );
+			try {
+				while( (int) p.threads.size( ) < p.wanted ) {
+					pthread_t thread;
+					if( pthread_create( &thread, NULL, &worker, &p ) != 0 ) {
+						break;
+					}
+					p.threads.push_back( thread );
+				}
+			} catch( ... ) {
+			}
+			if( unlikely( p.threads.size( ) == 0 ) ) {
+				pthread_mutex_unlock( &p.mutex );
+				fprintf( stderr, "could not start botoc I/O threads\n" );
+				delete t;
+				result._finish( false, 0 );
+				return false;
+			}
+			if( p.tail == NULL ) {
+				p.head = t;
+			} else {
+				p.tail->next = t;
+			}
+			p.tail = t;
+			pthread_cond_signal( &p.work );
+			pthread_mutex_unlock( &p.mutex );
+			return true;
+		}
+		
+		static bool fail( future &result ) _noexcept {
+			if( result._begin( ) ) {
+				result._finish( false, 0 );
+			}
+			return false;
+		}
+		
+		static void set_threads( const int count ) _noexcept {
+#if BOTOC_THREADSAFE
+			pool_state &p = pool( );
+			pthread_mutex_lock( &p.mutex );
+			p.wanted = (count > 1) ? count : 1;
+			pthread_mutex_unlock( &p.mutex );
+#else
+			(void) count; // Python and the connection can only be used from one thread
+#endif
+		}
+		
+		static void shutdown( void ) _noexcept {
+			pool_state &p = pool( );
+			pthread_mutex_lock( &p.mutex );
+			std::vector<pthread_t> threads;
+			threads.swap( p.threads );
+			p.stopping = true;
+			pthread_cond_broadcast( &p.work );
+			pthread_mutex_unlock( &p.mutex );
+			
+			for( size_t i = 0, e = threads.size( ); i < e; ++ i ) {
+				pthread_join( threads[i], NULL );
+			}
+			
+			pthread_mutex_lock( &p.mutex );
+			p.stopping = false;
+			pthread_mutex_unlock( &p.mutex );
+		}
+	}
+
+#ifdef BOTOC_SQS_H_INCLUDED__
+	namespace sqs {
+		/* classes */
+		
+		class put_task : public async::task {
+		private:
+			const string_t _queue;
+			const string_t _message;
+			
+		public:
+			inline put_task( const const_string_t &queue, const const_string_t &message ) _throws_bad_alloc :
+			_queue( queue ),
+			_message( message )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				const bool ok = put( _queue, _message );
+				count = ok ? 1 : 0;
+				return ok;
+			}
+		};
+		
+		class put_batch_task : public async::task {
+		private:
+			const string_t _queue;
+			const string_list_t _messages;
+			std::vector<bool> *const _sent;
+			
+		public:
+			inline put_batch_task( const const_string_t &queue, const string_list_t &messages, std::vector<bool> *sent ) _throws_bad_alloc :
+			_queue( queue ),
+			_messages( messages ),
+			_sent( sent )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				count = put_batch( _queue, _messages, _sent );
+				return count == _messages.size( );
+			}
+		};
+		
+		class get_task : public async::task {
+		private:
+			const string_t _queue;
+			string_t *const _body;
+			handle_t *const _handle;
+			const int _lockSeconds;
+			const int _waitSeconds;
+			
+		public:
+			inline get_task( const const_string_t &queue, string_t &body, handle_t &handle, int lockSeconds, int waitSeconds ) _throws_bad_alloc :
+			_queue( queue ),
+			_body( &body ),
+			_handle( &handle ),
+			_lockSeconds( lockSeconds ),
+			_waitSeconds( waitSeconds )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				*_handle = get( _queue, *_body, _lockSeconds, _waitSeconds );
+				count = (*_handle != NULL) ? 1 : 0;
+				return *_handle != NULL;
+			}
+		};
+		
+		class get_batch_task : public async::task {
+		private:
+			const string_t _queue;
+			const int _maxCount;
+			const int _lockSeconds;
+			const int _waitSeconds;
+			message_list_t *const _messages;
+			
+		public:
+			inline get_batch_task( const const_string_t &queue, int maxCount, int lockSeconds, int waitSeconds, message_list_t &messages ) _throws_bad_alloc :
+			_queue( queue ),
+			_maxCount( maxCount ),
+			_lockSeconds( lockSeconds ),
+			_waitSeconds( waitSeconds ),
+			_messages( &messages )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				const bool ok = get_batch( _queue, _maxCount, _lockSeconds, _waitSeconds, *_messages );
+				count = ok ? _messages->size( ) : 0;
+				return ok;
+			}
+		};
+		
+		class remove_task : public async::task {
+		private:
+			const string_t _queue;
+			const handle_t _handle;
+			const int _lockSeconds; // extend only; -1 to remove
+			
+		public:
+			inline remove_task( const const_string_t &queue, handle_t handle, int lockSeconds ) _throws_bad_alloc :
+			_queue( queue ),
+			_handle( handle ),
+			_lockSeconds( lockSeconds )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				const bool ok = (_lockSeconds < 0) ? remove( _queue, _handle ) : extend( _queue, _handle, _lockSeconds );
+				count = ok ? 1 : 0;
+				return ok;
+			}
+		};
+		
+		class remove_batch_task : public async::task {
+		private:
+			const string_t _queue;
+			const handle_list_t _handles;
+			const int _lockSeconds; // extend only; -1 to remove
+			std::vector<bool> *const _done;
+			
+		public:
+			inline remove_batch_task( const const_string_t &queue, const handle_list_t &handles, int lockSeconds, std::vector<bool> *done ) _throws_bad_alloc :
+			_queue( queue ),
+			_handles( handles ),
+			_lockSeconds( lockSeconds ),
+			_done( done )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				count = (_lockSeconds < 0) ? remove_batch( _queue, _handles, _done ) : extend_batch( _queue, _handles, _lockSeconds, _done );
+				return count == _handles.size( );
+			}
+		};
+		
+		/* prototypes */
+		
+		__attribute__((unused))
+		static bool put_async( const const_string_t &queue, const const_string_t &message, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool put_batch_async( const const_string_t &queue, const string_list_t &messages, std::vector<bool> *sent, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool get_async( const const_string_t &queue, string_t &body, handle_t &handle, int lockSeconds, int waitSeconds, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool get_batch_async( const const_string_t &queue, int maxCount, int lockSeconds, int waitSeconds, message_list_t &messages, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool remove_async( const const_string_t &queue, handle_t handle, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool remove_batch_async( const const_string_t &queue, const handle_list_t &handles, std::vector<bool> *removed, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool extend_async( const const_string_t &queue, handle_t handle, int lockSeconds, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool extend_batch_async( const const_string_t &queue, const handle_list_t &handles, int lockSeconds, std::vector<bool> *extended, async::future &result ) _noexcept;
+		
+		/* implementation */
+		
+		static bool put_async( const const_string_t &queue, const const_string_t &message, async::future &result ) _noexcept {
+			try {
+				return async::submit( new put_task( queue, message ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool put_batch_async( const const_string_t &queue, const string_list_t &messages, std::vector<bool> *const sent, async::future &result ) _noexcept {
+			try {
+				return async::submit( new put_batch_task( queue, messages, sent ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool get_async( const const_string_t &queue, string_t &body, handle_t &handle, const int lockSeconds, const int waitSeconds, async::future &result ) _noexcept {
+			try {
+				return async::submit( new get_task( queue, body, handle, lockSeconds, waitSeconds ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool get_batch_async( const const_string_t &queue, const int maxCount, const int lockSeconds, const int waitSeconds, message_list_t &messages, async::future &result ) _noexcept {
+			try {
+				return async::submit( new get_batch_task( queue, maxCount, lockSeconds, waitSeconds, messages ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool remove_async( const const_string_t &queue, const handle_t handle, async::future &result ) _noexcept {
+			try {
+				return async::submit( new remove_task( queue, handle, -1 ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool remove_batch_async( const const_string_t &queue, const handle_list_t &handles, std::vector<bool> *const removed, async::future &result ) _noexcept {
+			try {
+				return async::submit( new remove_batch_task( queue, handles, -1, removed ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool extend_async( const const_string_t &queue, const handle_t handle, const int lockSeconds, async::future &result ) _noexcept {
+			try {
+				return async::submit( new remove_task( queue, handle, (lockSeconds > 0) ? lockSeconds : 0 ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool extend_batch_async( const const_string_t &queue, const handle_list_t &handles, const int lockSeconds, std::vector<bool> *const extended, async::future &result ) _noexcept {
+			try {
+				return async::submit( new remove_batch_task( queue, handles, (lockSeconds > 0) ? lockSeconds : 0, extended ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+	}
+#endif
+
+#ifdef BOTOC_DDB_H_INCLUDED__
+	namespace ddb {
+		/* classes */
+		
+		class update_task : public async::task {
+		private:
+			const string_t _db;
+			const item_key _key;
+			const item_list_t _items;
+			const item_list_t _expected;
+			
+		public:
+			inline update_task( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *expected ) _throws_bad_alloc :
+			_db( db ),
+			_key( key ),
+			_items( items ),
+			_expected( (expected != NULL) ? *expected : item_list_t( ) )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				const bool ok = update( _db, _key, _items, &_expected );
+				count = ok ? 1 : 0;
+				return ok;
+			}
+		};
+		
+		class get_task : public async::task {
+		private:
+			const string_t _db;
+			const item_key _key;
+			const bool _consistent;
+			item_list_t *const _items;
+			
+		public:
+			inline get_task( const const_string_t &db, const item_key &key, bool consistent, item_list_t &items ) _throws_bad_alloc :
+			_db( db ),
+			_key( key ),
+			_consistent( consistent ),
+			_items( &items )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				const bool ok = get( _db, _key, _consistent, *_items );
+				count = ok ? 1 : 0;
+				return ok;
+			}
+		};
+		
+		class batch_get_task : public async::task {
+		private:
+			const string_t _db;
+			const string_list_t _keys;
+			const item_list_t _attributes;
+			const bool _consistent;
+			item_map_t *const _results;
+			
+		public:
+			inline batch_get_task( const const_string_t &db, const string_list_t &keys, const item_list_t &attributes, bool consistent, item_map_t &results ) _throws_bad_alloc :
+			_db( db ),
+			_keys( keys ),
+			_attributes( attributes ),
+			_consistent( consistent ),
+			_results( &results )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				const bool ok = batch_get( _db, _keys, _attributes, _consistent, *_results );
+				count = _results->size( );
+				return ok;
+			}
+		};
+		
+		class batch_write_task : public async::task {
+		private:
+			const string_t _db;
+			const item_map_t _records; // (puts)
+			string_list_t _keys;       // (deletes; distinct)
+			const bool _delete;
+			const int _inFlight;
+			
+		public:
+			inline batch_write_task( const const_string_t &db, const item_map_t &records, int inFlight ) _throws_bad_alloc :
+			_db( db ),
+			_records( records ),
+			_keys( ),
+			_delete( false ),
+			_inFlight( inFlight )
+			{
+			}
+			
+			inline batch_write_task( const const_string_t &db, const string_list_t &keys, int inFlight ) _throws_bad_alloc :
+			_db( db ),
+			_records( ),
+			_keys( keys ),
+			_delete( true ),
+			_inFlight( inFlight )
+			{
+				// so that success can be judged by the count
+				std::sort( _keys.begin( ), _keys.end( ) );
+				_keys.erase( std::unique( _keys.begin( ), _keys.end( ) ), _keys.end( ) );
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				if( _delete ) {
+					count = batch_delete( _db, _keys, _inFlight );
+					return count == _keys.size( );
+				}
+				count = batch_put( _db, _records, _inFlight );
+				return count == _records.size( );
+			}
+		};
+		
+		class page_task : public async::task {
+		private:
+			const page_callback _callback;
+			void *const _context;
+			size_t _records;
+			
+		protected:
+			// passes pages on to the caller's callback, counting the records
+			// (parallel_scan can call it from several threads at once)
+			static bool counted( record_list_t &page, void *const self ) _noexcept {
+				page_task &t = *(page_task *) self;
+				(void) __sync_fetch_and_add( &t._records, page.size( ) );
+				return t._callback( page, t._context );
+			}
+			
+			inline size_t records( void ) const _noexcept {
+				return _records;
+			}
+			
+		public:
+			inline page_task( page_callback callback, void *context ) _noexcept :
+			_callback( callback ),
+			_context( context ),
+			_records( 0 )
+			{
+			}
+		};
+		
+		class query_task : public page_task {
+		private:
+			const string_t _db;
+			const item _hash;
+			const range_condition _condition;
+			const size_t _limit;
+			const bool _consistent;
+			const bool _forward;
+			const bool _attributesGiven;
+			const item_list_t _attributes;
+			
+		public:
+			inline query_task( const const_string_t &db, const item &hash, const range_condition &condition, size_t limit, page_callback callback, void *context, bool consistent, bool forward, const item_list_t *attributes ) _throws_bad_alloc :
+			page_task( callback, context ),
+			_db( db ),
+			_hash( hash ),
+			_condition( condition ),
+			_limit( limit ),
+			_consistent( consistent ),
+			_forward( forward ),
+			_attributesGiven( attributes != NULL ),
+			_attributes( (attributes != NULL) ? *attributes : item_list_t( ) )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				const bool ok = query( _db, _hash, _condition, _limit, &counted, this, _consistent, _forward, _attributesGiven ? &_attributes : NULL );
+				count = records( );
+				return ok;
+			}
+		};
+		
+		class scan_task : public page_task {
+		private:
+			const string_t _db;
+			const int _segments;
+			const bool _attributesGiven;
+			const item_list_t _attributes;
+			const double _maxUnits;
+			
+		public:
+			inline scan_task( const const_string_t &db, int segments, const item_list_t *attributes, page_callback callback, void *context, double maxUnits ) _throws_bad_alloc :
+			page_task( callback, context ),
+			_db( db ),
+			_segments( segments ),
+			_attributesGiven( attributes != NULL ),
+			_attributes( (attributes != NULL) ? *attributes : item_list_t( ) ),
+			_maxUnits( maxUnits )
+			{
+			}
+			
+			virtual bool run( size_t &count ) _noexcept {
+				const bool ok = parallel_scan( _db, _segments, _attributesGiven ? &_attributes : NULL, &counted, this, _maxUnits );
+				count = records( );
+				return ok;
+			}
+		};
+		
+		/* prototypes */
+		
+		__attribute__((unused))
+		static bool update_async( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *expected, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool update_async( const const_string_t &db, const const_string_t &key, const item_list_t &items, const item_list_t *expected, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool get_async( const const_string_t &db, const item_key &key, bool consistent, item_list_t &items, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool get_async( const const_string_t &db, const const_string_t &key, bool consistent, item_list_t &items, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool batch_get_async( const const_string_t &db, const string_list_t &keys, const item_list_t &attributes, bool consistent, item_map_t &results, async::future &result ) _noexcept;
+		
+		__attribute__((unused))
+		static bool batch_put_async( const const_string_t &db, const item_map_t &records, async::future &result, int inFlight = 4 ) _noexcept;
+		
+		__attribute__((unused))
+		static bool batch_delete_async( const const_string_t &db, const string_list_t &keys, async::future &result, int inFlight = 4 ) _noexcept;
+		
+		// (count( ) is the number of records handed to callback)
+		__attribute__((unused))
+		static bool query_async( const const_string_t &db, const item &hash, const range_condition &condition, size_t limit, page_callback callback, void *context, async::future &result, bool consistent = false, bool forward = true, const item_list_t *attributes = NULL ) _noexcept;
+		
+		__attribute__((unused))
+		static bool query_async( const const_string_t &db, const const_string_t &hash, const range_condition &condition, size_t limit, page_callback callback, void *context, async::future &result, bool consistent = false, bool forward = true, const item_list_t *attributes = NULL ) _noexcept;
+		
+		__attribute__((unused))
+		static bool parallel_scan_async( const const_string_t &db, int segments, const item_list_t *attributes, page_callback callback, void *context, async::future &result, double maxUnits = 0.0 ) _noexcept;
+		
+		/* implementation */
+		
+		static bool update_async( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *const expected, async::future &result ) _noexcept {
+			try {
+				return async::submit( new update_task( db, key, items, expected ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool update_async( const const_string_t &db, const const_string_t &key, const item_list_t &items, const item_list_t *const expected, async::future &result ) _noexcept {
+			try {
+				return async::submit( new update_task( db, item_key( key ), items, expected ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool get_async( const const_string_t &db, const item_key &key, const bool consistent, item_list_t &items, async::future &result ) _noexcept {
+			try {
+				return async::submit( new get_task( db, key, consistent, items ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool get_async( const const_string_t &db, const const_string_t &key, const bool consistent, item_list_t &items, async::future &result ) _noexcept {
+			try {
+				return async::submit( new get_task( db, item_key( key ), consistent, items ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool batch_get_async( const const_string_t &db, const string_list_t &keys, const item_list_t &attributes, const bool consistent, item_map_t &results, async::future &result ) _noexcept {
+			try {
+				return async::submit( new batch_get_task( db, keys, attributes, consistent, results ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool batch_put_async( const const_string_t &db, const item_map_t &records, async::future &result, const int inFlight ) _noexcept {
+			try {
+				return async::submit( new batch_write_task( db, records, inFlight ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool batch_delete_async( const const_string_t &db, const string_list_t &keys, async::future &result, const int inFlight ) _noexcept {
+			try {
+				return async::submit( new batch_write_task( db, keys, inFlight ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool query_async( const const_string_t &db, const item &hash, const range_condition &condition, const size_t limit, const page_callback callback, void *const context, async::future &result, const bool consistent, const bool forward, const item_list_t *const attributes ) _noexcept {
+			try {
+				return async::submit( new query_task( db, hash, condition, limit, callback, context, consistent, forward, attributes ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool query_async( const const_string_t &db, const const_string_t &hash, const range_condition &condition, const size_t limit, const page_callback callback, void *const context, async::future &result, const bool consistent, const bool forward, const item_list_t *const attributes ) _noexcept {
+			try {
+				return async::submit( new query_task( db, item( string_t( ), hash, STRING ), condition, limit, callback, context, consistent, forward, attributes ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+		
+		static bool parallel_scan_async( const const_string_t &db, const int segments, const item_list_t *const attributes, const page_callback callback, void *const context, async::future &result, const double maxUnits ) _noexcept {
+			try {
+				return async::submit( new scan_task( db, segments, attributes, callback, context, maxUnits ), result );
+			} catch( ... ) {
+				return async::fail( result );
+			}
+		}
+	}
+#endif
+}
+
+#endif
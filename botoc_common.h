@@ -11,6 +11,16 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <new>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <pthread.h>
 
 /* enable fancy compiler extras if they are available */
 
@@ -45,8 +55,58 @@
 #  define _noexcept throw()
 #endif
 
+// dynamic exception specifications were removed in C++17
+#if LANGUAGE_CPP && __cplusplus >= 201703L
+#  define _throws_bad_alloc noexcept(false)
+#else
+#  define _throws_bad_alloc throw( std::bad_alloc )
+#endif
+
 #define LOCALBLOCK
 
+/* Set BOTOC_THREADSAFE to 1 (before including botoc) to allow calls from many
+ * threads at once. botoc will then set up Python's thread support itself and
+ * hold the GIL only while it is working with Python objects (Python releases
+ * it while waiting on the network). Configuration (set_iam_user, set_region)
+ * and disconnect should still only be called while no requests are running.
+ * If your program initialises Python itself, it must also call
+ * PyEval_InitThreads and release the GIL before using botoc. */
+#ifndef BOTOC_THREADSAFE
+#  define BOTOC_THREADSAFE 0
+#endif
+
+/* Set BOTOC_NATIVE to 1 (before including botoc) to talk to AWS directly
+ * instead of through boto: requests are signed and sent by botoc itself (see
+ * botoc_native.h), and Python is not needed at all. The botoc::sqs and
+ * botoc::ddb functions behave the same with either backend. */
+#ifndef BOTOC_NATIVE
+#  define BOTOC_NATIVE 0
+#endif
+
+/* The native backend has no TLS, so it refuses to send anything (credentials
+ * are only used for signing, but every request and response is readable on
+ * the wire) until botoc::native::set_endpoint points it at a test server or a
+ * TLS-terminating proxy. Set BOTOC_NATIVE_ALLOW_HTTP to 1 to fall back on the
+ * public AWS endpoints over plain HTTP instead, e.g. from inside a VPC. */
+#ifndef BOTOC_NATIVE_ALLOW_HTTP
+#  define BOTOC_NATIVE_ALLOW_HTTP 0
+#endif
+
+/* base64 uses SSSE3 or AVX2 when the CPU supports them (checked at runtime,
+ * x86 with GCC 4.9+ or clang only). Set BOTOC_SIMD to 0 to always use the
+ * portable code. */
+#ifndef BOTOC_SIMD
+#  if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#    define BOTOC_SIMD 1
+#  else
+#    define BOTOC_SIMD 0
+#  endif
+#endif
+
+#if BOTOC_SIMD
+#  include <immintrin.h>
+#endif
+
 /* constants */
 
 #define SIZED_STRING(s) (int)(s).size(),(s).data()
@@ -54,6 +114,50 @@
 
 
 namespace botoc {
+	/* constants */
+	
+	enum simd_level {
+		SIMD_NONE  = 0,
+		SIMD_SSSE3 = 1,
+		SIMD_AVX2  = 2
+	};
+	
+	// How a failed request is treated (see retry_from_code)
+	enum retry_kind {
+		RETRY_FATAL     = 0, // the request itself is wrong (validation, condition, permissions); never retried
+		RETRY_THROTTLED = 1, // the service asked us to slow down
+		RETRY_SERVER    = 2, // 5xx / internal errors
+		RETRY_NETWORK   = 3  // no response at all (refused, reset, timed out)
+	};
+	
+	// Connection state each service keeps in a client (see client::slot and
+	// client::pool)
+	enum client_slot {
+		SLOT_SQS     = 0,
+		SLOT_DDB     = 1,
+		CLIENT_SLOTS = 2
+	};
+	
+	// decoding table for BASE64_DEFAULT_ALPHABET (0 for characters outside it)
+	static const unsigned char base64_default_table[256] = {
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 62,  0,  0,  0, 63,
+		52, 53, 54, 55, 56, 57, 58, 59, 60, 61,  0,  0,  0,  0,  0,  0,
+		 0,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+		15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,  0,  0,  0,  0,  0,
+		 0, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+		41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+		 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+	};
+	
 	/* typedefs */
 	
 	/* If you want to use your own string/vector classes, this is the place to
@@ -63,23 +167,134 @@ namespace botoc {
 	typedef std::string string_t;
 	typedef const std::string const_string_t;
 	typedef std::vector<string_t> string_list_t;
-	typedef void *handle_t; // used to return python objects as handles
+	typedef void *handle_t; // used to return python objects (or native equivalents) as handles
+	
+	/* types */
+	
+	class client;
+	
+	// Each client has one for SQS and one for DDB (see sqs::set_retry_policy
+	// and ddb::set_retry_policy)
+	struct retry_policy {
+		int maxAttempts;          // including the first (1 turns retries off)
+		long long baseMicros;     // the first retry waits up to this long,
+		long long maxMicros;      // doubling for each retry up to this
+		long long deadlineMicros; // no retry is started after this long (0 for no limit)
+		double budget;            // retries are paid for from a budget, refilled by
+		double retryCost;         // successes, so a failing service is not hammered
+		double successRefill;     // (network errors cost double)
+		
+		inline retry_policy( void ) _noexcept :
+		maxAttempts( 4 ),
+		baseMicros( 50000 ),
+		maxMicros( 3200000 ),
+		deadlineMicros( 10000000 ),
+		budget( 100.0 ),
+		retryCost( 5.0 ),
+		successRefill( 1.0 )
+		{
+		}
+	};
+	
+	struct retry_stats {
+		unsigned long long calls;      // requests, not counting retries
+		unsigned long long retries;    // extra attempts made
+		unsigned long long recovered;  // requests which succeeded after retrying
+		unsigned long long throttled;  // failed attempts by kind
+		unsigned long long server;
+		unsigned long long network;
+		unsigned long long fatal;
+		unsigned long long exhausted;  // requests given up: out of attempts,
+		unsigned long long deadline;   // past the deadline,
+		unsigned long long overBudget; // or the budget was used up
+		double budget;                 // what is left of the budget
+	};
+	
+	struct retry_state {
+		retry_policy policy;
+		retry_stats stats;
+		pthread_mutex_t mutex;
+		
+		inline retry_state( void ) _noexcept :
+		policy( )
+		{
+			memset( &stats, 0, sizeof( stats ) );
+			stats.budget = policy.budget;
+			pthread_mutex_init( &mutex, NULL );
+		}
+	};
+	
+	// Each client has one for SQS and one for DDB (see sqs::set_pool_policy
+	// and ddb::set_pool_policy)
+	struct pool_policy {
+		size_t maxConnections; // open at once (with BOTOC_THREADSAFE; more requests wait)
+		size_t maxIdle;        // kept open between requests
+		long long idleMicros;  // idle connections unused for longer are closed, not reused (0 for no limit)
+		long long waitMicros;  // a request fails if no connection is free by then (0 for no limit)
+		
+		inline pool_policy( void ) _noexcept :
+		maxConnections( 16 ),
+		maxIdle( 16 ),
+		idleMicros( 50000000 ),
+		waitMicros( 30000000 )
+		{
+		}
+	};
+	
+	struct pool_stats {
+		unsigned long long opened;    // connections made
+		unsigned long long reused;    // requests which took an idle connection
+		unsigned long long waited;    // requests which had to wait for one
+		unsigned long long timedOut;  // requests which gave up waiting
+		unsigned long long expired;   // idle connections closed for being unused too long
+		unsigned long long discarded; // connections closed after a failed check or request (or by the server)
+		size_t open;                  // open now (in use or idle)
+		size_t idle;                  // idle now
+	};
+	
+	// How a service's pooled connections are checked and closed
+	struct connection_type {
+		void (*close)( void *connection );
+		bool (*check)( void *connection ); // false if an idle connection can no longer be used (NULL: always usable)
+	};
 	
 	/* globals */
 	
-	static string_t user_key;
-	static string_t user_secret;
-	static string_t region;
+	static int simd_limit = SIMD_AVX2;
 	
 	/* prototypes */
 	
-	// Configuration
+	// Configuration (of the default client)
 	__attribute__((warn_unused_result,unused))
 	static inline bool set_iam_user( const const_string_t &key, const const_string_t &secret ) _noexcept;
 	
 	__attribute__((warn_unused_result,unused))
 	static inline bool set_region( const const_string_t &region ) _noexcept;
 	
+	// Clients
+	// The client set up by set_iam_user and set_region; never destroyed
+	__attribute__((warn_unused_result,unused))
+	static inline client &default_client( void ) _noexcept;
+	
+	// The client this thread's calls go through: the innermost client_scope's,
+	// or the default client
+	__attribute__((warn_unused_result,unused))
+	static inline client &current_client( void ) _noexcept;
+	
+	// Clock
+	__attribute__((warn_unused_result,unused))
+	static inline long long clock_micros( void ) _noexcept;
+	
+	__attribute__((unused))
+	static inline void sleep_micros( long long micros ) _noexcept;
+	
+	// SIMD
+	__attribute__((warn_unused_result,unused))
+	static inline int simd_level( void ) _noexcept;
+	
+	__attribute__((unused))
+	static inline int set_simd_level( int maxLevel ) _noexcept;
+	
 	// Base64
 	__attribute__((warn_unused_result,unused))
 	static inline size_t base64( const unsigned char *string, size_t bytecount, char *output, const char alphabet[64] = NULL, bool cap = true, bool term = true ) _noexcept;
@@ -93,10 +308,51 @@ namespace botoc {
 	__attribute__((warn_unused_result,unused))
 	static inline size_t decode_binary( const const_string_t &data, void **output ) _noexcept;
 	
+	// Decodes in one pass into output (e.g. a reused or arena buffer), which
+	// needs room for binary_length( data ) bytes; returns the bytes written
+	__attribute__((warn_unused_result,unused))
+	static inline size_t decode_binary( const const_string_t &data, void *output, size_t capacity ) _noexcept;
+	
+	__attribute__((warn_unused_result,unused))
+	static inline bool decode_binary( const const_string_t &data, string_t &output ) _noexcept;
+	
+	// Exact decoded size of valid base64 data (an upper limit otherwise)
+	__attribute__((pure,warn_unused_result,unused))
+	static inline size_t binary_length( const const_string_t &data ) _noexcept;
+	
+	/* internal prototypes */
+	
+	__attribute__((warn_unused_result,always_inline))
+	static inline client *&client_in_scope( void ) _noexcept;
+	
+	__attribute__((warn_unused_result))
+	static inline size_t base64_blocks( const unsigned char *string, size_t bytecount, char *output ) _noexcept;
+	
+	__attribute__((warn_unused_result))
+	static inline size_t unbase64_blocks( const unsigned char *string, size_t length, char *output ) _noexcept;
+	
+	// Retries
+	__attribute__((warn_unused_result,unused))
+	static retry_kind retry_from_code( const char *code, int status ) _noexcept;
+	
+	__attribute__((unused))
+	static void retry_configure( retry_state &state, const retry_policy &policy ) _noexcept;
+	
+	__attribute__((unused))
+	static void retry_snapshot( retry_state &state, retry_stats &stats ) _noexcept;
+	
+	// Fills the budget back up (e.g. for a new connection)
+	__attribute__((unused))
+	static void retry_refill( retry_state &state ) _noexcept;
+	
+#if !BOTOC_NATIVE
 	// Python helpers
 	__attribute__((always_inline,warn_unused_result,unused))
 	static inline bool py_init( void ) _noexcept;
 	
+	__attribute__((always_inline,unused))
+	static inline void py_threads_init( void ) _noexcept;
+	
 	__attribute__((always_inline,unused))
 	static inline void py_release( PyObject *o ) _noexcept;
 	
@@ -124,6 +380,20 @@ namespace botoc {
 	__attribute__((warn_unused_result))
 	static bool py_error( const char *stage, const char *extra = "" ) _noexcept;
 	
+	// The code of the last exception reported by py_error on this thread
+	// (boto's error_code, or the exception's class name); empty if the last
+	// call raised nothing. Kept for each thread, since other threads can run
+	// python calls while the GIL is released between retries.
+	__attribute__((warn_unused_result,always_inline,unused))
+	static inline char *py_error_code( void ) _noexcept;
+	
+	// The HTTP status of the last exception reported by py_error on this
+	// thread (boto's status; 0 if it had none)
+	__attribute__((warn_unused_result,always_inline,unused))
+	static inline int &py_error_status( void ) _noexcept;
+	
+	static void py_error_fill( PyObject *type, PyObject *value ) _noexcept;
+	
 	__attribute__((warn_unused_result))
 	static PyObject *py_import( const char *path ) _noexcept;
 	
@@ -133,26 +403,930 @@ namespace botoc {
 	__attribute__((warn_unused_result,sentinel))
 	static PyObject *py_callfunc( PyObject *object, const char *funcname, ... ) _noexcept;
 	
+	// Looks up object.funcname once, so it can be kept and passed to py_call
+	// (returns a new reference, or NULL)
+	__attribute__((warn_unused_result))
+	static PyObject *py_method( PyObject *object, const char *funcname ) _noexcept;
+	
+	// As py_callfunc, for a callable which has already been looked up
+	// (funcname is only used in messages)
+	__attribute__((warn_unused_result,sentinel,unused))
+	static PyObject *py_call( PyObject *function, const char *funcname, ... ) _noexcept;
+	
+	// As py_call, but tries again (following state's policy) while the call
+	// raises a throttling, server or network error
+	__attribute__((warn_unused_result,sentinel))
+	static PyObject *py_call_retry( retry_state &state, PyObject *function, const char *funcname, ... ) _noexcept;
+	
+	// As py_callfunc, retrying as py_call_retry
+	__attribute__((warn_unused_result,sentinel))
+	static PyObject *py_callfunc_retry( retry_state &state, PyObject *object, const char *funcname, ... ) _noexcept;
+	
+	__attribute__((warn_unused_result))
+	static PyObject *py_call_attempts( retry_state &state, PyObject *function, PyObject *args, PyObject *kwargs ) _noexcept;
+#endif
+	
+	/* classes */
+	
+	// A service's connections for one client. Each request checks one out (an
+	// idle one, or room to open a new one) and checks it back in when done, so
+	// that with BOTOC_THREADSAFE every thread can have a request in flight.
+	class connection_pool {
+	public:
+		enum result {
+			TAKEN     = 0, // connection is an idle one
+			RESERVED  = 1, // connection is NULL: open one and check it in
+			BUSY      = 2, // at the limit (only when not waiting)
+			TIMED_OUT = 3
+		};
+		
+	private:
+		struct idle_connection {
+			void *connection;
+			long long since;
+		};
+		
+		pool_policy _policy;
+		pool_stats _stats;
+		std::vector<idle_connection> _idle; // oldest first
+		const connection_type *_type; // (set by the first checkout)
+		pthread_mutex_t _mutex;
+		pthread_cond_t _returned;
+		
+		connection_pool( const connection_pool & );
+		connection_pool &operator =( const connection_pool & );
+		
+		inline void _lock( void ) _noexcept {
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &_mutex );
+#endif
+		}
+		
+		inline void _unlock( void ) _noexcept {
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &_mutex );
+#endif
+		}
+		
+	public:
+		inline connection_pool( void ) _noexcept :
+		_policy( ),
+		_idle( ),
+		_type( NULL )
+		{
+			memset( &_stats, 0, sizeof( _stats ) );
+			pthread_mutex_init( &_mutex, NULL );
+			pthread_cond_init( &_returned, NULL );
+		}
+		
+		inline ~connection_pool( void ) _noexcept {
+			close( );
+			pthread_cond_destroy( &_returned );
+			pthread_mutex_destroy( &_mutex );
+		}
+		
+		inline void set_policy( const pool_policy &policy ) _noexcept {
+			_lock( );
+			_policy = policy;
+			if( _policy.maxConnections < 1 ) {
+				_policy.maxConnections = 1;
+			}
+#if BOTOC_THREADSAFE
+			pthread_cond_broadcast( &_returned );
+#endif
+			_unlock( );
+		}
+		
+		inline void get_stats( pool_stats &stats ) _noexcept {
+			_lock( );
+			stats = _stats;
+			stats.idle = _idle.size( );
+			_unlock( );
+		}
+		
+		// Without BOTOC_THREADSAFE there is never more than one request at a
+		// time, so the limit is not applied (and nothing waits)
+		inline result checkout( const connection_type &type, void *&connection, const bool wait ) _noexcept {
+			connection = NULL;
+			long long deadline = 0;
+			bool waited = false;
+			result r = BUSY;
+			_lock( );
+			_type = &type;
+			while( true ) {
+				const long long now = clock_micros( );
+				void *stale = NULL;
+				if( !_idle.empty( ) && _policy.idleMicros > 0 && now - _idle.front( ).since > _policy.idleMicros ) {
+					stale = _idle.front( ).connection;
+					_idle.erase( _idle.begin( ) );
+					-- _stats.open;
+					++ _stats.expired;
+				} else if( !_idle.empty( ) ) {
+					// the most recently used is the most likely to still be open
+					connection = _idle.back( ).connection;
+					_idle.pop_back( );
+					if( type.check != NULL ) {
+						_unlock( );
+						const bool usable = type.check( connection );
+						_lock( );
+						if( !usable ) {
+							stale = connection;
+							connection = NULL;
+							-- _stats.open;
+							++ _stats.discarded;
+						}
+					}
+					if( stale == NULL ) {
+						++ _stats.reused;
+						r = TAKEN;
+						break;
+					}
+#if BOTOC_THREADSAFE
+				} else if( _stats.open >= _policy.maxConnections ) {
+					if( !wait ) {
+						r = BUSY;
+						break;
+					}
+					if( !waited ) {
+						waited = true;
+						deadline = now + _policy.waitMicros;
+						++ _stats.waited;
+					}
+					if( _policy.waitMicros <= 0 ) {
+						pthread_cond_wait( &_returned, &_mutex );
+					} else if( now >= deadline ) {
+						++ _stats.timedOut;
+						r = TIMED_OUT;
+						break;
+					} else {
+						struct timespec until;
+						until.tv_sec = (time_t) (deadline / 1000000ll);
+						until.tv_nsec = (long) (deadline % 1000000ll) * 1000l;
+						(void) pthread_cond_timedwait( &_returned, &_mutex, &until );
+					}
+					continue;
+#endif
+				} else {
+					++ _stats.open;
+					++ _stats.opened;
+					r = RESERVED;
+					break;
+				}
+				_unlock( );
+				type.close( stale );
+				_lock( );
+			}
+			_unlock( );
+			(void) wait;
+			(void) deadline;
+			(void) waited;
+			return r;
+		}
+		
+		// connection is NULL if opening one failed. Unhealthy connections (and
+		// any beyond maxIdle) are closed.
+		inline void checkin( void *const connection, const bool healthy ) _noexcept {
+			void *closing = NULL;
+			_lock( );
+			if( connection == NULL ) {
+				-- _stats.open;
+				-- _stats.opened;
+			} else if( !healthy || _idle.size( ) >= _policy.maxIdle ) {
+				closing = connection;
+				-- _stats.open;
+				if( !healthy ) {
+					++ _stats.discarded;
+				}
+			} else {
+				try {
+					idle_connection i;
+					i.connection = connection;
+					i.since = clock_micros( );
+					_idle.push_back( i );
+				} catch( ... ) {
+					closing = connection;
+					-- _stats.open;
+				}
+			}
+			const connection_type *const type = _type;
+#if BOTOC_THREADSAFE
+			pthread_cond_signal( &_returned );
+#endif
+			_unlock( );
+			if( closing != NULL ) {
+				type->close( closing );
+			}
+		}
+		
+		// Closes the idle connections (which should be all of them)
+		inline void close( void ) _noexcept {
+			std::vector<idle_connection> idle;
+			_lock( );
+			idle.swap( _idle );
+			_stats.open -= idle.size( );
+			const connection_type *const type = _type;
+			_unlock( );
+			for( size_t i = 0; i < idle.size( ); ++ i ) {
+				type->close( idle[i].connection );
+			}
+		}
+	};
+	
+	// Holds a connection from a pool while in scope: get( ) is an idle one, or
+	// NULL if a new one should be opened and handed over with set( ). With
+	// BOTOC_THREADSAFE, the GIL is released while waiting for a connection.
+	class pool_lease {
+	private:
+		connection_pool &_pool;
+		void *_connection;
+		bool _reserved; // false if no connection could be had
+		bool _healthy;
+		
+		pool_lease( const pool_lease & );
+		pool_lease &operator =( const pool_lease & );
+		
+	public:
+		inline pool_lease( connection_pool &pool, const connection_type &type ) _noexcept :
+		_pool( pool ),
+		_connection( NULL ),
+		_reserved( false ),
+		_healthy( true )
+		{
+			connection_pool::result r = _pool.checkout( type, _connection, false );
+#if BOTOC_THREADSAFE
+			if( r == connection_pool::BUSY ) {
+#if BOTOC_NATIVE
+				r = _pool.checkout( type, _connection, true );
+#else
+				Py_BEGIN_ALLOW_THREADS
+				r = _pool.checkout( type, _connection, true );
+				Py_END_ALLOW_THREADS
+#endif
+			}
+#endif
+			_reserved = (r == connection_pool::TAKEN || r == connection_pool::RESERVED);
+			if( unlikely( r == connection_pool::TIMED_OUT ) ) {
+				fprintf( stderr, "botoc: timed out waiting for a free connection\n" );
+			}
+		}
+		
+		inline ~pool_lease( void ) _noexcept {
+			if( _reserved ) {
+				_pool.checkin( _connection, _healthy );
+			}
+		}
+		
+		inline bool ok( void ) const _noexcept {
+			return _reserved;
+		}
+		
+		inline void *get( void ) const _noexcept {
+			return _connection;
+		}
+		
+		inline void set( void *const connection ) _noexcept {
+			_connection = connection;
+		}
+		
+		// Closes the connection instead of returning it to the pool
+		inline void discard( void ) _noexcept {
+			_healthy = false;
+		}
+	};
+	
+	// Credentials, a region and the connections made with them. Any number of
+	// clients can be alive at once, each keeping its own connections and
+	// queues; calls use the default client unless a client_scope picks
+	// another. A client must outlive the requests made through it.
+	class client {
+	public:
+		// closes the service's connections for c (clearing its slot)
+		typedef void (*releaser)( client &c );
+		
+	private:
+		string_t _key;
+		string_t _secret;
+		string_t _region;
+		unsigned long _id;
+		void *_slots[CLIENT_SLOTS];
+		releaser _releasers[CLIENT_SLOTS];
+		retry_state _retries[CLIENT_SLOTS];
+		connection_pool _pools[CLIENT_SLOTS];
+		
+		client( const client & );
+		client &operator =( const client & );
+		
+		static unsigned long _next_id( void ) _noexcept {
+			static unsigned long next = 0;
+			return __sync_fetch_and_add( &next, 1ul );
+		}
+		
+	public:
+		inline client( void ) _noexcept :
+		_key( ),
+		_secret( ),
+		_region( ),
+		_id( _next_id( ) ),
+		_retries( )
+		{
+			memset( _slots, 0, sizeof( _slots ) );
+			memset( _releasers, 0, sizeof( _releasers ) );
+		}
+		
+		inline client( const const_string_t &key, const const_string_t &secret, const const_string_t &region ) _throws_bad_alloc :
+		_key( key ),
+		_secret( secret ),
+		_region( region ),
+		_id( _next_id( ) ),
+		_retries( )
+		{
+			memset( _slots, 0, sizeof( _slots ) );
+			memset( _releasers, 0, sizeof( _releasers ) );
+		}
+		
+		// (no requests may still be running through the client)
+		inline ~client( void ) _noexcept {
+			disconnect( );
+		}
+		
+		// As botoc::set_iam_user and set_region, only affecting connections
+		// made after the call
+		__attribute__((warn_unused_result))
+		inline bool set_iam_user( const const_string_t &key, const const_string_t &secret ) _noexcept {
+			try {
+				_key.assign( key );
+				_secret.assign( secret );
+			} catch( ... ) {
+				return false;
+			}
+			return true;
+		}
+		
+		__attribute__((warn_unused_result))
+		inline bool set_region( const const_string_t &region ) _noexcept {
+			try {
+				_region.assign( region );
+			} catch( ... ) {
+				return false;
+			}
+			return true;
+		}
+		
+		inline const string_t &key( void ) const _noexcept {
+			return _key;
+		}
+		
+		inline const string_t &secret( void ) const _noexcept {
+			return _secret;
+		}
+		
+		inline const string_t &region( void ) const _noexcept {
+			return _region;
+		}
+		
+		// unique for the life of the process (addresses can be reused)
+		inline unsigned long id( void ) const _noexcept {
+			return _id;
+		}
+		
+		// Closes this client's connections to every service; the next request
+		// reconnects
+		inline void disconnect( void ) _noexcept {
+			for( int i = 0; i < CLIENT_SLOTS; ++ i ) {
+				if( _releasers[i] != NULL ) {
+					_releasers[i]( *this );
+				}
+				_pools[i].close( );
+				retry_refill( _retries[i] );
+			}
+		}
+		
+		// Connection state kept by a service (guarded by the service's own
+		// lock), and how to release it
+		inline void *&slot( const client_slot s ) _noexcept {
+			return _slots[s];
+		}
+		
+		inline void set_releaser( const client_slot s, const releaser r ) _noexcept {
+			_releasers[s] = r;
+		}
+		
+		// The service's retry policy, budget and counters for this client
+		inline retry_state &retries( const client_slot s ) _noexcept {
+			return _retries[s];
+		}
+		
+		// The service's open connections to this client's endpoint
+		inline connection_pool &pool( const client_slot s ) _noexcept {
+			return _pools[s];
+		}
+	};
+	
+	// Sends the calls made by this thread through a client while in scope
+	// (scopes can be nested). botoc's own threads (async, consumer, batch and
+	// scan workers) use the client which was current when they were started.
+	class client_scope {
+	private:
+		client *_previous;
+		
+		client_scope( const client_scope & );
+		client_scope &operator =( const client_scope & );
+		
+	public:
+		inline explicit client_scope( client &c ) _noexcept :
+		_previous( client_in_scope( ) )
+		{
+			client_in_scope( ) = &c;
+		}
+		
+		inline ~client_scope( void ) _noexcept {
+			client_in_scope( ) = _previous;
+		}
+	};
+	
+	// One request which may be retried: call again( kind ) after each failed
+	// attempt (it sleeps and returns true if another should be made), and
+	// succeeded( ) once an attempt works
+	class retry_call {
+	private:
+		retry_state &_state;
+		long long _started;
+		int _attempt;
+		
+		retry_call( const retry_call & );
+		retry_call &operator =( const retry_call & );
+		
+	public:
+		inline explicit retry_call( retry_state &state ) _noexcept :
+		_state( state ),
+		_started( clock_micros( ) ),
+		_attempt( 0 )
+		{
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &_state.mutex );
+#endif
+			++ _state.stats.calls;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &_state.mutex );
+#endif
+		}
+		
+		inline bool again( const retry_kind kind ) _noexcept {
+			retry_stats &s = _state.stats;
+			const retry_policy &p = _state.policy;
+			long long wait = 0;
+			bool retry = false;
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &_state.mutex );
+#endif
+			switch( kind ) {
+				case RETRY_THROTTLED: ++ s.throttled; break;
+				case RETRY_SERVER:    ++ s.server;    break;
+				case RETRY_NETWORK:   ++ s.network;   break;
+				default:              ++ s.fatal;     break;
+			}
+			if( kind == RETRY_FATAL ) {
+				// reported as it is
+			} else if( _attempt + 1 >= p.maxAttempts ) {
+				++ s.exhausted;
+			} else {
+				// 0 to base * 2^attempt, capped ("full jitter"), so that clients
+				// which failed together do not all retry together
+				long long cap = p.maxMicros;
+				if( _attempt < 30 && (p.baseMicros << _attempt) < cap ) {
+					cap = p.baseMicros << _attempt;
+				}
+				wait = (cap > 0) ? (long long) (random( ) % (long) cap) + 1ll : 0ll;
+				const double cost = (kind == RETRY_NETWORK) ? p.retryCost * 2.0 : p.retryCost;
+				if( p.deadlineMicros > 0 && clock_micros( ) + wait - _started > p.deadlineMicros ) {
+					++ s.deadline;
+				} else if( s.budget < cost ) {
+					++ s.overBudget;
+				} else {
+					s.budget -= cost;
+					++ s.retries;
+					retry = true;
+				}
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &_state.mutex );
+#endif
+			if( retry ) {
+				sleep_micros( wait );
+				++ _attempt;
+			}
+			return retry;
+		}
+		
+		// Part of a batch got through, so the rest is sent straight away, and
+		// backs off (and times out) afresh if it then stops getting through
+		inline void progressed( void ) _noexcept {
+			_attempt = 0;
+			_started = clock_micros( );
+		}
+		
+		inline void succeeded( void ) _noexcept {
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &_state.mutex );
+#endif
+			_state.stats.budget += _state.policy.successRefill;
+			if( _state.stats.budget > _state.policy.budget ) {
+				_state.stats.budget = _state.policy.budget;
+			}
+			if( _attempt > 0 ) {
+				++ _state.stats.recovered;
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &_state.mutex );
+#endif
+		}
+	};
+	
+#if !BOTOC_NATIVE
+	// Holds the GIL while in scope (does nothing unless BOTOC_THREADSAFE is set).
+	// Every public function which touches Python objects starts with one.
+	class py_gil {
+	private:
+#if BOTOC_THREADSAFE
+		PyGILState_STATE _state;
+#endif
+		
+		py_gil( const py_gil & );
+		py_gil &operator =( const py_gil & );
+		
+	public:
+		__attribute__((always_inline))
+		inline py_gil( void ) _noexcept {
+#if BOTOC_THREADSAFE
+			py_threads_init( );
+			_state = PyGILState_Ensure( );
+#endif
+		}
+		
+		__attribute__((always_inline))
+		inline ~py_gil( void ) _noexcept {
+#if BOTOC_THREADSAFE
+			PyGILState_Release( _state );
+#endif
+		}
+	};
+	
+	// Locks a mutex while in scope (does nothing unless BOTOC_THREADSAFE is set).
+	// Must be used inside a py_gil; the GIL is released while waiting for the
+	// mutex, since its owner may need the GIL before it can finish.
+	class py_lock {
+	private:
+#if BOTOC_THREADSAFE
+		pthread_mutex_t *_mutex;
+#endif
+		
+		py_lock( const py_lock & );
+		py_lock &operator =( const py_lock & );
+		
+	public:
+		__attribute__((always_inline))
+		inline explicit py_lock( pthread_mutex_t &mutex ) _noexcept
+#if BOTOC_THREADSAFE
+		: _mutex( &mutex )
+		{
+			if( pthread_mutex_trylock( _mutex ) != 0 ) {
+				Py_BEGIN_ALLOW_THREADS
+				pthread_mutex_lock( _mutex );
+				Py_END_ALLOW_THREADS
+			}
+		}
+#else
+		{
+			(void) mutex;
+		}
+#endif
+		
+		__attribute__((always_inline))
+		inline ~py_lock( void ) _noexcept {
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( _mutex );
+#endif
+		}
+	};
+#endif
+	
 	/* implementation */
 	
 	// Configuration
 	static inline bool set_iam_user( const const_string_t &key, const const_string_t &secret ) _noexcept {
-		try {
-			user_key.assign( key );
-			user_secret.assign( secret );
-		} catch( ... ) {
-			return false;
-		}
-		return true;
+		return default_client( ).set_iam_user( key, secret );
 	}
 	
 	static inline bool set_region( const const_string_t &reg ) _noexcept {
-		try {
-			region.assign( reg );
-		} catch( ... ) {
-			return false;
+		return default_client( ).set_region( reg );
+	}
+	
+	// Clients
+	static inline client &default_client( void ) _noexcept {
+		// leaked, so that nothing is released while the program exits (Python
+		// may already have gone)
+		static client *const c = new client( );
+		return *c;
+	}
+	
+	static inline client &current_client( void ) _noexcept {
+		client *const c = client_in_scope( );
+		return (c == NULL) ? default_client( ) : *c;
+	}
+	
+	static inline client *&client_in_scope( void ) _noexcept {
+		static __thread client *c = NULL;
+		return c;
+	}
+	
+	// Clock
+	static inline long long clock_micros( void ) _noexcept {
+		struct timeval t;
+		gettimeofday( &t, NULL );
+		return (long long) t.tv_sec * 1000000ll + (long long) t.tv_usec;
+	}
+	
+	static inline void sleep_micros( const long long micros ) _noexcept {
+		if( micros <= 0 ) {
+			return;
 		}
-		return true;
+		struct timespec ts;
+		ts.tv_sec = (time_t) (micros / 1000000ll);
+		ts.tv_nsec = (long) (micros % 1000000ll) * 1000l;
+		while( nanosleep( &ts, &ts ) != 0 && errno == EINTR ) {
+		}
+	}
+	
+	// Retries
+	static retry_kind retry_from_code( const char *code, const int status ) _noexcept {
+		// code is the service's error code (or a Python exception's class name)
+		// and status its HTTP status (0 if no response arrived); throttling,
+		// server and network errors are worth retrying, anything else is not
+		static const char *const throttled[] = {
+			"ProvisionedThroughputExceededException", "ThrottlingException", "Throttling",
+			"RequestThrottled", "RequestLimitExceeded", "SlowDown", NULL
+		};
+		static const char *const server[] = {
+			"InternalServerError", "InternalError", "InternalFailure",
+			"ServiceUnavailable", "ServiceUnavailableException", NULL
+		};
+		static const char *const network[] = {
+			"error", "timeout", "gaierror", "BadStatusLine", "IncompleteRead",
+			"HTTPException", "SSLError", "CannotSendRequest", "ResponseNotReady", NULL
+		};
+		
+		if( code == NULL ) {
+			code = "";
+		}
+		if( strchr( code, '#' ) != NULL ) {
+			code = strchr( code, '#' ) + 1;
+		}
+		for( int i = 0; throttled[i] != NULL; ++ i ) {
+			if( strcmp( code, throttled[i] ) == 0 ) {
+				return RETRY_THROTTLED;
+			}
+		}
+		for( int i = 0; server[i] != NULL; ++ i ) {
+			if( strcmp( code, server[i] ) == 0 ) {
+				return RETRY_SERVER;
+			}
+		}
+		if( status >= 500 ) {
+			return RETRY_SERVER;
+		}
+		if( status == 0 ) {
+			if( code[0] == '\0' ) {
+				return RETRY_NETWORK;
+			}
+			for( int i = 0; network[i] != NULL; ++ i ) {
+				if( strcmp( code, network[i] ) == 0 ) {
+					return RETRY_NETWORK;
+				}
+			}
+		}
+		return RETRY_FATAL;
+	}
+	
+	static void retry_configure( retry_state &state, const retry_policy &policy ) _noexcept {
+#if BOTOC_THREADSAFE
+		pthread_mutex_lock( &state.mutex );
+#endif
+		state.policy = policy;
+		if( state.policy.maxAttempts < 1 ) {
+			state.policy.maxAttempts = 1;
+		}
+		state.stats.budget = policy.budget;
+#if BOTOC_THREADSAFE
+		pthread_mutex_unlock( &state.mutex );
+#endif
+	}
+	
+	static void retry_snapshot( retry_state &state, retry_stats &stats ) _noexcept {
+#if BOTOC_THREADSAFE
+		pthread_mutex_lock( &state.mutex );
+#endif
+		stats = state.stats;
+#if BOTOC_THREADSAFE
+		pthread_mutex_unlock( &state.mutex );
+#endif
+	}
+	
+	static void retry_refill( retry_state &state ) _noexcept {
+#if BOTOC_THREADSAFE
+		pthread_mutex_lock( &state.mutex );
+#endif
+		state.stats.budget = state.policy.budget;
+#if BOTOC_THREADSAFE
+		pthread_mutex_unlock( &state.mutex );
+#endif
+	}
+	
+	// SIMD
+	static inline int simd_level( void ) _noexcept {
+#if BOTOC_SIMD
+		static int detected = -1;
+		if( unlikely( detected < 0 ) ) {
+			__builtin_cpu_init( );
+			detected = __builtin_cpu_supports( "avx2" ) ? SIMD_AVX2 : (__builtin_cpu_supports( "ssse3" ) ? SIMD_SSSE3 : SIMD_NONE);
+		}
+		return (detected < simd_limit) ? detected : simd_limit;
+#else
+		return SIMD_NONE;
+#endif
+	}
+	
+	static inline int set_simd_level( const int maxLevel ) _noexcept {
+		// mostly useful for testing and benchmarking
+		simd_limit = maxLevel;
+		return simd_level( );
+	}
+	
+#if BOTOC_SIMD
+	// Encodes whole 12-byte blocks (reading 16) with the default alphabet;
+	// returns the number of bytes consumed. Based on Wojciech Muła's method.
+	__attribute__((target("ssse3")))
+	static size_t base64_blocks_ssse3( const unsigned char *const string, const size_t bytecount, char *const output ) _noexcept {
+		const __m128i spread = _mm_set_epi8( 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1 );
+		const __m128i shifts = _mm_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0 );
+		size_t i = 0;
+		for( ; i + 16 <= bytecount; i += 12 ) {
+			// 3 bytes => 4 indices (0-63), one per byte
+			const __m128i in = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) (string + i) ), spread );
+			const __m128i t0 = _mm_mulhi_epu16( _mm_and_si128( in, _mm_set1_epi32( 0x0fc0fc00 ) ), _mm_set1_epi32( 0x04000040 ) );
+			const __m128i t1 = _mm_mullo_epi16( _mm_and_si128( in, _mm_set1_epi32( 0x003f03f0 ) ), _mm_set1_epi32( 0x01000010 ) );
+			const __m128i indices = _mm_or_si128( t0, t1 );
+			
+			// indices => characters: 0-25 'A', 26-51 'a', 52-61 '0', 62 '+', 63 '/'
+			__m128i range = _mm_subs_epu8( indices, _mm_set1_epi8( 51 ) );
+			range = _mm_or_si128( range, _mm_and_si128( _mm_cmpgt_epi8( _mm_set1_epi8( 26 ), indices ), _mm_set1_epi8( 13 ) ) );
+			const __m128i chars = _mm_add_epi8( _mm_shuffle_epi8( shifts, range ), indices );
+			_mm_storeu_si128( (__m128i *) (output + (i / 3) * 4), chars );
+		}
+		return i;
+	}
+	
+	// As base64_blocks_ssse3, but 24 bytes (reading 28) at a time.
+	__attribute__((target("avx2")))
+	static size_t base64_blocks_avx2( const unsigned char *const string, const size_t bytecount, char *const output ) _noexcept {
+		const __m128i spread128 = _mm_set_epi8( 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1 );
+		const __m128i shifts128 = _mm_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0 );
+		const __m256i spread = _mm256_inserti128_si256( _mm256_castsi128_si256( spread128 ), spread128, 1 );
+		const __m256i shifts = _mm256_inserti128_si256( _mm256_castsi128_si256( shifts128 ), shifts128, 1 );
+		size_t i = 0;
+		for( ; i + 28 <= bytecount; i += 24 ) {
+			const __m128i lo = _mm_loadu_si128( (const __m128i *) (string + i) );
+			const __m128i hi = _mm_loadu_si128( (const __m128i *) (string + i + 12) );
+			const __m256i in = _mm256_shuffle_epi8( _mm256_inserti128_si256( _mm256_castsi128_si256( lo ), hi, 1 ), spread );
+			const __m256i t0 = _mm256_mulhi_epu16( _mm256_and_si256( in, _mm256_set1_epi32( 0x0fc0fc00 ) ), _mm256_set1_epi32( 0x04000040 ) );
+			const __m256i t1 = _mm256_mullo_epi16( _mm256_and_si256( in, _mm256_set1_epi32( 0x003f03f0 ) ), _mm256_set1_epi32( 0x01000010 ) );
+			const __m256i indices = _mm256_or_si256( t0, t1 );
+			
+			__m256i range = _mm256_subs_epu8( indices, _mm256_set1_epi8( 51 ) );
+			range = _mm256_or_si256( range, _mm256_and_si256( _mm256_cmpgt_epi8( _mm256_set1_epi8( 26 ), indices ), _mm256_set1_epi8( 13 ) ) );
+			const __m256i chars = _mm256_add_epi8( _mm256_shuffle_epi8( shifts, range ), indices );
+			_mm256_storeu_si256( (__m256i *) (output + (i / 3) * 4), chars );
+		}
+		return i;
+	}
+	
+	// Decodes whole 16-character blocks with the default alphabet, stopping at
+	// the first block containing any other character (the caller decodes that
+	// one, so the output is always the same as the portable code's); returns
+	// the number of characters consumed. Based on Muła and Lemire's method.
+	__attribute__((target("ssse3")))
+	static size_t unbase64_blocks_ssse3( const unsigned char *const string, const size_t length, char *const output ) _noexcept {
+		const __m128i pack = _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 );
+		size_t i = 0;
+		for( ; i + 16 <= length; i += 16 ) {
+			const __m128i in = _mm_loadu_si128( (const __m128i *) (string + i) );
+			// (bytes above 127 are negative, so fail every range)
+			const __m128i upper = _mm_and_si128( _mm_cmpgt_epi8( in, _mm_set1_epi8( 'A' - 1 ) ), _mm_cmplt_epi8( in, _mm_set1_epi8( 'Z' + 1 ) ) );
+			const __m128i lower = _mm_and_si128( _mm_cmpgt_epi8( in, _mm_set1_epi8( 'a' - 1 ) ), _mm_cmplt_epi8( in, _mm_set1_epi8( 'z' + 1 ) ) );
+			const __m128i digit = _mm_and_si128( _mm_cmpgt_epi8( in, _mm_set1_epi8( '0' - 1 ) ), _mm_cmplt_epi8( in, _mm_set1_epi8( '9' + 1 ) ) );
+			const __m128i plus = _mm_cmpeq_epi8( in, _mm_set1_epi8( '+' ) );
+			const __m128i slash = _mm_cmpeq_epi8( in, _mm_set1_epi8( '/' ) );
+			const __m128i valid = _mm_or_si128( _mm_or_si128( _mm_or_si128( upper, lower ), _mm_or_si128( digit, plus ) ), slash );
+			if( _mm_movemask_epi8( valid ) != 0xffff ) {
+				break;
+			}
+			
+			__m128i shift = _mm_and_si128( upper, _mm_set1_epi8( -'A' ) );
+			shift = _mm_or_si128( shift, _mm_and_si128( lower, _mm_set1_epi8( 26 - 'a' ) ) );
+			shift = _mm_or_si128( shift, _mm_and_si128( digit, _mm_set1_epi8( 52 - '0' ) ) );
+			shift = _mm_or_si128( shift, _mm_and_si128( plus, _mm_set1_epi8( 62 - '+' ) ) );
+			shift = _mm_or_si128( shift, _mm_and_si128( slash, _mm_set1_epi8( 63 - '/' ) ) );
+			const __m128i values = _mm_add_epi8( in, shift );
+			
+			// 4 x 6 bits => 3 bytes
+			const __m128i pairs = _mm_maddubs_epi16( values, _mm_set1_epi32( 0x01400140 ) );
+			const __m128i words = _mm_madd_epi16( pairs, _mm_set1_epi32( 0x00011000 ) );
+			const __m128i bytes = _mm_shuffle_epi8( words, pack );
+			char *const o = output + (i / 4) * 3;
+			const int last = _mm_cvtsi128_si32( _mm_srli_si128( bytes, 8 ) );
+			_mm_storel_epi64( (__m128i *) o, bytes );
+			memcpy( o + 8, &last, 4 );
+		}
+		return i;
+	}
+	
+	// As unbase64_blocks_ssse3, but 32 characters at a time.
+	__attribute__((target("avx2")))
+	static size_t unbase64_blocks_avx2( const unsigned char *const string, const size_t length, char *const output ) _noexcept {
+		const __m128i pack128 = _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 );
+		const __m256i pack = _mm256_inserti128_si256( _mm256_castsi128_si256( pack128 ), pack128, 1 );
+		size_t i = 0;
+		for( ; i + 32 <= length; i += 32 ) {
+			const __m256i in = _mm256_loadu_si256( (const __m256i *) (string + i) );
+			const __m256i upper = _mm256_and_si256( _mm256_cmpgt_epi8( in, _mm256_set1_epi8( 'A' - 1 ) ), _mm256_cmpgt_epi8( _mm256_set1_epi8( 'Z' + 1 ), in ) );
+			const __m256i lower = _mm256_and_si256( _mm256_cmpgt_epi8( in, _mm256_set1_epi8( 'a' - 1 ) ), _mm256_cmpgt_epi8( _mm256_set1_epi8( 'z' + 1 ), in ) );
+			const __m256i digit = _mm256_and_si256( _mm256_cmpgt_epi8( in, _mm256_set1_epi8( '0' - 1 ) ), _mm256_cmpgt_epi8( _mm256_set1_epi8( '9' + 1 ), in ) );
+			const __m256i plus = _mm256_cmpeq_epi8( in, _mm256_set1_epi8( '+' ) );
+			const __m256i slash = _mm256_cmpeq_epi8( in, _mm256_set1_epi8( '/' ) );
+			const __m256i valid = _mm256_or_si256( _mm256_or_si256( _mm256_or_si256( upper, lower ), _mm256_or_si256( digit, plus ) ), slash );
+			if( _mm256_movemask_epi8( valid ) != -1 ) {
+				break;
+			}
+			
+			__m256i shift = _mm256_and_si256( upper, _mm256_set1_epi8( -'A' ) );
+			shift = _mm256_or_si256( shift, _mm256_and_si256( lower, _mm256_set1_epi8( 26 - 'a' ) ) );
+			shift = _mm256_or_si256( shift, _mm256_and_si256( digit, _mm256_set1_epi8( 52 - '0' ) ) );
+			shift = _mm256_or_si256( shift, _mm256_and_si256( plus, _mm256_set1_epi8( 62 - '+' ) ) );
+			shift = _mm256_or_si256( shift, _mm256_and_si256( slash, _mm256_set1_epi8( 63 - '/' ) ) );
+			const __m256i values = _mm256_add_epi8( in, shift );
+			
+			const __m256i pairs = _mm256_maddubs_epi16( values, _mm256_set1_epi32( 0x01400140 ) );
+			const __m256i words = _mm256_madd_epi16( pairs, _mm256_set1_epi32( 0x00011000 ) );
+			const __m256i bytes = _mm256_shuffle_epi8( words, pack );
+			char *const o = output + (i / 4) * 3;
+			const __m128i lo = _mm256_castsi256_si128( bytes );
+			const __m128i hi = _mm256_extracti128_si256( bytes, 1 );
+			const int lastLo = _mm_cvtsi128_si32( _mm_srli_si128( lo, 8 ) );
+			const int lastHi = _mm_cvtsi128_si32( _mm_srli_si128( hi, 8 ) );
+			_mm_storel_epi64( (__m128i *) o, lo );
+			memcpy( o + 8, &lastLo, 4 );
+			_mm_storel_epi64( (__m128i *) (o + 12), hi );
+			memcpy( o + 20, &lastHi, 4 );
+		}
+		return i;
+	}
+#endif
+	
+	static inline size_t base64_blocks( const unsigned char *const string, const size_t bytecount, char *const output ) _noexcept {
+#if BOTOC_SIMD
+		const int level = simd_level( );
+		size_t i = 0;
+		if( level >= SIMD_AVX2 ) {
+			i = base64_blocks_avx2( string, bytecount, output );
+		}
+		if( level >= SIMD_SSSE3 ) {
+			i += base64_blocks_ssse3( string + i, bytecount - i, output + (i / 3) * 4 );
+		}
+		return i;
+#else
+		(void) string;
+		(void) bytecount;
+		(void) output;
+		return 0;
+#endif
+	}
+	
+	static inline size_t unbase64_blocks( const unsigned char *const string, const size_t length, char *const output ) _noexcept {
+#if BOTOC_SIMD
+		const int level = simd_level( );
+		size_t i = 0;
+		if( level >= SIMD_AVX2 ) {
+			i = unbase64_blocks_avx2( string, length, output );
+		}
+		if( level >= SIMD_SSSE3 ) {
+			i += unbase64_blocks_ssse3( string + i, length - i, output + (i / 4) * 3 );
+		}
+		return i;
+#else
+		(void) string;
+		(void) length;
+		(void) output;
+		return 0;
+#endif
 	}
 	
 	// Base64
@@ -164,12 +1338,14 @@ namespace botoc {
 		if( output == NULL ) {
 			return ((bytecount + 2) / 3) * 4 + (cap ? 0 : (((bytecount + 2) % 3) - 2));
 		}
+		size_t p = 0;
+		size_t i = 0;
 		if( alphabet == NULL ) {
 			alphabet = BASE64_DEFAULT_ALPHABET;
+			i = base64_blocks( string, bytecount, output );
+			p = (i / 3) * 4;
 		}
 		
-		size_t p = 0;
-		size_t i = 0;
 		for( ; i + 2 < bytecount; i += 3, p += 4 ) {
 			output[p  ] = alphabet[string[i]>>2];
 			output[p+1] = alphabet[((string[i]&3)<<4)|(string[i+1]>>4)];
@@ -232,19 +1408,31 @@ namespace botoc {
 		if( output == NULL ) {
 			return (length * 3) / 4 + (term ? 1 : 0); // = upper limit (ignores cap)
 		}
+		const unsigned char *tbl = base64_default_table;
+		unsigned char custom[256];
 		if( alphabet == NULL ) {
 			alphabet = BASE64_DEFAULT_ALPHABET;
+		} else {
+			memset( custom, 0, 256 * sizeof( unsigned char ) );
+			for( int i = 0; i < 64; ++ i ) {
+				custom[(unsigned char)alphabet[i]] = (unsigned char) i;
+			}
+			tbl = custom;
 		}
-		
-		static unsigned char tbl[256];
-		memset( tbl, 0, 256 * sizeof( unsigned char ) );
-		for( int i = 0; i < 64; ++ i ) {
-			tbl[(unsigned char)alphabet[i]] = (unsigned char) i;
-		}
+		const bool blocks = (tbl == base64_default_table);
 		
 		size_t p = 0;
 		size_t i = 0;
 		for( ; i + 5 < length; i += 4, p += 3 ) {
+			if( blocks ) {
+				// blocks must end before the final 2 characters (handled below)
+				const size_t n = unbase64_blocks( string + i, length - 2 - i, output + p );
+				i += n;
+				p += (n / 4) * 3;
+				if( i + 5 >= length ) {
+					break;
+				}
+			}
 			const unsigned char v0 = tbl[string[i  ]];
 			const unsigned char v1 = tbl[string[i+1]];
 			const unsigned char v2 = tbl[string[i+2]];
@@ -321,37 +1509,46 @@ namespace botoc {
 	}
 	
 	static inline bool encode_binary( const void *const data, const size_t length, string_t &output ) _noexcept {
-		size_t l = base64( (const unsigned char *) data, length, NULL, NULL, true, false );
+		// the size is exact, so this is the only pass over the data
+		const size_t l = base64( (const unsigned char *) data, length, NULL, NULL, true, false );
 		try {
 			output.resize( l ); // slower than reserve, but std::string optimises weirdly otherwise :(
 		} catch( ... ) {
 			fprintf( stderr, "encode_binary: reserve failed\n" );
 			return false;
 		}
+		if( l == 0 ) {
+			return true;
+		}
 		
 		// this is not 100% safe in C++03 (but I think is in C++11)
 		// technically we're not allowed to manipulate .data(),
 		// but it seems to be fine in all implementations I've seen
 		char *const internal = const_cast<char *>( output.data( ) );
-		l = base64( (const unsigned char *) data, length, internal, NULL, true, false );
-		try {
-			output.resize( l ); // actual size may be less
-		} catch( ... ) {
-			fprintf( stderr, "encode_binary: resize failed (!)\n" );
+		const size_t written = base64( (const unsigned char *) data, length, internal, NULL, true, false );
+		if( unlikely( written != l ) ) {
+			fprintf( stderr, "encode_binary: encoded %lu bytes, expected %lu\n", (unsigned long) written, (unsigned long) l );
 			return false;
 		}
 		return true;
 	}
 	
+	static inline size_t binary_length( const const_string_t &data ) _noexcept {
+		size_t length = data.size( );
+		for( int i = 0; i < 2 && length > 0 && data[length - 1] == '='; ++ i ) {
+			-- length;
+		}
+		// a trailing group of n characters holds n - 1 bytes
+		const size_t tail = length % 4;
+		return (length / 4) * 3 + ((tail > 1) ? (tail - 1) : 0);
+	}
+	
 	static inline size_t decode_binary( const const_string_t &data, void **output ) _noexcept {
 		if( unlikely( output == NULL ) ) {
 			return 0;
 		}
 		
-		const unsigned char *const d = (const unsigned char *) data.data( );
-		const size_t length = data.size( );
-		
-		const size_t l = unbase64( d, length, NULL, NULL, false );
+		const size_t l = binary_length( data );
 		if( unlikely( l == 0 ) ) {
 			*output = NULL;
 			return 0;
@@ -363,15 +1560,70 @@ namespace botoc {
 			return 0;
 		}
 		
-		return unbase64( d, length, (char *) *output, NULL, false );
+		return decode_binary( data, *output, l );
+	}
+	
+	static inline size_t decode_binary( const const_string_t &data, void *const output, const size_t capacity ) _noexcept {
+		if( unlikely( output == NULL ) ) {
+			return 0;
+		}
+		if( unlikely( capacity < binary_length( data ) ) ) {
+			fprintf( stderr, "decode_binary: buffer too small\n" );
+			return 0;
+		}
+		
+		return unbase64( (const unsigned char *) data.data( ), data.size( ), (char *) output, NULL, false );
+	}
+	
+	static inline bool decode_binary( const const_string_t &data, string_t &output ) _noexcept {
+		// reuses output's capacity, so a warm buffer needs no allocation
+		const size_t l = binary_length( data );
+		try {
+			output.resize( l ); // slower than reserve, but std::string optimises weirdly otherwise :(
+		} catch( ... ) {
+			fprintf( stderr, "decode_binary: reserve failed\n" );
+			return false;
+		}
+		if( l == 0 ) {
+			return true;
+		}
+		
+		// (see encode_binary)
+		char *const internal = const_cast<char *>( output.data( ) );
+		const size_t actual = decode_binary( data, internal, l );
+		if( actual < l ) {
+			// only possible for invalid data
+			output.resize( actual );
+		}
+		return true;
 	}
 	
+#if !BOTOC_NATIVE
 	// Python helpers
 	static inline bool py_init( void ) _noexcept {
 		Py_Initialize( );
 		return !py_error( "initializing python" );
 	}
 	
+#if BOTOC_THREADSAFE
+	static void py_threads_init_once( void ) _noexcept {
+		if( Py_IsInitialized( ) ) {
+			// the program set Python up itself (see BOTOC_THREADSAFE)
+			return;
+		}
+		Py_Initialize( );
+		PyEval_InitThreads( );
+		(void) PyEval_SaveThread( ); // this thread holds the GIL; let any thread take it
+	}
+#endif
+	
+	static inline void py_threads_init( void ) _noexcept {
+#if BOTOC_THREADSAFE
+		static pthread_once_t once = PTHREAD_ONCE_INIT;
+		pthread_once( &once, &py_threads_init_once );
+#endif
+	}
+	
 	static inline void py_release( PyObject *o ) _noexcept {
 		if( likely( o != NULL ) ) {
 			Py_DECREF( o );
@@ -434,6 +1686,8 @@ namespace botoc {
 		PyObject *value;
 		PyObject *traceback;
 		PyErr_Fetch( &type, &value, &traceback );
+		py_error_fill( type, value );
+		PyErr_Clear( );
 		if( likely( value != NULL ) ) {
 			PyObject *value_str = PyObject_Str( value );
 			fprintf( stderr, "botoc: %s%s threw %s\n", stage, extra, py_cstring( value_str ) );
@@ -449,6 +1703,37 @@ namespace botoc {
 		return true;
 	}
 	
+	static inline char *py_error_code( void ) _noexcept {
+		static __thread char code[64];
+		return code;
+	}
+	
+	static inline int &py_error_status( void ) _noexcept {
+		static __thread int status = 0;
+		return status;
+	}
+	
+	static void py_error_fill( PyObject *const type, PyObject *const value ) _noexcept {
+		// code = getattr( value, 'error_code', None ) or type.__name__
+		// status = getattr( value, 'status', 0 )
+		char *const code = py_error_code( );
+		PyObject *code_str = (value != NULL && PyObject_HasAttrString( value, "error_code" )) ? PyObject_GetAttrString( value, "error_code" ) : NULL;
+		if( code_str == NULL || !PyString_Check( code_str ) ) {
+			py_release( code_str );
+			code_str = (type != NULL) ? PyObject_GetAttrString( type, "__name__" ) : NULL;
+		}
+		if( code_str != NULL && PyString_Check( code_str ) ) {
+			snprintf( code, 64, "%s", PyString_AsString( code_str ) );
+		} else {
+			code[0] = '\0';
+		}
+		py_release( code_str );
+		PyObject *status = (value != NULL && PyObject_HasAttrString( value, "status" )) ? PyObject_GetAttrString( value, "status" ) : NULL;
+		py_error_status( ) = (status != NULL && PyInt_Check( status )) ? (int) PyInt_AsLong( status ) : 0;
+		py_release( status );
+		PyErr_Clear( ); // (from a failed getattr; the caller holds the exception)
+	}
+	
 	static PyObject *py_import( const char *const path ) _noexcept {
 		if( unlikely( path == NULL ) ) {
 			return NULL;
@@ -490,7 +1775,7 @@ namespace botoc {
 	} \
 	va_end( v2 )
 	
-#define py_call_va( func, param, fail ) \
+#define py_args_va( param, fail ) \
 	va_list v; \
 	va_start( v, param ); \
 	int args = 0; \
@@ -541,7 +1826,10 @@ namespace botoc {
 			Py_DECREF( o ); \
 		} \
 	} \
-	va_end( v ); \
+	va_end( v )
+	
+#define py_call_va( func, param, fail ) \
+	py_args_va( param, fail ); \
 	PyObject *ret = PyObject_Call( func, arg_list, arg_dict ); \
 	Py_DECREF( arg_list ); \
 	py_release( arg_dict )
@@ -560,7 +1848,8 @@ namespace botoc {
 			return NULL;
 		}
 		
-		PyObject *classobj = PyDict_GetItemString( dict, cls );
+		PyObject *classobj = PyDict_GetItemString( dict, cls ); // borrowed
+		Py_XINCREF( classobj );
 		if( unlikely( py_error( "find constructor ", cls ) ) ) {
 			py_release( classobj );
 			py_cancel_va( cls );
@@ -585,26 +1874,32 @@ namespace botoc {
 		return ret;
 	}
 	
-	static PyObject *py_callfunc( PyObject *obj, const char *const fnc, ... ) _noexcept {
+	static PyObject *py_method( PyObject *const obj, const char *const fnc ) _noexcept {
 		if( unlikely( obj == NULL || fnc == NULL ) ) {
-			py_cancel_va( fnc );
 			return NULL;
 		}
 		
 		if( unlikely( !PyObject_HasAttrString( obj, fnc ) ) ) {
 			fprintf( stderr, "python function %s not found\n", fnc );
-			py_cancel_va( fnc );
 			return NULL;
 		}
 		PyObject *funcobj = PyObject_GetAttrString( obj, fnc );
 		if( unlikely( py_error( "find function ", fnc ) ) ) {
 			fprintf( stderr, "python function %s not referenced\n", fnc );
 			py_release( funcobj );
-			py_cancel_va( fnc );
 			return NULL;
 		}
 		if( unlikely( funcobj == NULL ) ) {
 			fprintf( stderr, "python function %s error\n", fnc );
+			return NULL;
+		}
+		return funcobj;
+	}
+	
+	static PyObject *py_callfunc( PyObject *obj, const char *const fnc, ... ) _noexcept {
+		py_error_code( )[0] = '\0';
+		PyObject *funcobj = py_method( obj, fnc );
+		if( unlikely( funcobj == NULL ) ) {
 			py_cancel_va( fnc );
 			return NULL;
 		}
@@ -622,8 +1917,110 @@ namespace botoc {
 		return ret;
 	}
 	
+	static PyObject *py_call( PyObject *funcobj, const char *const fnc, ... ) _noexcept {
+		py_error_code( )[0] = '\0';
+		if( unlikely( funcobj == NULL ) ) {
+			py_cancel_va( fnc );
+			return NULL;
+		}
+		py_call_va( funcobj, fnc, return NULL; );
+		if( unlikely( py_error( fnc ) ) ) {
+			py_release( ret );
+			return NULL;
+		}
+		if( unlikely( ret == NULL ) ) {
+			fprintf( stderr, "python function %s failed\n", fnc );
+			return NULL;
+		}
+		
+		return ret;
+	}
+	
+	static PyObject *py_call_retry( retry_state &state, PyObject *funcobj, const char *const fnc, ... ) _noexcept {
+		py_error_code( )[0] = '\0';
+		if( unlikely( funcobj == NULL ) ) {
+			py_cancel_va( fnc );
+			return NULL;
+		}
+		py_args_va( fnc, return NULL; );
+		PyObject *ret = py_call_attempts( state, funcobj, arg_list, arg_dict );
+		Py_DECREF( arg_list );
+		py_release( arg_dict );
+		if( unlikely( py_error( fnc ) ) ) {
+			py_release( ret );
+			return NULL;
+		}
+		if( unlikely( ret == NULL ) ) {
+			fprintf( stderr, "python function %s failed\n", fnc );
+			return NULL;
+		}
+		
+		return ret;
+	}
+	
+	static PyObject *py_callfunc_retry( retry_state &state, PyObject *obj, const char *const fnc, ... ) _noexcept {
+		py_error_code( )[0] = '\0';
+		PyObject *funcobj = py_method( obj, fnc );
+		if( unlikely( funcobj == NULL ) ) {
+			py_cancel_va( fnc );
+			return NULL;
+		}
+		py_args_va( fnc, Py_DECREF( funcobj ); return NULL; );
+		PyObject *ret = py_call_attempts( state, funcobj, arg_list, arg_dict );
+		Py_DECREF( arg_list );
+		py_release( arg_dict );
+		Py_DECREF( funcobj );
+		if( unlikely( py_error( fnc ) ) ) {
+			py_release( ret );
+			return NULL;
+		}
+		if( unlikely( ret == NULL ) ) {
+			fprintf( stderr, "python function %s failed\n", fnc );
+			return NULL;
+		}
+		
+		return ret;
+	}
+	
+	static PyObject *py_call_attempts( retry_state &state, PyObject *const funcobj, PyObject *const args, PyObject *const kwargs ) _noexcept {
+		// the exception from the last attempt is left set for py_error
+		retry_call attempt( state );
+		while( true ) {
+			PyObject *ret = PyObject_Call( funcobj, args, kwargs );
+			if( likely( ret != NULL ) ) {
+				attempt.succeeded( );
+				return ret;
+			}
+			if( unlikely( PyErr_Occurred( ) == NULL ) ) {
+				return NULL;
+			}
+			PyObject *type;
+			PyObject *value;
+			PyObject *traceback;
+			PyErr_Fetch( &type, &value, &traceback );
+			PyErr_NormalizeException( &type, &value, &traceback );
+			py_error_fill( type, value );
+			PyErr_Restore( type, value, traceback );
+			const retry_kind kind = retry_from_code( py_error_code( ), py_error_status( ) );
+			bool retry;
+#if BOTOC_THREADSAFE
+			Py_BEGIN_ALLOW_THREADS
+			retry = attempt.again( kind );
+			Py_END_ALLOW_THREADS
+#else
+			retry = attempt.again( kind );
+#endif
+			if( !retry ) {
+				return NULL;
+			}
+			PyErr_Clear( );
+		}
+	}
+	
 #undef py_cancel_va
+#undef py_args_va
 #undef py_call_va
+#endif
 }
 
 #undef BASE64_DEFAULT_ALPHABET
@@ -0,0 +1,223 @@
+// botoc_coro.h: C++20 coroutine versions of the SQS and DDB calls
+// Copyright 2013, Poikos Ltd.
+// Author: David Evans
+
+// usage:
+//  1: include python (first!), unless BOTOC_NATIVE is set
+//  2: include botoc_sqs.h and / or botoc_ddb.h, then botoc_async.h, then this
+//     header (needs C++20)
+//  3: call botoc::set_iam_user( key, secret ) and botoc::set_region( region )
+//  4: optionally call botoc::coro::set_executor( executor, context )
+//  5: co_await as the synchronous calls, inside a coroutine:
+//       bool ok = co_await botoc::sqs::put_co( queue, message )
+//       handle_t h = co_await botoc::sqs::get_co( queue, message[, lock[, wait]] )
+//       bool ok = co_await botoc::sqs::remove_co( queue, handle )
+//       bool ok = co_await botoc::ddb::update_co( table, key, items[, expected] )
+//       bool ok = co_await botoc::ddb::get_co( table, key, consistent, items )
+//  6: link with python (not needed with BOTOC_NATIVE)
+
+// the request is sent as soon as the call is made, on the botoc::async I/O
+// threads, and the coroutine is suspended until it completes; co_await the
+// result straight away (outputs must stay valid until then).
+
+// a suspended coroutine does not hold a thread, so any number of them can be
+// waiting at once; botoc::async::set_threads limits how many requests are
+// actually in flight. By default coroutines resume on the I/O thread that
+// completed their request. To resume them on your own threads (e.g. an event
+// loop), give set_executor a function which queues resume( frame ) to run
+// there.
+
+#ifndef BOTOC_CORO_H_INCLUDED__
+#define BOTOC_CORO_H_INCLUDED__
+
+#ifndef BOTOC_ASYNC_H_INCLUDED__
+#  error "include botoc_async.h before botoc_coro.h"
+#endif
+
+#if !defined(__cpp_impl_coroutine) || __cpp_impl_coroutine < 201902L
+#  error "botoc_coro.h needs C++20 coroutines (e.g. -std=c++20)"
+#endif
+
+#include <coroutine>
+#include <atomic>
+#include <sched.h>
+
+namespace botoc {
+	namespace coro {
+		/* types */
+		
+		// must arrange for resume( frame ) to be called exactly once, on any
+		// thread (it is called on an I/O thread, so should only queue the work)
+		typedef void (*resumer)( void *frame );
+		typedef void (*executor)( resumer resume, void *frame, void *context );
+		
+		struct executor_state {
+			std::atomic<executor> run;
+			std::atomic<void *> context;
+			
+			inline executor_state( void ) _noexcept :
+			run( NULL ),
+			context( NULL )
+			{
+			}
+		};
+		
+		/* prototypes */
+		
+		// Sets where coroutines resume once their request completes; NULL
+		// resumes them directly on the I/O thread. Only affects requests made
+		// after the call.
+		__attribute__((unused))
+		static void set_executor( executor run, void *context = NULL ) _noexcept;
+		
+		/* internal prototypes */
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline executor_state &executor_config( void ) _noexcept;
+		
+		/* classes */
+		
+		class operation {
+		private:
+			std::coroutine_handle<> _frame;
+			executor _run;
+			void *_runContext;
+			std::atomic<bool> _claimed; // set by whichever of completion / await_suspend comes first
+			
+			operation( const operation & );
+			operation &operator =( const operation & );
+			
+			static void _resume( void *const frame ) _noexcept {
+				std::coroutine_handle<>::from_address( frame ).resume( );
+			}
+			
+			static void _completed( bool, size_t, void *const self ) _noexcept {
+				operation &o = *(operation *) self;
+				if( !o._claimed.exchange( true ) ) {
+					return; // not suspended yet; await_suspend will see this and carry on
+				}
+				if( o._run == NULL ) {
+					o._frame.resume( );
+				} else {
+					o._run( &_resume, o._frame.address( ), o._runContext );
+				}
+			}
+			
+		protected:
+			async::future _future;
+			
+			inline operation( void ) _noexcept :
+			_frame( ),
+			_run( executor_config( ).run.load( ) ),
+			_runContext( executor_config( ).context.load( ) ),
+			_claimed( false ),
+			_future( )
+			{
+				_future._after( &_completed, this );
+			}
+			
+		public:
+			// (only waits if the operation was never co_awaited)
+			inline ~operation( void ) _noexcept {
+				(void) _future.wait( );
+				while( !_claimed.load( ) ) {
+					sched_yield( ); // completion is about to return
+				}
+			}
+			
+			inline bool await_ready( void ) const _noexcept {
+				return false;
+			}
+			
+			inline bool await_suspend( std::coroutine_handle<> frame ) _noexcept {
+				_frame = frame;
+				// if the request has already completed, carry on without suspending
+				return !_claimed.exchange( true );
+			}
+			
+			inline bool await_resume( void ) _noexcept {
+				return _future.ok( );
+			}
+		};
+		
+		/* implementation */
+		
+		static inline executor_state &executor_config( void ) _noexcept {
+			static executor_state state;
+			return state;
+		}
+		
+		static void set_executor( const executor run, void *const context ) _noexcept {
+			executor_state &s = executor_config( );
+			s.context.store( context );
+			s.run.store( run );
+		}
+	}
+
+#ifdef BOTOC_SQS_H_INCLUDED__
+	namespace sqs {
+		/* classes */
+		
+		class put_co : public coro::operation {
+		public:
+			inline put_co( const const_string_t &queue, const const_string_t &message ) _noexcept {
+				(void) put_async( queue, message, _future );
+			}
+		};
+		
+		class get_co : public coro::operation {
+		private:
+			handle_t _handle;
+			
+		public:
+			inline get_co( const const_string_t &queue, string_t &body, int lockSeconds = 30, int waitSeconds = 0 ) _noexcept :
+			_handle( NULL )
+			{
+				(void) get_async( queue, body, _handle, lockSeconds, waitSeconds, _future );
+			}
+			
+			// the message's handle (NULL if nothing was received)
+			inline handle_t await_resume( void ) _noexcept {
+				return _future.ok( ) ? _handle : NULL;
+			}
+		};
+		
+		class remove_co : public coro::operation {
+		public:
+			inline remove_co( const const_string_t &queue, handle_t handle ) _noexcept {
+				(void) remove_async( queue, handle, _future );
+			}
+		};
+	}
+#endif
+
+#ifdef BOTOC_DDB_H_INCLUDED__
+	namespace ddb {
+		/* classes */
+		
+		class update_co : public coro::operation {
+		public:
+			inline update_co( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *expected = NULL ) _noexcept {
+				(void) update_async( db, key, items, expected, _future );
+			}
+			
+			inline update_co( const const_string_t &db, const const_string_t &key, const item_list_t &items, const item_list_t *expected = NULL ) _noexcept {
+				(void) update_async( db, key, items, expected, _future );
+			}
+		};
+		
+		class get_co : public coro::operation {
+		public:
+			inline get_co( const const_string_t &db, const item_key &key, bool consistent, item_list_t &items ) _noexcept {
+				(void) get_async( db, key, consistent, items, _future );
+			}
+			
+			inline get_co( const const_string_t &db, const const_string_t &key, bool consistent, item_list_t &items ) _noexcept {
+				(void) get_async( db, key, consistent, items, _future );
+			}
+		};
+	}
+#endif
+}
+
+#endif
@@ -4,23 +4,42 @@
 // Based on code from 9apps
 
 // usage:
-//  1: include python (first!)
+//  1: include python (first!), unless BOTOC_NATIVE is set
 //  2: include this header
 //  3: call botoc::set_iam_user( key, secret ) and botoc::set_region( region )
 //  4: use as required:
 //       botoc::ddb::update( table, key, items[, expected] )
 //       botoc::ddb::get( table, key, consistent, items )
+//         (key is a hash key string, or an item_key for other types / range keys)
+//       botoc::ddb::get( table, key, consistent, map[, attributes] )
+//         (decodes into an arena-backed botoc::ddb::attribute_map)
+//       botoc::ddb::query( table, hash, condition, limit, callback, context )
+//       botoc::ddb::parallel_scan( table, segments, attributes, callback, context[, maxUnits] )
+//       botoc::ddb::batch_get( table, keys, attributes, consistent, results )
+//       botoc::ddb::batch_put( table, records[, inFlight] )
+//       botoc::ddb::batch_delete( table, keys[, inFlight] )
+//       botoc::ddb::set_cache( maxBytes, ttlSeconds ) (optional)
+//       botoc::ddb::set_retry_policy( policy ) (optional)
+//       botoc::ddb::set_pool_policy( policy ) (optional)
 //       botoc::ddb::disconnect( )
-//  5: link with python
+//  5: link with python (not needed with BOTOC_NATIVE)
 
 // changing iam user or region after performing an action has no effect; calling
-// disconnect() will close the current connection, and the next request will use
-// the new credentials / url
+// disconnect() will close the current connections, and the next request will use
+// the new credentials / url. To use several regions or accounts at once, make a
+// botoc::client for each and select it with a botoc::client_scope.
 
 #ifndef BOTOC_DDB_H_INCLUDED__
 #define BOTOC_DDB_H_INCLUDED__
 
 #include "botoc_common.h"
+#if BOTOC_NATIVE
+#  include "botoc_native.h"
+#endif
+
+#include <algorithm>
+#include <list>
+#include <utility>
 
 namespace botoc {
 	namespace ddb {
@@ -45,18 +64,63 @@ namespace botoc {
 			ADD      = 1,
 			DELETE   = 2
 		};
+		enum compare_op {
+			NO_CONDITION = 0, // (all range keys)
+			EQ           = 1,
+			LE           = 2,
+			LT           = 3,
+			GE           = 4,
+			GT           = 5,
+			BEGINS_WITH  = 6,
+			BETWEEN      = 7
+		};
+		enum limits {
+			MAX_BATCH_GET     = 100, // most keys DDB will read in one request
+			MAX_BATCH_WRITE   = 25,  // most items DDB will write in one request
+			ARENA_BLOCK       = 1024, // smallest block an arena allocates
+			METRIC_BUCKETS    = 24    // latency histogram buckets (powers of 2 microseconds)
+		};
+		enum metric_op {
+			OP_UPDATE      = 0, // UpdateItem
+			OP_GET         = 1, // GetItem
+			OP_BATCH_GET   = 2, // BatchGetItem
+			OP_BATCH_WRITE = 3, // BatchWriteItem
+			OP_QUERY       = 4, // Query
+			OP_SCAN        = 5, // Scan
+			OP_DESCRIBE    = 6, // DescribeTable
+			OP_KINDS       = 7
+		};
+		enum metric_failure {
+			FAIL_INVALID   = 0, // bad arguments, or rejected by DDB (ValidationException, ResourceNotFoundException)
+			FAIL_THROTTLED = 1, // ProvisionedThroughputExceededException, ThrottlingException
+			FAIL_CONDITION = 2, // ConditionalCheckFailedException ("expected" did not match)
+			FAIL_NOT_FOUND = 3, // get found no record
+			FAIL_REQUEST   = 4, // the request failed (network, credentials, other DDB errors)
+			FAIL_RESPONSE  = 5, // the response was malformed
+			FAIL_MEMORY    = 6, // out of memory
+			FAIL_KINDS     = 7
+		};
 		
 		/* prototypes */
 		
 		__attribute__((const,warn_unused_result,always_inline))
 		static inline const char *string_from_type( const data_type type ) _noexcept;
 		
+		__attribute__((const,warn_unused_result,always_inline,unused))
+		static inline const char *string_from_op( const metric_op op ) _noexcept;
+		
+		__attribute__((const,warn_unused_result,always_inline,unused))
+		static inline const char *string_from_failure( const metric_failure failure ) _noexcept;
+		
 		__attribute__((const,warn_unused_result,always_inline))
 		static inline const char *string_from_action( const data_action action ) _noexcept;
 		
 		__attribute__((pure,warn_unused_result,always_inline))
 		static inline data_type type_from_string( const char *const type ) _noexcept;
 		
+		__attribute__((const,warn_unused_result,always_inline))
+		static inline const char *string_from_compare( const compare_op op ) _noexcept;
+		
 		/* implementation */
 		
 		static inline const char *string_from_type( const data_type type ) _noexcept {
@@ -65,6 +129,15 @@ namespace botoc {
 		static inline const char *string_from_action( const data_action action ) _noexcept {
 			return &("PUT\0ADD\0DELETE"[action*4]);
 		}
+		static inline const char *string_from_op( const metric_op op ) _noexcept {
+			return &("UpdateItem\0\0\0\0\0GetItem\0\0\0\0\0\0\0\0BatchGetItem\0\0\0BatchWriteItem\0Query\0\0\0\0\0\0\0\0\0\0Scan\0\0\0\0\0\0\0\0\0\0\0DescribeTable"[op*15]);
+		}
+		static inline const char *string_from_failure( const metric_failure failure ) _noexcept {
+			return &("invalid\0\0\0throttled\0condition\0not found\0request\0\0\0response\0\0memory"[failure*10]);
+		}
+		static inline const char *string_from_compare( const compare_op op ) _noexcept {
+			return &("\0\0\0\0\0\0\0\0\0\0\0\0EQ\0\0\0\0\0\0\0\0\0\0LE\0\0\0\0\0\0\0\0\0\0LT\0\0\0\0\0\0\0\0\0\0GE\0\0\0\0\0\0\0\0\0\0GT\0\0\0\0\0\0\0\0\0\0BEGINS_WITH\0BETWEEN"[op*12]);
+		}
 		static inline data_type type_from_string( const char *const type ) _noexcept {
 			if( unlikely( type == NULL ) ) {
 				return UNKNOWN;
@@ -207,6 +280,47 @@ namespace botoc {
 				((_type & SET) ? _list( ).size( ) : _value( ).size( ));
 			}
 			
+			// Size of the value as get_binary would return it (decoded for BINARY)
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline size_t binary_size( void ) const _noexcept {
+				if( unlikely( _type == UNKNOWN || (_type & SET) ) ) {
+					return 0;
+				}
+				return (_type == BINARY) ? binary_length( _value( ) ) : _value( ).size( );
+			}
+			
+			// Copies the value into output (which needs binary_size( ) bytes),
+			// decoding BINARY values; returns the bytes written
+			__attribute__((always_inline,warn_unused_result))
+			inline size_t get_binary( void *output, size_t capacity ) const _noexcept {
+				if( unlikely( _type == UNKNOWN || (_type & SET) ) ) {
+					return 0;
+				}
+				if( _type == BINARY ) {
+					return decode_binary( _value( ), output, capacity );
+				}
+				const size_t l = _value( ).size( );
+				if( unlikely( output == NULL || capacity < l ) ) {
+					return 0;
+				}
+				memcpy( output, _value( ).data( ), l );
+				return l;
+			}
+			
+			__attribute__((always_inline,warn_unused_result))
+			inline bool get_binary( string_t &output ) const _noexcept {
+				if( unlikely( _type == UNKNOWN || (_type & SET) ) ) {
+					return false;
+				}
+				if( _type == BINARY ) {
+					return decode_binary( _value( ), output );
+				}
+				try {
+					output.assign( _value( ) );
+				} catch( ... ) { return false; }
+				return true;
+			}
+			
 			/*
 			 inline float float_value( void ) const _noexcept {
 			 if( _type != NUMBER ) {
@@ -262,6 +376,13 @@ namespace botoc {
 				return true;
 			}
 			
+#if LANGUAGE_CPP11
+			__attribute__((always_inline))
+			inline void set_name( string_t &&name ) _noexcept {
+				_name = std::move( name );
+			}
+#endif
+			
 			__attribute__((always_inline,warn_unused_result))
 			inline bool set_type( data_type type ) _noexcept {
 				if( _type == type ) {
@@ -384,6 +505,30 @@ namespace botoc {
 				return true;
 			}
 			
+#if LANGUAGE_CPP11
+			// takes value's contents without copying them
+			__attribute__((always_inline,warn_unused_result))
+			inline bool set_value( string_t &&value ) _noexcept {
+				if( unlikely( _type == UNKNOWN || (_type & SET) ) ) {
+					return false;
+				}
+				_value( ) = std::move( value );
+				return true;
+			}
+			
+			__attribute__((always_inline,warn_unused_result))
+			inline bool set_value( string_t &&value, data_type type ) _noexcept {
+				if( unlikely( type == UNKNOWN || (type & SET) ) ) {
+					return false;
+				}
+				if( unlikely( !set_type( type ) ) ) {
+					return false;
+				}
+				_value( ) = std::move( value );
+				return true;
+			}
+#endif
+			
 			__attribute__((always_inline,warn_unused_result))
 			inline bool set_value( const char *value, size_t length, data_type type ) _noexcept {
 				if( unlikely( type == UNKNOWN || (type & SET) ) ) {
@@ -604,6 +749,20 @@ namespace botoc {
 				return true;
 			}
 			
+#if LANGUAGE_CPP11
+			// takes value's contents without copying them
+			__attribute__((always_inline,warn_unused_result))
+			inline bool add_item( string_t &&value ) _noexcept {
+				if( unlikely( !(_type & SET) ) ) {
+					return false;
+				}
+				try {
+					_list( ).push_back( std::move( value ) );
+				} catch( ... ) { return false; }
+				return true;
+			}
+#endif
+			
 			__attribute__((always_inline))
 			inline void clear_items( void ) _noexcept {
 				if( _type & SET ) {
@@ -650,8 +809,61 @@ namespace botoc {
 			{
 			}
 			
+#if LANGUAGE_CPP11
+			// (these take their string arguments without copying them, so
+			// emplace_back( std::move( name ), ... ) builds items in place)
+			__attribute__((always_inline))
+			inline explicit item( string_t &&name, data_action action = REPLACE ) _noexcept :
+			_name( std::move( name ) ),
+			_type( UNKNOWN ),
+			_action( action ),
+			_data( )
+			{
+			}
+			
+			__attribute__((always_inline))
+			inline item( string_t &&name, data_type type, data_action action = REPLACE ) _throws_bad_alloc :
+			_name( std::move( name ) ),
+			_type( UNKNOWN ),
+			_action( action ),
+			_data( )
+			{
+				if( unlikely( !set_type( type ) ) ) {
+					std::bad_alloc ex;
+					throw ex;
+				}
+			}
+			
+			__attribute__((always_inline))
+			inline item( const const_string_t &name, string_t &&value, data_type type = STRING ) _throws_bad_alloc :
+			_name( name ),
+			_type( UNKNOWN ),
+			_action( REPLACE ),
+			_data( )
+			{
+				if( unlikely( !set_value( std::move( value ), type ) ) ) {
+					std::bad_alloc ex;
+					throw ex;
+				}
+			}
+			
+			__attribute__((always_inline))
+			inline item( const const_string_t &name, string_list_t &&values, data_type type = STRINGSET ) _throws_bad_alloc :
+			_name( name ),
+			_type( UNKNOWN ),
+			_action( REPLACE ),
+			_data( )
+			{
+				if( unlikely( !(type & SET) || !set_type( type ) ) ) {
+					std::bad_alloc ex;
+					throw ex;
+				}
+				_list( ) = std::move( values );
+			}
+#endif
+			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, data_type type, data_action action = REPLACE ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, data_type type, data_action action = REPLACE ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( action ),
@@ -664,7 +876,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, const const_string_t &value, data_type type = STRING ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, const const_string_t &value, data_type type = STRING ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( REPLACE ),
@@ -677,7 +889,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, const char *value, data_type type = STRING ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, const char *value, data_type type = STRING ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( REPLACE ),
@@ -690,7 +902,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, const char *value, size_t length, data_type type = STRING ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, const char *value, size_t length, data_type type = STRING ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( REPLACE ),
@@ -703,7 +915,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, const char *value, size_t length, flag_raw raw, data_type type = BINARY ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, const char *value, size_t length, flag_raw raw, data_type type = BINARY ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( REPLACE ),
@@ -717,7 +929,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, const void *value, size_t length, data_type type = BINARY ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, const void *value, size_t length, data_type type = BINARY ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( REPLACE ),
@@ -730,7 +942,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, float value, data_action action = REPLACE ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, float value, data_action action = REPLACE ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( REPLACE ),
@@ -747,7 +959,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, double value, data_action action = REPLACE ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, double value, data_action action = REPLACE ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( action ),
@@ -764,7 +976,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, int value, data_action action = REPLACE ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, int value, data_action action = REPLACE ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( action ),
@@ -781,7 +993,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const const_string_t &name, long value, data_action action = REPLACE ) throw( std::bad_alloc ) :
+			inline item( const const_string_t &name, long value, data_action action = REPLACE ) _throws_bad_alloc :
 			_name( name ),
 			_type( UNKNOWN ),
 			_action( action ),
@@ -798,7 +1010,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item( const item &copy ) throw( std::bad_alloc ) :
+			inline item( const item &copy ) _throws_bad_alloc :
 			_name( copy._name ),
 			_type( UNKNOWN ),
 			_action( copy._action ),
@@ -818,7 +1030,7 @@ namespace botoc {
 			}
 			
 			__attribute__((always_inline))
-			inline item &operator =( const item &copy ) throw( std::bad_alloc ) {
+			inline item &operator =( const item &copy ) _throws_bad_alloc {
 				_name.assign( copy._name );
 				if( unlikely( !set_type( copy._type ) ) ) {
 					std::bad_alloc ex;
@@ -835,415 +1047,4279 @@ namespace botoc {
 				return *this;
 			}
 			
+#if LANGUAGE_CPP11
+			// leaves other with its name moved out and no value
+			__attribute__((always_inline))
+			inline item( item &&other ) _noexcept :
+			_name( std::move( other._name ) ),
+			_type( other._type ),
+			_action( other._action ),
+			_data( )
+			{
+				if( _type != UNKNOWN ) {
+					if( (_type & SET) ) {
+						(void) new( &_list( ) ) string_list_t( std::move( other._list( ) ) );
+					} else {
+						(void) new( &_value( ) ) string_t( std::move( other._value( ) ) );
+					}
+					other.clear_data( );
+				}
+			}
+			
+			__attribute__((always_inline))
+			inline item &operator =( item &&other ) _noexcept {
+				if( this == &other ) {
+					return *this;
+				}
+				clear_data( );
+				_name = std::move( other._name );
+				_action = other._action;
+				if( other._type != UNKNOWN ) {
+					if( (other._type & SET) ) {
+						(void) new( &_list( ) ) string_list_t( std::move( other._list( ) ) );
+					} else {
+						(void) new( &_value( ) ) string_t( std::move( other._value( ) ) );
+					}
+					_type = other._type;
+					other.clear_data( );
+				}
+				return *this;
+			}
+#endif
+			
 			__attribute__((always_inline))
 			inline ~item( void ) _noexcept {
 				clear_data( );
 			}
 		};
 		
-		typedef std::vector<item> item_list_t;
-		
-		/* prototypes */
-		
-		__attribute__((warn_unused_result,unused))
-		static bool update( const const_string_t &db, const const_string_t &key, const item_list_t &items, const item_list_t *expected = NULL ) _noexcept;
-		
-		__attribute__((warn_unused_result,unused))
-		static bool get( const const_string_t &db, const const_string_t &key, bool consistent, item_list_t &items ) _noexcept;
-		
-		__attribute__((always_inline,unused))
-		static inline void disconnect( void ) _noexcept;
-		
-		/* internal prototypes */
-		
-		__attribute__((warn_unused_result))
-		static PyObject *prep( bool disconnect = false ) _noexcept;
-		
-		__attribute__((warn_unused_result))
-		static PyObject *dict_from_items_expect( const item_list_t &items ) _noexcept;
-		
-		__attribute__((warn_unused_result))
-		static PyObject *dict_from_items_update( const item_list_t &items ) _noexcept;
-		
-		__attribute__((warn_unused_result))
-		static PyObject *list_from_items( const item_list_t &items ) _noexcept;
+		// A primary key: a hash key, optionally with a range key. Each element is
+		// an item (the name is ignored) of type STRING, NUMBER or BINARY, e.g.
+		//   item_key( item( "", user ), item( "", timestamp ) )
+		class item_key {
+		public:
+			item hash;
+			item range; // UNKNOWN type if the table has no range key
+			
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline bool has_range( void ) const _noexcept {
+				return range.type( ) != UNKNOWN;
+			}
+			
+			__attribute__((pure,warn_unused_result))
+			inline bool valid( void ) const _noexcept {
+				// STRING, NUMBER or BINARY (not UNKNOWN or a SET), and not empty
+				return hash.type( ) <= BINARY && hash.size( ) > 0 && (!has_range( ) || (range.type( ) <= BINARY && range.size( ) > 0));
+			}
+			
+			__attribute__((always_inline))
+			inline item_key( void ) _noexcept :
+			hash( ),
+			range( )
+			{
+			}
+			
+			__attribute__((always_inline))
+			inline explicit item_key( const const_string_t &hashKey ) _throws_bad_alloc :
+			hash( string_t( ), hashKey, STRING ),
+			range( )
+			{
+			}
+			
+			__attribute__((always_inline))
+			inline item_key( const const_string_t &hashKey, const const_string_t &rangeKey ) _throws_bad_alloc :
+			hash( string_t( ), hashKey, STRING ),
+			range( string_t( ), rangeKey, STRING )
+			{
+			}
+			
+			__attribute__((always_inline))
+			inline explicit item_key( const item &hashKey ) _throws_bad_alloc :
+			hash( hashKey ),
+			range( )
+			{
+			}
+			
+			__attribute__((always_inline))
+			inline item_key( const item &hashKey, const item &rangeKey ) _throws_bad_alloc :
+			hash( hashKey ),
+			range( rangeKey )
+			{
+			}
+		};
 		
-		__attribute__((warn_unused_result))
-		static inline bool item_from_dict( PyObject *obj, item &output ) _noexcept;
+		// A condition on range keys for query, e.g.
+		//   range_condition( GT, item( "", timestamp ) )
+		//   range_condition( item( "", from ), item( "", to ) )  (BETWEEN)
+		class range_condition {
+		public:
+			compare_op op;
+			item first;
+			item second; // BETWEEN only
+			
+			__attribute__((always_inline))
+			inline range_condition( void ) _noexcept :
+			op( NO_CONDITION ),
+			first( ),
+			second( )
+			{
+			}
+			
+			__attribute__((always_inline))
+			inline range_condition( compare_op compare, const item &value ) _throws_bad_alloc :
+			op( compare ),
+			first( value ),
+			second( )
+			{
+			}
+			
+			__attribute__((always_inline))
+			inline range_condition( const item &low, const item &high ) _throws_bad_alloc :
+			op( BETWEEN ),
+			first( low ),
+			second( high )
+			{
+			}
+		};
 		
-		__attribute__((warn_unused_result))
-		static bool update_from_dict( item_list_t &items, PyObject *ret_items ) _noexcept;
+		typedef std::vector<item> item_list_t;
+		typedef std::map<string_t,item_list_t> item_map_t; // hash key => items
+		typedef std::vector<item_list_t> record_list_t;
 		
-		/* implementation */
+		// receives each page of query results (which it may modify, e.g. by
+		// swapping records out); return false to stop early
+		typedef bool (*page_callback)( record_list_t &page, void *context );
 		
-		static PyObject *prep( const bool disconnect ) _noexcept {
-			/*
-			 * import boto.regioninfo
-			 * import boto.dynamodb.layer1
-			 *
-			 * layer1 = boto.dynamodb.layer1.Layer1(
-			 *   aws_access_key_id = [key],
-			 *   aws_secret_access_key = [secret],
-			 *   region = boto.regioninfo.RegionInfo(
-			 *     name = [region],
-			 *     endpoint = 'dynamodb.' + [region] + '.amazonaws.com'
-			 *   )
-			 * )
-			 */
+		// A bump allocator: memory is handed out from a few large blocks and is
+		// only freed all at once (by clear or the destructor). Move-only.
+		class arena {
+		private:
+			struct block {
+				block *next;
+				size_t size;
+			};
 			
-			static bool tried = false;
-			static PyObject *layer1 = NULL;
+			block *_blocks; // newest (and largest) first
+			char *_next;
+			char *_end;
 			
-			if( disconnect ) {
-				if( layer1 == NULL ) {
-					return NULL;
+			arena( const arena & );
+			arena &operator =( const arena & );
+			
+			inline void _release( void ) _noexcept {
+				while( _blocks != NULL ) {
+					block *const next = _blocks->next;
+					free( _blocks );
+					_blocks = next;
 				}
-				
-				py_release( layer1 );
-				layer1 = NULL;
-				
-				tried = false;
-				return NULL;
+				_next = NULL;
+				_end = NULL;
 			}
 			
-			if( tried ) {
-				return layer1;
-			}
-			if( unlikely( region.size( ) <= 0 ) ) {
-				fprintf( stderr, "attempted to connect to DDB without a region\n" );
-				return NULL;
-			}
-			if( unlikely( user_key.size( ) <= 0 || user_secret.size( ) <= 0 ) ) {
-				fprintf( stderr, "attempted to connect to DDB without a valid IAM user\n" );
-				return NULL;
+		public:
+			inline arena( void ) _noexcept :
+			_blocks( NULL ),
+			_next( NULL ),
+			_end( NULL )
+			{
 			}
-			tried = true;
 			
-			if( unlikely( !py_init( ) ) ) {
-				return NULL;
+#if LANGUAGE_CPP11
+			inline arena( arena &&other ) _noexcept :
+			_blocks( other._blocks ),
+			_next( other._next ),
+			_end( other._end )
+			{
+				other._blocks = NULL;
+				other._next = NULL;
+				other._end = NULL;
 			}
 			
-			PyObject *regioninfo_mod = py_import( "boto.regioninfo" );
-			PyObject *ddb_mod = py_import( "boto.dynamodb.layer1" );
+			inline arena &operator =( arena &&other ) _noexcept {
+				if( this != &other ) {
+					_release( );
+					swap( other );
+				}
+				return *this;
+			}
+#endif
 			
-			string_t endpoint( "dynamodb." );
-			endpoint.append( region );
-			endpoint.append( ".amazonaws.com" );
+			inline ~arena( void ) _noexcept {
+				_release( );
+			}
 			
-			layer1 = py_construct( ddb_mod, "Layer1",
-				"aws_access_key_id", py_string( user_key ),
-				"aws_secret_access_key", py_string( user_secret ),
-				"region", py_construct( regioninfo_mod, "RegionInfo",
-					"name", py_string( region ),
-					"endpoint", py_string( endpoint ),
-				NULL ),
-			NULL );
+			inline void swap( arena &other ) _noexcept {
+				std::swap( _blocks, other._blocks );
+				std::swap( _next, other._next );
+				std::swap( _end, other._end );
+			}
 			
-			py_release( regioninfo_mod );
-			py_release( ddb_mod );
+			// Makes sure the next bytes (in total) can be allocated without
+			// going back to malloc
+			__attribute__((warn_unused_result))
+			inline bool reserve( const size_t bytes ) _noexcept {
+				if( (size_t) (_end - _next) >= bytes ) {
+					return true;
+				}
+				// grow geometrically, so many small allocations cost few blocks
+				size_t size = (_blocks == NULL) ? (size_t) ARENA_BLOCK : _blocks->size * 2;
+				if( size < bytes ) {
+					size = bytes;
+				}
+				block *const b = (block *) malloc( sizeof( block ) + size );
+				if( unlikely( b == NULL ) ) {
+					return false;
+				}
+				b->next = _blocks;
+				b->size = size;
+				_blocks = b;
+				_next = (char *) (b + 1);
+				_end = _next + size;
+				return true;
+			}
 			
-			if( unlikely( layer1 == NULL ) ) {
-				fprintf( stderr, "could not connect to DDB\n" );
+			// Returns NULL if out of memory; align must be a power of 2
+			__attribute__((warn_unused_result))
+			inline void *allocate( const size_t bytes, const size_t align = sizeof( void * ) ) _noexcept {
+				size_t pad = (align - ((size_t) _next & (align - 1))) & (align - 1);
+				if( (size_t) (_end - _next) < pad + bytes ) {
+					if( unlikely( !reserve( bytes + align ) ) ) {
+						return NULL;
+					}
+					pad = (align - ((size_t) _next & (align - 1))) & (align - 1);
+				}
+				char *const r = _next + pad;
+				_next = r + bytes;
+				return r;
 			}
 			
-			return layer1;
+			// Copies length bytes (and a terminating 0); NULL if out of memory
+			__attribute__((warn_unused_result))
+			inline const char *copy( const char *const data, const size_t length ) _noexcept {
+				char *const r = (char *) allocate( length + 1, 1 );
+				if( unlikely( r == NULL ) ) {
+					return NULL;
+				}
+				memcpy( r, data, length );
+				r[length] = '\0';
+				return r;
+			}
+			
+			// Frees everything, but keeps the newest (largest) block for reuse
+			inline void clear( void ) _noexcept {
+				if( _blocks == NULL ) {
+					return;
+				}
+				block *b = _blocks->next;
+				while( b != NULL ) {
+					block *const next = b->next;
+					free( b );
+					b = next;
+				}
+				_blocks->next = NULL;
+				_next = (char *) (_blocks + 1);
+				_end = _next + _blocks->size;
+			}
+		};
+		
+		struct attribute_value {
+			const char *data; // 0-terminated
+			size_t length;
+		};
+		
+		// An attribute in an attribute_map. Its strings belong to the map, so it
+		// is only valid until the map is cleared, changed or destroyed.
+		struct attribute {
+			attribute_value name;
+			data_type type;
+			size_t count;            // 1 unless type is a SET
+			attribute_value *values;
+			
+			// NULL for sets
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline const attribute_value *value( void ) const _noexcept {
+				return (type & SET) ? NULL : values;
+			}
+		};
+		
+		// The attributes of one record, with all names and values held in an
+		// arena: decoding a record costs one allocation (none if the map is
+		// reused and big enough) rather than several per attribute, and
+		// attributes are found by name in O(1). Move-only (use swap in C++03).
+		class attribute_map {
+		private:
+			arena _arena;
+			attribute *_attributes;
+			size_t _count;
+			size_t _capacity;
+			size_t *_index; // open addressing; position in _attributes + 1, or 0
+			size_t _mask;   // (buckets - 1)
+			
+			attribute_map( const attribute_map & );
+			attribute_map &operator =( const attribute_map & );
+			
+			__attribute__((pure,warn_unused_result,always_inline))
+			static inline size_t _hash( const char *const name, const size_t length ) _noexcept {
+				// FNV-1a
+				size_t h = (size_t) 2166136261u;
+				for( size_t i = 0; i < length; ++ i ) {
+					h = (h ^ (unsigned char) name[i]) * (size_t) 16777619u;
+				}
+				return h;
+			}
+			
+			inline void _reset( void ) _noexcept {
+				_attributes = NULL;
+				_count = 0;
+				_capacity = 0;
+				_index = NULL;
+				_mask = 0;
+			}
+			
+		public:
+			inline attribute_map( void ) _noexcept :
+			_arena( ),
+			_attributes( NULL ),
+			_count( 0 ),
+			_capacity( 0 ),
+			_index( NULL ),
+			_mask( 0 )
+			{
+			}
+			
+#if LANGUAGE_CPP11
+			inline attribute_map( attribute_map &&other ) _noexcept :
+			_arena( std::move( other._arena ) ),
+			_attributes( other._attributes ),
+			_count( other._count ),
+			_capacity( other._capacity ),
+			_index( other._index ),
+			_mask( other._mask )
+			{
+				other._reset( );
+			}
+			
+			inline attribute_map &operator =( attribute_map &&other ) _noexcept {
+				if( this != &other ) {
+					clear( );
+					swap( other );
+				}
+				return *this;
+			}
+#endif
+			
+			inline void swap( attribute_map &other ) _noexcept {
+				_arena.swap( other._arena );
+				std::swap( _attributes, other._attributes );
+				std::swap( _count, other._count );
+				std::swap( _capacity, other._capacity );
+				std::swap( _index, other._index );
+				std::swap( _mask, other._mask );
+			}
+			
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline size_t size( void ) const _noexcept {
+				return _count;
+			}
+			
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline bool empty( void ) const _noexcept {
+				return _count == 0;
+			}
+			
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline const attribute &operator []( const size_t i ) const _noexcept {
+				return _attributes[i];
+			}
+			
+			// NULL if the record has no such attribute
+			__attribute__((pure,warn_unused_result))
+			inline const attribute *find( const char *const name, const size_t length ) const _noexcept {
+				if( _count == 0 ) {
+					return NULL;
+				}
+				for( size_t h = _hash( name, length ) & _mask; _index[h] != 0; h = (h + 1) & _mask ) {
+					const attribute &a = _attributes[_index[h] - 1];
+					if( a.name.length == length && memcmp( a.name.data, name, length ) == 0 ) {
+						return &a;
+					}
+				}
+				return NULL;
+			}
+			
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline const attribute *find( const const_string_t &name ) const _noexcept {
+				return find( name.data( ), name.size( ) );
+			}
+			
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline const attribute *find( const char *const name ) const _noexcept {
+				return find( name, strlen( name ) );
+			}
+			
+			inline void clear( void ) _noexcept {
+				_arena.clear( );
+				_reset( );
+			}
+			
+			// (used when decoding) clears the map and makes room for count
+			// attributes with values values in total, and bytes of names and
+			// values (including their terminating 0s), in a single allocation
+			__attribute__((warn_unused_result))
+			inline bool _reserve( const size_t count, const size_t values, const size_t bytes ) _noexcept {
+				clear( );
+				size_t buckets = 8;
+				while( buckets < count * 2 ) {
+					buckets <<= 1;
+				}
+				// (each attribute's values are pointer-aligned after its name, which
+				// can cost up to sizeof( void * ) - 1 bytes of padding apiece)
+				const size_t padding = count * (sizeof( void * ) - 1) + 4 * sizeof( void * );
+				if( unlikely( !_arena.reserve( count * sizeof( attribute ) + buckets * sizeof( size_t ) + values * sizeof( attribute_value ) + bytes + padding ) ) ) {
+					return false;
+				}
+				_attributes = (attribute *) _arena.allocate( count * sizeof( attribute ) );
+				_index = (size_t *) _arena.allocate( buckets * sizeof( size_t ) );
+				if( unlikely( _attributes == NULL || _index == NULL ) ) {
+					_reset( );
+					return false;
+				}
+				memset( _index, 0, buckets * sizeof( size_t ) );
+				_capacity = count;
+				_mask = buckets - 1;
+				return true;
+			}
+			
+			// (used when decoding) adds an attribute with room for count values,
+			// which are then filled in by _set_value; a repeated name replaces the
+			// earlier attribute in lookups
+			__attribute__((warn_unused_result))
+			inline attribute *_add( const char *const name, const size_t length, const data_type type, const size_t count ) _noexcept {
+				if( unlikely( _count >= _capacity ) ) {
+					return NULL;
+				}
+				const char *const n = _arena.copy( name, length );
+				attribute_value *const v = (attribute_value *) _arena.allocate( count * sizeof( attribute_value ) );
+				if( unlikely( n == NULL || (v == NULL && count > 0) ) ) {
+					return NULL;
+				}
+				attribute &a = _attributes[_count];
+				a.name.data = n;
+				a.name.length = length;
+				a.type = type;
+				a.count = count;
+				a.values = v;
+				for( size_t i = 0; i < count; ++ i ) {
+					v[i].data = "";
+					v[i].length = 0;
+				}
+				
+				size_t h = _hash( name, length ) & _mask;
+				for( ; _index[h] != 0; h = (h + 1) & _mask ) {
+					const attribute &o = _attributes[_index[h] - 1];
+					if( o.name.length == length && memcmp( o.name.data, name, length ) == 0 ) {
+						break;
+					}
+				}
+				_index[h] = (++ _count);
+				return &a;
+			}
+			
+			__attribute__((warn_unused_result))
+			inline bool _set_value( attribute &a, const size_t i, const char *const data, const size_t length ) _noexcept {
+				const char *const c = _arena.copy( data, length );
+				if( unlikely( c == NULL ) ) {
+					return false;
+				}
+				a.values[i].data = c;
+				a.values[i].length = length;
+				return true;
+			}
+			
+			// Replaces the contents with a copy of items (UNKNOWN items are skipped)
+			__attribute__((warn_unused_result))
+			inline bool assign( const item_list_t &items ) _noexcept {
+				size_t count = 0;
+				size_t values = 0;
+				size_t bytes = 0;
+				for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+					const item &itm = items[i];
+					if( itm.type( ) == UNKNOWN ) {
+						continue;
+					}
+					++ count;
+					bytes += itm.name( ).size( ) + 1;
+					if( (itm.type( ) & SET) ) {
+						const string_list_t &l = itm.list_knowntype( );
+						values += l.size( );
+						for( size_t j = 0, f = l.size( ); j < f; ++ j ) {
+							bytes += l[j].size( ) + 1;
+						}
+					} else {
+						values += 1;
+						bytes += itm.value_knowntype( ).size( ) + 1;
+					}
+				}
+				if( unlikely( !_reserve( count, values, bytes ) ) ) {
+					return false;
+				}
+				for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+					const item &itm = items[i];
+					if( itm.type( ) == UNKNOWN ) {
+						continue;
+					}
+					const bool set = (itm.type( ) & SET) != 0;
+					attribute *const a = _add( itm.name( ).data( ), itm.name( ).size( ), itm.type( ), set ? itm.list_knowntype( ).size( ) : 1 );
+					if( unlikely( a == NULL ) ) {
+						clear( );
+						return false;
+					}
+					for( size_t j = 0; j < a->count; ++ j ) {
+						const string_t &v = set ? itm.list_knowntype( )[j] : itm.value_knowntype( );
+						if( unlikely( !_set_value( *a, j, v.data( ), v.size( ) ) ) ) {
+							clear( );
+							return false;
+						}
+					}
+				}
+				return true;
+			}
+			
+			// Appends the attributes to items, as regular items
+			__attribute__((warn_unused_result))
+			inline bool append_to( item_list_t &items ) const _noexcept {
+				try {
+					items.reserve( items.size( ) + _count );
+					for( size_t i = 0; i < _count; ++ i ) {
+						const attribute &a = _attributes[i];
+						items.push_back( item( string_t( a.name.data, a.name.length ), a.type ) );
+						item &itm = items.back( );
+						for( size_t j = 0; j < a.count; ++ j ) {
+							if( unlikely( !((a.type & SET) ? itm.add_item( a.values[j].data, a.values[j].length ) : itm.set_value( a.values[j].data, a.values[j].length )) ) ) {
+								return false;
+							}
+						}
+					}
+				} catch( ... ) {
+					return false;
+				}
+				return true;
+			}
+		};
+		
+		/* types */
+		
+		struct cache_stats {
+			unsigned long long hits;      // eventually consistent gets answered from the cache
+			unsigned long long misses;    // eventually consistent gets which went to DDB
+			unsigned long long evictions; // entries dropped to stay under maxBytes
+			size_t entries;
+			size_t bytes;
+		};
+		
+		struct cache_entry {
+			item_list_t items;
+			long long expires; // clock_micros( )
+			size_t bytes;
+			std::list<const string_t *>::iterator used; // position in cache_state::lru
+		};
+		
+		typedef std::map<string_t,cache_entry> cache_map_t; // table, key & attribute names => items
+		
+		struct cache_state {
+			cache_map_t entries;
+			std::list<const string_t *> lru; // keys of entries, most recently used first
+			size_t maxBytes;                 // 0 when the cache is off
+			long long ttl;                   // microseconds
+			size_t bytes;
+			unsigned long generation;        // changes whenever entries are invalidated
+			cache_stats stats;
+			pthread_mutex_t mutex;
+			
+			inline cache_state( void ) _noexcept :
+			entries( ),
+			lru( ),
+			maxBytes( 0 ),
+			ttl( 0 ),
+			bytes( 0 ),
+			generation( 0 )
+			{
+				memset( &stats, 0, sizeof( stats ) );
+				pthread_mutex_init( &mutex, NULL );
+			}
+		};
+		
+		struct op_metrics {
+			unsigned long long requests;
+			unsigned long long failures;
+			long long micros;    // total time taken by requests
+			long long maxMicros;
+			// latency[i] counts requests which took under 2^i microseconds (but
+			// at least 2^(i-1)); the last bucket also counts anything slower
+			unsigned long long latency[METRIC_BUCKETS];
+		};
+		
+		struct table_metrics {
+			unsigned long long requests;
+			double readUnits;     // capacity units consumed, as reported by DDB
+			double writeUnits;
+			long long waitMicros; // time requests spent waiting for the rate limit
+		};
+		
+		typedef std::map<string_t,table_metrics> table_metrics_map_t;
+		
+		struct metrics_snapshot {
+			op_metrics ops[OP_KINDS];
+			unsigned long long failures[FAIL_KINDS];
+			table_metrics_map_t tables;
+		};
+		
+		struct metric_event {
+			metric_op op;
+			const string_t *table;
+			long long micros;
+			double units;           // capacity units consumed (0 if unknown)
+			size_t records;         // records read or written
+			long long waited;       // microseconds spent waiting for the rate limit (not in micros)
+			bool ok;
+			metric_failure failure; // (only set if !ok)
+		};
+		
+		typedef void (*metrics_sink)( const metric_event &event, void *context );
+		
+		class request_metric; // (internal)
+		
+		struct rate_bucket {
+			double rate;       // capacity units per second
+			double burst;      // most units saved up while idle
+			double tokens;     // negative while requests are queued
+			long long updated; // clock_micros( )
+		};
+		
+		struct rate_limit {
+			rate_bucket read;  // (rate 0 for no limit)
+			rate_bucket write;
+		};
+		
+		typedef std::map<string_t,rate_limit> rate_map_t; // client_table => limit
+		
+		struct limiter_state {
+			rate_map_t tables;
+			size_t limited; // tables.size( ), for reading without the mutex (with __sync)
+			pthread_mutex_t mutex;
+			
+			inline limiter_state( void ) _noexcept :
+			tables( ),
+			limited( 0 )
+			{
+				pthread_mutex_init( &mutex, NULL );
+			}
+		};
+		
+		struct metrics_state {
+			metrics_snapshot totals;
+			metrics_sink sink;
+			void *sinkContext;
+			pthread_mutex_t mutex;
+			
+			inline metrics_state( void ) _noexcept :
+			totals( ),
+			sink( NULL ),
+			sinkContext( NULL )
+			{
+				memset( totals.ops, 0, sizeof( totals.ops ) );
+				memset( totals.failures, 0, sizeof( totals.failures ) );
+				pthread_mutex_init( &mutex, NULL );
+			}
+		};
+		
+		struct write_request {
+			const string_t *key;
+			const item_list_t *items; // NULL to delete
+		};
+		
+		typedef std::vector<write_request> write_list_t;
+		
+		struct write_job {
+			client *owner; // (workers use the caller's client)
+			const string_t *db;
+			const string_t *keyName;
+			const write_request *requests;
+			size_t count;
+			size_t next;    // first request not yet taken by a worker
+			size_t written;
+			pthread_mutex_t mutex;
+		};
+		
+		struct query_job {
+			const string_t *db;
+			const item *hash;
+			const range_condition *condition;
+			const item_list_t *attributes; // NULL for all
+			bool consistent;
+			bool forward;
+			size_t limit;       // most items to ask for (0 for no limit)
+			item_key start;     // in: ExclusiveStartKey (UNKNOWN hash for none), out: LastEvaluatedKey
+			record_list_t page;
+			bool more;          // start holds the next page's key
+			bool ok;
+		};
+		
+		// The thread which fetches a query's next page while the caller has the
+		// current one (one per query, however many pages it has)
+		struct query_prefetch {
+			client *owner;
+			query_job *job;      // page to fetch; NULL once it has arrived
+			bool quit;
+			pthread_mutex_t mutex;
+			pthread_cond_t wake; // a job was given, or quit set
+			pthread_cond_t done; // job was fetched
+		};
+		
+		struct scan_job {
+			client *owner;
+			const string_t *db;
+			const item_list_t *attributes; // NULL for all
+			page_callback callback;
+			void *context;
+			int segments;
+			int next;           // first segment not yet taken by a worker
+			double maxUnits;    // read capacity units per second (0 for no limit)
+			double used;        // read capacity units used so far
+			long long started;  // clock_micros( ) when the scan began
+			bool stop;          // the callback asked to stop, or a request failed
+			bool ok;
+			pthread_mutex_t mutex;
+		};
+		
+#if !BOTOC_NATIVE
+		// A connection and the bound methods used by requests, looked up once
+		// when connecting; each client keeps a pool of them (see
+		// ddb::set_pool_policy)
+		struct layer1_ref {
+			PyObject *layer1;
+			PyObject *get_item;
+			PyObject *update_item;
+			PyObject *batch_get_item;
+			PyObject *batch_write_item;
+			PyObject *query;
+			PyObject *make_request;
+		};
+		
+#endif
+		/* prototypes */
+		
+		__attribute__((warn_unused_result,unused))
+		static bool update( const const_string_t &db, const const_string_t &key, const item_list_t &items, const item_list_t *expected = NULL ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool update( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *expected = NULL ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool get( const const_string_t &db, const const_string_t &key, bool consistent, item_list_t &items ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool get( const const_string_t &db, const item_key &key, bool consistent, item_list_t &items ) _noexcept;
+		
+		// As get, but decodes the record into an arena-backed attribute_map
+		// (attributes lists the names to fetch; NULL for all of them)
+		__attribute__((warn_unused_result,unused))
+		static bool get( const const_string_t &db, const const_string_t &key, bool consistent, attribute_map &output, const item_list_t *attributes = NULL ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool get( const const_string_t &db, const item_key &key, bool consistent, attribute_map &output, const item_list_t *attributes = NULL ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool batch_get( const const_string_t &db, const string_list_t &keys, const item_list_t &attributes, bool consistent, item_map_t &results ) _noexcept;
+		
+		// Writes whole records (the hash key attribute is added from the map's
+		// keys), 25 per request with up to inFlight requests at once (inFlight
+		// needs BOTOC_THREADSAFE; otherwise requests are sent one at a time).
+		// Returns the number of records written.
+		__attribute__((warn_unused_result,unused))
+		static size_t batch_put( const const_string_t &db, const item_map_t &records, int inFlight = 4 ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static size_t batch_delete( const const_string_t &db, const string_list_t &keys, int inFlight = 4 ) _noexcept;
+		
+		// Reads items with the given hash key (and range keys matching condition),
+		// up to limit items (0 for no limit), in range key order (or reversed if
+		// !forward). Results are handed to callback a page at a time; with
+		// BOTOC_THREADSAFE the next page is requested while callback runs.
+		// Returns false if a request failed.
+		__attribute__((warn_unused_result,unused))
+		static bool query( const const_string_t &db, const item &hash, const range_condition &condition, size_t limit, page_callback callback, void *context, bool consistent = false, bool forward = true, const item_list_t *attributes = NULL ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool query( const const_string_t &db, const const_string_t &hash, const range_condition &condition, size_t limit, page_callback callback, void *context, bool consistent = false, bool forward = true, const item_list_t *attributes = NULL ) _noexcept;
+		
+		// Reads every item in the table, split into segments which are read
+		// in parallel (one thread per segment with BOTOC_THREADSAFE; otherwise
+		// in turn). Pages of items are handed to callback, which can be called
+		// from several threads at once; return false from it to stop the scan.
+		// maxUnits caps the read capacity used per second (0 for no limit).
+		// Returns false if a request failed.
+		__attribute__((warn_unused_result,unused))
+		static bool parallel_scan( const const_string_t &db, int segments, const item_list_t *attributes, page_callback callback, void *context, double maxUnits = 0.0 ) _noexcept;
+		
+		// Keeps the results of eventually consistent gets for ttlSeconds, in up to
+		// maxBytes (roughly) of memory, dropping the least recently used first.
+		// Entries are per table, key and requested attributes; an update (or
+		// batch write) through botoc removes the key's entries. Consistent gets
+		// always go to DDB and refresh the cache. Off (maxBytes 0) by default.
+		__attribute__((unused))
+		static void set_cache( size_t maxBytes, double ttlSeconds ) _noexcept;
+		
+		__attribute__((unused))
+		static void clear_cache( void ) _noexcept;
+		
+		__attribute__((unused))
+		static void get_cache_stats( cache_stats &stats ) _noexcept;
+		
+		// Copies the counters collected for requests sent to DDB since the
+		// start (or reset_metrics): requests, failures and latencies for each
+		// operation, failures by kind, and capacity consumed in each table.
+		// Returns false if out of memory.
+		__attribute__((warn_unused_result,unused))
+		static bool get_metrics( metrics_snapshot &output ) _noexcept;
+		
+		__attribute__((unused))
+		static void reset_metrics( void ) _noexcept;
+		
+		// Calls sink( event, context ) after every request, on the thread which
+		// made it (NULL to stop). The sink should be quick and must not call
+		// botoc. Should only be called while no requests are running.
+		__attribute__((unused))
+		static void set_metrics_sink( metrics_sink sink, void *context = NULL ) _noexcept;
+		
+		// A sink which prints every request to stderr, with the capacity used
+		__attribute__((unused))
+		static void log_metric( const metric_event &event, void *context ) _noexcept;
+		
+		// Keeps requests to a table under readUnits / writeUnits capacity units
+		// per second (0 for no limit), saving up at most burstSeconds' worth
+		// while idle. Each request waits its turn (on its own thread) for an
+		// estimate of its cost, and is charged the units DDB reports it used
+		// once it completes. Limits apply to the current client's requests (as
+		// with cached items, each client is kept apart, since the same table
+		// name may be in another region), and can be changed while requests
+		// are running (those already waiting keep their turn).
+		// Returns false if out of memory.
+		__attribute__((warn_unused_result,unused))
+		static bool set_rate_limit( const const_string_t &db, double readUnits, double writeUnits, double burstSeconds = 1.0 ) _noexcept;
+		
+		// Removes the current client's rate limits
+		__attribute__((unused))
+		static void clear_rate_limits( void ) _noexcept;
+		
+		// The latency (in microseconds, to within a power of 2) under which
+		// fraction (0 - 1) of the operation's requests completed
+		__attribute__((pure,warn_unused_result,unused))
+		static long long metric_percentile( const op_metrics &op, double fraction ) _noexcept;
+		
+		// Throttling, server and network errors are retried with backoff by
+		// every call (see botoc::retry_policy); applies to later requests
+		// through the current client, as are the unprocessed keys and items
+		// of batch requests (while some of each batch is getting through).
+		__attribute__((unused))
+		static void set_retry_policy( const retry_policy &policy ) _noexcept;
+		
+		__attribute__((unused))
+		static void get_retry_stats( retry_stats &stats ) _noexcept;
+		
+		// Requests take a connection from a pool for the current client (see
+		// botoc::pool_policy), so that with BOTOC_THREADSAFE many can be in
+		// flight at once; applies to later requests through the current client
+		__attribute__((unused))
+		static void set_pool_policy( const pool_policy &policy ) _noexcept;
+		
+		__attribute__((unused))
+		static void get_pool_stats( pool_stats &stats ) _noexcept;
+		
+		__attribute__((always_inline,unused))
+		static inline void disconnect( void ) _noexcept;
+		
+		/* internal prototypes */
+		
+		__attribute__((warn_unused_result))
+		static bool update_item( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *expected ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool get_item( const const_string_t &db, const item_key &key, bool consistent, item_list_t &items ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool get_attributes( const const_string_t &db, const item_key &key, bool consistent, attribute_map &output, const item_list_t *attributes ) _noexcept;
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline cache_state &cache( void ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool cache_enabled( void ) _noexcept;
+		
+		// appends the table's name, kept apart for each client (which may be in
+		// another region)
+		static void client_table( const const_string_t &db, string_t &output ) _throws_bad_alloc;
+		
+		static void cache_key( const const_string_t &db, const item_key &key, string_t &output ) _throws_bad_alloc;
+		
+		__attribute__((pure,warn_unused_result))
+		static size_t cache_bytes( const const_string_t &id, const item_list_t &items ) _noexcept;
+		
+		static void cache_erase( cache_state &c, const cache_map_t::iterator &entry ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool cache_lookup( const const_string_t &db, const item_key &key, bool consistent, item_list_t &items, string_t &id, unsigned long &generation ) _noexcept;
+		
+		static void cache_store( const const_string_t &id, const item_list_t &items, unsigned long generation ) _noexcept;
+		
+		static void cache_invalidate( const const_string_t &db, const item_key &key ) _noexcept;
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline metrics_state &metrics( void ) _noexcept;
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline retry_state &retries( void ) _noexcept;
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline connection_pool &connections( void ) _noexcept;
+		
+		static void metrics_record( const metric_event &event ) _noexcept;
+		
+		__attribute__((pure,warn_unused_result))
+		static metric_failure failure_from_code( const char *code ) _noexcept;
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline limiter_state &limiter( void ) _noexcept;
+		
+		// takes units from the table's bucket, waiting until they are
+		// available; returns false if there is no limit
+		__attribute__((warn_unused_result))
+		static bool rate_wait( metric_op op, const const_string_t &db, double units, long long &waited ) _noexcept;
+		
+		// gives back units taken by rate_wait (if the limit is still set: the
+		// bucket is looked up again, as it may have been removed meanwhile)
+		static void rate_refund( metric_op op, const const_string_t &db, double units ) _noexcept;
+		
+		// (with the limiter's mutex held)
+		__attribute__((warn_unused_result))
+		static rate_bucket *rate_find( limiter_state &l, metric_op op, const string_t &id ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool hash_key_name( const const_string_t &db, string_t &name ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool get_group( const const_string_t &db, const const_string_t &keyName, string_list_t &pending, const item_list_t &attributes, bool consistent, item_map_t &results ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool write_group( const const_string_t &db, const const_string_t &keyName, write_list_t &pending ) _noexcept;
+		
+		static void *write_worker( void *job ) _noexcept;
+		
+		static void query_page( query_job &job ) _noexcept;
+		
+		__attribute__((unused))
+		static void *query_worker( void *prefetch ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool scan_page( const const_string_t &db, int segment, int segments, const item_list_t *attributes, item_key &start, bool &more, record_list_t &page, double &used ) _noexcept;
+		
+		static void *scan_worker( void *job ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static size_t batch_write( const const_string_t &db, const write_list_t &requests, int inFlight ) _noexcept;
+		
+#if BOTOC_NATIVE
+		__attribute__((warn_unused_result))
+		static bool call( const char *operation, const const_string_t &payload, native::json_value &response, request_metric &metric ) _noexcept;
+		
+		static void json_from_value( const item &itm, string_t &output ) _throws_bad_alloc;
+		
+		__attribute__((warn_unused_result))
+		static bool json_from_items_expect( const item_list_t &items, string_t &output ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool json_from_items_update( const item_list_t &items, string_t &output ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool json_from_items_put( const item_list_t &items, const const_string_t &keyName, const const_string_t &key, string_t &output ) _noexcept;
+		
+		static void json_from_key( const item_key &key, string_t &output ) _throws_bad_alloc;
+		
+		__attribute__((warn_unused_result))
+		static bool key_from_json( const native::json_value *obj, item_key &output ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static inline bool item_from_json( const native::json_value *obj, item &output ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool update_from_json( item_list_t &items, const native::json_value &ret_items ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool map_from_json( attribute_map &output, const native::json_value &ret_items ) _noexcept;
+		
+		// sends GetItem; returns the record's items (within response), or NULL
+		__attribute__((warn_unused_result))
+		static const native::json_value *get_record( const const_string_t &db, const item_key &key, bool consistent, const item_list_t *attributes, native::json_value &response, request_metric &metric ) _noexcept;
+#else
+		// The lease's connection (opening one if the lease is empty)
+		__attribute__((warn_unused_result))
+		static const layer1_ref *prep( pool_lease &lease ) _noexcept;
+		
+		static void release_layer1( layer1_ref &l ) _noexcept;
+		
+		// (closes a pooled layer1_ref)
+		static void release_connection( void *connection ) _noexcept;
+		
+		static const connection_type pooled_connection = { &release_connection, NULL };
+		
+		__attribute__((warn_unused_result))
+		static PyObject *dict_from_value( const item &itm ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static PyObject *dict_from_key( const item_key &key ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool key_from_dict( PyObject *obj, item_key &output ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static PyObject *dict_from_items_expect( const item_list_t &items ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static PyObject *dict_from_items_update( const item_list_t &items ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static PyObject *dict_from_items_put( const item_list_t &items, const const_string_t &keyName, const const_string_t &key ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static PyObject *list_from_items( const item_list_t &items ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static inline bool item_from_dict( PyObject *obj, item &output ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool update_from_dict( item_list_t &items, PyObject *ret_items ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool map_from_dict( attribute_map &output, PyObject *ret_items ) _noexcept;
+		
+		// calls get_item (the GIL must be held); returns the response, and sets
+		// ret_items to the record's items (borrowed from it), or NULL
+		__attribute__((warn_unused_result))
+		static PyObject *get_record( const const_string_t &db, const item_key &key, bool consistent, const item_list_t *attributes, PyObject *&ret_items, request_metric &metric ) _noexcept;
+#endif
+		
+		/* internal classes */
+		
+		// Waits for the table's rate limit (charging estimate units), then
+		// times one request, and adds it to the metrics when it goes out of
+		// scope (correcting the charge to the units actually used). It counts
+		// as a failure (FAIL_REQUEST unless fail says otherwise) until succeed
+		// is called. Declared before the py_gil where possible, so that the
+		// GIL is not held while waiting or calling sinks.
+		class request_metric {
+		private:
+			metric_event _event;
+			bool _limited;
+			double _estimate;
+			long long _started;
+			
+			request_metric( const request_metric & );
+			request_metric &operator =( const request_metric & );
+			
+		public:
+			inline request_metric( const metric_op op, const const_string_t &db, const double estimate = 1.0 ) _noexcept :
+			_limited( rate_wait( op, db, estimate, _event.waited ) ),
+			_estimate( estimate ),
+			_started( clock_micros( ) )
+			{
+				_event.op = op;
+				_event.table = &db;
+				_event.micros = 0;
+				_event.units = 0.0;
+				_event.records = 0;
+				_event.ok = false;
+				_event.failure = FAIL_REQUEST;
+			}
+			
+			inline ~request_metric( void ) _noexcept {
+				_event.micros = clock_micros( ) - _started;
+				if( _limited ) {
+					rate_refund( _event.op, *_event.table, _estimate - _event.units );
+				}
+				metrics_record( _event );
+			}
+			
+			inline void succeed( const double units, const size_t records ) _noexcept {
+				_event.units = units;
+				_event.records = records;
+				_event.ok = true;
+			}
+			
+			inline bool fail( const metric_failure failure ) _noexcept {
+				_event.ok = false;
+				_event.failure = failure;
+				return false;
+			}
+		};
+		
+		/* implementation */
+		
+#if BOTOC_NATIVE
+		static bool call( const char *const operation, const const_string_t &payload, native::json_value &response, request_metric &metric ) _noexcept {
+			/*
+			 * POST / X-Amz-Target: DynamoDB_20111205.[operation]
+			 * [payload]
+			 */
+			
+			native::http_response http;
+			string_t endpoint;
+			string_t target;
+			const string_t root( "/" );
+			try {
+				if( !native::ddb_endpoint.empty( ) ) {
+					endpoint.assign( native::ddb_endpoint );
+				} else if( !native::allow_http( operation ) ) {
+					return metric.fail( FAIL_REQUEST );
+				} else {
+					endpoint.assign( "dynamodb." );
+					endpoint.append( current_client( ).region( ) );
+					endpoint.append( ".amazonaws.com" );
+				}
+				target.assign( "DynamoDB_20111205." );
+				target.append( operation );
+			} catch( ... ) {
+				fprintf( stderr, "%s: out of memory\n", operation );
+				return metric.fail( FAIL_MEMORY );
+			}
+			retry_call attempt( retries( ) );
+			while( true ) {
+				if( unlikely( !native::request( connections( ), endpoint, "dynamodb", root, "application/x-amz-json-1.0", target.c_str( ), payload, http ) ) ) {
+					if( attempt.again( RETRY_NETWORK ) ) {
+						continue;
+					}
+					return false;
+				}
+				response = native::json_value( );
+				const bool parsed = native::json_parse( http.body, response );
+				if( likely( parsed && http.status == 200 ) ) {
+					attempt.succeeded( );
+					return true;
+				}
+				const native::json_value *type = parsed ? response.get( "__type" ) : NULL;
+				const char *t = (type != NULL) ? type->text.c_str( ) : "";
+				if( strchr( t, '#' ) != NULL ) {
+					t = strchr( t, '#' ) + 1;
+				}
+				if( attempt.again( retry_from_code( t, http.status ) ) ) {
+					continue;
+				}
+				if( unlikely( !parsed ) ) {
+					return metric.fail( FAIL_RESPONSE );
+				}
+				const native::json_value *message = response.get( "message" );
+				if( message == NULL ) {
+					message = response.get( "Message" );
+				}
+				fprintf( stderr, "botoc: %s threw %d %s: %s\n", operation, http.status, t, (message != NULL) ? message->text.c_str( ) : "" );
+				return metric.fail( failure_from_code( t ) );
+			}
+		}
+		
+		static void json_from_value( const item &itm, string_t &output ) _throws_bad_alloc {
+			// {[T]:[value]} or {[TS]:[[value1],[value2]]}
+			output.append( "{\"" );
+			output.append( itm.type_string( ) );
+			output.append( "\":" );
+			if( (itm.type( ) & SET) ) {
+				output.push_back( '[' );
+				bool first = true;
+				for( size_t j = 0, f = itm.size( ); j < f; ++ j ) {
+					const string_t &s = itm._list( )[j];
+					if( s.size( ) > 0 ) {
+						if( !first ) {
+							output.push_back( ',' );
+						}
+						native::json_string( output, s );
+						first = false;
+					}
+				}
+				output.push_back( ']' );
+			} else {
+				native::json_string( output, itm._value( ) );
+			}
+			output.push_back( '}' );
+		}
+		
+		static void json_from_key( const item_key &key, string_t &output ) _throws_bad_alloc {
+			// {"HashKeyElement":{[T]:[hash]},"RangeKeyElement":{[T]:[range]}}
+			output.append( "{\"HashKeyElement\":" );
+			json_from_value( key.hash, output );
+			if( key.has_range( ) ) {
+				output.append( ",\"RangeKeyElement\":" );
+				json_from_value( key.range, output );
+			}
+			output.push_back( '}' );
+		}
+		
+		static bool key_from_json( const native::json_value *obj, item_key &output ) _noexcept {
+			if( obj == NULL ) {
+				return false;
+			}
+			output.range.clear( );
+			if( unlikely( !item_from_json( obj->get( "HashKeyElement" ), output.hash ) ) ) {
+				return false;
+			}
+			const native::json_value *range = obj->get( "RangeKeyElement" );
+			return range == NULL || item_from_json( range, output.range );
+		}
+		
+		static bool json_from_items_expect( const item_list_t &items, string_t &output ) _noexcept {
+			try {
+				output.push_back( '{' );
+				bool first = true;
+				for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+					if( items[i].type( ) == UNKNOWN ) {
+						continue;
+					}
+					if( !first ) {
+						output.push_back( ',' );
+					}
+					first = false;
+					native::json_string( output, items[i].name( ) );
+					if( items[i].size( ) == 0 ) {
+						output.append( ":{\"Exists\":false}" );
+					} else {
+						output.append( ":{\"Value\":" );
+						json_from_value( items[i], output );
+						output.push_back( '}' );
+					}
+				}
+				output.push_back( '}' );
+			} catch( ... ) {
+				fprintf( stderr, "json_from_items_expect: out of memory\n" );
+				return false;
+			}
+			return true;
+		}
+		
+		static bool json_from_items_update( const item_list_t &items, string_t &output ) _noexcept {
+			try {
+				output.push_back( '{' );
+				bool first = true;
+				for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+					const size_t f = items[i].size( );
+					const size_t start = output.size( );
+					if( !first ) {
+						output.push_back( ',' );
+					}
+					native::json_string( output, items[i].name( ) );
+					if( (items[i].action( ) == DELETE && (!(items[i].type( ) & SET) || f <= 0)) || (f <= 0 && items[i].action( ) == REPLACE) ) {
+						output.append( ":{\"Action\":\"DELETE\"}" );
+					} else if( (items[i].type( ) & SET) ) {
+						if( f <= 0 ) {
+							output.resize( start );
+							continue;
+						}
+						output.append( ":{" );
+						if( items[i].action( ) != REPLACE ) {
+							output.append( "\"Action\":\"" );
+							output.append( items[i].action_string( ) );
+							output.append( "\"," );
+						}
+						output.append( "\"Value\":" );
+						json_from_value( items[i], output );
+						output.push_back( '}' );
+					} else {
+						output.append( ":{" );
+						if( items[i].type( ) == NUMBER && items[i].action( ) == ADD ) {
+							output.append( "\"Action\":\"ADD\"," );
+						}
+						output.append( "\"Value\":" );
+						json_from_value( items[i], output );
+						output.push_back( '}' );
+					}
+					first = false;
+				}
+				output.push_back( '}' );
+			} catch( ... ) {
+				fprintf( stderr, "json_from_items_update: out of memory\n" );
+				return false;
+			}
+			return true;
+		}
+		
+		static bool json_from_items_put( const item_list_t &items, const const_string_t &keyName, const const_string_t &key, string_t &output ) _noexcept {
+			// {[keyName]:{"S":[key]},[attr1]:{[T]:[value]},[attr2]:{[TS]:[[value1],[value2]]}}
+			try {
+				output.push_back( '{' );
+				native::json_string( output, keyName );
+				output.append( ":{\"S\":" );
+				native::json_string( output, key );
+				output.push_back( '}' );
+				for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+					// DDB rejects empty values; the key comes from the map
+					if( items[i].type( ) == UNKNOWN || items[i].size( ) == 0 || items[i].name( ) == keyName ) {
+						continue;
+					}
+					output.push_back( ',' );
+					native::json_string( output, items[i].name( ) );
+					output.push_back( ':' );
+					json_from_value( items[i], output );
+				}
+				output.push_back( '}' );
+			} catch( ... ) {
+				fprintf( stderr, "json_from_items_put: out of memory\n" );
+				return false;
+			}
+			return true;
+		}
+		
+		static inline bool item_from_json( const native::json_value *obj, item &output ) _noexcept {
+			if( obj == NULL ) {
+				return false;
+			}
+			// exactly 1 attribute, named after its type
+			if( obj->type != native::json_value::OBJECT || obj->keys.empty( ) ) {
+				fprintf( stderr, "malformed record (no data)\n" );
+				return false;
+			}
+			
+			if( unlikely( !output.set_type( type_from_string( obj->keys[0].c_str( ) ) ) ) ) {
+				return false;
+			}
+			if( unlikely( output.type( ) == UNKNOWN ) ) {
+				fprintf( stderr, "malformed record (unknown type)\n" );
+				return false;
+			}
+			const native::json_value &value = obj->items[0];
+			if( (output.type( ) & SET) ) {
+				output.clear_items( );
+				
+				for( size_t i = 0, l = value.items.size( ); i < l; ++ i ) {
+					if( unlikely( !output.add_item( value.items[i].text ) ) ) {
+						output.clear_items( );
+						return false;
+					}
+				}
+			} else {
+				if( value.type != native::json_value::STRING ) {
+					fprintf( stderr, "malformed record (value is not a string)\n" );
+					return false;
+				}
+				if( unlikely( !output.set_value( value.text ) ) ) {
+					return false;
+				}
+			}
+			output.set_action( REPLACE );
+			return true;
+		}
+		
+		static bool update_from_json( item_list_t &items, const native::json_value &ret_items ) _noexcept {
+			if( items.size( ) == 0 ) {
+				try {
+					items.reserve( ret_items.keys.size( ) );
+				} catch( ... ) {
+					return false;
+				}
+				for( size_t i = 0, e = ret_items.keys.size( ); i < e; ++ i ) {
+					// decoded in place, so values are not copied again
+					try {
+						items.push_back( item( ret_items.keys[i] ) );
+					} catch( ... ) {
+						return false;
+					}
+					if( unlikely( !item_from_json( &ret_items.items[i], items.back( ) ) ) ) {
+						items.pop_back( );
+					}
+				}
+			} else {
+				for( size_t i = items.size( ); (i --) > 0; ) {
+					if( !item_from_json( ret_items.get( items[i].name( ).c_str( ) ), items[i] ) ) {
+						items.erase( items.begin( ) + (std::ptrdiff_t) i );
+						continue;
+					}
+				}
+			}
+			return true;
+		}
+		
+		static bool map_from_json( attribute_map &output, const native::json_value &ret_items ) _noexcept {
+			// measure everything first, so the map needs a single allocation
+			size_t count = 0;
+			size_t values = 0;
+			size_t bytes = 0;
+			for( size_t i = 0, e = ret_items.keys.size( ); i < e; ++ i ) {
+				const native::json_value &obj = ret_items.items[i];
+				if( obj.type != native::json_value::OBJECT || obj.keys.empty( ) || type_from_string( obj.keys[0].c_str( ) ) == UNKNOWN ) {
+					fprintf( stderr, "malformed record (no data)\n" );
+					continue;
+				}
+				const native::json_value &value = obj.items[0];
+				++ count;
+				bytes += ret_items.keys[i].size( ) + 1;
+				if( value.type == native::json_value::ARRAY ) {
+					values += value.items.size( );
+					for( size_t j = 0, f = value.items.size( ); j < f; ++ j ) {
+						bytes += value.items[j].text.size( ) + 1;
+					}
+				} else {
+					values += 1;
+					bytes += value.text.size( ) + 1;
+				}
+			}
+			
+			if( unlikely( !output._reserve( count, values, bytes ) ) ) {
+				return false;
+			}
+			for( size_t i = 0, e = ret_items.keys.size( ); i < e; ++ i ) {
+				const native::json_value &obj = ret_items.items[i];
+				const data_type type = (obj.type == native::json_value::OBJECT && !obj.keys.empty( )) ? type_from_string( obj.keys[0].c_str( ) ) : UNKNOWN;
+				if( type == UNKNOWN ) {
+					continue;
+				}
+				const native::json_value &value = obj.items[0];
+				if( (type & SET) != 0 && value.type != native::json_value::ARRAY ) {
+					continue; // (counted as a single value above)
+				}
+				const string_t &name = ret_items.keys[i];
+				attribute *const a = output._add( name.data( ), name.size( ), type, (type & SET) ? value.items.size( ) : 1 );
+				if( unlikely( a == NULL ) ) {
+					output.clear( );
+					return false;
+				}
+				for( size_t j = 0; j < a->count; ++ j ) {
+					const string_t &v = (type & SET) ? value.items[j].text : value.text;
+					if( unlikely( !output._set_value( *a, j, v.data( ), v.size( ) ) ) ) {
+						output.clear( );
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+		
+		static bool update_item( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *expected ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_UpdateItem.html
+			 * {
+			 *   "TableName":[table],
+			 *   "Key":{"HashKeyElement":{[T]:[hash]},"RangeKeyElement":{[T]:[range]}},
+			 *   "AttributeUpdates":{
+			 *     [attr1]:{"Value":{[T]:[value]}},
+			 *     [attr2]:{"Value":{[TS]:[[value1],[value2]]},"Action":"ADD"}
+			 *   },
+			 *   "Expected":{...}
+			 * }
+			 * used = ret.ConsumedCapacityUnits
+			 */
+			
+			request_metric metric( OP_UPDATE, db );
+			if( unlikely( !key.valid( ) ) ) {
+				fprintf( stderr, "invalid key for table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_INVALID );
+			}
+			
+			string_t payload;
+			try {
+				payload.append( "{\"TableName\":" );
+				native::json_string( payload, db );
+				payload.append( ",\"Key\":" );
+				json_from_key( key, payload );
+				payload.append( ",\"AttributeUpdates\":" );
+				if( unlikely( !json_from_items_update( items, payload ) ) ) {
+					return metric.fail( FAIL_MEMORY );
+				}
+				if( expected != NULL && expected->size( ) > 0 ) {
+					payload.append( ",\"Expected\":" );
+					if( unlikely( !json_from_items_expect( *expected, payload ) ) ) {
+						return metric.fail( FAIL_MEMORY );
+					}
+				}
+				payload.push_back( '}' );
+			} catch( ... ) {
+				return metric.fail( FAIL_MEMORY );
+			}
+			
+			native::json_value ret;
+			if( unlikely( !call( "UpdateItem", payload, ret, metric ) ) ) {
+				return false;
+			}
+			
+			const native::json_value *cap = ret.get( "ConsumedCapacityUnits" );
+			if( unlikely( cap == NULL ) ) {
+				fprintf( stderr, "bad response when saving record in table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_RESPONSE );
+			}
+			metric.succeed( cap->number( ), 1 );
+			return true;
+		}
+		
+		static const native::json_value *get_record( const const_string_t &db, const item_key &key, bool consistent, const item_list_t *const attributes, native::json_value &response, request_metric &metric ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_GetItem.html
+			 * {
+			 *   "TableName":[table],
+			 *   "Key":{"HashKeyElement":{[T]:[hash]},"RangeKeyElement":{[T]:[range]}},
+			 *   "AttributesToGet":[[name1],[name2]],
+			 *   "ConsistentRead":[consistent]
+			 * }
+			 */
+			
+			if( unlikely( !key.valid( ) ) ) {
+				fprintf( stderr, "invalid key for table \"%.*s\"\n", SIZED_STRING(db) );
+				metric.fail( FAIL_INVALID );
+				return NULL;
+			}
+			
+			string_t payload;
+			try {
+				payload.append( "{\"TableName\":" );
+				native::json_string( payload, db );
+				payload.append( ",\"Key\":" );
+				json_from_key( key, payload );
+				if( attributes != NULL && attributes->size( ) > 0 ) {
+					payload.append( ",\"AttributesToGet\":[" );
+					for( size_t i = 0, e = attributes->size( ); i < e; ++ i ) {
+						if( i > 0 ) {
+							payload.push_back( ',' );
+						}
+						native::json_string( payload, (*attributes)[i].name( ) );
+					}
+					payload.push_back( ']' );
+				}
+				payload.append( consistent ? ",\"ConsistentRead\":true}" : ",\"ConsistentRead\":false}" );
+			} catch( ... ) {
+				metric.fail( FAIL_MEMORY );
+				return NULL;
+			}
+			
+			if( unlikely( !call( "GetItem", payload, response, metric ) ) ) {
+				return NULL;
+			}
+			
+			const native::json_value *cap = response.get( "ConsumedCapacityUnits" );
+			const native::json_value *ret_items = response.get( "Item" );
+			if( unlikely( ret_items == NULL || ret_items->type != native::json_value::OBJECT ) ) {
+				fprintf( stderr, "failed to load record items from table \"%.*s\"\n", SIZED_STRING(db) );
+				metric.fail( (ret_items == NULL) ? FAIL_NOT_FOUND : FAIL_RESPONSE );
+				return NULL;
+			}
+			metric.succeed( (cap != NULL) ? cap->number( ) : 0.0, 1 );
+			return ret_items;
+		}
+		
+		static bool get_item( const const_string_t &db, const item_key &key, bool consistent, item_list_t &items ) _noexcept {
+			request_metric metric( OP_GET, db );
+			native::json_value ret;
+			const native::json_value *ret_items = get_record( db, key, consistent, &items, ret, metric );
+			if( unlikely( ret_items == NULL ) ) {
+				return false;
+			}
+			if( unlikely( !update_from_json( items, *ret_items ) ) ) {
+				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_MEMORY );
+			}
+			return true;
+		}
+		
+		static bool get_attributes( const const_string_t &db, const item_key &key, bool consistent, attribute_map &output, const item_list_t *const attributes ) _noexcept {
+			request_metric metric( OP_GET, db );
+			native::json_value ret;
+			const native::json_value *ret_items = get_record( db, key, consistent, attributes, ret, metric );
+			if( unlikely( ret_items == NULL ) ) {
+				return false;
+			}
+			if( unlikely( !map_from_json( output, *ret_items ) ) ) {
+				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_MEMORY );
+			}
+			return true;
+		}
+		
+		static bool hash_key_name( const const_string_t &db, string_t &name ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_DescribeTable.html
+			 * {"TableName":[table]}
+			 * name = ret.Table.KeySchema.HashKeyElement.AttributeName
+			 */
+			
+			static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+			static std::map<string_t,string_t> map; // client_table => name
+			
+			string_t id;
+			try {
+				client_table( db, id );
+			} catch( ... ) {
+				return false;
+			}
+			
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &mutex );
+#else
+			(void) mutex;
+#endif
+			bool found = false;
+			try {
+				std::map<string_t,string_t>::const_iterator ind = map.find( id );
+				if( ind != map.end( ) ) {
+					name.assign( ind->second );
+					found = true;
+				}
+			} catch( ... ) {
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &mutex );
+#endif
+			if( found ) {
+				return true;
+			}
+			
+			request_metric metric( OP_DESCRIBE, db );
+			native::json_value ret;
+			try {
+				string_t payload( "{\"TableName\":" );
+				native::json_string( payload, db );
+				payload.push_back( '}' );
+				if( unlikely( !call( "DescribeTable", payload, ret, metric ) ) ) {
+					return false;
+				}
+			} catch( ... ) {
+				return metric.fail( FAIL_MEMORY );
+			}
+			const native::json_value *table = ret.get( "Table" );
+			const native::json_value *schema = (table != NULL) ? table->get( "KeySchema" ) : NULL;
+			const native::json_value *hash = (schema != NULL) ? schema->get( "HashKeyElement" ) : NULL;
+			const native::json_value *attr = (hash != NULL) ? hash->get( "AttributeName" ) : NULL;
+			if( unlikely( attr == NULL || attr->type != native::json_value::STRING ) ) {
+				fprintf( stderr, "could not find the hash key of table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_RESPONSE );
+			}
+			metric.succeed( 0.0, 0 );
+			
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &mutex );
+#endif
+			try {
+				name.assign( attr->text );
+				map[id] = attr->text;
+				found = true;
+			} catch( ... ) {
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &mutex );
+#endif
+			return found;
+		}
+		
+		static bool get_group( const const_string_t &db, const const_string_t &keyName, string_list_t &pending, const item_list_t &attributes, const bool consistent, item_map_t &results ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_BatchGetItem.html
+			 * {"RequestItems":{[table]:{
+			 *   "Keys":[{"HashKeyElement":{"S":[key1]}},{"HashKeyElement":{"S":[key2]}}],
+			 *   "AttributesToGet":[[name1],[name2],[keyName]],
+			 *   "ConsistentRead":[consistent]
+			 * }}}
+			 * items = ret.Responses.[table].Items
+			 * pending = ret.UnprocessedKeys.[table].Keys
+			 */
+			
+			request_metric metric( OP_BATCH_GET, db, (double) pending.size( ) );
+			string_t payload;
+			try {
+				payload.append( "{\"RequestItems\":{" );
+				native::json_string( payload, db );
+				payload.append( ":{\"Keys\":[" );
+				for( size_t i = 0, e = pending.size( ); i < e; ++ i ) {
+					payload.append( (i > 0) ? ",{\"HashKeyElement\":{\"S\":" : "{\"HashKeyElement\":{\"S\":" );
+					native::json_string( payload, pending[i] );
+					payload.append( "}}" );
+				}
+				payload.push_back( ']' );
+				if( attributes.size( ) > 0 ) {
+					// the key is needed to match items to keys
+					bool hasKey = false;
+					payload.append( ",\"AttributesToGet\":[" );
+					for( size_t i = 0, e = attributes.size( ); i < e; ++ i ) {
+						if( i > 0 ) {
+							payload.push_back( ',' );
+						}
+						native::json_string( payload, attributes[i].name( ) );
+						hasKey = hasKey || attributes[i].name( ) == keyName;
+					}
+					if( !hasKey ) {
+						payload.push_back( ',' );
+						native::json_string( payload, keyName );
+					}
+					payload.push_back( ']' );
+				}
+				payload.append( consistent ? ",\"ConsistentRead\":true}}}" : ",\"ConsistentRead\":false}}}" );
+			} catch( ... ) {
+				return metric.fail( FAIL_MEMORY );
+			}
+			
+			native::json_value ret;
+			if( unlikely( !call( "BatchGetItem", payload, ret, metric ) ) ) {
+				return false;
+			}
+			
+			const native::json_value *responses = ret.get( "Responses" );
+			const native::json_value *response = (responses != NULL) ? responses->get( db.c_str( ) ) : NULL;
+			const native::json_value *ret_items = (response != NULL) ? response->get( "Items" ) : NULL;
+			if( unlikely( ret_items == NULL || ret_items->type != native::json_value::ARRAY ) ) {
+				fprintf( stderr, "failed to load records from table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_RESPONSE );
+			}
+			const native::json_value *cap = response->get( "ConsumedCapacityUnits" );
+			metric.succeed( (cap != NULL) ? cap->number( ) : 0.0, ret_items->items.size( ) );
+			
+			for( size_t i = 0, e = ret_items->items.size( ); i < e; ++ i ) {
+				const native::json_value &obj = ret_items->items[i];
+				item key( keyName );
+				if( unlikely( !item_from_json( obj.get( keyName.c_str( ) ), key ) || key.type( ) != STRING ) ) {
+					fprintf( stderr, "malformed record (no key)\n" );
+					continue;
+				}
+				try {
+					item_list_t &items = results[key.value_knowntype( )];
+					items = attributes;
+					if( unlikely( !update_from_json( items, obj ) ) ) {
+						throw std::bad_alloc( );
+					}
+				} catch( ... ) {
+					fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+					return metric.fail( FAIL_MEMORY );
+				}
+			}
+			
+			pending.clear( );
+			const native::json_value *unprocessed = ret.get( "UnprocessedKeys" );
+			const native::json_value *left = (unprocessed != NULL) ? unprocessed->get( db.c_str( ) ) : NULL;
+			const native::json_value *keys = (left != NULL) ? left->get( "Keys" ) : NULL;
+			if( keys != NULL ) {
+				for( size_t i = 0, e = keys->items.size( ); i < e; ++ i ) {
+					const native::json_value *hash = keys->items[i].get( "HashKeyElement" );
+					const native::json_value *value = (hash != NULL) ? hash->get( "S" ) : NULL;
+					if( unlikely( value == NULL ) ) {
+						continue;
+					}
+					try {
+						pending.push_back( value->text );
+					} catch( ... ) {
+						return metric.fail( FAIL_MEMORY );
+					}
+				}
+			}
+			return true;
+		}
+		
+		static bool write_group( const const_string_t &db, const const_string_t &keyName, write_list_t &pending ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_BatchWriteItem.html
+			 * {"RequestItems":{[table]:[
+			 *   {"PutRequest":{"Item":{[keyName]:{"S":[key1]},[attr1]:{[T]:[value]}}}},
+			 *   {"DeleteRequest":{"Key":{"HashKeyElement":{"S":[key2]}}}}
+			 * ]}}
+			 * used = ret.Responses.[table].ConsumedCapacityUnits
+			 * pending = ret.UnprocessedItems.[table]
+			 */
+			
+			request_metric metric( OP_BATCH_WRITE, db, (double) pending.size( ) );
+			string_t payload;
+			try {
+				payload.append( "{\"RequestItems\":{" );
+				native::json_string( payload, db );
+				payload.append( ":[" );
+				for( size_t i = 0, e = pending.size( ); i < e; ++ i ) {
+					if( i > 0 ) {
+						payload.push_back( ',' );
+					}
+					if( pending[i].items != NULL ) {
+						payload.append( "{\"PutRequest\":{\"Item\":" );
+						if( unlikely( !json_from_items_put( *pending[i].items, keyName, *pending[i].key, payload ) ) ) {
+							return metric.fail( FAIL_MEMORY );
+						}
+						payload.append( "}}" );
+					} else {
+						payload.append( "{\"DeleteRequest\":{\"Key\":{\"HashKeyElement\":{\"S\":" );
+						native::json_string( payload, *pending[i].key );
+						payload.append( "}}}}" );
+					}
+				}
+				payload.append( "]}}" );
+			} catch( ... ) {
+				return metric.fail( FAIL_MEMORY );
+			}
+			
+			native::json_value ret;
+			if( unlikely( !call( "BatchWriteItem", payload, ret, metric ) ) ) {
+				return false;
+			}
+			
+			const native::json_value *responses = ret.get( "Responses" );
+			const native::json_value *response = (responses != NULL) ? responses->get( db.c_str( ) ) : NULL;
+			const native::json_value *cap = (response != NULL) ? response->get( "ConsumedCapacityUnits" ) : NULL;
+			const native::json_value *unprocessed = ret.get( "UnprocessedItems" );
+			const native::json_value *left = (unprocessed != NULL) ? unprocessed->get( db.c_str( ) ) : NULL;
+			const size_t failed = (left != NULL) ? left->items.size( ) : 0;
+			metric.succeed( (cap != NULL) ? cap->number( ) : 0.0, pending.size( ) - failed );
+			
+			write_list_t retry;
+			for( size_t i = 0; i < failed; ++ i ) {
+				const native::json_value &req = left->items[i];
+				const native::json_value *put = req.get( "PutRequest" );
+				const native::json_value *del = req.get( "DeleteRequest" );
+				const native::json_value *value = NULL;
+				if( put != NULL ) {
+					const native::json_value *itm = put->get( "Item" );
+					const native::json_value *attr = (itm != NULL) ? itm->get( keyName.c_str( ) ) : NULL;
+					value = (attr != NULL) ? attr->get( "S" ) : NULL;
+				} else if( del != NULL ) {
+					const native::json_value *key = del->get( "Key" );
+					const native::json_value *hash = (key != NULL) ? key->get( "HashKeyElement" ) : NULL;
+					value = (hash != NULL) ? hash->get( "S" ) : NULL;
+				}
+				if( unlikely( value == NULL ) ) {
+					continue;
+				}
+				// keys are unique within a request
+				for( size_t j = 0, e = pending.size( ); j < e; ++ j ) {
+					if( *pending[j].key == value->text ) {
+						try {
+							retry.push_back( pending[j] );
+						} catch( ... ) {
+							return metric.fail( FAIL_MEMORY );
+						}
+						break;
+					}
+				}
+			}
+			pending.swap( retry );
+			return true;
+		}
+		
+		static void query_page( query_job &job ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_Query.html
+			 * {
+			 *   "TableName":[table],
+			 *   "HashKeyValue":{[T]:[hash]},
+			 *   "RangeKeyCondition":{"AttributeValueList":[{[T]:[value1]},{[T]:[value2]}],"ComparisonOperator":[op]},
+			 *   "AttributesToGet":[[name1],[name2]],
+			 *   "Limit":[limit],
+			 *   "ScanIndexForward":[forward],
+			 *   "ExclusiveStartKey":{"HashKeyElement":{[T]:[hash]},"RangeKeyElement":{[T]:[range]}},
+			 *   "ConsistentRead":[consistent]
+			 * }
+			 * page = ret.Items
+			 * start = ret.LastEvaluatedKey
+			 */
+			
+			const string_t &db = *job.db;
+			request_metric metric( OP_QUERY, db );
+			job.ok = false;
+			job.more = false;
+			job.page.clear( );
+			
+			string_t payload;
+			try {
+				payload.append( "{\"TableName\":" );
+				native::json_string( payload, db );
+				payload.append( ",\"HashKeyValue\":" );
+				json_from_value( *job.hash, payload );
+				if( job.condition->op != NO_CONDITION ) {
+					payload.append( ",\"RangeKeyCondition\":{\"AttributeValueList\":[" );
+					json_from_value( job.condition->first, payload );
+					if( job.condition->op == BETWEEN ) {
+						payload.push_back( ',' );
+						json_from_value( job.condition->second, payload );
+					}
+					payload.append( "],\"ComparisonOperator\":\"" );
+					payload.append( string_from_compare( job.condition->op ) );
+					payload.append( "\"}" );
+				}
+				if( job.attributes != NULL && job.attributes->size( ) > 0 ) {
+					payload.append( ",\"AttributesToGet\":[" );
+					for( size_t i = 0, e = job.attributes->size( ); i < e; ++ i ) {
+						if( i > 0 ) {
+							payload.push_back( ',' );
+						}
+						native::json_string( payload, (*job.attributes)[i].name( ) );
+					}
+					payload.push_back( ']' );
+				}
+				if( job.limit > 0 ) {
+					char limit[32];
+					snprintf( limit, sizeof( limit ), ",\"Limit\":%lu", (unsigned long) job.limit );
+					payload.append( limit );
+				}
+				payload.append( job.forward ? ",\"ScanIndexForward\":true" : ",\"ScanIndexForward\":false" );
+				if( job.start.hash.type( ) != UNKNOWN ) {
+					payload.append( ",\"ExclusiveStartKey\":" );
+					json_from_key( job.start, payload );
+				}
+				payload.append( job.consistent ? ",\"ConsistentRead\":true}" : ",\"ConsistentRead\":false}" );
+			} catch( ... ) {
+				metric.fail( FAIL_MEMORY );
+				return;
+			}
+			
+			native::json_value ret;
+			if( unlikely( !call( "Query", payload, ret, metric ) ) ) {
+				return;
+			}
+			
+			const native::json_value *ret_items = ret.get( "Items" );
+			if( unlikely( ret_items == NULL || ret_items->type != native::json_value::ARRAY ) ) {
+				fprintf( stderr, "failed to load records from table \"%.*s\"\n", SIZED_STRING(db) );
+				metric.fail( FAIL_RESPONSE );
+				return;
+			}
+			const native::json_value *cap = ret.get( "ConsumedCapacityUnits" );
+			metric.succeed( (cap != NULL) ? cap->number( ) : 0.0, ret_items->items.size( ) );
+			
+			try {
+				job.page.resize( ret_items->items.size( ) );
+			} catch( ... ) {
+				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				metric.fail( FAIL_MEMORY );
+				return;
+			}
+			for( size_t i = 0, e = ret_items->items.size( ); i < e; ++ i ) {
+				if( unlikely( !update_from_json( job.page[i], ret_items->items[i] ) ) ) {
+					fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+					metric.fail( FAIL_MEMORY );
+					return;
+				}
+			}
+			
+			const native::json_value *last = ret.get( "LastEvaluatedKey" );
+			if( last != NULL && last->type == native::json_value::OBJECT ) {
+				if( unlikely( !key_from_json( last, job.start ) ) ) {
+					fprintf( stderr, "malformed LastEvaluatedKey from table \"%.*s\"\n", SIZED_STRING(db) );
+					metric.fail( FAIL_RESPONSE );
+					return;
+				}
+				job.more = true;
+			}
+			job.ok = true;
+		}
+		
+		static bool scan_page( const const_string_t &db, const int segment, const int segments, const item_list_t *const attributes, item_key &start, bool &more, record_list_t &page, double &used ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_Scan.html
+			 * {
+			 *   "TableName":[table],
+			 *   "AttributesToGet":[[name1],[name2]],
+			 *   "ExclusiveStartKey":{"HashKeyElement":{[T]:[hash]},"RangeKeyElement":{[T]:[range]}},
+			 *   "Segment":[segment],
+			 *   "TotalSegments":[segments]
+			 * }
+			 * page = ret.Items
+			 * start = ret.LastEvaluatedKey
+			 * used = ret.ConsumedCapacityUnits
+			 */
+			
+			request_metric metric( OP_SCAN, db );
+			more = false;
+			used = 0.0;
+			page.clear( );
+			
+			string_t payload;
+			try {
+				payload.append( "{\"TableName\":" );
+				native::json_string( payload, db );
+				if( attributes != NULL && attributes->size( ) > 0 ) {
+					payload.append( ",\"AttributesToGet\":[" );
+					for( size_t i = 0, e = attributes->size( ); i < e; ++ i ) {
+						if( i > 0 ) {
+							payload.push_back( ',' );
+						}
+						native::json_string( payload, (*attributes)[i].name( ) );
+					}
+					payload.push_back( ']' );
+				}
+				if( start.hash.type( ) != UNKNOWN ) {
+					payload.append( ",\"ExclusiveStartKey\":" );
+					json_from_key( start, payload );
+				}
+				if( segments > 1 ) {
+					char seg[64];
+					snprintf( seg, sizeof( seg ), ",\"Segment\":%d,\"TotalSegments\":%d", segment, segments );
+					payload.append( seg );
+				}
+				payload.push_back( '}' );
+			} catch( ... ) {
+				return metric.fail( FAIL_MEMORY );
+			}
+			
+			native::json_value ret;
+			if( unlikely( !call( "Scan", payload, ret, metric ) ) ) {
+				return false;
+			}
+			
+			const native::json_value *ret_items = ret.get( "Items" );
+			if( unlikely( ret_items == NULL || ret_items->type != native::json_value::ARRAY ) ) {
+				fprintf( stderr, "failed to load records from table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_RESPONSE );
+			}
+			const native::json_value *cap = ret.get( "ConsumedCapacityUnits" );
+			if( cap != NULL ) {
+				used = cap->number( );
+			}
+			metric.succeed( used, ret_items->items.size( ) );
+			
+			try {
+				page.resize( ret_items->items.size( ) );
+			} catch( ... ) {
+				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_MEMORY );
+			}
+			for( size_t i = 0, e = ret_items->items.size( ); i < e; ++ i ) {
+				if( unlikely( !update_from_json( page[i], ret_items->items[i] ) ) ) {
+					fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+					return metric.fail( FAIL_MEMORY );
+				}
+			}
+			
+			const native::json_value *last = ret.get( "LastEvaluatedKey" );
+			if( last != NULL && last->type == native::json_value::OBJECT ) {
+				if( unlikely( !key_from_json( last, start ) ) ) {
+					fprintf( stderr, "malformed LastEvaluatedKey from table \"%.*s\"\n", SIZED_STRING(db) );
+					return metric.fail( FAIL_RESPONSE );
+				}
+				more = true;
+			}
+			return true;
+		}
+		
+		static inline void disconnect( void ) _noexcept {
+			connections( ).close( );
+			retry_refill( retries( ) );
+		}
+#else
+		static void release_layer1( layer1_ref &l ) _noexcept {
+			py_release( l.make_request );
+			py_release( l.query );
+			py_release( l.batch_write_item );
+			py_release( l.batch_get_item );
+			py_release( l.update_item );
+			py_release( l.get_item );
+			py_release( l.layer1 );
+			memset( &l, 0, sizeof( l ) );
+		}
+		
+		static void release_connection( void *const connection ) _noexcept {
+			py_gil gil;
+			
+			layer1_ref *conn = (layer1_ref *) connection;
+			release_layer1( *conn );
+			delete conn;
+		}
+		
+		static const layer1_ref *prep( pool_lease &lease ) _noexcept {
+			/*
+			 * import boto.regioninfo
+			 * import boto.dynamodb.layer1
+			 *
+			 * layer1 = boto.dynamodb.layer1.Layer1(
+			 *   aws_access_key_id = [key],
+			 *   aws_secret_access_key = [secret],
+			 *   region = boto.regioninfo.RegionInfo(
+			 *     name = [region],
+			 *     endpoint = 'dynamodb.' + [region] + '.amazonaws.com'
+			 *   )
+			 * )
+			 * (with layer1.get_item, layer1.update_item, etc. kept alongside)
+			 */
+			
+			if( unlikely( !lease.ok( ) ) ) {
+				return NULL;
+			}
+			layer1_ref *conn = (layer1_ref *) lease.get( );
+			if( conn != NULL ) {
+				return conn;
+			}
+			
+			const client &c = current_client( );
+			if( unlikely( c.region( ).size( ) <= 0 ) ) {
+				fprintf( stderr, "attempted to connect to DDB without a region\n" );
+				return NULL;
+			}
+			if( unlikely( c.key( ).size( ) <= 0 || c.secret( ).size( ) <= 0 ) ) {
+				fprintf( stderr, "attempted to connect to DDB without a valid IAM user\n" );
+				return NULL;
+			}
+			if( unlikely( !py_init( ) ) ) {
+				return NULL;
+			}
+			
+			string_t endpoint;
+			try {
+				conn = new layer1_ref( );
+				endpoint.assign( "dynamodb." );
+				endpoint.append( c.region( ) );
+				endpoint.append( ".amazonaws.com" );
+			} catch( ... ) {
+				delete conn;
+				return NULL;
+			}
+			memset( conn, 0, sizeof( *conn ) );
+			
+			PyObject *regioninfo_mod = py_import( "boto.regioninfo" );
+			PyObject *ddb_mod = py_import( "boto.dynamodb.layer1" );
+			
+			PyObject *layer1 = py_construct( ddb_mod, "Layer1",
+				"aws_access_key_id", py_string( c.key( ) ),
+				"aws_secret_access_key", py_string( c.secret( ) ),
+				"region", py_construct( regioninfo_mod, "RegionInfo",
+					"name", py_string( c.region( ) ),
+					"endpoint", py_string( endpoint ),
+				NULL ),
+			NULL );
+			
+			py_release( regioninfo_mod );
+			py_release( ddb_mod );
+			
+			if( unlikely( layer1 == NULL ) ) {
+				fprintf( stderr, "could not connect to DDB\n" );
+				delete conn;
+				return NULL;
+			}
+			
+			conn->layer1 = layer1;
+			conn->get_item = py_method( layer1, "get_item" );
+			conn->update_item = py_method( layer1, "update_item" );
+			conn->batch_get_item = py_method( layer1, "batch_get_item" );
+			conn->batch_write_item = py_method( layer1, "batch_write_item" );
+			conn->query = py_method( layer1, "query" );
+			conn->make_request = py_method( layer1, "make_request" );
+			if( unlikely( conn->get_item == NULL || conn->update_item == NULL || conn->batch_get_item == NULL || conn->batch_write_item == NULL || conn->query == NULL || conn->make_request == NULL ) ) {
+				release_layer1( *conn );
+				delete conn;
+				return NULL;
+			}
+			lease.set( conn );
+			return conn;
+		}
+		
+		static PyObject *dict_from_value( const item &itm ) _noexcept {
+			// {[T]:[value]} or {[TS]:[[value1],[value2]]}
+			PyObject *v;
+			const size_t f = itm.size( );
+			if( (itm.type( ) & SET) ) {
+				v = PyList_New( 0 );
+				for( size_t j = 0; j < f; ++ j ) {
+					const string_t &str = itm._list( )[j];
+					if( str.size( ) > 0 ) {
+						PyObject *o = py_string( str );
+						PyList_Append( v, o );
+						Py_DECREF( o );
+					}
+				}
+			} else {
+				v = py_string( itm._value( ) );
+			}
+			PyObject *r = PyDict_New( );
+			PyDict_SetItemString( r, itm.type_string( ), v );
+			Py_DECREF( v );
+			if( unlikely( py_error( "dict_from_value" ) ) ) {
+				py_release( r );
+				return NULL;
+			}
+			return r;
+		}
+		
+		static PyObject *dict_from_key( const item_key &key ) _noexcept {
+			// {'HashKeyElement':{[T]:[hash]},'RangeKeyElement':{[T]:[range]}}
+			PyObject *r = PyDict_New( );
+			const item *elements[] = { &key.hash, &key.range };
+			const char *names[] = { "HashKeyElement", "RangeKeyElement" };
+			for( int i = 0; i < (key.has_range( ) ? 2 : 1); ++ i ) {
+				PyObject *o = dict_from_value( *elements[i] );
+				if( unlikely( o == NULL ) ) {
+					py_release( r );
+					return NULL;
+				}
+				PyDict_SetItemString( r, names[i], o );
+				Py_DECREF( o );
+			}
+			if( unlikely( py_error( "dict_from_key" ) ) ) {
+				py_release( r );
+				return NULL;
+			}
+			return r;
+		}
+		
+		static bool key_from_dict( PyObject *obj, item_key &output ) _noexcept {
+			if( obj == NULL || !PyDict_Check( obj ) ) {
+				return false;
+			}
+			output.range.clear( );
+			if( unlikely( !item_from_dict( PyDict_GetItemString( obj, "HashKeyElement" ), output.hash ) ) ) {
+				return false;
+			}
+			PyObject *range = PyDict_GetItemString( obj, "RangeKeyElement" ); // borrowed
+			return range == NULL || item_from_dict( range, output.range );
+		}
+		
+		static PyObject *dict_from_items_expect( const item_list_t &items ) _noexcept {
+			PyObject *r = PyDict_New( );
+			for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+				const size_t f = items[i].size( );
+				if( items[i].type( ) == UNKNOWN ) {
+					continue;
+				}
+				PyObject *t = PyDict_New( );
+				if( f == 0 ) {
+					PyDict_SetItemString( t, "Exists", Py_False );
+				} else {
+					PyObject *o = PyDict_New( );
+					PyObject *v;
+					if( (items[i].type( ) & SET) ) {
+						v = PyList_New( (Py_ssize_t) f );
+						for( size_t j = 0; j < f; ++ j ) {
+							const string_t &s = items[i]._list( )[j];
+							if( s.size( ) > 0 ) {
+								PyList_SET_ITEM( v, j, py_string( s ) );
+							}
+						}
+					} else {
+						v = py_string( items[i]._value( ) );
+					}
+					PyDict_SetItemString( o, items[i].type_string( ), v );
+					Py_DECREF( v );
+					PyDict_SetItemString( t, "Value", o );
+					Py_DECREF( o );
+				}
+				PyObject *key = py_string( items[i].name( ) );
+				PyDict_SetItem( r, key, t );
+				Py_DECREF( key );
+				Py_DECREF( t );
+			}
+			if( unlikely( py_error( "dict_from_items_expect" ) ) ) {
+				py_release( r );
+				return NULL;
+			}
+			return r;
+		}
+		
+		static PyObject *dict_from_items_update( const item_list_t &items ) _noexcept {
+			PyObject *r = PyDict_New( );
+			for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+				const size_t f = items[i].size( );
+				PyObject *t = PyDict_New( );
+				if( (items[i].action( ) == DELETE && (!(items[i].type( ) & SET) || f <= 0)) || (f <= 0 && items[i].action( ) == REPLACE) ) {
+					PyObject *s = py_string( "DELETE" );
+					PyDict_SetItemString( t, "Action", s );
+					Py_DECREF( s );
+				} else if( (items[i].type( ) & SET) ) {
+					if( f <= 0 ) {
+						Py_DECREF( t );
+						continue;
+					}
+					if( items[i].action( ) != REPLACE ) {
+						PyObject *a = py_string( items[i].action_string( ) );
+						PyDict_SetItemString( t, "Action", a );
+						Py_DECREF( a );
+					}
+					
+					PyObject *v = PyList_New( (Py_ssize_t) f );
+					for( size_t j = 0; j < f; ++ j ) {
+						const string_t &s = items[i]._list( )[j];
+						if( s.size( ) > 0 ) {
+							PyList_SET_ITEM( v, j, py_string( s ) );
+						}
+					}
+					PyObject *o = PyDict_New( );
+					PyDict_SetItemString( o, items[i].type_string( ), v );
+					Py_DECREF( v );
+					PyDict_SetItemString( t, "Value", o );
+					Py_DECREF( o );
+				} else {
+					if( items[i].type( ) == NUMBER && items[i].action( ) == ADD ) {
+						PyObject *a = py_string( "ADD" );
+						PyDict_SetItemString( t, "Action", a );
+						Py_DECREF( a );
+					}
+					PyObject *o = PyDict_New( );
+					PyObject *s = py_string( items[i]._value( ) );
+					PyDict_SetItemString( o, items[i].type_string( ), s );
+					Py_DECREF( s );
+					PyDict_SetItemString( t, "Value", o );
+					Py_DECREF( o );
+				}
+				PyObject *key = py_string( items[i].name( ) );
+				PyDict_SetItem( r, key, t );
+				Py_DECREF( key );
+				Py_DECREF( t );
+			}
+			if( unlikely( py_error( "dict_from_items_update" ) ) ) {
+				py_release( r );
+				return NULL;
+			}
+			return r;
+		}
+		
+		static PyObject *dict_from_items_put( const item_list_t &items, const const_string_t &keyName, const const_string_t &key ) _noexcept {
+			PyObject *r = PyDict_New( );
+			PyObject *k = PyDict_New( );
+			PyObject *s = py_string( key );
+			PyDict_SetItemString( k, "S", s );
+			Py_DECREF( s );
+			s = py_string( keyName );
+			PyDict_SetItem( r, s, k );
+			Py_DECREF( s );
+			Py_DECREF( k );
+			for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+				const size_t f = items[i].size( );
+				// DDB rejects empty values; the key comes from the map
+				if( items[i].type( ) == UNKNOWN || f == 0 || items[i].name( ) == keyName ) {
+					continue;
+				}
+				PyObject *o = dict_from_value( items[i] );
+				if( unlikely( o == NULL ) ) {
+					py_release( r );
+					return NULL;
+				}
+				PyObject *name = py_string( items[i].name( ) );
+				PyDict_SetItem( r, name, o );
+				Py_DECREF( name );
+				Py_DECREF( o );
+			}
+			if( unlikely( py_error( "dict_from_items_put" ) ) ) {
+				py_release( r );
+				return NULL;
+			}
+			return r;
+		}
+		
+		static PyObject *list_from_items( const item_list_t &items ) _noexcept {
+			const size_t e = items.size( );
+			PyObject *r = PyList_New( (Py_ssize_t) e );
+			for( size_t i = 0; i < e; ++ i ) {
+				PyObject *key = py_string( items[i].name( ) );
+				PyList_SET_ITEM( r, i, key );
+//				Py_DECREF( key );
+			}
+			if( unlikely( py_error( "list_from_items" ) ) ) {
+				py_release( r );
+				return NULL;
+			}
+			return r;
+		}
+		
+		static inline bool item_from_dict( PyObject *obj, item &output ) _noexcept {
+			if( obj == NULL ) {
+				return false;
+			}
+			// exactly 1 attribute, but with unknown key, so just fetch an attribute at random
+			PyObject *key; // borrowed
+			PyObject *value; // borrowed
+			Py_ssize_t pos = 0;
+			if( !PyDict_Next( obj, &pos, &key, &value ) ) {
+				fprintf( stderr, "malformed record (no data)\n" );
+				return false;
+			}
+			
+			if( unlikely( !output.set_type( type_from_string( py_cstring( key ) ) ) ) ) {
+				return false;
+			}
+			if( unlikely( output.type( ) == UNKNOWN ) ) {
+				fprintf( stderr, "malformed record (unknown type)\n" );
+				return false;
+			}
+			if( (output.type( ) & SET) ) {
+				output.clear_items( );
+				
+				const size_t l = (size_t) PyList_Size( value );
+				for( size_t i = 0; i < l; ++ i ) {
+					if( unlikely( !output.add_item( py_cstring( PyList_GET_ITEM( value, i ) ) ) ) ) {
+						output.clear_items( );
+						return false;
+					}
+				}
+			} else {
+				const char *v = py_cstring( value );
+				if( v == NULL ) {
+					fprintf( stderr, "malformed record (value is not a string)\n" );
+					return false;
+				}
+				if( unlikely( !output.set_value( v ) ) ) {
+					return false;
+				}
+			}
+			output.set_action( REPLACE );
+			return true;
+		}
+		
+		static bool update_from_dict( item_list_t &items, PyObject *ret_items ) _noexcept {
+			if( items.size( ) == 0 ) {
+				PyObject *key; // borrowed
+				PyObject *itm; // borrowed
+				Py_ssize_t i = 0;
+				try {
+					items.reserve( (size_t) PyDict_Size( ret_items ) );
+				} catch( ... ) {
+					return false;
+				}
+				while( PyDict_Next( ret_items, &i, &key, &itm ) ) {
+					// decoded in place, so values are not copied again
+					try {
+						items.push_back( item( py_cstring( key ) ) );
+					} catch( ... ) {
+						return false;
+					}
+					if( unlikely( !item_from_dict( itm, items.back( ) ) ) ) {
+						items.pop_back( );
+					}
+				}
+			} else {
+				for( size_t i = items.size( ); (i --) > 0; ) {
+					PyObject *key = py_string( items[i].name( ) );
+					PyObject *itm = PyDict_GetItem( ret_items, key ); // borrowed
+					Py_DECREF( key );
+					
+					if( !item_from_dict( itm, items[i] ) ) {
+						items.erase( items.begin( ) + (std::ptrdiff_t) i );
+						continue;
+					}
+				}
+			}
+			return true;
+		}
+		
+		static bool map_from_dict( attribute_map &output, PyObject *ret_items ) _noexcept {
+			// measure everything first, so the map needs a single allocation
+			size_t count = 0;
+			size_t values = 0;
+			size_t bytes = 0;
+			PyObject *name; // borrowed
+			PyObject *itm; // borrowed
+			PyObject *type; // borrowed
+			PyObject *value; // borrowed
+			Py_ssize_t i = 0;
+			while( PyDict_Next( ret_items, &i, &name, &itm ) ) {
+				Py_ssize_t pos = 0;
+				const char *n = py_cstring( name );
+				if( n == NULL || !PyDict_Check( itm ) || !PyDict_Next( itm, &pos, &type, &value ) ) {
+					fprintf( stderr, "malformed record (no data)\n" );
+					continue;
+				}
+				++ count;
+				bytes += strlen( n ) + 1;
+				if( PyList_Check( value ) ) {
+					const Py_ssize_t l = PyList_GET_SIZE( value );
+					values += (size_t) l;
+					for( Py_ssize_t j = 0; j < l; ++ j ) {
+						const char *v = py_cstring( PyList_GET_ITEM( value, j ) );
+						bytes += (v != NULL) ? strlen( v ) + 1 : 1;
+					}
+				} else {
+					const char *v = py_cstring( value );
+					values += 1;
+					bytes += (v != NULL) ? strlen( v ) + 1 : 1;
+				}
+			}
+			PyErr_Clear( ); // (from values which were not strings)
+			
+			if( unlikely( !output._reserve( count, values, bytes ) ) ) {
+				return false;
+			}
+			i = 0;
+			while( PyDict_Next( ret_items, &i, &name, &itm ) ) {
+				Py_ssize_t pos = 0;
+				const char *n = py_cstring( name );
+				if( n == NULL || !PyDict_Check( itm ) || !PyDict_Next( itm, &pos, &type, &value ) ) {
+					continue;
+				}
+				const data_type t = type_from_string( py_cstring( type ) );
+				const bool set = (t & SET) != 0 && t != UNKNOWN;
+				if( t == UNKNOWN || set != (PyList_Check( value ) != 0) ) {
+					fprintf( stderr, "malformed record (unknown type)\n" );
+					continue;
+				}
+				attribute *const a = output._add( n, strlen( n ), t, set ? (size_t) PyList_GET_SIZE( value ) : 1 );
+				if( unlikely( a == NULL ) ) {
+					output.clear( );
+					return false;
+				}
+				for( size_t j = 0; j < a->count; ++ j ) {
+					const char *v = py_cstring( set ? PyList_GET_ITEM( value, (Py_ssize_t) j ) : value );
+					if( v == NULL ) {
+						PyErr_Clear( );
+						fprintf( stderr, "malformed record (value is not a string)\n" );
+						continue; // (left empty)
+					}
+					if( unlikely( !output._set_value( *a, j, v, strlen( v ) ) ) ) {
+						output.clear( );
+						return false;
+					}
+				}
+			}
+			PyErr_Clear( );
+			return true;
+		}
+		
+		static bool update_item( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *expected ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_UpdateItem.html
+			 * ret = layer1.update_item( [table],
+			 *   {'HashKeyElement':{[T]:[hash]},'RangeKeyElement':{[T]:[range]}},
+			 *   {
+			 *     [attr1]:{'Value':{[T]:[value]}},
+			 *     [attr2]:{'Value':{[TS]:[[value1],[value2]]},'Action':'ADD'}
+			 *   }
+			 * )
+			 * used = ret.ConsumedCapacityUnits
+			 */
+			
+			request_metric metric( OP_UPDATE, db );
+			if( unlikely( !key.valid( ) ) ) {
+				fprintf( stderr, "invalid key for table \"%.*s\"\n", SIZED_STRING(db) );
+				return metric.fail( FAIL_INVALID );
+			}
+			
+			py_gil gil;
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const layer1_ref *conn = prep( lease );
+			if( unlikely( conn == NULL ) ) {
+				return false;
+			}
+			
+			PyObject *key_dict = dict_from_key( key );
+			if( unlikely( key_dict == NULL ) ) {
+				return false;
+			}
+			
+			PyObject *expect = NULL;
+			if( expected != NULL ) {
+				if( expected->size( ) > 0 ) {
+					expect = dict_from_items_expect( *expected );
+				}
+			}
+			
+			PyObject *ret = py_call_retry( retries( ), conn->update_item, "update_item",
+				"", py_string( db ),
+				"", key_dict,
+				"", dict_from_items_update( items ),
+				(expect != NULL) ? "expected" : "-", expect,
+			NULL );
+			
+			if( unlikely( ret == NULL ) ) {
+				return metric.fail( failure_from_code( py_error_code( ) ) );
+			}
+			
+			PyObject *cap = PyDict_GetItemString( ret, "ConsumedCapacityUnits" ); // borrowed
+			if( unlikely( cap == NULL ) ) {
+				fprintf( stderr, "bad response when saving record in table \"%.*s\"\n", SIZED_STRING(db) );
+				Py_DECREF( ret );
+				return metric.fail( FAIL_RESPONSE );
+			}
+			metric.succeed( PyFloat_AsDouble( cap ), 1 );
+			Py_DECREF( ret );
+			return true;
+		}
+		
+		static PyObject *get_record( const const_string_t &db, const item_key &key, bool consistent, const item_list_t *const attributes, PyObject *&ret_items, request_metric &metric ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_GetItem.html
+			 * layer1.get_item( [database_name], {'HashKeyElement':{[T]:[hash]},'RangeKeyElement':{[T]:[range]}} )
+			 */
+			
+			ret_items = NULL;
+			if( unlikely( !key.valid( ) ) ) {
+				fprintf( stderr, "invalid key for table \"%.*s\"\n", SIZED_STRING(db) );
+				metric.fail( FAIL_INVALID );
+				return NULL;
+			}
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const layer1_ref *conn = prep( lease );
+			if( unlikely( conn == NULL ) ) {
+				return NULL;
+			}
+			
+			PyObject *key_dict = dict_from_key( key );
+			if( unlikely( key_dict == NULL ) ) {
+				return NULL;
+			}
+			
+			const bool partial = attributes != NULL && attributes->size( ) > 0;
+			PyObject *ret = py_call_retry( retries( ), conn->get_item, "get_item",
+				"", py_string( db ),
+				"", key_dict,
+				partial ? "attributes_to_get" : "-", partial ? list_from_items( *attributes ) : NULL,
+				"consistent_read", py_boolean( consistent ),
+			NULL );
+			
+			if( unlikely( ret == NULL ) ) {
+				metric.fail( failure_from_code( py_error_code( ) ) );
+				return NULL;
+			}
+			
+			PyObject *cap = PyDict_GetItemString( ret, "ConsumedCapacityUnits" ); // borrowed
+			ret_items = PyDict_GetItemString( ret, "Item" ); // borrowed
+			if( unlikely( ret_items == NULL ) ) {
+				fprintf( stderr, "failed to load record items from table \"%.*s\"\n", SIZED_STRING(db) );
+				metric.fail( FAIL_NOT_FOUND );
+				Py_DECREF( ret );
+				return NULL;
+			}
+			metric.succeed( (cap != NULL) ? PyFloat_AsDouble( cap ) : 0.0, 1 );
+			return ret;
+		}
+		
+		static bool get_item( const const_string_t &db, const item_key &key, bool consistent, item_list_t &items ) _noexcept {
+			request_metric metric( OP_GET, db );
+			py_gil gil;
+			
+			PyObject *ret_items; // borrowed
+			PyObject *ret = get_record( db, key, consistent, &items, ret_items, metric );
+			if( unlikely( ret == NULL ) ) {
+				return false;
+			}
+			if( unlikely( !update_from_dict( items, ret_items ) ) ) {
+				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				Py_DECREF( ret );
+				return metric.fail( FAIL_MEMORY );
+			}
+			Py_DECREF( ret );
+			return true;
+		}
+		
+		static bool get_attributes( const const_string_t &db, const item_key &key, bool consistent, attribute_map &output, const item_list_t *const attributes ) _noexcept {
+			request_metric metric( OP_GET, db );
+			py_gil gil;
+			
+			PyObject *ret_items; // borrowed
+			PyObject *ret = get_record( db, key, consistent, attributes, ret_items, metric );
+			if( unlikely( ret == NULL ) ) {
+				return false;
+			}
+			if( unlikely( !map_from_dict( output, ret_items ) ) ) {
+				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				Py_DECREF( ret );
+				return metric.fail( FAIL_MEMORY );
+			}
+			Py_DECREF( ret );
+			return true;
+		}
+		
+		static bool hash_key_name( const const_string_t &db, string_t &name ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_DescribeTable.html
+			 * ret = layer1.describe_table( [table] )
+			 * name = ret['Table']['KeySchema']['HashKeyElement']['AttributeName']
+			 */
+			
+			static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+			static std::map<string_t,string_t> map; // client_table => name
+			
+			string_t id;
+			try {
+				client_table( db, id );
+			} catch( ... ) {
+				return false;
+			}
+			
+			// (the mutex is only held for lookups, so that sinks called when the
+			// metric completes can make batch calls themselves)
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &mutex );
+#else
+			(void) mutex;
+#endif
+			bool found = false;
+			try {
+				std::map<string_t,string_t>::const_iterator ind = map.find( id );
+				if( ind != map.end( ) ) {
+					name.assign( ind->second );
+					found = true;
+				}
+			} catch( ... ) {
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &mutex );
+#endif
+			if( found ) {
+				return true;
+			}
+			
+			request_metric metric( OP_DESCRIBE, db );
+			py_gil gil;
+			pool_lease lease( connections( ), pooled_connection );
+			const layer1_ref *conn = prep( lease );
+			if( unlikely( conn == NULL ) ) {
+				return false;
+			}
+			
+			PyObject *ret = py_callfunc_retry( retries( ), conn->layer1, "describe_table",
+				"", py_string( db ),
+			NULL );
+			
+			if( unlikely( ret == NULL ) ) {
+				return metric.fail( failure_from_code( py_error_code( ) ) );
+			}
+			
+			PyObject *table = PyDict_GetItemString( ret, "Table" ); // borrowed
+			PyObject *schema = (table != NULL) ? PyDict_GetItemString( table, "KeySchema" ) : NULL; // borrowed
+			PyObject *hash = (schema != NULL) ? PyDict_GetItemString( schema, "HashKeyElement" ) : NULL; // borrowed
+			PyObject *attr = (hash != NULL) ? PyDict_GetItemString( hash, "AttributeName" ) : NULL; // borrowed
+			const char *n = (attr != NULL) ? py_cstring( attr ) : NULL;
+			if( unlikely( n == NULL ) ) {
+				fprintf( stderr, "could not find the hash key of table \"%.*s\"\n", SIZED_STRING(db) );
+				Py_DECREF( ret );
+				return metric.fail( FAIL_RESPONSE );
+			}
+			metric.succeed( 0.0, 0 );
+			try {
+				name.assign( n );
+			} catch( ... ) {
+				Py_DECREF( ret );
+				return metric.fail( FAIL_MEMORY );
+			}
+			Py_DECREF( ret );
+			
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &mutex );
+#endif
+			try {
+				map[id] = name;
+			} catch( ... ) {
+				// (looked up again next time)
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &mutex );
+#endif
+			return true;
+		}
+		
+		static bool get_group( const const_string_t &db, const const_string_t &keyName, string_list_t &pending, const item_list_t &attributes, const bool consistent, item_map_t &results ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_BatchGetItem.html
+			 * ret = layer1.batch_get_item( {[table]:{
+			 *   'Keys':[{'HashKeyElement':{'S':[key1]}},{'HashKeyElement':{'S':[key2]}}],
+			 *   'AttributesToGet':[[name1],[name2],[keyName]],
+			 *   'ConsistentRead':[consistent]
+			 * }} )
+			 * items = ret['Responses'][table]['Items']
+			 * pending = ret['UnprocessedKeys'][table]['Keys']
+			 */
+			
+			request_metric metric( OP_BATCH_GET, db, (double) pending.size( ) );
+			py_gil gil;
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const layer1_ref *conn = prep( lease );
+			if( unlikely( conn == NULL ) ) {
+				return false;
+			}
+			
+			PyObject *key_list = PyList_New( (Py_ssize_t) pending.size( ) );
+			for( size_t i = 0, e = pending.size( ); i < e; ++ i ) {
+				PyObject *key_dict = PyDict_New( );
+				PyObject *key_str = py_string( pending[i] );
+				PyObject *key_prop = PyDict_New( );
+				PyDict_SetItemString( key_prop, "S", key_str );
+				Py_DECREF( key_str );
+				PyDict_SetItemString( key_dict, "HashKeyElement", key_prop );
+				Py_DECREF( key_prop );
+				PyList_SET_ITEM( key_list, i, key_dict );
+			}
+			PyObject *request = PyDict_New( );
+			PyDict_SetItemString( request, "Keys", key_list );
+			Py_DECREF( key_list );
+			PyObject *key_name = py_string( keyName );
+			if( attributes.size( ) > 0 ) {
+				// the key is needed to match items to keys
+				PyObject *names = list_from_items( attributes );
+				if( names != NULL ) {
+					if( PySequence_Contains( names, key_name ) != 1 ) {
+						PyList_Append( names, key_name );
+					}
+					PyDict_SetItemString( request, "AttributesToGet", names );
+					Py_DECREF( names );
+				}
+			}
+			PyDict_SetItemString( request, "ConsistentRead", consistent ? Py_True : Py_False );
+			PyObject *table = py_string( db );
+			PyObject *request_items = PyDict_New( );
+			PyDict_SetItem( request_items, table, request );
+			Py_DECREF( request );
+			
+			PyObject *ret = py_call_retry( retries( ), conn->batch_get_item, "batch_get_item",
+				"", request_items,
+			NULL );
+			
+			if( unlikely( ret == NULL ) ) {
+				Py_DECREF( key_name );
+				Py_DECREF( table );
+				return metric.fail( failure_from_code( py_error_code( ) ) );
+			}
+			
+			PyObject *responses = PyDict_GetItemString( ret, "Responses" ); // borrowed
+			PyObject *response = (responses != NULL) ? PyDict_GetItem( responses, table ) : NULL; // borrowed
+			PyObject *ret_items = (response != NULL) ? PyDict_GetItemString( response, "Items" ) : NULL; // borrowed
+			if( unlikely( ret_items == NULL || !PyList_Check( ret_items ) ) ) {
+				fprintf( stderr, "failed to load records from table \"%.*s\"\n", SIZED_STRING(db) );
+				Py_DECREF( ret );
+				Py_DECREF( key_name );
+				Py_DECREF( table );
+				return metric.fail( FAIL_RESPONSE );
+			}
+			const size_t count = (size_t) PyList_Size( ret_items );
+			PyObject *cap = PyDict_GetItemString( response, "ConsumedCapacityUnits" ); // borrowed
+			metric.succeed( (cap != NULL) ? PyFloat_AsDouble( cap ) : 0.0, count );
+			
+			bool ok = true;
+			for( size_t i = 0; i < count && ok; ++ i ) {
+				PyObject *obj = PyList_GET_ITEM( ret_items, i ); // borrowed
+				item key( keyName );
+				if( unlikely( !item_from_dict( PyDict_GetItem( obj, key_name ), key ) || key.type( ) != STRING ) ) {
+					fprintf( stderr, "malformed record (no key)\n" );
+					continue;
+				}
+				try {
+					item_list_t &items = results[key.value_knowntype( )];
+					items = attributes;
+					ok = update_from_dict( items, obj );
+				} catch( ... ) {
+					ok = false;
+				}
+				if( unlikely( !ok ) ) {
+					fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				}
+			}
+			
+			pending.clear( );
+			PyObject *unprocessed = PyDict_GetItemString( ret, "UnprocessedKeys" ); // borrowed
+			PyObject *left = (unprocessed != NULL) ? PyDict_GetItem( unprocessed, table ) : NULL; // borrowed
+			PyObject *keys = (left != NULL) ? PyDict_GetItemString( left, "Keys" ) : NULL; // borrowed
+			if( ok && keys != NULL && PyList_Check( keys ) ) {
+				for( Py_ssize_t i = 0, e = PyList_Size( keys ); i < e; ++ i ) {
+					PyObject *hash = PyDict_GetItemString( PyList_GET_ITEM( keys, i ), "HashKeyElement" ); // borrowed
+					PyObject *value = (hash != NULL) ? PyDict_GetItemString( hash, "S" ) : NULL; // borrowed
+					const char *k = (value != NULL) ? py_cstring( value ) : NULL;
+					if( unlikely( k == NULL ) ) {
+						continue;
+					}
+					try {
+						pending.push_back( k );
+					} catch( ... ) {
+						ok = false;
+						break;
+					}
+				}
+			}
+			Py_DECREF( ret );
+			Py_DECREF( key_name );
+			Py_DECREF( table );
+			if( !ok ) {
+				return metric.fail( FAIL_MEMORY );
+			}
+			return true;
+		}
+		
+		static bool write_group( const const_string_t &db, const const_string_t &keyName, write_list_t &pending ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_BatchWriteItem.html
+			 * ret = layer1.batch_write_item( {[table]:[
+			 *   {'PutRequest':{'Item':{[keyName]:{'S':[key1]},[attr1]:{[T]:[value]}}}},
+			 *   {'DeleteRequest':{'Key':{'HashKeyElement':{'S':[key2]}}}}
+			 * ]} )
+			 * used = ret['Responses'][table]['ConsumedCapacityUnits']
+			 * pending = ret['UnprocessedItems'][table]
+			 */
+			
+			request_metric metric( OP_BATCH_WRITE, db, (double) pending.size( ) );
+			py_gil gil;
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const layer1_ref *conn = prep( lease );
+			if( unlikely( conn == NULL ) ) {
+				return false;
+			}
+			
+			PyObject *list = PyList_New( (Py_ssize_t) pending.size( ) );
+			for( size_t i = 0, e = pending.size( ); i < e; ++ i ) {
+				PyObject *req = PyDict_New( );
+				if( pending[i].items != NULL ) {
+					PyObject *itm = dict_from_items_put( *pending[i].items, keyName, *pending[i].key );
+					if( unlikely( itm == NULL ) ) {
+						Py_DECREF( req );
+						Py_DECREF( list );
+						return false;
+					}
+					PyObject *put = PyDict_New( );
+					PyDict_SetItemString( put, "Item", itm );
+					Py_DECREF( itm );
+					PyDict_SetItemString( req, "PutRequest", put );
+					Py_DECREF( put );
+				} else {
+					PyObject *key_dict = PyDict_New( );
+					PyObject *key_str = py_string( *pending[i].key );
+					PyObject *key_prop = PyDict_New( );
+					PyDict_SetItemString( key_prop, "S", key_str );
+					Py_DECREF( key_str );
+					PyDict_SetItemString( key_dict, "HashKeyElement", key_prop );
+					Py_DECREF( key_prop );
+					PyObject *del = PyDict_New( );
+					PyDict_SetItemString( del, "Key", key_dict );
+					Py_DECREF( key_dict );
+					PyDict_SetItemString( req, "DeleteRequest", del );
+					Py_DECREF( del );
+				}
+				PyList_SET_ITEM( list, i, req );
+			}
+			PyObject *table = py_string( db );
+			PyObject *request_items = PyDict_New( );
+			PyDict_SetItem( request_items, table, list );
+			Py_DECREF( list );
+			
+			PyObject *ret = py_call_retry( retries( ), conn->batch_write_item, "batch_write_item",
+				"", request_items,
+			NULL );
+			
+			if( unlikely( ret == NULL ) ) {
+				Py_DECREF( table );
+				return metric.fail( failure_from_code( py_error_code( ) ) );
+			}
+			
+			PyObject *responses = PyDict_GetItemString( ret, "Responses" ); // borrowed
+			PyObject *response = (responses != NULL) ? PyDict_GetItem( responses, table ) : NULL; // borrowed
+			PyObject *cap = (response != NULL) ? PyDict_GetItemString( response, "ConsumedCapacityUnits" ) : NULL; // borrowed
+			PyObject *unprocessed = PyDict_GetItemString( ret, "UnprocessedItems" ); // borrowed
+			PyObject *left = (unprocessed != NULL) ? PyDict_GetItem( unprocessed, table ) : NULL; // borrowed
+			const size_t failed = (left != NULL && PyList_Check( left )) ? (size_t) PyList_Size( left ) : 0;
+			Py_DECREF( table );
+			metric.succeed( (cap != NULL) ? PyFloat_AsDouble( cap ) : 0.0, pending.size( ) - failed );
+			
+			PyObject *key_name = py_string( keyName );
+			write_list_t retry;
+			bool ok = true;
+			for( size_t i = 0; i < failed && ok; ++ i ) {
+				PyObject *req = PyList_GET_ITEM( left, i ); // borrowed
+				PyObject *put = PyDict_GetItemString( req, "PutRequest" ); // borrowed
+				PyObject *del = PyDict_GetItemString( req, "DeleteRequest" ); // borrowed
+				PyObject *value = NULL; // borrowed
+				if( put != NULL ) {
+					PyObject *itm = PyDict_GetItemString( put, "Item" ); // borrowed
+					PyObject *attr = (itm != NULL) ? PyDict_GetItem( itm, key_name ) : NULL; // borrowed
+					value = (attr != NULL) ? PyDict_GetItemString( attr, "S" ) : NULL;
+				} else if( del != NULL ) {
+					PyObject *key = PyDict_GetItemString( del, "Key" ); // borrowed
+					PyObject *hash = (key != NULL) ? PyDict_GetItemString( key, "HashKeyElement" ) : NULL; // borrowed
+					value = (hash != NULL) ? PyDict_GetItemString( hash, "S" ) : NULL;
+				}
+				const char *k = (value != NULL) ? py_cstring( value ) : NULL;
+				if( unlikely( k == NULL ) ) {
+					continue;
+				}
+				// keys are unique within a request
+				for( size_t j = 0, e = pending.size( ); j < e; ++ j ) {
+					if( *pending[j].key == k ) {
+						try {
+							retry.push_back( pending[j] );
+						} catch( ... ) {
+							ok = false;
+						}
+						break;
+					}
+				}
+			}
+			Py_DECREF( key_name );
+			Py_DECREF( ret );
+			if( !ok ) {
+				return metric.fail( FAIL_MEMORY );
+			}
+			pending.swap( retry );
+			return true;
+		}
+		
+		static void query_page( query_job &job ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_Query.html
+			 * ret = layer1.query( [table], {[T]:[hash]},
+			 *   range_key_conditions = {'AttributeValueList':[{[T]:[value1]},{[T]:[value2]}],'ComparisonOperator':[op]},
+			 *   attributes_to_get = [[name1],[name2]],
+			 *   limit = [limit],
+			 *   consistent_read = [consistent],
+			 *   scan_index_forward = [forward],
+			 *   exclusive_start_key = {'HashKeyElement':{[T]:[hash]},'RangeKeyElement':{[T]:[range]}}
+			 * )
+			 * page = ret['Items']
+			 * start = ret['LastEvaluatedKey']
+			 */
+			
+			const string_t &db = *job.db;
+			request_metric metric( OP_QUERY, db );
+			job.ok = false;
+			job.more = false;
+			job.page.clear( );
+			
+			py_gil gil;
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const layer1_ref *conn = prep( lease );
+			if( unlikely( conn == NULL ) ) {
+				return;
+			}
+			
+			PyObject *hash = dict_from_value( *job.hash );
+			if( unlikely( hash == NULL ) ) {
+				return;
+			}
+			
+			PyObject *condition = NULL;
+			if( job.condition->op != NO_CONDITION ) {
+				PyObject *values = PyList_New( 0 );
+				PyObject *v = dict_from_value( job.condition->first );
+				if( v != NULL ) {
+					PyList_Append( values, v );
+					Py_DECREF( v );
+				}
+				if( job.condition->op == BETWEEN ) {
+					v = dict_from_value( job.condition->second );
+					if( v != NULL ) {
+						PyList_Append( values, v );
+						Py_DECREF( v );
+					}
+				}
+				condition = PyDict_New( );
+				PyDict_SetItemString( condition, "AttributeValueList", values );
+				Py_DECREF( values );
+				PyObject *op = py_string( string_from_compare( job.condition->op ) );
+				PyDict_SetItemString( condition, "ComparisonOperator", op );
+				Py_DECREF( op );
+			}
+			
+			PyObject *start = NULL;
+			if( job.start.hash.type( ) != UNKNOWN ) {
+				start = dict_from_key( job.start );
+			}
+			
+			const bool names = (job.attributes != NULL && job.attributes->size( ) > 0);
+			PyObject *ret = py_call_retry( retries( ), conn->query, "query",
+				"", py_string( db ),
+				"", hash,
+				(condition != NULL) ? "range_key_conditions" : "-", condition,
+				names ? "attributes_to_get" : "-", names ? list_from_items( *job.attributes ) : NULL,
+				(job.limit > 0) ? "limit" : "-", (job.limit > 0) ? PyInt_FromSize_t( job.limit ) : NULL,
+				"consistent_read", py_boolean( job.consistent ),
+				"scan_index_forward", py_boolean( job.forward ),
+				(start != NULL) ? "exclusive_start_key" : "-", start,
+			NULL );
+			
+			if( unlikely( ret == NULL ) ) {
+				metric.fail( failure_from_code( py_error_code( ) ) );
+				return;
+			}
+			
+			PyObject *ret_items = PyDict_GetItemString( ret, "Items" ); // borrowed
+			if( unlikely( ret_items == NULL || !PyList_Check( ret_items ) ) ) {
+				fprintf( stderr, "failed to load records from table \"%.*s\"\n", SIZED_STRING(db) );
+				metric.fail( FAIL_RESPONSE );
+				Py_DECREF( ret );
+				return;
+			}
+			const size_t count = (size_t) PyList_Size( ret_items );
+			PyObject *cap = PyDict_GetItemString( ret, "ConsumedCapacityUnits" ); // borrowed
+			metric.succeed( (cap != NULL) ? PyFloat_AsDouble( cap ) : 0.0, count );
+			
+			try {
+				job.page.resize( count );
+			} catch( ... ) {
+				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				metric.fail( FAIL_MEMORY );
+				Py_DECREF( ret );
+				return;
+			}
+			for( size_t i = 0; i < count; ++ i ) {
+				if( unlikely( !update_from_dict( job.page[i], PyList_GET_ITEM( ret_items, i ) ) ) ) {
+					fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+					metric.fail( FAIL_MEMORY );
+					Py_DECREF( ret );
+					return;
+				}
+			}
+			
+			PyObject *last = PyDict_GetItemString( ret, "LastEvaluatedKey" ); // borrowed
+			if( last != NULL && last != Py_None ) {
+				if( unlikely( !key_from_dict( last, job.start ) ) ) {
+					fprintf( stderr, "malformed LastEvaluatedKey from table \"%.*s\"\n", SIZED_STRING(db) );
+					metric.fail( FAIL_RESPONSE );
+					Py_DECREF( ret );
+					return;
+				}
+				job.more = true;
+			}
+			Py_DECREF( ret );
+			job.ok = true;
+		}
+		
+		static bool scan_page( const const_string_t &db, const int segment, const int segments, const item_list_t *const attributes, item_key &start, bool &more, record_list_t &page, double &used ) _noexcept {
+			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_Scan.html
+			 * (layer1.scan has no segments, so the request is made directly)
+			 * import json
+			 * ret = layer1.make_request( 'Scan', json.dumps( {
+			 *   'TableName':[table],
+			 *   'AttributesToGet':[[name1],[name2]],
+			 *   'ExclusiveStartKey':{'HashKeyElement':{[T]:[hash]},'RangeKeyElement':{[T]:[range]}},
+			 *   'Segment':[segment],
+			 *   'TotalSegments':[segments]
+			 * } ) )
+			 * page = ret['Items']
+			 * start = ret['LastEvaluatedKey']
+			 * used = ret['ConsumedCapacityUnits']
+			 */
+			
+			request_metric metric( OP_SCAN, db );
+			more = false;
+			used = 0.0;
+			page.clear( );
+			
+			py_gil gil;
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const layer1_ref *conn = prep( lease );
+			if( unlikely( conn == NULL ) ) {
+				return false;
+			}
+			
+			PyObject *json_mod = py_import( "json" );
+			if( unlikely( json_mod == NULL ) ) {
+				return false;
+			}
+			
+			PyObject *request = PyDict_New( );
+			PyObject *o = py_string( db );
+			PyDict_SetItemString( request, "TableName", o );
+			Py_DECREF( o );
+			if( attributes != NULL && attributes->size( ) > 0 ) {
+				o = list_from_items( *attributes );
+				if( o != NULL ) {
+					PyDict_SetItemString( request, "AttributesToGet", o );
+					Py_DECREF( o );
+				}
+			}
+			if( start.hash.type( ) != UNKNOWN ) {
+				o = dict_from_key( start );
+				if( o != NULL ) {
+					PyDict_SetItemString( request, "ExclusiveStartKey", o );
+					Py_DECREF( o );
+				}
+			}
+			if( segments > 1 ) {
+				o = PyInt_FromLong( segment );
+				PyDict_SetItemString( request, "Segment", o );
+				Py_DECREF( o );
+				o = PyInt_FromLong( segments );
+				PyDict_SetItemString( request, "TotalSegments", o );
+				Py_DECREF( o );
+			}
+			
+			PyObject *body = py_callfunc( json_mod, "dumps",
+				"", request,
+			NULL );
+			py_release( json_mod );
+			
+			PyObject *ret = py_call_retry( retries( ), conn->make_request, "make_request",
+				"", py_string( "Scan" ),
+				"", body,
+			NULL );
+			
+			if( unlikely( ret == NULL ) ) {
+				return metric.fail( failure_from_code( py_error_code( ) ) );
+			}
+			
+			PyObject *ret_items = PyDict_GetItemString( ret, "Items" ); // borrowed
+			if( unlikely( ret_items == NULL || !PyList_Check( ret_items ) ) ) {
+				fprintf( stderr, "failed to load records from table \"%.*s\"\n", SIZED_STRING(db) );
+				Py_DECREF( ret );
+				return metric.fail( FAIL_RESPONSE );
+			}
+			const size_t count = (size_t) PyList_Size( ret_items );
+			PyObject *cap = PyDict_GetItemString( ret, "ConsumedCapacityUnits" ); // borrowed
+			if( cap != NULL ) {
+				used = PyFloat_AsDouble( cap );
+			}
+			metric.succeed( used, count );
+			
+			try {
+				page.resize( count );
+			} catch( ... ) {
+				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+				Py_DECREF( ret );
+				return metric.fail( FAIL_MEMORY );
+			}
+			for( size_t i = 0; i < count; ++ i ) {
+				if( unlikely( !update_from_dict( page[i], PyList_GET_ITEM( ret_items, i ) ) ) ) {
+					fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
+					Py_DECREF( ret );
+					return metric.fail( FAIL_MEMORY );
+				}
+			}
+			
+			PyObject *last = PyDict_GetItemString( ret, "LastEvaluatedKey" ); // borrowed
+			if( last != NULL && last != Py_None ) {
+				if( unlikely( !key_from_dict( last, start ) ) ) {
+					fprintf( stderr, "malformed LastEvaluatedKey from table \"%.*s\"\n", SIZED_STRING(db) );
+					Py_DECREF( ret );
+					return metric.fail( FAIL_RESPONSE );
+				}
+				more = true;
+			}
+			Py_DECREF( ret );
+			return true;
 		}
 		
-		static PyObject *dict_from_items_expect( const item_list_t &items ) _noexcept {
-			PyObject *r = PyDict_New( );
-			for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
-				const size_t f = items[i].size( );
-				if( items[i].type( ) == UNKNOWN ) {
-					continue;
+		static inline void disconnect( void ) _noexcept {
+			py_gil gil;
+			connections( ).close( );
+			retry_refill( retries( ) );
+		}
+#endif
+		
+		static bool batch_get( const const_string_t &db, const string_list_t &keys, const item_list_t &attributes, const bool consistent, item_map_t &results ) _noexcept {
+			/* for each group of up to 100 distinct keys:
+			 *   while the group has keys:
+			 *     results += batch_get_item( group ), group = unprocessed keys
+			 *     (backing off as the retry policy says while none get through)
+			 */
+			
+			results.clear( );
+			if( keys.size( ) == 0 ) {
+				return true;
+			}
+			
+			string_t keyName;
+			if( unlikely( !hash_key_name( db, keyName ) ) ) {
+				return false;
+			}
+			
+			// DDB rejects requests which repeat a key
+			string_list_t unique;
+			string_list_t pending;
+			try {
+				unique = keys;
+				std::sort( unique.begin( ), unique.end( ) );
+				unique.erase( std::unique( unique.begin( ), unique.end( ) ), unique.end( ) );
+				pending.reserve( MAX_BATCH_GET );
+			} catch( ... ) {
+				fprintf( stderr, "batch_get: out of memory\n" );
+				return false;
+			}
+			
+			bool ok = true;
+			for( size_t start = 0, e = unique.size( ); start < e; start += MAX_BATCH_GET ) {
+				const size_t end = std::min( e, start + (size_t) MAX_BATCH_GET );
+				try {
+					pending.assign( unique.begin( ) + (std::ptrdiff_t) start, unique.begin( ) + (std::ptrdiff_t) end );
+				} catch( ... ) {
+					fprintf( stderr, "batch_get: out of memory\n" );
+					return false;
 				}
-				PyObject *t = PyDict_New( );
-				if( f == 0 ) {
-					PyDict_SetItemString( t, "Exists", Py_False );
-				} else {
-					PyObject *o = PyDict_New( );
-					PyObject *v;
-					if( (items[i].type( ) & SET) ) {
-						v = PyList_New( (Py_ssize_t) f );
-						for( size_t j = 0; j < f; ++ j ) {
-							const string_t &s = items[i]._list( )[j];
-							if( s.size( ) > 0 ) {
-								PyList_SET_ITEM( v, j, py_string( s ) );
-							}
-						}
-					} else {
-						v = py_string( items[i]._value( ) );
+				retry_call attempt( retries( ) );
+				while( true ) {
+					const size_t before = pending.size( );
+					if( unlikely( !get_group( db, keyName, pending, attributes, consistent, results ) ) ) {
+						ok = false;
+						break;
+					}
+					if( pending.size( ) == 0 ) {
+						attempt.succeeded( );
+						break;
+					}
+					if( pending.size( ) < before ) {
+						// only back off (and give up) when nothing is getting through
+						attempt.progressed( );
+						continue;
+					}
+					if( !attempt.again( RETRY_THROTTLED ) ) {
+						fprintf( stderr, "gave up on %d unprocessed keys in table \"%.*s\"\n", (int) pending.size( ), SIZED_STRING(db) );
+						ok = false;
+						break;
 					}
-					PyDict_SetItemString( o, items[i].type_string( ), v );
-					Py_DECREF( v );
-					PyDict_SetItemString( t, "Value", o );
-					Py_DECREF( o );
 				}
-				PyObject *key = py_string( items[i].name( ) );
-				PyDict_SetItem( r, key, t );
-				Py_DECREF( key );
-				Py_DECREF( t );
 			}
-			if( unlikely( py_error( "dict_from_items_expect" ) ) ) {
-				py_release( r );
-				return NULL;
+			return ok;
+		}
+		
+		static bool update( const const_string_t &db, const item_key &key, const item_list_t &items, const item_list_t *expected ) _noexcept {
+			const bool ok = update_item( db, key, items, expected );
+			cache_invalidate( db, key ); // (even if it failed; it may still have been applied)
+			return ok;
+		}
+		
+		static bool get( const const_string_t &db, const item_key &key, const bool consistent, item_list_t &items ) _noexcept {
+			/* read-through: eventually consistent gets are answered from the cache
+			 * (when set_cache has turned it on) until they expire or are updated
+			 */
+			
+			string_t id;
+			unsigned long generation = 0;
+			if( cache_lookup( db, key, consistent, items, id, generation ) ) {
+				return true;
 			}
-			return r;
+			if( unlikely( !get_item( db, key, consistent, items ) ) ) {
+				return false;
+			}
+			if( id.size( ) > 0 ) {
+				cache_store( id, items, generation );
+			}
+			return true;
 		}
 		
-		static PyObject *dict_from_items_update( const item_list_t &items ) _noexcept {
-			PyObject *r = PyDict_New( );
-			for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
-				const size_t f = items[i].size( );
-				PyObject *t = PyDict_New( );
-				if( (items[i].action( ) == DELETE && (!(items[i].type( ) & SET) || f <= 0)) || (f <= 0 && items[i].action( ) == REPLACE) ) {
-					PyObject *s = py_string( "DELETE" );
-					PyDict_SetItemString( t, "Action", s );
-					Py_DECREF( s );
-				} else if( (items[i].type( ) & SET) ) {
-					if( f <= 0 ) {
-						Py_DECREF( t );
+		static bool update( const const_string_t &db, const const_string_t &key, const item_list_t &items, const item_list_t *expected ) _noexcept {
+			try {
+				const item_key k( key );
+				return update( db, k, items, expected );
+			} catch( ... ) {
+				return false;
+			}
+		}
+		
+		static bool get( const const_string_t &db, const const_string_t &key, const bool consistent, item_list_t &items ) _noexcept {
+			try {
+				const item_key k( key );
+				return get( db, k, consistent, items );
+			} catch( ... ) {
+				return false;
+			}
+		}
+		
+		static bool get( const const_string_t &db, const item_key &key, const bool consistent, attribute_map &output, const item_list_t *const attributes ) _noexcept {
+			/* with the cache on, eventually consistent gets go through it (and
+			 * are copied into output); otherwise the response is decoded
+			 * straight into output's arena
+			 */
+			
+			if( !consistent && cache_enabled( ) ) {
+				item_list_t items;
+				try {
+					if( attributes != NULL ) {
+						items = *attributes;
+					}
+				} catch( ... ) {
+					return false;
+				}
+				return get( db, key, consistent, items ) && output.assign( items );
+			}
+			return get_attributes( db, key, consistent, output, attributes );
+		}
+		
+		static bool get( const const_string_t &db, const const_string_t &key, const bool consistent, attribute_map &output, const item_list_t *const attributes ) _noexcept {
+			try {
+				const item_key k( key );
+				return get( db, k, consistent, output, attributes );
+			} catch( ... ) {
+				return false;
+			}
+		}
+		
+		static void *write_worker( void *const job ) _noexcept {
+			write_job &j = *(write_job *) job;
+			client_scope use( *j.owner );
+			write_list_t pending;
+			try {
+				pending.reserve( MAX_BATCH_WRITE );
+			} catch( ... ) {
+				return NULL;
+			}
+			
+			while( true ) {
+				pthread_mutex_lock( &j.mutex );
+				const size_t start = j.next;
+				const size_t end = std::min( j.count, start + (size_t) MAX_BATCH_WRITE );
+				j.next = end;
+				pthread_mutex_unlock( &j.mutex );
+				if( start >= end ) {
+					break;
+				}
+				
+				pending.assign( j.requests + start, j.requests + end );
+				retry_call attempt( retries( ) );
+				while( true ) {
+					const size_t before = pending.size( );
+					if( unlikely( !write_group( *j.db, *j.keyName, pending ) ) ) {
+						break;
+					}
+					if( pending.size( ) == 0 ) {
+						attempt.succeeded( );
+						break;
+					}
+					if( pending.size( ) < before ) {
+						// only back off (and give up) when nothing is getting through
+						attempt.progressed( );
 						continue;
 					}
-					if( items[i].action( ) != REPLACE ) {
-						PyObject *a = py_string( items[i].action_string( ) );
-						PyDict_SetItemString( t, "Action", a );
-						Py_DECREF( a );
+					if( !attempt.again( RETRY_THROTTLED ) ) {
+						fprintf( stderr, "gave up on %d unprocessed items in table \"%.*s\"\n", (int) pending.size( ), SIZED_STRING(*j.db) );
+						break;
 					}
-					
-					PyObject *v = PyList_New( (Py_ssize_t) f );
-					for( size_t j = 0; j < f; ++ j ) {
-						const string_t &s = items[i]._list( )[j];
-						if( s.size( ) > 0 ) {
-							PyList_SET_ITEM( v, j, py_string( s ) );
-						}
+				}
+				
+				pthread_mutex_lock( &j.mutex );
+				j.written += (end - start) - pending.size( );
+				pthread_mutex_unlock( &j.mutex );
+			}
+			return NULL;
+		}
+		
+		static size_t batch_write( const const_string_t &db, const write_list_t &requests, const int inFlight ) _noexcept {
+			/* for each group of up to 25 requests (up to inFlight groups at once):
+			 *   while the group has requests:
+			 *     batch_write_item( group ), group = unprocessed items
+			 *     (backing off as the retry policy says while none get through)
+			 */
+			
+			if( requests.size( ) == 0 ) {
+				return 0;
+			}
+			
+			string_t keyName;
+			if( unlikely( !hash_key_name( db, keyName ) ) ) {
+				return 0;
+			}
+			
+			write_job job;
+			job.owner = &current_client( );
+			job.db = &db;
+			job.keyName = &keyName;
+			job.requests = &requests[0];
+			job.count = requests.size( );
+			job.next = 0;
+			job.written = 0;
+			pthread_mutex_init( &job.mutex, NULL );
+			
+#if BOTOC_THREADSAFE
+			// this thread is one of the workers
+			const size_t groups = (job.count + MAX_BATCH_WRITE - 1) / MAX_BATCH_WRITE;
+			const size_t helpers = std::min( groups, (size_t) ((inFlight > 1) ? inFlight : 1) ) - 1;
+			std::vector<pthread_t> threads;
+			try {
+				threads.reserve( helpers );
+			} catch( ... ) {
+			}
+			for( size_t i = 0; i < helpers && threads.size( ) < threads.capacity( ); ++ i ) {
+				pthread_t t;
+				if( pthread_create( &t, NULL, &write_worker, &job ) != 0 ) {
+					break;
+				}
+				threads.push_back( t );
+			}
+			(void) write_worker( &job );
+			for( size_t i = 0, e = threads.size( ); i < e; ++ i ) {
+				pthread_join( threads[i], NULL );
+			}
+#else
+			(void) inFlight; // Python and the connection can only be used from one thread
+			(void) write_worker( &job );
+#endif
+			
+			pthread_mutex_destroy( &job.mutex );
+			
+			for( size_t i = 0, e = requests.size( ); i < e; ++ i ) {
+				try {
+					cache_invalidate( db, item_key( *requests[i].key ) );
+				} catch( ... ) {
+					clear_cache( );
+					break;
+				}
+			}
+			return job.written;
+		}
+		
+		static size_t batch_put( const const_string_t &db, const item_map_t &records, const int inFlight ) _noexcept {
+			write_list_t requests;
+			try {
+				requests.reserve( records.size( ) );
+				for( item_map_t::const_iterator i = records.begin( ); i != records.end( ); ++ i ) {
+					write_request r;
+					r.key = &i->first;
+					r.items = &i->second;
+					requests.push_back( r );
+				}
+			} catch( ... ) {
+				fprintf( stderr, "batch_put: out of memory\n" );
+				return 0;
+			}
+			return batch_write( db, requests, inFlight );
+		}
+		
+		static size_t batch_delete( const const_string_t &db, const string_list_t &keys, const int inFlight ) _noexcept {
+			// DDB rejects requests which repeat a key
+			string_list_t unique;
+			write_list_t requests;
+			try {
+				unique = keys;
+				std::sort( unique.begin( ), unique.end( ) );
+				unique.erase( std::unique( unique.begin( ), unique.end( ) ), unique.end( ) );
+				requests.reserve( unique.size( ) );
+				for( size_t i = 0, e = unique.size( ); i < e; ++ i ) {
+					write_request r;
+					r.key = &unique[i];
+					r.items = NULL;
+					requests.push_back( r );
+				}
+			} catch( ... ) {
+				fprintf( stderr, "batch_delete: out of memory\n" );
+				return 0;
+			}
+			return batch_write( db, requests, inFlight );
+		}
+		
+		static void *query_worker( void *const prefetch ) _noexcept {
+			query_prefetch &p = *(query_prefetch *) prefetch;
+			client_scope use( *p.owner );
+			pthread_mutex_lock( &p.mutex );
+			while( true ) {
+				while( p.job == NULL && !p.quit ) {
+					pthread_cond_wait( &p.wake, &p.mutex );
+				}
+				if( p.job == NULL ) {
+					break;
+				}
+				query_job &job = *p.job;
+				pthread_mutex_unlock( &p.mutex );
+				query_page( job );
+				pthread_mutex_lock( &p.mutex );
+				p.job = NULL;
+				pthread_cond_signal( &p.done );
+			}
+			pthread_mutex_unlock( &p.mutex );
+			return NULL;
+		}
+		
+		static bool query( const const_string_t &db, const item &hash, const range_condition &condition, const size_t limit, const page_callback callback, void *const context, const bool consistent, const bool forward, const item_list_t *const attributes ) _noexcept {
+			/* start = None
+			 * do:
+			 *   ret = query( ..., exclusive_start_key = start ), start = ret.LastEvaluatedKey
+			 *   callback( ret.Items ) (while the next page is requested)
+			 * while start and fewer than limit items
+			 */
+			
+			if( unlikely( hash.type( ) > BINARY || hash.size( ) == 0 || callback == NULL ) ) {
+				fprintf( stderr, "invalid query for table \"%.*s\"\n", SIZED_STRING(db) );
+				return false;
+			}
+			
+			// two pages: one for the caller, one being fetched
+			query_job jobs[2];
+			for( int i = 0; i < 2; ++ i ) {
+				jobs[i].db = &db;
+				jobs[i].hash = &hash;
+				jobs[i].condition = &condition;
+				jobs[i].attributes = attributes;
+				jobs[i].consistent = consistent;
+				jobs[i].forward = forward;
+				jobs[i].limit = limit;
+				jobs[i].more = false;
+				jobs[i].ok = false;
+			}
+			
+#if BOTOC_THREADSAFE
+			// started when there is a second page to fetch
+			query_prefetch worker;
+			worker.owner = &current_client( );
+			worker.job = NULL;
+			worker.quit = false;
+			pthread_mutex_init( &worker.mutex, NULL );
+			pthread_cond_init( &worker.wake, NULL );
+			pthread_cond_init( &worker.done, NULL );
+			pthread_t thread;
+			bool started = false;
+#endif
+			
+			query_page( jobs[0] );
+			bool ok = true;
+			size_t remaining = limit;
+			for( int current = 0; ; current ^= 1 ) {
+				query_job &job = jobs[current];
+				query_job &next = jobs[current ^ 1];
+				if( unlikely( !job.ok ) ) {
+					ok = false;
+					break;
+				}
+				if( limit > 0 ) {
+					remaining -= std::min( remaining, job.page.size( ) );
+				}
+				bool more = job.more && (limit == 0 || remaining > 0);
+				if( more ) {
+					try {
+						next.start = job.start;
+					} catch( ... ) {
+						fprintf( stderr, "query: out of memory\n" );
+						ok = false;
+						break;
 					}
-					PyObject *o = PyDict_New( );
-					PyDict_SetItemString( o, items[i].type_string( ), v );
-					Py_DECREF( v );
-					PyDict_SetItemString( t, "Value", o );
-					Py_DECREF( o );
-				} else {
-					if( items[i].type( ) == NUMBER && items[i].action( ) == ADD ) {
-						PyObject *a = py_string( "ADD" );
-						PyDict_SetItemString( t, "Action", a );
-						Py_DECREF( a );
+					next.limit = remaining;
+				}
+				
+#if BOTOC_THREADSAFE
+				if( more && !started ) {
+					started = (pthread_create( &thread, NULL, &query_worker, &worker ) == 0);
+				}
+				const bool prefetch = more && started;
+				if( prefetch ) {
+					pthread_mutex_lock( &worker.mutex );
+					worker.job = &next;
+					pthread_cond_signal( &worker.wake );
+					pthread_mutex_unlock( &worker.mutex );
+				}
+#else
+				// Python and the connection can only be used from one thread
+				const bool prefetch = false;
+#endif
+				if( job.page.size( ) > 0 && !callback( job.page, context ) ) {
+					more = false;
+				}
+#if BOTOC_THREADSAFE
+				if( prefetch ) {
+					pthread_mutex_lock( &worker.mutex );
+					while( worker.job != NULL ) {
+						pthread_cond_wait( &worker.done, &worker.mutex );
 					}
-					PyObject *o = PyDict_New( );
-					PyObject *s = py_string( items[i]._value( ) );
-					PyDict_SetItemString( o, items[i].type_string( ), s );
-					Py_DECREF( s );
-					PyDict_SetItemString( t, "Value", o );
-					Py_DECREF( o );
+					pthread_mutex_unlock( &worker.mutex );
+				}
+#endif
+				if( !more ) {
+					break;
+				}
+				if( !prefetch ) {
+					query_page( next );
 				}
-				PyObject *key = py_string( items[i].name( ) );
-				PyDict_SetItem( r, key, t );
-				Py_DECREF( key );
-				Py_DECREF( t );
 			}
-			if( unlikely( py_error( "dict_from_items_update" ) ) ) {
-				py_release( r );
-				return NULL;
+			
+#if BOTOC_THREADSAFE
+			if( started ) {
+				pthread_mutex_lock( &worker.mutex );
+				worker.quit = true;
+				pthread_cond_signal( &worker.wake );
+				pthread_mutex_unlock( &worker.mutex );
+				pthread_join( thread, NULL );
 			}
-			return r;
+			pthread_cond_destroy( &worker.done );
+			pthread_cond_destroy( &worker.wake );
+			pthread_mutex_destroy( &worker.mutex );
+#endif
+			return ok;
 		}
 		
-		static PyObject *list_from_items( const item_list_t &items ) _noexcept {
-			const size_t e = items.size( );
-			PyObject *r = PyList_New( (Py_ssize_t) e );
-			for( size_t i = 0; i < e; ++ i ) {
-				PyObject *key = py_string( items[i].name( ) );
-				PyList_SET_ITEM( r, i, key );
-//				Py_DECREF( key );
+		static bool query( const const_string_t &db, const const_string_t &hash, const range_condition &condition, const size_t limit, const page_callback callback, void *const context, const bool consistent, const bool forward, const item_list_t *const attributes ) _noexcept {
+			try {
+				const item h( string_t( ), hash, STRING );
+				return query( db, h, condition, limit, callback, context, consistent, forward, attributes );
+			} catch( ... ) {
+				return false;
 			}
-			if( unlikely( py_error( "list_from_items" ) ) ) {
-				py_release( r );
-				return NULL;
+		}
+		
+		static void *scan_worker( void *const job ) _noexcept {
+			scan_job &j = *(scan_job *) job;
+			client_scope use( *j.owner );
+			record_list_t page;
+			item_key start;
+			
+			while( true ) {
+				pthread_mutex_lock( &j.mutex );
+				const int segment = j.next ++;
+				bool stop = j.stop || segment >= j.segments;
+				pthread_mutex_unlock( &j.mutex );
+				if( stop ) {
+					break;
+				}
+				
+				start.hash.clear( );
+				start.range.clear( );
+				for( bool more = true; more && !stop; ) {
+					double used = 0.0;
+					const bool ok = scan_page( *j.db, segment, j.segments, j.attributes, start, more, page, used );
+					
+					// pages which arrive after another worker has stopped are dropped
+					pthread_mutex_lock( &j.mutex );
+					stop = j.stop;
+					pthread_mutex_unlock( &j.mutex );
+					const bool keep = ok && !stop && (page.size( ) == 0 || j.callback( page, j.context ));
+					
+					pthread_mutex_lock( &j.mutex );
+					j.ok = j.ok && ok;
+					j.stop = j.stop || !keep;
+					stop = j.stop;
+					j.used += used;
+					// stay under maxUnits per second on average since the start
+					const long long wait = (j.maxUnits > 0.0) ? (long long) (j.used / j.maxUnits * 1000000.0) - (clock_micros( ) - j.started) : 0;
+					pthread_mutex_unlock( &j.mutex );
+					
+					if( more && !stop ) {
+						sleep_micros( wait );
+					}
+				}
 			}
-			return r;
+			return NULL;
 		}
 		
-		static inline bool item_from_dict( PyObject *obj, item &output ) _noexcept {
-			if( obj == NULL ) {
-				return false;
-			}
-			// exactly 1 attribute, but with unknown key, so just fetch an attribute at random
-			PyObject *key; // borrowed
-			PyObject *value; // borrowed
-			Py_ssize_t pos = 0;
-			if( !PyDict_Next( obj, &pos, &key, &value ) ) {
-				fprintf( stderr, "malformed record (no data)\n" );
+		static bool parallel_scan( const const_string_t &db, const int segments, const item_list_t *const attributes, const page_callback callback, void *const context, const double maxUnits ) _noexcept {
+			/* for each segment (one worker each):
+			 *   start = None
+			 *   do:
+			 *     ret = scan( ..., segment, segments, exclusive_start_key = start ), start = ret.LastEvaluatedKey
+			 *     callback( ret.Items )
+			 *     (waiting if more than maxUnits per second have been used)
+			 *   while start
+			 */
+			
+			if( unlikely( segments < 1 || callback == NULL ) ) {
+				fprintf( stderr, "invalid scan for table \"%.*s\"\n", SIZED_STRING(db) );
 				return false;
 			}
 			
-			if( unlikely( !output.set_type( type_from_string( py_cstring( key ) ) ) ) ) {
-				return false;
+			scan_job job;
+			job.owner = &current_client( );
+			job.db = &db;
+			job.attributes = attributes;
+			job.callback = callback;
+			job.context = context;
+			job.segments = segments;
+			job.next = 0;
+			job.maxUnits = maxUnits;
+			job.used = 0.0;
+			job.started = clock_micros( );
+			job.stop = false;
+			job.ok = true;
+			pthread_mutex_init( &job.mutex, NULL );
+			
+#if BOTOC_THREADSAFE
+			// this thread is one of the workers
+			std::vector<pthread_t> threads;
+			try {
+				threads.reserve( (size_t) segments - 1 );
+			} catch( ... ) {
 			}
-			if( unlikely( output.type( ) == UNKNOWN ) ) {
-				fprintf( stderr, "malformed record (unknown type)\n" );
-				return false;
+			for( int i = 1; i < segments && threads.size( ) < threads.capacity( ); ++ i ) {
+				pthread_t t;
+				if( pthread_create( &t, NULL, &scan_worker, &job ) != 0 ) {
+					break;
+				}
+				threads.push_back( t );
 			}
-			if( (output.type( ) & SET) ) {
-				output.clear_items( );
-				
-				const size_t l = (size_t) PyList_Size( value );
-				for( size_t i = 0; i < l; ++ i ) {
-					if( unlikely( !output.add_item( py_cstring( PyList_GET_ITEM( value, i ) ) ) ) ) {
-						output.clear_items( );
-						return false;
+			(void) scan_worker( &job );
+			for( size_t i = 0, e = threads.size( ); i < e; ++ i ) {
+				pthread_join( threads[i], NULL );
+			}
+#else
+			// Python and the connection can only be used from one thread, so
+			// segments are read in turn
+			(void) scan_worker( &job );
+#endif
+			
+			pthread_mutex_destroy( &job.mutex );
+			return job.ok;
+		}
+		
+		static inline cache_state &cache( void ) _noexcept {
+			static cache_state state;
+			return state;
+		}
+		
+		static void client_table( const const_string_t &db, string_t &output ) _throws_bad_alloc {
+			char prefix[48];
+			snprintf( prefix, sizeof( prefix ), "%lu/%lu:", current_client( ).id( ), (unsigned long) db.size( ) );
+			output.append( prefix );
+			output.append( db );
+		}
+		
+		static void cache_key( const const_string_t &db, const item_key &key, string_t &output ) _throws_bad_alloc {
+			// length-prefixed, so that every projection of a key shares this prefix;
+			// key must be valid
+			client_table( db, output );
+			char length[48];
+			snprintf( length, sizeof( length ), "%lu%s:", (unsigned long) key.hash.size( ), key.hash.type_string( ) );
+			output.append( length );
+			output.append( key.hash._value( ) );
+			if( key.has_range( ) ) {
+				snprintf( length, sizeof( length ), "%lu%s:", (unsigned long) key.range.size( ), key.range.type_string( ) );
+				output.append( length );
+				output.append( key.range._value( ) );
+			}
+			output.push_back( ';' );
+		}
+		
+		static size_t cache_bytes( const const_string_t &id, const item_list_t &items ) _noexcept {
+			// roughly what the entry costs in memory
+			size_t bytes = sizeof( cache_entry ) + sizeof( const string_t * ) + id.size( ) + 64;
+			for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+				bytes += sizeof( item ) + items[i].name( ).size( );
+				if( (items[i].type( ) & SET) && items[i].type( ) != UNKNOWN ) {
+					for( size_t j = 0, f = items[i].size( ); j < f; ++ j ) {
+						bytes += sizeof( string_t ) + items[i]._list( )[j].size( );
 					}
+				} else {
+					bytes += items[i].size( );
 				}
-			} else {
-				const char *v = py_cstring( value );
-				if( v == NULL ) {
-					fprintf( stderr, "malformed record (value is not a string)\n" );
-					return false;
+			}
+			return bytes;
+		}
+		
+		static void cache_erase( cache_state &c, const cache_map_t::iterator &entry ) _noexcept {
+			c.bytes -= entry->second.bytes;
+			c.lru.erase( entry->second.used );
+			c.entries.erase( entry );
+		}
+		
+		static bool cache_enabled( void ) _noexcept {
+			cache_state &c = cache( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &c.mutex );
+#endif
+			const bool r = c.maxBytes > 0;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &c.mutex );
+#endif
+			return r;
+		}
+		
+		static bool cache_lookup( const const_string_t &db, const item_key &key, const bool consistent, item_list_t &items, string_t &id, unsigned long &generation ) _noexcept {
+			if( !key.valid( ) ) {
+				return false; // (leaves id empty; the request will be rejected)
+			}
+			cache_state &c = cache( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &c.mutex );
+#endif
+			bool hit = false;
+			if( c.maxBytes > 0 ) {
+				generation = c.generation;
+				try {
+					cache_key( db, key, id );
+					for( size_t i = 0, e = items.size( ); i < e; ++ i ) {
+						id.append( items[i].name( ) );
+						id.push_back( '\0' );
+					}
+				} catch( ... ) {
+					id.clear( );
 				}
-				if( unlikely( !output.set_value( v ) ) ) {
-					return false;
+				if( !consistent && id.size( ) > 0 ) {
+					cache_map_t::iterator entry = c.entries.find( id );
+					if( entry != c.entries.end( ) && entry->second.expires < clock_micros( ) ) {
+						cache_erase( c, entry );
+						entry = c.entries.end( );
+					}
+					if( entry != c.entries.end( ) ) {
+						try {
+							item_list_t copy( entry->second.items );
+							items.swap( copy );
+							hit = true;
+						} catch( ... ) {
+						}
+					}
+					if( hit ) {
+						++ c.stats.hits;
+						c.lru.splice( c.lru.begin( ), c.lru, entry->second.used );
+					} else {
+						++ c.stats.misses;
+					}
 				}
 			}
-			output.set_action( REPLACE );
-			return true;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &c.mutex );
+#endif
+			return hit;
 		}
 		
-		static bool update_from_dict( item_list_t &items, PyObject *ret_items ) _noexcept {
-			if( items.size( ) == 0 ) {
-				PyObject *key; // borrowed
-				PyObject *itm; // borrowed
-				Py_ssize_t i = 0;
-				while( PyDict_Next( ret_items, &i, &key, &itm ) ) {
-					item o( py_cstring( key ) );
-					if( unlikely( !item_from_dict( itm, o ) ) ) {
-						continue;
+		static void cache_store( const const_string_t &id, const item_list_t &items, const unsigned long generation ) _noexcept {
+			const size_t bytes = cache_bytes( id, items );
+			cache_state &c = cache( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &c.mutex );
+#endif
+			// skip results which an update may have made stale while loading
+			if( c.generation == generation && bytes <= c.maxBytes ) {
+				try {
+					cache_map_t::iterator entry = c.entries.find( id );
+					if( entry != c.entries.end( ) ) {
+						cache_erase( c, entry );
 					}
+					entry = c.entries.insert( std::make_pair( id, cache_entry( ) ) ).first;
 					try {
-						items.push_back( o );
+						c.lru.push_front( &entry->first );
 					} catch( ... ) {
-						return false;
+						c.entries.erase( entry );
+						throw;
 					}
+					entry->second.used = c.lru.begin( );
+					entry->second.bytes = bytes;
+					c.bytes += bytes;
+					entry->second.expires = clock_micros( ) + c.ttl;
+					entry->second.items = items;
+				} catch( ... ) {
+					// not cached
 				}
-			} else {
-				for( size_t i = items.size( ); (i --) > 0; ) {
-					PyObject *key = py_string( items[i].name( ) );
-					PyObject *itm = PyDict_GetItem( ret_items, key ); // borrowed
-					Py_DECREF( key );
-					
-					if( !item_from_dict( itm, items[i] ) ) {
-						items.erase( items.begin( ) + (std::ptrdiff_t) i );
-						continue;
+				while( c.bytes > c.maxBytes && !c.lru.empty( ) ) {
+					cache_erase( c, c.entries.find( *c.lru.back( ) ) );
+					++ c.stats.evictions;
+				}
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &c.mutex );
+#endif
+		}
+		
+		static void cache_invalidate( const const_string_t &db, const item_key &key ) _noexcept {
+			if( !key.valid( ) ) {
+				return; // (never sent, so nothing changed)
+			}
+			cache_state &c = cache( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &c.mutex );
+#endif
+			if( c.maxBytes > 0 ) {
+				++ c.generation;
+				try {
+					string_t prefix;
+					cache_key( db, key, prefix );
+					cache_map_t::iterator entry = c.entries.lower_bound( prefix );
+					while( entry != c.entries.end( ) && entry->first.compare( 0, prefix.size( ), prefix ) == 0 ) {
+						cache_erase( c, entry ++ );
 					}
+				} catch( ... ) {
+					// (the generation change still stops stale loads being stored)
+					c.entries.clear( );
+					c.lru.clear( );
+					c.bytes = 0;
 				}
 			}
-			return true;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &c.mutex );
+#endif
 		}
 		
-		static bool update( const const_string_t &db, const const_string_t &key, const item_list_t &items, const item_list_t *expected ) _noexcept {
-			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_UpdateItem.html
-			 * ret = layer1.update_item( [table],
-			 *   {'HashKeyElement':{'S':[key]}},
-			 *   {
-			 *     [attr1]:{'Value':{[T]:[value]}},
-			 *     [attr2]:{'Value':{[TS]:[[value1],[value2]]},'Action':'ADD'}
-			 *   }
-			 * )
-			 * used = ret.ConsumedCapacityUnits
-			 */
-			
-			PyObject *layer1 = prep( );
-			if( unlikely( layer1 == NULL ) ) {
-				return false;
+		static void set_cache( const size_t maxBytes, const double ttlSeconds ) _noexcept {
+			cache_state &c = cache( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &c.mutex );
+#endif
+			c.maxBytes = maxBytes;
+			c.ttl = (long long) (ttlSeconds * 1000000.0);
+			++ c.generation;
+			c.entries.clear( );
+			c.lru.clear( );
+			c.bytes = 0;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &c.mutex );
+#endif
+		}
+		
+		static void clear_cache( void ) _noexcept {
+			cache_state &c = cache( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &c.mutex );
+#endif
+			++ c.generation;
+			c.entries.clear( );
+			c.lru.clear( );
+			c.bytes = 0;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &c.mutex );
+#endif
+		}
+		
+		static void get_cache_stats( cache_stats &stats ) _noexcept {
+			cache_state &c = cache( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &c.mutex );
+#endif
+			stats = c.stats;
+			stats.entries = c.entries.size( );
+			stats.bytes = c.bytes;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &c.mutex );
+#endif
+		}
+		
+		static inline metrics_state &metrics( void ) _noexcept {
+			static metrics_state state;
+			return state;
+		}
+		
+		static metric_failure failure_from_code( const char *const code ) _noexcept {
+			// DDB's __type, or boto's error_code
+			if( code == NULL ) {
+				return FAIL_REQUEST;
 			}
-			
-			PyObject *key_dict = PyDict_New( );
-			PyObject *key_str = py_string( key );
-			PyObject *key_prop = PyDict_New( );
-			PyDict_SetItemString( key_prop, "S", key_str );
-			Py_DECREF( key_str );
-			PyDict_SetItemString( key_dict, "HashKeyElement", key_prop );
-			Py_DECREF( key_prop );
-			
-			PyObject *expect = NULL;
-			if( expected != NULL ) {
-				if( expected->size( ) > 0 ) {
-					expect = dict_from_items_expect( *expected );
+			if( strchr( code, '#' ) != NULL ) {
+				return failure_from_code( strchr( code, '#' ) + 1 );
+			}
+			if( strcmp( code, "ProvisionedThroughputExceededException" ) == 0 || strcmp( code, "ThrottlingException" ) == 0 ) {
+				return FAIL_THROTTLED;
+			}
+			if( strcmp( code, "ConditionalCheckFailedException" ) == 0 ) {
+				return FAIL_CONDITION;
+			}
+			if( strcmp( code, "ValidationException" ) == 0 || strcmp( code, "ResourceNotFoundException" ) == 0 ) {
+				return FAIL_INVALID;
+			}
+			return FAIL_REQUEST;
+		}
+		
+		static void metrics_record( const metric_event &event ) _noexcept {
+			metrics_state &m = metrics( );
+			int bucket = 0;
+			while( bucket < METRIC_BUCKETS - 1 && event.micros >= (1LL << bucket) ) {
+				++ bucket;
+			}
+			const bool write = (event.op == OP_UPDATE || event.op == OP_BATCH_WRITE);
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &m.mutex );
+#endif
+			op_metrics &o = m.totals.ops[event.op];
+			++ o.requests;
+			o.micros += event.micros;
+			if( event.micros > o.maxMicros ) {
+				o.maxMicros = event.micros;
+			}
+			++ o.latency[bucket];
+			if( !event.ok ) {
+				++ o.failures;
+				++ m.totals.failures[event.failure];
+			}
+			try {
+				table_metrics_map_t::iterator t = m.totals.tables.find( *event.table );
+				if( t == m.totals.tables.end( ) ) {
+					const table_metrics blank = { 0, 0.0, 0.0, 0 };
+					t = m.totals.tables.insert( std::make_pair( *event.table, blank ) ).first;
 				}
+				++ t->second.requests;
+				(write ? t->second.writeUnits : t->second.readUnits) += event.units;
+				t->second.waitMicros += event.waited;
+			} catch( ... ) {
+				// only the table's totals are lost
 			}
-			
-			PyObject *ret = py_callfunc( layer1, "update_item",
-				"", py_string( db ),
-				"", key_dict,
-				"", dict_from_items_update( items ),
-				(expect != NULL) ? "expected" : "-", expect,
-			NULL );
-			
-			if( unlikely( ret == NULL ) ) {
-				return false;
+			const metrics_sink sink = m.sink;
+			void *const context = m.sinkContext;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &m.mutex );
+#endif
+			if( sink != NULL ) {
+				sink( event, context );
 			}
-			
-			PyObject *cap = PyDict_GetItemString( ret, "ConsumedCapacityUnits" ); // borrowed
-			if( unlikely( cap == NULL ) ) {
-				fprintf( stderr, "bad response when saving record in table \"%.*s\"\n", SIZED_STRING(db) );
-				Py_DECREF( ret );
-				return false;
+		}
+		
+		static bool get_metrics( metrics_snapshot &output ) _noexcept {
+			metrics_state &m = metrics( );
+			bool ok = true;
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &m.mutex );
+#endif
+			try {
+				output = m.totals;
+			} catch( ... ) {
+				fprintf( stderr, "out of memory when copying metrics\n" );
+				ok = false;
 			}
-			fprintf( stderr, "saved record, used %f capacity units\n", PyFloat_AsDouble( cap ) );
-			Py_DECREF( ret );
-			return true;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &m.mutex );
+#endif
+			return ok;
 		}
 		
-		static bool get( const const_string_t &db, const const_string_t &key, bool consistent, item_list_t &items ) _noexcept {
-			/* http://docs.amazonwebservices.com/amazondynamodb/latest/developerguide/API_GetItem.html
-			 * layer1.get_item( [database_name], {'HashKeyElement':{'S':[key]}} )
-			 */
-			
-			PyObject *layer1 = prep( );
-			if( unlikely( layer1 == NULL ) ) {
+		static void reset_metrics( void ) _noexcept {
+			metrics_state &m = metrics( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &m.mutex );
+#endif
+			memset( m.totals.ops, 0, sizeof( m.totals.ops ) );
+			memset( m.totals.failures, 0, sizeof( m.totals.failures ) );
+			m.totals.tables.clear( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &m.mutex );
+#endif
+		}
+		
+		static void set_metrics_sink( const metrics_sink sink, void *const context ) _noexcept {
+			metrics_state &m = metrics( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &m.mutex );
+#endif
+			m.sink = sink;
+			m.sinkContext = context;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &m.mutex );
+#endif
+		}
+		
+		static void log_metric( const metric_event &event, void * ) _noexcept {
+			if( event.ok ) {
+				fprintf( stderr, "%s on table \"%.*s\": %d records, used %f capacity units (%lld us)\n", string_from_op( event.op ), SIZED_STRING(*event.table), (int) event.records, event.units, event.micros );
+			} else {
+				fprintf( stderr, "%s on table \"%.*s\" failed (%s, %lld us)\n", string_from_op( event.op ), SIZED_STRING(*event.table), string_from_failure( event.failure ), event.micros );
+			}
+		}
+		
+		static inline limiter_state &limiter( void ) _noexcept {
+			static limiter_state state;
+			return state;
+		}
+		
+		static rate_bucket *rate_find( limiter_state &l, const metric_op op, const string_t &id ) _noexcept {
+			const rate_map_t::iterator t = l.tables.find( id );
+			if( t == l.tables.end( ) ) {
+				return NULL;
+			}
+			rate_bucket *const b = (op == OP_UPDATE || op == OP_BATCH_WRITE) ? &t->second.write : &t->second.read;
+			return (b->rate > 0.0) ? b : NULL;
+		}
+		
+		static bool rate_wait( const metric_op op, const const_string_t &db, const double units, long long &waited ) _noexcept {
+			waited = 0;
+			limiter_state &l = limiter( );
+			if( likely( __sync_fetch_and_add( &l.limited, (size_t) 0 ) == 0 ) || op == OP_DESCRIBE ) {
 				return false;
 			}
-			
-			PyObject *key_dict = PyDict_New( );
-			PyObject *key_str = py_string( key );
-			PyObject *key_prop = PyDict_New( );
-			PyDict_SetItemString( key_prop, "S", key_str );
-			Py_DECREF( key_str );
-			PyDict_SetItemString( key_dict, "HashKeyElement", key_prop );
-			Py_DECREF( key_prop );
-			
-			PyObject *ret = py_callfunc( layer1, "get_item",
-				"", py_string( db ),
-				"", key_dict,
-				"attributes_to_get", list_from_items( items ),
-				"consistent_read", py_boolean( consistent ),
-			NULL );
-			
-			if( unlikely( ret == NULL ) ) {
+			string_t id;
+			try {
+				client_table( db, id );
+			} catch( ... ) {
 				return false;
 			}
-			
-			PyObject *cap = PyDict_GetItemString( ret, "ConsumedCapacityUnits" ); // borrowed
-			PyObject *ret_items = PyDict_GetItemString( ret, "Item" ); // borrowed
-			if( unlikely( ret_items == NULL ) ) {
-				fprintf( stderr, "failed to load record items from table \"%.*s\"\n", SIZED_STRING(db) );
-				Py_DECREF( ret );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &l.mutex );
+#endif
+			long long wait = 0;
+			rate_bucket *const b = rate_find( l, op, id );
+			if( b != NULL ) {
+				// refill, then queue behind anything already waiting
+				const long long now = clock_micros( );
+				b->tokens += (double) (now - b->updated) * b->rate / 1000000.0;
+				if( b->tokens > b->burst ) {
+					b->tokens = b->burst;
+				}
+				b->updated = now;
+				b->tokens -= units;
+				if( b->tokens < 0.0 ) {
+					wait = (long long) (-b->tokens / b->rate * 1000000.0);
+				}
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &l.mutex );
+#endif
+			if( wait > 0 ) {
+				sleep_micros( wait );
+				waited = wait;
+			}
+			return b != NULL;
+		}
+		
+		static void rate_refund( const metric_op op, const const_string_t &db, const double units ) _noexcept {
+			limiter_state &l = limiter( );
+			string_t id;
+			try {
+				client_table( db, id );
+			} catch( ... ) {
+				return;
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &l.mutex );
+#endif
+			rate_bucket *const b = rate_find( l, op, id );
+			if( b != NULL ) {
+				b->tokens += units;
+				if( b->tokens > b->burst ) {
+					b->tokens = b->burst;
+				}
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &l.mutex );
+#endif
+		}
+		
+		static bool set_rate_limit( const const_string_t &db, const double readUnits, const double writeUnits, const double burstSeconds ) _noexcept {
+			limiter_state &l = limiter( );
+			string_t id;
+			try {
+				client_table( db, id );
+			} catch( ... ) {
+				fprintf( stderr, "out of memory when setting the rate limit for table \"%.*s\"\n", SIZED_STRING(db) );
 				return false;
 			}
-			if( unlikely( cap == NULL ) ) {
-				fprintf( stderr, "loaded record, but capacity units used is unknown\n" );
+			bool ok = true;
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &l.mutex );
+#endif
+			if( readUnits <= 0.0 && writeUnits <= 0.0 ) {
+				l.tables.erase( id );
 			} else {
-				fprintf( stderr, "loaded record, used %f capacity units\n", PyFloat_AsDouble( cap ) );
+				try {
+					const long long now = clock_micros( );
+					rate_limit &r = l.tables[id];
+					r.read.rate = (readUnits > 0.0) ? readUnits : 0.0;
+					r.write.rate = (writeUnits > 0.0) ? writeUnits : 0.0;
+					r.read.burst = r.read.rate * burstSeconds;
+					r.write.burst = r.write.rate * burstSeconds;
+					r.read.tokens = r.read.burst;
+					r.write.tokens = r.write.burst;
+					r.read.updated = now;
+					r.write.updated = now;
+				} catch( ... ) {
+					fprintf( stderr, "out of memory when setting the rate limit for table \"%.*s\"\n", SIZED_STRING(db) );
+					ok = false;
+				}
 			}
-			
-			if( unlikely( !update_from_dict( items, ret_items ) ) ) {
-				fprintf( stderr, "out of memory when loading items from table \"%.*s\"\n", SIZED_STRING(db) );
-				Py_DECREF( ret );
-				return false;
+			(void) __sync_lock_test_and_set( &l.limited, l.tables.size( ) );
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &l.mutex );
+#endif
+			return ok;
+		}
+		
+		static void clear_rate_limits( void ) _noexcept {
+			limiter_state &l = limiter( );
+			char id[24];
+			snprintf( id, sizeof( id ), "%lu/", current_client( ).id( ) );
+			string_t prefix;
+			try {
+				prefix.assign( id );
+			} catch( ... ) {
+				return;
 			}
-			Py_DECREF( ret );
-			return true;
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( &l.mutex );
+#endif
+			rate_map_t::iterator i = l.tables.lower_bound( prefix );
+			while( i != l.tables.end( ) && i->first.compare( 0, prefix.size( ), prefix ) == 0 ) {
+				l.tables.erase( i ++ );
+			}
+			(void) __sync_lock_test_and_set( &l.limited, l.tables.size( ) );
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( &l.mutex );
+#endif
 		}
 		
-		static inline void disconnect( void ) _noexcept {
-			(void) prep( true );
+		static inline retry_state &retries( void ) _noexcept {
+			return current_client( ).retries( SLOT_DDB );
+		}
+		
+		static inline connection_pool &connections( void ) _noexcept {
+			return current_client( ).pool( SLOT_DDB );
+		}
+		
+		static void set_retry_policy( const retry_policy &policy ) _noexcept {
+			retry_configure( retries( ), policy );
+		}
+		
+		static void get_retry_stats( retry_stats &stats ) _noexcept {
+			retry_snapshot( retries( ), stats );
+		}
+		
+		static void set_pool_policy( const pool_policy &policy ) _noexcept {
+			connections( ).set_policy( policy );
+		}
+		
+		static void get_pool_stats( pool_stats &stats ) _noexcept {
+			connections( ).get_stats( stats );
+		}
+		
+		static long long metric_percentile( const op_metrics &op, const double fraction ) _noexcept {
+			if( op.requests == 0 ) {
+				return 0;
+			}
+			const double target = fraction * (double) op.requests;
+			unsigned long long seen = 0;
+			for( int i = 0; i < METRIC_BUCKETS - 1; ++ i ) {
+				seen += op.latency[i];
+				if( (double) seen >= target ) {
+					return ((1LL << i) < op.maxMicros) ? (1LL << i) : op.maxMicros;
+				}
+			}
+			return op.maxMicros;
 		}
 	}
 }
@@ -0,0 +1,997 @@
+// botoc_native.h: request signing, HTTP and data formats for the native backend
+// Copyright 2013, Poikos Ltd.
+// Author: David Evans
+
+// only used when BOTOC_NATIVE is 1 (see botoc_common.h); included automatically
+// by botoc_sqs.h and botoc_ddb.h
+
+// requests are sent over plain HTTP (port 80 by default), signed with AWS
+// Signature Version 4. TLS is not supported, so nothing is sent until
+// set_endpoint names a TLS-terminating proxy or test server, unless
+// BOTOC_NATIVE_ALLOW_HTTP is set (see botoc_common.h).
+
+#ifndef BOTOC_NATIVE_H_INCLUDED__
+#define BOTOC_NATIVE_H_INCLUDED__
+
+#include "botoc_common.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace botoc {
+	namespace native {
+		/* constants */
+		
+		enum limits {
+			SOCKET_TIMEOUT_SECONDS = 60 // longer than the longest SQS long-poll
+		};
+		
+		/* types */
+		
+		struct sha256_state {
+			uint32_t h[8];
+			unsigned char block[64];
+			size_t used;
+			unsigned long long length;
+		};
+		
+		struct http_response {
+			int status;
+			string_t body;
+		};
+		
+		// A keep-alive connection, kept in a client's connection_pool
+		struct pooled_socket {
+			int sock;
+			string_t endpoint;
+		};
+		
+		class json_value {
+		public:
+			enum kind {
+				NONE,
+				BOOLEAN,
+				NUMBER,
+				STRING,
+				ARRAY,
+				OBJECT
+			};
+			
+			kind type;
+			string_t text;               // STRING, NUMBER (as written) and BOOLEAN ("true" / "false")
+			std::vector<string_t> keys;  // OBJECT
+			std::vector<json_value> items; // ARRAY, OBJECT (matching keys)
+			
+			inline json_value( void ) : type( NONE ), text( ), keys( ), items( ) { }
+			
+			__attribute__((pure,warn_unused_result))
+			inline const json_value *get( const char *key ) const _noexcept {
+				if( type != OBJECT ) {
+					return NULL;
+				}
+				for( size_t i = 0, e = keys.size( ); i < e; ++ i ) {
+					if( keys[i] == key ) {
+						return &items[i];
+					}
+				}
+				return NULL;
+			}
+			
+			__attribute__((pure,warn_unused_result))
+			inline double number( void ) const _noexcept {
+				return (type == NUMBER) ? strtod( text.c_str( ), NULL ) : 0.0;
+			}
+		};
+		
+		/* globals */
+		
+		static string_t sqs_endpoint; // host[:port]; empty for [region].queue.amazonaws.com
+		static string_t ddb_endpoint; // host[:port]; empty for dynamodb.[region].amazonaws.com
+		
+		/* prototypes */
+		
+		// Configuration
+		__attribute__((warn_unused_result,unused))
+		static inline bool set_endpoint( const const_string_t &service, const const_string_t &endpoint ) _noexcept;
+		
+		// Whether [operation] may go to the public AWS endpoint over plain HTTP
+		__attribute__((warn_unused_result,unused))
+		static inline bool allow_http( const char *operation ) _noexcept;
+		
+		// Hashing
+		__attribute__((unused))
+		static void sha256_init( sha256_state &s ) _noexcept;
+		
+		__attribute__((unused))
+		static void sha256_update( sha256_state &s, const void *data, size_t length ) _noexcept;
+		
+		__attribute__((unused))
+		static void sha256_final( sha256_state &s, unsigned char digest[32] ) _noexcept;
+		
+		__attribute__((unused))
+		static void hmac_sha256( const void *key, size_t keyLength, const void *data, size_t length, unsigned char digest[32] ) _noexcept;
+		
+		__attribute__((unused))
+		static void hex( const unsigned char *data, size_t length, string_t &output ) _throws_bad_alloc;
+		
+		// Signing
+		__attribute__((warn_unused_result,unused))
+		static bool sign( const char *method, const const_string_t &path, const const_string_t &query, const string_list_t &headers, const const_string_t &payload, const char *service, const const_string_t &amzDate, string_t &authorization ) _noexcept;
+		
+		// Encoding
+		__attribute__((unused))
+		static void uri_encode( string_t &output, const const_string_t &value, bool keepSlash = false ) _throws_bad_alloc;
+		
+		__attribute__((unused))
+		static void form_param( string_t &output, const char *name, const const_string_t &value ) _throws_bad_alloc;
+		
+		__attribute__((unused))
+		static void json_string( string_t &output, const char *value, size_t length ) _throws_bad_alloc;
+		
+		__attribute__((unused))
+		static void json_string( string_t &output, const const_string_t &value ) _throws_bad_alloc;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool json_parse( const const_string_t &text, json_value &output ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool xml_find( const const_string_t &xml, const char *tag, size_t &pos, size_t end, size_t &first, size_t &last ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool xml_value( const const_string_t &xml, const char *tag, size_t &pos, size_t end, string_t &output ) _noexcept;
+		
+		// HTTP (sent over one of pool's connections)
+		__attribute__((warn_unused_result,unused))
+		static bool request( connection_pool &pool, const const_string_t &endpoint, const char *service, const const_string_t &path, const char *contentType, const char *target, const const_string_t &payload, http_response &response ) _noexcept;
+		
+		/* internal prototypes */
+		
+		__attribute__((warn_unused_result))
+		static bool json_parse_value( const char *&p, const char *end, json_value &output, int depth ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static int http_connect( const const_string_t &host, const char *port ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool http_exchange( int sock, const const_string_t &message, http_response &response, bool &keepAlive ) _noexcept;
+		
+		// (connection_type functions for pooled_socket)
+		static void close_socket( void *connection ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool check_socket( void *connection ) _noexcept;
+		
+		/* implementation */
+		
+		// Configuration
+		static inline bool set_endpoint( const const_string_t &service, const const_string_t &endpoint ) _noexcept {
+			try {
+				if( service == "sqs" ) {
+					sqs_endpoint.assign( endpoint );
+				} else if( service == "dynamodb" ) {
+					ddb_endpoint.assign( endpoint );
+				} else {
+					fprintf( stderr, "unknown service %.*s\n", SIZED_STRING(service) );
+					return false;
+				}
+			} catch( ... ) {
+				return false;
+			}
+			return true;
+		}
+		
+		static inline bool allow_http( const char *const operation ) _noexcept {
+#if BOTOC_NATIVE_ALLOW_HTTP
+			(void) operation;
+			return true;
+#else
+			fprintf( stderr, "%s: no endpoint set; refusing to send to AWS over plain HTTP (call botoc::native::set_endpoint or define BOTOC_NATIVE_ALLOW_HTTP)\n", operation );
+			return false;
+#endif
+		}
+		
+		// Hashing
+		static void sha256_init( sha256_state &s ) _noexcept {
+			s.h[0] = 0x6a09e667; s.h[1] = 0xbb67ae85; s.h[2] = 0x3c6ef372; s.h[3] = 0xa54ff53a;
+			s.h[4] = 0x510e527f; s.h[5] = 0x9b05688c; s.h[6] = 0x1f83d9ab; s.h[7] = 0x5be0cd19;
+			s.used = 0;
+			s.length = 0;
+		}
+
+#define ROTR32(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+		static void sha256_block( uint32_t h[8], const unsigned char *const b ) _noexcept {
+			static const uint32_t k[64] = {
+				0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+				0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+				0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+				0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+				0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+				0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+				0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+				0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+			};
+			uint32_t w[64];
+			for( int i = 0; i < 16; ++ i ) {
+				w[i] = ((uint32_t) b[i*4] << 24) | ((uint32_t) b[i*4+1] << 16) | ((uint32_t) b[i*4+2] << 8) | (uint32_t) b[i*4+3];
+			}
+			for( int i = 16; i < 64; ++ i ) {
+				const uint32_t s0 = ROTR32( w[i-15], 7 ) ^ ROTR32( w[i-15], 18 ) ^ (w[i-15] >> 3);
+				const uint32_t s1 = ROTR32( w[i-2], 17 ) ^ ROTR32( w[i-2], 19 ) ^ (w[i-2] >> 10);
+				w[i] = w[i-16] + s0 + w[i-7] + s1;
+			}
+			uint32_t a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+			for( int i = 0; i < 64; ++ i ) {
+				const uint32_t t1 = hh + (ROTR32( e, 6 ) ^ ROTR32( e, 11 ) ^ ROTR32( e, 25 )) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+				const uint32_t t2 = (ROTR32( a, 2 ) ^ ROTR32( a, 13 ) ^ ROTR32( a, 22 )) + ((a & bb) ^ (a & c) ^ (bb & c));
+				hh = g; g = f; f = e; e = d + t1;
+				d = c; c = bb; bb = a; a = t1 + t2;
+			}
+			h[0] += a; h[1] += bb; h[2] += c; h[3] += d;
+			h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+		}
+#undef ROTR32
+		
+		static void sha256_update( sha256_state &s, const void *const data, size_t length ) _noexcept {
+			const unsigned char *d = (const unsigned char *) data;
+			s.length += length;
+			if( s.used > 0 ) {
+				const size_t n = (length < 64 - s.used) ? length : (64 - s.used);
+				memcpy( s.block + s.used, d, n );
+				s.used += n;
+				d += n;
+				length -= n;
+				if( s.used < 64 ) {
+					return;
+				}
+				sha256_block( s.h, s.block );
+				s.used = 0;
+			}
+			for( ; length >= 64; d += 64, length -= 64 ) {
+				sha256_block( s.h, d );
+			}
+			memcpy( s.block, d, length );
+			s.used = length;
+		}
+		
+		static void sha256_final( sha256_state &s, unsigned char digest[32] ) _noexcept {
+			const unsigned long long bits = s.length * 8ull;
+			s.block[s.used ++] = 0x80;
+			if( s.used > 56 ) {
+				memset( s.block + s.used, 0, 64 - s.used );
+				sha256_block( s.h, s.block );
+				s.used = 0;
+			}
+			memset( s.block + s.used, 0, 56 - s.used );
+			for( int i = 0; i < 8; ++ i ) {
+				s.block[56 + i] = (unsigned char) (bits >> (56 - i * 8));
+			}
+			sha256_block( s.h, s.block );
+			for( int i = 0; i < 8; ++ i ) {
+				digest[i*4  ] = (unsigned char) (s.h[i] >> 24);
+				digest[i*4+1] = (unsigned char) (s.h[i] >> 16);
+				digest[i*4+2] = (unsigned char) (s.h[i] >> 8);
+				digest[i*4+3] = (unsigned char) s.h[i];
+			}
+		}
+		
+		static void hmac_sha256( const void *key, size_t keyLength, const void *const data, const size_t length, unsigned char digest[32] ) _noexcept {
+			unsigned char k[64];
+			unsigned char pad[64];
+			sha256_state s;
+			memset( k, 0, 64 );
+			if( keyLength > 64 ) {
+				sha256_init( s );
+				sha256_update( s, key, keyLength );
+				sha256_final( s, k );
+			} else {
+				memcpy( k, key, keyLength );
+			}
+			for( int i = 0; i < 64; ++ i ) {
+				pad[i] = k[i] ^ 0x36;
+			}
+			sha256_init( s );
+			sha256_update( s, pad, 64 );
+			sha256_update( s, data, length );
+			sha256_final( s, digest );
+			for( int i = 0; i < 64; ++ i ) {
+				pad[i] = k[i] ^ 0x5c;
+			}
+			sha256_init( s );
+			sha256_update( s, pad, 64 );
+			sha256_update( s, digest, 32 );
+			sha256_final( s, digest );
+		}
+		
+		static void hex( const unsigned char *const data, const size_t length, string_t &output ) _throws_bad_alloc {
+			static const char digits[] = "0123456789abcdef";
+			output.reserve( output.size( ) + length * 2 );
+			for( size_t i = 0; i < length; ++ i ) {
+				output.push_back( digits[data[i] >> 4] );
+				output.push_back( digits[data[i] & 15] );
+			}
+		}
+		
+		// Signing
+		static bool sign( const char *const method, const const_string_t &path, const const_string_t &query, const string_list_t &headers, const const_string_t &payload, const char *const service, const const_string_t &amzDate, string_t &authorization ) _noexcept {
+			/* http://docs.aws.amazon.com/general/latest/gr/sigv4_signing.html
+			 * headers are "name:value" pairs, already lower-case and sorted by name
+			 * (signed with the current client's credentials and region)
+			 */
+			
+			const client &c = current_client( );
+			unsigned char digest[32];
+			sha256_state s;
+			try {
+				string_t canonical( method );
+				canonical.push_back( '\n' );
+				canonical.append( path );
+				canonical.push_back( '\n' );
+				canonical.append( query );
+				canonical.push_back( '\n' );
+				string_t signedHeaders;
+				for( size_t i = 0, e = headers.size( ); i < e; ++ i ) {
+					canonical.append( headers[i] );
+					canonical.push_back( '\n' );
+					if( i > 0 ) {
+						signedHeaders.push_back( ';' );
+					}
+					signedHeaders.append( headers[i], 0, headers[i].find( ':' ) );
+				}
+				canonical.push_back( '\n' );
+				canonical.append( signedHeaders );
+				canonical.push_back( '\n' );
+				sha256_init( s );
+				sha256_update( s, payload.data( ), payload.size( ) );
+				sha256_final( s, digest );
+				hex( digest, 32, canonical );
+				
+				const string_t date( amzDate, 0, 8 );
+				string_t scope( date );
+				scope.push_back( '/' );
+				scope.append( c.region( ) );
+				scope.push_back( '/' );
+				scope.append( service );
+				scope.append( "/aws4_request" );
+				
+				string_t toSign( "AWS4-HMAC-SHA256\n" );
+				toSign.append( amzDate );
+				toSign.push_back( '\n' );
+				toSign.append( scope );
+				toSign.push_back( '\n' );
+				sha256_init( s );
+				sha256_update( s, canonical.data( ), canonical.size( ) );
+				sha256_final( s, digest );
+				hex( digest, 32, toSign );
+				
+				string_t key( "AWS4" );
+				key.append( c.secret( ) );
+				hmac_sha256( key.data( ), key.size( ), date.data( ), date.size( ), digest );
+				hmac_sha256( digest, 32, c.region( ).data( ), c.region( ).size( ), digest );
+				hmac_sha256( digest, 32, service, strlen( service ), digest );
+				hmac_sha256( digest, 32, "aws4_request", 12, digest );
+				hmac_sha256( digest, 32, toSign.data( ), toSign.size( ), digest );
+				
+				authorization.assign( "AWS4-HMAC-SHA256 Credential=" );
+				authorization.append( c.key( ) );
+				authorization.push_back( '/' );
+				authorization.append( scope );
+				authorization.append( ", SignedHeaders=" );
+				authorization.append( signedHeaders );
+				authorization.append( ", Signature=" );
+				hex( digest, 32, authorization );
+			} catch( ... ) {
+				fprintf( stderr, "sign: out of memory\n" );
+				return false;
+			}
+			return true;
+		}
+		
+		// Encoding
+		static void uri_encode( string_t &output, const const_string_t &value, const bool keepSlash ) _throws_bad_alloc {
+			static const char digits[] = "0123456789ABCDEF";
+			for( size_t i = 0, e = value.size( ); i < e; ++ i ) {
+				const unsigned char c = (unsigned char) value[i];
+				if( (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+					c == '-' || c == '_' || c == '.' || c == '~' || (keepSlash && c == '/') ) {
+					output.push_back( (char) c );
+				} else {
+					output.push_back( '%' );
+					output.push_back( digits[c >> 4] );
+					output.push_back( digits[c & 15] );
+				}
+			}
+		}
+		
+		static void form_param( string_t &output, const char *const name, const const_string_t &value ) _throws_bad_alloc {
+			if( output.size( ) > 0 ) {
+				output.push_back( '&' );
+			}
+			output.append( name );
+			output.push_back( '=' );
+			uri_encode( output, value );
+		}
+		
+		static void json_string( string_t &output, const char *const value, const size_t length ) _throws_bad_alloc {
+			static const char digits[] = "0123456789abcdef";
+			output.push_back( '"' );
+			for( size_t i = 0; i < length; ++ i ) {
+				const unsigned char c = (unsigned char) value[i];
+				if( c == '"' || c == '\\' ) {
+					output.push_back( '\\' );
+					output.push_back( (char) c );
+				} else if( c < 0x20 ) {
+					output.append( "\\u00" );
+					output.push_back( digits[c >> 4] );
+					output.push_back( digits[c & 15] );
+				} else {
+					output.push_back( (char) c );
+				}
+			}
+			output.push_back( '"' );
+		}
+		
+		static void json_string( string_t &output, const const_string_t &value ) _throws_bad_alloc {
+			json_string( output, value.data( ), value.size( ) );
+		}
+		
+		static bool json_parse_string( const char *&p, const char *const end, string_t &output ) _noexcept {
+			// p is just after the opening quote
+			output.clear( );
+			try {
+				while( p < end && *p != '"' ) {
+					if( *p != '\\' ) {
+						const char *q = p;
+						while( q < end && *q != '"' && *q != '\\' ) {
+							++ q;
+						}
+						output.append( p, (size_t) (q - p) );
+						p = q;
+						continue;
+					}
+					if( ++ p >= end ) {
+						return false;
+					}
+					switch( *p ) {
+						case 'b': output.push_back( '\b' ); break;
+						case 'f': output.push_back( '\f' ); break;
+						case 'n': output.push_back( '\n' ); break;
+						case 'r': output.push_back( '\r' ); break;
+						case 't': output.push_back( '\t' ); break;
+						case 'u': {
+							unsigned long c = 0;
+							for( int n = 0; n < 2; ++ n ) {
+								if( p + 4 >= end ) {
+									return false;
+								}
+								char h[5] = { p[1], p[2], p[3], p[4], '\0' };
+								const unsigned long u = strtoul( h, NULL, 16 );
+								p += 4;
+								if( n == 0 && u >= 0xd800 && u < 0xdc00 && p + 2 < end && p[1] == '\\' && p[2] == 'u' ) {
+									c = u; // high surrogate; combine with the next escape
+									p += 2;
+									continue;
+								}
+								c = (n == 0) ? u : (0x10000 + ((c - 0xd800) << 10) + (u - 0xdc00));
+								break;
+							}
+							if( c < 0x80 ) {
+								output.push_back( (char) c );
+							} else if( c < 0x800 ) {
+								output.push_back( (char) (0xc0 | (c >> 6)) );
+								output.push_back( (char) (0x80 | (c & 0x3f)) );
+							} else if( c < 0x10000 ) {
+								output.push_back( (char) (0xe0 | (c >> 12)) );
+								output.push_back( (char) (0x80 | ((c >> 6) & 0x3f)) );
+								output.push_back( (char) (0x80 | (c & 0x3f)) );
+							} else {
+								output.push_back( (char) (0xf0 | (c >> 18)) );
+								output.push_back( (char) (0x80 | ((c >> 12) & 0x3f)) );
+								output.push_back( (char) (0x80 | ((c >> 6) & 0x3f)) );
+								output.push_back( (char) (0x80 | (c & 0x3f)) );
+							}
+							break;
+						}
+						default: output.push_back( *p ); break; // " \ /
+					}
+					++ p;
+				}
+			} catch( ... ) {
+				return false;
+			}
+			if( p >= end ) {
+				return false;
+			}
+			++ p;
+			return true;
+		}
+		
+		static bool json_parse_value( const char *&p, const char *const end, json_value &output, const int depth ) _noexcept {
+			while( p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') ) {
+				++ p;
+			}
+			if( unlikely( p >= end || depth > 64 ) ) {
+				return false;
+			}
+			try {
+				switch( *p ) {
+					case '{':
+					case '[': {
+						const bool object = (*p == '{');
+						const char close = object ? '}' : ']';
+						output.type = object ? json_value::OBJECT : json_value::ARRAY;
+						++ p;
+						while( true ) {
+							while( p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ',') ) {
+								++ p;
+							}
+							if( p >= end ) {
+								return false;
+							}
+							if( *p == close ) {
+								++ p;
+								return true;
+							}
+							if( object ) {
+								if( *p != '"' ) {
+									return false;
+								}
+								++ p;
+								output.keys.push_back( string_t( ) );
+								if( !json_parse_string( p, end, output.keys.back( ) ) ) {
+									return false;
+								}
+								while( p < end && *p != ':' ) {
+									++ p;
+								}
+								++ p;
+							}
+							output.items.push_back( json_value( ) );
+							if( !json_parse_value( p, end, output.items.back( ), depth + 1 ) ) {
+								return false;
+							}
+						}
+					}
+					case '"':
+						output.type = json_value::STRING;
+						++ p;
+						return json_parse_string( p, end, output.text );
+					case 't':
+					case 'f':
+					case 'n': {
+						const char *q = p;
+						while( q < end && *q >= 'a' && *q <= 'z' ) {
+							++ q;
+						}
+						output.text.assign( p, (size_t) (q - p) );
+						p = q;
+						if( output.text == "null" ) {
+							output.type = json_value::NONE;
+							output.text.clear( );
+							return true;
+						}
+						output.type = json_value::BOOLEAN;
+						return output.text == "true" || output.text == "false";
+					}
+					default: {
+						const char *q = p;
+						while( q < end && (strchr( "+-.eE", *q ) != NULL || (*q >= '0' && *q <= '9')) ) {
+							++ q;
+						}
+						if( q == p ) {
+							return false;
+						}
+						output.type = json_value::NUMBER;
+						output.text.assign( p, (size_t) (q - p) );
+						p = q;
+						return true;
+					}
+				}
+			} catch( ... ) {
+				return false;
+			}
+		}
+		
+		static bool json_parse( const const_string_t &text, json_value &output ) _noexcept {
+			const char *p = text.data( );
+			if( unlikely( !json_parse_value( p, p + text.size( ), output, 0 ) ) ) {
+				fprintf( stderr, "botoc: malformed JSON response\n" );
+				return false;
+			}
+			return true;
+		}
+		
+		static bool xml_find( const const_string_t &xml, const char *const tag, size_t &pos, const size_t end, size_t &first, size_t &last ) _noexcept {
+			/* finds the next <tag>...</tag> between pos and end; its contents are
+			 * xml[first, last). pos is moved past the closing tag.
+			 */
+			
+			const size_t l = strlen( tag );
+			size_t a = pos;
+			while( true ) {
+				a = xml.find( tag, a, l );
+				if( a == string_t::npos || a + l >= end ) {
+					return false;
+				}
+				if( a > 0 && xml[a-1] == '<' && xml[a+l] == '>' ) {
+					break;
+				}
+				a += l;
+			}
+			a += l + 1;
+			size_t b = a;
+			while( true ) {
+				b = xml.find( tag, b, l );
+				if( b == string_t::npos || b + l >= end ) {
+					return false;
+				}
+				if( xml[b-2] == '<' && xml[b-1] == '/' && xml[b+l] == '>' ) {
+					break;
+				}
+				b += l;
+			}
+			pos = b + l + 1;
+			first = a;
+			last = b - 2;
+			return true;
+		}
+		
+		static bool xml_value( const const_string_t &xml, const char *const tag, size_t &pos, const size_t end, string_t &output ) _noexcept {
+			/* as xml_find, but stores the (unescaped) contents in output
+			 */
+			
+			size_t a;
+			size_t b;
+			if( !xml_find( xml, tag, pos, end, a, b ) ) {
+				return false;
+			}
+			
+			try {
+				output.clear( );
+				output.reserve( b - a );
+				for( size_t i = a; i < b; ++ i ) {
+					if( xml[i] != '&' ) {
+						output.push_back( xml[i] );
+						continue;
+					}
+					const size_t semi = xml.find( ';', i );
+					if( semi == string_t::npos || semi > b ) {
+						output.push_back( '&' );
+						continue;
+					}
+					const string_t entity( xml, i + 1, semi - i - 1 );
+					if( entity == "amp" ) {
+						output.push_back( '&' );
+					} else if( entity == "lt" ) {
+						output.push_back( '<' );
+					} else if( entity == "gt" ) {
+						output.push_back( '>' );
+					} else if( entity == "quot" ) {
+						output.push_back( '"' );
+					} else if( entity == "apos" ) {
+						output.push_back( '\'' );
+					} else if( entity.size( ) > 1 && entity[0] == '#' ) {
+						const unsigned long c = (entity[1] == 'x') ? strtoul( entity.c_str( ) + 2, NULL, 16 ) : strtoul( entity.c_str( ) + 1, NULL, 10 );
+						if( c < 0x80 ) {
+							output.push_back( (char) c );
+						} else if( c < 0x800 ) {
+							output.push_back( (char) (0xc0 | (c >> 6)) );
+							output.push_back( (char) (0x80 | (c & 0x3f)) );
+						} else {
+							output.push_back( (char) (0xe0 | (c >> 12)) );
+							output.push_back( (char) (0x80 | ((c >> 6) & 0x3f)) );
+							output.push_back( (char) (0x80 | (c & 0x3f)) );
+						}
+					} else {
+						output.append( xml, i, semi - i + 1 );
+					}
+					i = semi;
+				}
+			} catch( ... ) {
+				return false;
+			}
+			return true;
+		}
+		
+		// HTTP
+		static int http_connect( const const_string_t &host, const char *const port ) _noexcept {
+			struct addrinfo hints;
+			memset( &hints, 0, sizeof( hints ) );
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			struct addrinfo *addr = NULL;
+			const int err = getaddrinfo( host.c_str( ), port, &hints, &addr );
+			if( unlikely( err != 0 ) ) {
+				fprintf( stderr, "botoc: could not resolve %.*s: %s\n", SIZED_STRING(host), gai_strerror( err ) );
+				return -1;
+			}
+			int sock = -1;
+			for( struct addrinfo *a = addr; a != NULL; a = a->ai_next ) {
+				sock = socket( a->ai_family, a->ai_socktype, a->ai_protocol );
+				if( sock < 0 ) {
+					continue;
+				}
+				if( connect( sock, a->ai_addr, a->ai_addrlen ) == 0 ) {
+					break;
+				}
+				close( sock );
+				sock = -1;
+			}
+			freeaddrinfo( addr );
+			if( unlikely( sock < 0 ) ) {
+				fprintf( stderr, "botoc: could not connect to %.*s:%s\n", SIZED_STRING(host), port );
+				return -1;
+			}
+			
+			const int one = 1;
+			(void) setsockopt( sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+#ifdef SO_NOSIGPIPE
+			(void) setsockopt( sock, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof( one ) );
+#endif
+			struct timeval timeout;
+			timeout.tv_sec = SOCKET_TIMEOUT_SECONDS;
+			timeout.tv_usec = 0;
+			(void) setsockopt( sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+			(void) setsockopt( sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+			return sock;
+		}
+		
+		static bool http_exchange( const int sock, const const_string_t &message, http_response &response, bool &keepAlive ) _noexcept {
+#ifdef MSG_NOSIGNAL
+			const int flags = MSG_NOSIGNAL;
+#else
+			const int flags = 0;
+#endif
+			for( size_t sent = 0; sent < message.size( ); ) {
+				const ssize_t n = send( sock, message.data( ) + sent, message.size( ) - sent, flags );
+				if( n <= 0 ) {
+					return false;
+				}
+				sent += (size_t) n;
+			}
+			
+			string_t &buf = response.body;
+			char chunk[16384];
+			size_t headerEnd = string_t::npos;
+			try {
+				buf.clear( );
+				while( headerEnd == string_t::npos ) {
+					const ssize_t n = recv( sock, chunk, sizeof( chunk ), 0 );
+					if( n <= 0 ) {
+						return false;
+					}
+					buf.append( chunk, (size_t) n );
+					headerEnd = buf.find( "\r\n\r\n" );
+				}
+				
+				// status line and the headers we care about
+				if( buf.compare( 0, 5, "HTTP/" ) != 0 || buf.find( ' ' ) == string_t::npos ) {
+					return false;
+				}
+				response.status = atoi( buf.c_str( ) + buf.find( ' ' ) + 1 );
+				keepAlive = (buf.compare( 0, 8, "HTTP/1.1" ) == 0);
+				size_t contentLength = string_t::npos;
+				bool chunked = false;
+				for( size_t p = buf.find( "\r\n" ) + 2; p < headerEnd; ) {
+					const size_t eol = buf.find( "\r\n", p );
+					const size_t colon = buf.find( ':', p );
+					if( colon < eol ) {
+						string_t name( buf, p, colon - p );
+						for( size_t i = 0; i < name.size( ); ++ i ) {
+							name[i] = (char) tolower( name[i] );
+						}
+						size_t v = colon + 1;
+						while( v < eol && buf[v] == ' ' ) {
+							++ v;
+						}
+						if( name == "content-length" ) {
+							contentLength = (size_t) strtoul( buf.c_str( ) + v, NULL, 10 );
+						} else if( name == "transfer-encoding" ) {
+							chunked = (buf.compare( v, 7, "chunked" ) == 0);
+						} else if( name == "connection" ) {
+							keepAlive = (buf.compare( v, 10, "keep-alive" ) == 0 || (keepAlive && buf.compare( v, 5, "close" ) != 0));
+						}
+					}
+					p = eol + 2;
+				}
+				buf.erase( 0, headerEnd + 4 );
+				
+				if( chunked ) {
+					string_t body;
+					size_t p = 0;
+					while( true ) {
+						size_t eol;
+						while( (eol = buf.find( "\r\n", p )) == string_t::npos ) {
+							const ssize_t n = recv( sock, chunk, sizeof( chunk ), 0 );
+							if( n <= 0 ) {
+								return false;
+							}
+							buf.append( chunk, (size_t) n );
+						}
+						const size_t size = (size_t) strtoul( buf.c_str( ) + p, NULL, 16 );
+						while( buf.size( ) < eol + 2 + size + 2 ) {
+							const ssize_t n = recv( sock, chunk, sizeof( chunk ), 0 );
+							if( n <= 0 ) {
+								return false;
+							}
+							buf.append( chunk, (size_t) n );
+						}
+						if( size == 0 ) {
+							break; // trailers are not supported
+						}
+						body.append( buf, eol + 2, size );
+						p = eol + 2 + size + 2;
+					}
+					buf.swap( body );
+				} else if( contentLength != string_t::npos ) {
+					while( buf.size( ) < contentLength ) {
+						const ssize_t n = recv( sock, chunk, sizeof( chunk ), 0 );
+						if( n <= 0 ) {
+							return false;
+						}
+						buf.append( chunk, (size_t) n );
+					}
+					buf.resize( contentLength );
+				} else {
+					while( true ) {
+						const ssize_t n = recv( sock, chunk, sizeof( chunk ), 0 );
+						if( n <= 0 ) {
+							break;
+						}
+						buf.append( chunk, (size_t) n );
+					}
+					keepAlive = false;
+				}
+			} catch( ... ) {
+				return false;
+			}
+			return true;
+		}
+		
+		static void close_socket( void *const connection ) _noexcept {
+			pooled_socket *const s = (pooled_socket *) connection;
+			close( s->sock );
+			delete s;
+		}
+		
+		static bool check_socket( void *const connection ) _noexcept {
+			/*
+			 * an idle connection should have nothing to read; end of file (or
+			 * anything else) means the server has closed it or it is out of step
+			 */
+			
+			const pooled_socket *const s = (const pooled_socket *) connection;
+			char c;
+			const ssize_t n = recv( s->sock, &c, 1, MSG_PEEK | MSG_DONTWAIT );
+			return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+		
+		static bool request( connection_pool &pool, const const_string_t &endpoint, const char *const service, const const_string_t &path, const char *const contentType, const char *const target, const const_string_t &payload, http_response &response ) _noexcept {
+			/* POST [path] HTTP/1.1
+			 * Host: [endpoint]
+			 * Content-Type: [contentType]
+			 * X-Amz-Date: [now]
+			 * X-Amz-Target: [target] (if not NULL)
+			 * Authorization: [signature]
+			 *
+			 * [payload]
+			 */
+			
+			const client &c = current_client( );
+			if( unlikely( c.region( ).size( ) <= 0 ) ) {
+				fprintf( stderr, "attempted to connect to %s without a region\n", service );
+				return false;
+			}
+			if( unlikely( c.key( ).size( ) <= 0 || c.secret( ).size( ) <= 0 ) ) {
+				fprintf( stderr, "attempted to connect to %s without a valid IAM user\n", service );
+				return false;
+			}
+			
+			char amzDate[17];
+			const time_t now = time( NULL );
+			struct tm t;
+			gmtime_r( &now, &t );
+			strftime( amzDate, sizeof( amzDate ), "%Y%m%dT%H%M%SZ", &t );
+			
+			string_t message;
+			string_t host;
+			string_t port( "80" );
+			try {
+				const size_t colon = endpoint.find( ':' );
+				host.assign( endpoint, 0, colon );
+				if( colon != string_t::npos ) {
+					port.assign( endpoint, colon + 1, string_t::npos );
+				}
+				
+				string_list_t headers;
+				headers.push_back( string_t( "content-type:" ) + contentType );
+				headers.push_back( string_t( "host:" ) + endpoint );
+				headers.push_back( string_t( "x-amz-date:" ) + amzDate );
+				if( target != NULL ) {
+					headers.push_back( string_t( "x-amz-target:" ) + target );
+				}
+				string_t authorization;
+				if( unlikely( !sign( "POST", path, string_t( ), headers, payload, service, amzDate, authorization ) ) ) {
+					return false;
+				}
+				
+				char length[32];
+				snprintf( length, sizeof( length ), "%lu", (unsigned long) payload.size( ) );
+				message.reserve( payload.size( ) + 512 );
+				message.append( "POST " );
+				message.append( path );
+				message.append( " HTTP/1.1\r\nHost: " );
+				message.append( endpoint );
+				message.append( "\r\nContent-Type: " );
+				message.append( contentType );
+				message.append( "\r\nX-Amz-Date: " );
+				message.append( amzDate );
+				if( target != NULL ) {
+					message.append( "\r\nX-Amz-Target: " );
+					message.append( target );
+				}
+				message.append( "\r\nAuthorization: " );
+				message.append( authorization );
+				message.append( "\r\nContent-Length: " );
+				message.append( length );
+				message.append( "\r\nConnection: keep-alive\r\n\r\n" );
+				message.append( payload );
+			} catch( ... ) {
+				fprintf( stderr, "%s request: out of memory\n", service );
+				return false;
+			}
+			
+			// a pooled connection may have been closed by the server since it
+			// was checked, so failures on those get one more try with a new one
+			static const connection_type type = { &close_socket, &check_socket };
+			while( true ) {
+				pool_lease lease( pool, type );
+				if( unlikely( !lease.ok( ) ) ) {
+					return false;
+				}
+				pooled_socket *s = (pooled_socket *) lease.get( );
+				const bool reused = (s != NULL);
+				if( reused && s->endpoint != endpoint ) {
+					lease.discard( ); // (set_endpoint was called since)
+					continue;
+				}
+				if( !reused ) {
+					const int sock = http_connect( host, port.c_str( ) );
+					if( sock < 0 ) {
+						return false;
+					}
+					try {
+						s = new pooled_socket( );
+						s->endpoint.assign( endpoint );
+					} catch( ... ) {
+						delete s;
+						close( sock );
+						fprintf( stderr, "%s request: out of memory\n", service );
+						return false;
+					}
+					s->sock = sock;
+					lease.set( s );
+				}
+				bool keepAlive = false;
+				if( http_exchange( s->sock, message, response, keepAlive ) ) {
+					if( !keepAlive ) {
+						lease.discard( );
+					}
+					return true;
+				}
+				lease.discard( );
+				if( !reused ) {
+					fprintf( stderr, "botoc: %s request to %.*s failed\n", service, SIZED_STRING(endpoint) );
+					return false;
+				}
+			}
+		}
+	}
+}
+
+#endif
@@ -4,24 +4,39 @@
 // Based on code from 9apps
 
 // usage:
-//  1: include python (first!)
+//  1: include python (first!), unless BOTOC_NATIVE is set
 //  2: include this header
 //  3: call botoc::set_iam_user( key, secret ) and botoc::set_region( region )
 //  4: use as required:
 //       botoc::sqs::put( queue, message )
+//       botoc::sqs::put_batch( queue, messages[, &sent] )
 //       botoc::sqs::get( queue, message[, lock[, wait]] )
+//       botoc::sqs::get_batch( queue, max, lock, wait, messages )
 //       botoc::sqs::delete( queue, handle )
+//       botoc::sqs::remove_batch( queue, handles[, &removed] )
+//       botoc::sqs::extend( queue, handle, lock )
+//       botoc::sqs::extend_batch( queue, handles, lock[, &extended] )
+//       botoc::sqs::release( handle )
+//       botoc::sqs::consumer( queue[, capacity[, lock[, wait]]] )
+//       botoc::sqs::set_retry_policy( policy )
+//       botoc::sqs::get_retry_stats( stats )
+//       botoc::sqs::set_pool_policy( policy )
+//       botoc::sqs::get_pool_stats( stats )
 //       botoc::sqs::disconnect( )
-//  5: link with python
+//  5: link with python (not needed with BOTOC_NATIVE)
 
 // changing iam user or region after performing an action has no effect; calling
-// disconnect() will close the current connection, and the next request will use
-// the new credentials / url
+// disconnect() will close the current connections, and the next request will use
+// the new credentials / url. To use several regions or accounts at once, make a
+// botoc::client for each and select it with a botoc::client_scope.
 
 #ifndef BOTOC_SQS_H_INCLUDED__
 #define BOTOC_SQS_H_INCLUDED__
 
 #include "botoc_common.h"
+#if BOTOC_NATIVE
+#  include "botoc_native.h"
+#endif
 
 /* Earlier versions of boto don't have wait_time_seconds.
  * you can set this in the aws console, but if you want to change it per-request
@@ -30,28 +45,1113 @@
 
 namespace botoc {
 	namespace sqs {
+		/* constants */
+		
+		enum limits {
+			MAX_BATCH_COUNT = 10,    // most messages SQS will handle in one request
+			MAX_BATCH_BYTES = 262144 // most (encoded) message data SQS will accept in one request
+		};
+		
+		/* types */
+		
+		struct message {
+			string_t body;
+			handle_t handle; // pass to remove when done
+		};
+		
+		typedef std::vector<message> message_list_t;
+		typedef std::vector<handle_t> handle_list_t;
+		
+#if BOTOC_NATIVE
+		// queue name => path, kept in each client's SLOT_SQS
+		typedef std::map<string_t,string_t> queue_path_map_t;
+#else
+		// A queue and the bound methods used on every request, looked up once
+		// when the queue is first used (and released by disconnect)
+		struct queue_ref {
+			PyObject *queue;
+			PyObject *write;
+			PyObject *new_message;
+			PyObject *get_messages;
+			PyObject *delete_message;
+		};
+		
+		// One of a client's pooled connections, and the queues looked up
+		// through it
+		struct connection_ref {
+			PyObject *connection;
+			std::map<string_t,queue_ref> queues;
+		};
+#endif
+		
 		/* prototypes */
 		
 		__attribute__((warn_unused_result,unused))
 		static bool put( const const_string_t &queue, const const_string_t &message ) _noexcept;
 		
+		__attribute__((warn_unused_result,unused))
+		static size_t put_batch( const const_string_t &queue, const string_list_t &messages, std::vector<bool> *sent = NULL ) _noexcept;
+		
 		__attribute__((warn_unused_result,unused))
 		static handle_t get( const const_string_t &queue, string_t &body, int lockSeconds = 30, int waitSeconds = 0 ) _noexcept;
 		
-		__attribute__((warn_unused_result,unused))
-		static bool remove( const const_string_t &queue, handle_t handle ) _noexcept;
+		__attribute__((warn_unused_result,unused))
+		static bool get_batch( const const_string_t &queue, int maxCount, int lockSeconds, int waitSeconds, message_list_t &messages ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool remove( const const_string_t &queue, handle_t handle ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static size_t remove_batch( const const_string_t &queue, const handle_list_t &handles, std::vector<bool> *removed = NULL ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static bool extend( const const_string_t &queue, handle_t handle, int lockSeconds ) _noexcept;
+		
+		__attribute__((warn_unused_result,unused))
+		static size_t extend_batch( const const_string_t &queue, const handle_list_t &handles, int lockSeconds, std::vector<bool> *extended = NULL ) _noexcept;
+		
+		__attribute__((unused))
+		static void release( handle_t handle ) _noexcept;
+		
+		// Throttling, server and network errors are retried with backoff by
+		// every call (see botoc::retry_policy); applies to later requests
+		// through the current client
+		__attribute__((unused))
+		static void set_retry_policy( const retry_policy &policy ) _noexcept;
+		
+		__attribute__((unused))
+		static void get_retry_stats( retry_stats &stats ) _noexcept;
+		
+		// Requests take a connection from a pool for the current client (see
+		// botoc::pool_policy), so that with BOTOC_THREADSAFE many can be in
+		// flight at once; applies to later requests through the current client
+		__attribute__((unused))
+		static void set_pool_policy( const pool_policy &policy ) _noexcept;
+		
+		__attribute__((unused))
+		static void get_pool_stats( pool_stats &stats ) _noexcept;
+		
+		__attribute__((always_inline,unused))
+		static inline void disconnect( void ) _noexcept;
+		
+		/* internal prototypes */
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline retry_state &retries( void ) _noexcept;
+		
+		__attribute__((warn_unused_result,always_inline))
+		static inline connection_pool &connections( void ) _noexcept;
+		
+#if BOTOC_NATIVE
+		// (set as the client's SLOT_SQS releaser)
+		static void release_client( client &c ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static const string_t *prep( const const_string_t &queue_name ) _noexcept;
+		
+		// Forgets the current client's queue paths
+		static void forget_queues( void ) _noexcept;
+		
+		// (guards every client's SLOT_SQS)
+		__attribute__((warn_unused_result,always_inline))
+		static inline pthread_mutex_t *queue_mutex( void ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool call( const const_string_t &path, const char *action, const const_string_t &params, native::http_response &response ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static size_t send_group( const const_string_t &path, const char *action, const const_string_t &params, size_t count, size_t offset, std::vector<bool> *succeeded ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool read_messages( const const_string_t &xml, message_list_t &messages ) _noexcept;
+#else
+		// The queue looked up through the lease's connection (opening one if
+		// the lease is empty)
+		__attribute__((warn_unused_result))
+		static const queue_ref *prep( pool_lease &lease, const const_string_t &queue_name ) _noexcept;
+		
+		static void release_queue( queue_ref &q ) _noexcept;
+		
+		// (closes a pooled connection_ref)
+		static void release_connection( void *connection ) _noexcept;
+		
+		static const connection_type pooled_connection = { &release_connection, NULL };
+		
+		__attribute__((warn_unused_result))
+		static bool read_body( PyObject *msg, string_t &body ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static bool read_batch_errors( PyObject *ret, const char *stage, bool *failed, size_t count ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static size_t send_batch( PyObject *queue, PyObject *batch, const size_t *indices, std::vector<bool> *sent ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static size_t remove_group( PyObject *queue, const handle_t *handles, size_t count, size_t offset, std::vector<bool> *removed ) _noexcept;
+		
+		__attribute__((warn_unused_result))
+		static size_t extend_group( PyObject *queue, const handle_t *handles, size_t count, size_t offset, int lockSeconds, std::vector<bool> *extended ) _noexcept;
+#endif
+		
+		/* classes */
+		
+		// Collects handles from a worker and removes them in batches once maxCount
+		// handles are waiting or the oldest has waited maxMillis. The age is only
+		// checked by add and poll, so idle workers should call poll periodically.
+		// Any remaining handles are removed when the buffer is destroyed.
+		// Each worker thread should have its own buffer. Handles are removed
+		// through the client which was current when the buffer was made.
+		class ack_buffer {
+		private:
+			string_t _queue;
+			client *_client;
+			handle_list_t _handles;
+			size_t _maxCount;
+			long long _maxMicros;
+			long long _oldest;
+			
+			ack_buffer( const ack_buffer & );
+			ack_buffer &operator =( const ack_buffer & );
+			
+		public:
+			inline explicit ack_buffer( const const_string_t &queue, size_t maxCount = MAX_BATCH_COUNT, int maxMillis = 1000 ) _throws_bad_alloc :
+			_queue( queue ),
+			_client( &current_client( ) ),
+			_handles( ),
+			_maxCount( (maxCount > 0) ? maxCount : 1 ),
+			_maxMicros( (long long) maxMillis * 1000ll ),
+			_oldest( 0 )
+			{
+				_handles.reserve( _maxCount );
+			}
+			
+			inline ~ack_buffer( void ) _noexcept {
+				(void) flush( );
+			}
+			
+			__attribute__((pure,warn_unused_result,always_inline))
+			inline size_t size( void ) const _noexcept {
+				return _handles.size( );
+			}
+			
+			// returns false if the handle (or a batch flushed because of it) could not be removed
+			__attribute__((warn_unused_result))
+			inline bool add( handle_t handle ) _noexcept {
+				if( unlikely( handle == NULL ) ) {
+					return false;
+				}
+				try {
+					_handles.push_back( handle );
+				} catch( ... ) {
+					client_scope use( *_client );
+					return remove( _queue, handle );
+				}
+				if( _handles.size( ) == 1 ) {
+					_oldest = clock_micros( );
+				}
+				if( _handles.size( ) >= _maxCount ) {
+					const size_t n = _handles.size( );
+					return flush( ) == n;
+				}
+				return poll( );
+			}
+			
+			// flushes if the oldest handle has waited long enough
+			__attribute__((warn_unused_result))
+			inline bool poll( void ) _noexcept {
+				if( _handles.size( ) == 0 || clock_micros( ) - _oldest < _maxMicros ) {
+					return true;
+				}
+				const size_t n = _handles.size( );
+				return flush( ) == n;
+			}
+			
+			// returns the number of handles removed
+			inline size_t flush( void ) _noexcept {
+				if( _handles.size( ) == 0 ) {
+					return 0;
+				}
+				client_scope use( *_client );
+				const size_t r = remove_batch( _queue, _handles );
+				_handles.clear( );
+				return r;
+			}
+		};
+		
+		// Receives messages on a background thread into a bounded local buffer, so
+		// workers can pop them without waiting on the network. Buffered messages
+		// have their visibility extended (every lockSeconds / 2) so they are not
+		// given to other consumers while they wait.
+		// Workers hand finished messages back through ack, and they are removed in
+		// batches by the background thread. Without BOTOC_THREADSAFE that thread
+		// must be the only one which talks to Python, so nothing else may use botoc
+		// while a consumer is running (workers must ack rather than remove).
+		// Messages still buffered when the consumer stops are made visible again
+		// straight away.
+		class consumer {
+		private:
+			string_t _queue;
+			int _lockSeconds;
+			int _waitSeconds;
+			message_list_t _ring;
+			std::vector<long long> _received;
+			size_t _head;
+			size_t _count;
+			handle_list_t _acks;
+			unsigned long long _failedAcks;    // handles the background thread could not remove
+			unsigned long long _failedExtends; // or extend (or make visible again when stopping)
+			client *_client; // current when the thread was started
+			pthread_t _thread;
+			pthread_mutex_t _mutex;
+			pthread_cond_t _filled; // messages have arrived (or stopping)
+			pthread_cond_t _wake;   // space has been freed or acks are waiting (or stopping)
+			bool _running;
+			bool _stopping;
+			
+			consumer( const consumer & );
+			consumer &operator =( const consumer & );
+			
+			static inline void wait_micros( pthread_cond_t *cond, pthread_mutex_t *mutex, long long micros ) _noexcept {
+				const long long t = clock_micros( ) + micros;
+				struct timespec ts;
+				ts.tv_sec = (time_t) (t / 1000000ll);
+				ts.tv_nsec = (long) (t % 1000000ll) * 1000l;
+				(void) pthread_cond_timedwait( cond, mutex, &ts );
+			}
+			
+			static void *run( void *self ) _noexcept {
+				client_scope use( *((consumer *) self)->_client );
+				((consumer *) self)->loop( );
+				return NULL;
+			}
+			
+			inline void loop( void ) _noexcept {
+				const long long extendAfter = (long long) _lockSeconds * 500000ll;
+				const long long idleMicros = 250000ll;
+				message_list_t batch;
+				handle_list_t acks;
+				handle_list_t due;
+				
+				pthread_mutex_lock( &_mutex );
+				while( !_stopping ) {
+					// handles stay valid until this thread removes or releases them,
+					// so they can be used after unlocking
+					acks.swap( _acks );
+					due.clear( );
+					if( _lockSeconds > 0 ) {
+						const long long now = clock_micros( );
+						for( size_t i = 0; i < _count; ++ i ) {
+							const size_t j = (_head + i) % _ring.size( );
+							if( now - _received[j] < extendAfter ) {
+								continue;
+							}
+							try {
+								due.push_back( _ring[j].handle );
+							} catch( ... ) {
+								break;
+							}
+							_received[j] = now;
+						}
+					}
+					const size_t space = _ring.size( ) - _count;
+					const bool empty = (_count == 0);
+					pthread_mutex_unlock( &_mutex );
+					
+					size_t failedAcks = 0;
+					size_t failedExtends = 0;
+					if( acks.size( ) > 0 ) {
+						const size_t removed = remove_batch( _queue, acks );
+						failedAcks = acks.size( ) - removed;
+						acks.clear( );
+					}
+					if( due.size( ) > 0 ) {
+						const size_t extended = extend_batch( _queue, due, _lockSeconds );
+						failedExtends = due.size( ) - extended;
+					}
+					
+					bool received = false;
+					if( space > 0 ) {
+						int wait = _waitSeconds;
+						if( !empty && _lockSeconds > 0 && wait > _lockSeconds / 4 ) {
+							// come back in time to extend the messages we are holding
+							wait = _lockSeconds / 4;
+						}
+						const int n = (space < MAX_BATCH_COUNT) ? (int) space : MAX_BATCH_COUNT;
+						received = get_batch( _queue, n, _lockSeconds, wait, batch ) && batch.size( ) > 0;
+					}
+					
+					pthread_mutex_lock( &_mutex );
+					_failedAcks += failedAcks;
+					_failedExtends += failedExtends;
+					if( received ) {
+						// only workers change the buffer meanwhile, and they only free space
+						const long long now = clock_micros( );
+						for( size_t i = 0, e = batch.size( ); i < e; ++ i ) {
+							const size_t j = (_head + _count) % _ring.size( );
+							_ring[j].body.swap( batch[i].body );
+							_ring[j].handle = batch[i].handle;
+							_received[j] = now;
+							++ _count;
+						}
+						pthread_cond_broadcast( &_filled );
+					} else if( !_stopping && _acks.size( ) == 0 ) {
+						// full, empty or failing; wait for space, acks or the next extension
+						wait_micros( &_wake, &_mutex, idleMicros );
+					}
+				}
+				
+				acks.swap( _acks );
+				due.clear( );
+				try {
+					due.reserve( _count );
+				} catch( ... ) {
+				}
+				for( ; _count > 0; -- _count ) {
+					if( due.size( ) < due.capacity( ) ) {
+						due.push_back( _ring[_head].handle );
+					} else {
+						release( _ring[_head].handle );
+					}
+					_ring[_head].handle = NULL;
+					_head = (_head + 1) % _ring.size( );
+				}
+				pthread_mutex_unlock( &_mutex );
+				
+				size_t failedAcks = 0;
+				size_t failedExtends = 0;
+				if( acks.size( ) > 0 ) {
+					const size_t removed = remove_batch( _queue, acks );
+					failedAcks = acks.size( ) - removed;
+				}
+				if( due.size( ) > 0 ) {
+					const size_t extended = extend_batch( _queue, due, 0 );
+					failedExtends = due.size( ) - extended;
+					for( size_t i = 0, e = due.size( ); i < e; ++ i ) {
+						release( due[i] );
+					}
+				}
+				pthread_mutex_lock( &_mutex );
+				_failedAcks += failedAcks;
+				_failedExtends += failedExtends;
+				pthread_mutex_unlock( &_mutex );
+			}
+			
+		public:
+			inline explicit consumer( const const_string_t &queue, size_t capacity = 100, int lockSeconds = 30, int waitSeconds = 20 ) _throws_bad_alloc :
+			_queue( queue ),
+			_lockSeconds( lockSeconds ),
+			_waitSeconds( waitSeconds ),
+			_ring( (capacity > 0) ? capacity : 1 ),
+			_received( (capacity > 0) ? capacity : 1, 0ll ),
+			_head( 0 ),
+			_count( 0 ),
+			_acks( ),
+			_failedAcks( 0 ),
+			_failedExtends( 0 ),
+			_client( NULL ),
+			_thread( ),
+			_running( false ),
+			_stopping( false )
+			{
+				_acks.reserve( MAX_BATCH_COUNT );
+				pthread_mutex_init( &_mutex, NULL );
+				pthread_cond_init( &_filled, NULL );
+				pthread_cond_init( &_wake, NULL );
+			}
+			
+			inline ~consumer( void ) _noexcept {
+				stop( );
+				pthread_cond_destroy( &_wake );
+				pthread_cond_destroy( &_filled );
+				pthread_mutex_destroy( &_mutex );
+			}
+			
+			__attribute__((warn_unused_result))
+			inline bool start( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				if( _running ) {
+					pthread_mutex_unlock( &_mutex );
+					return true;
+				}
+				_stopping = false;
+				_client = &current_client( );
+				_running = (pthread_create( &_thread, NULL, &run, this ) == 0);
+				pthread_mutex_unlock( &_mutex );
+				if( unlikely( !_running ) ) {
+					fprintf( stderr, "could not start consumer thread for %.*s\n", SIZED_STRING(_queue) );
+				}
+				return _running;
+			}
+			
+			inline void stop( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				if( !_running ) {
+					pthread_mutex_unlock( &_mutex );
+					return;
+				}
+				_stopping = true;
+				pthread_cond_broadcast( &_filled );
+				pthread_cond_broadcast( &_wake );
+				pthread_mutex_unlock( &_mutex );
+				pthread_join( _thread, NULL );
+				pthread_mutex_lock( &_mutex );
+				_running = false;
+				pthread_mutex_unlock( &_mutex );
+			}
+			
+			// number of messages waiting in the local buffer
+			__attribute__((warn_unused_result))
+			inline size_t size( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				const size_t r = _count;
+				pthread_mutex_unlock( &_mutex );
+				return r;
+			}
+			
+			// acked handles which the background thread failed to remove (the
+			// messages will be received again once their lock expires)
+			__attribute__((warn_unused_result))
+			inline unsigned long long failed_acks( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				const unsigned long long r = _failedAcks;
+				pthread_mutex_unlock( &_mutex );
+				return r;
+			}
+			
+			// buffered messages whose visibility could not be extended (they may
+			// be given to another consumer) or reset when stopping
+			__attribute__((warn_unused_result))
+			inline unsigned long long failed_extends( void ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				const unsigned long long r = _failedExtends;
+				pthread_mutex_unlock( &_mutex );
+				return r;
+			}
+			
+			// waits up to timeoutMillis (forever if negative) for a message;
+			// returns false if none arrived or the consumer is stopped
+			__attribute__((warn_unused_result))
+			inline bool pop( message &output, int timeoutMillis = -1 ) _noexcept {
+				pthread_mutex_lock( &_mutex );
+				const long long end = clock_micros( ) + (long long) timeoutMillis * 1000ll;
+				while( _count == 0 && _running && !_stopping && timeoutMillis != 0 ) {
+					if( timeoutMillis < 0 ) {
+						pthread_cond_wait( &_filled, &_mutex );
+					} else {
+						const long long left = end - clock_micros( );
+						if( left <= 0 ) {
+							break;
+						}
+						wait_micros( &_filled, &_mutex, left );
+					}
+				}
+				if( _count == 0 || _stopping ) {
+					pthread_mutex_unlock( &_mutex );
+					return false;
+				}
+				message &m = _ring[_head];
+				output.body.swap( m.body );
+				output.handle = m.handle;
+				m.handle = NULL;
+				_head = (_head + 1) % _ring.size( );
+				-- _count;
+				pthread_cond_signal( &_wake );
+				pthread_mutex_unlock( &_mutex );
+				return true;
+			}
+			
+			// queues a popped message's handle for removal by the background thread
+			__attribute__((warn_unused_result))
+			inline bool ack( handle_t handle ) _noexcept {
+				if( unlikely( handle == NULL ) ) {
+					return false;
+				}
+				pthread_mutex_lock( &_mutex );
+				try {
+					_acks.push_back( handle );
+				} catch( ... ) {
+					pthread_mutex_unlock( &_mutex );
+					return false;
+				}
+				if( _acks.size( ) >= MAX_BATCH_COUNT ) {
+					pthread_cond_signal( &_wake );
+				}
+				pthread_mutex_unlock( &_mutex );
+				return true;
+			}
+		};
+		
+		/* implementation */
+		
+#if BOTOC_NATIVE
+		static inline pthread_mutex_t *queue_mutex( void ) _noexcept {
+			static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+			return &mutex;
+		}
+		
+		static void forget_queues( void ) _noexcept {
+			client &c = current_client( );
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( queue_mutex( ) );
+#endif
+			delete (queue_path_map_t *) c.slot( SLOT_SQS );
+			c.slot( SLOT_SQS ) = NULL;
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( queue_mutex( ) );
+#endif
+		}
+		
+		static const string_t *prep( const const_string_t &queue_name ) _noexcept {
+			/*
+			 * POST / Action=GetQueueUrl&QueueName=[queue_name]
+			 * => path of <QueueUrl>
+			 */
+			
+			client &c = current_client( );
+			
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( queue_mutex( ) );
+#endif
+			queue_path_map_t *map = (queue_path_map_t *) c.slot( SLOT_SQS );
+			const string_t *r = NULL;
+			if( map != NULL ) {
+				queue_path_map_t::iterator ind = map->find( queue_name );
+				if( ind != map->end( ) ) {
+					r = &ind->second;
+				}
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( queue_mutex( ) );
+#endif
+			if( r != NULL ) {
+				return r; // entries are never removed while requests are running
+			}
+			
+			native::http_response response;
+			string_t url;
+			try {
+				string_t params;
+				native::form_param( params, "QueueName", queue_name );
+				const string_t root( "/" );
+				if( unlikely( !call( root, "GetQueueUrl", params, response ) ) ) {
+					fprintf( stderr, "queue not found: %.*s\n", SIZED_STRING(queue_name) );
+					return NULL;
+				}
+				size_t pos = 0;
+				if( unlikely( !native::xml_value( response.body, "QueueUrl", pos, response.body.size( ), url ) ) ) {
+					fprintf( stderr, "get_queue failed: %.*s\n", SIZED_STRING(queue_name) );
+					return NULL;
+				}
+				const size_t scheme = url.find( "://" );
+				const size_t path = url.find( '/', (scheme == string_t::npos) ? 0 : scheme + 3 );
+				url.erase( 0, path );
+				if( url.empty( ) ) {
+					url.assign( root );
+				}
+			} catch( ... ) {
+				return NULL;
+			}
+			
+#if BOTOC_THREADSAFE
+			pthread_mutex_lock( queue_mutex( ) );
+#endif
+			try {
+				map = (queue_path_map_t *) c.slot( SLOT_SQS );
+				if( map == NULL ) {
+					map = new queue_path_map_t( );
+					c.slot( SLOT_SQS ) = map;
+					c.set_releaser( SLOT_SQS, &release_client );
+				}
+				r = &map->insert( std::pair<string_t,string_t>( string_t( queue_name ), url ) ).first->second;
+			} catch( ... ) {
+				r = NULL;
+			}
+#if BOTOC_THREADSAFE
+			pthread_mutex_unlock( queue_mutex( ) );
+#endif
+			return r;
+		}
+		
+		static bool call( const const_string_t &path, const char *const action, const const_string_t &params, native::http_response &response ) _noexcept {
+			/*
+			 * POST [path] Action=[action]&Version=2012-11-05&[params]
+			 */
+			
+			string_t payload;
+			string_t endpoint;
+			try {
+				payload.reserve( params.size( ) + 64 );
+				payload.assign( "Action=" );
+				payload.append( action );
+				payload.append( "&Version=2012-11-05&" );
+				payload.append( params );
+				if( !native::sqs_endpoint.empty( ) ) {
+					endpoint.assign( native::sqs_endpoint );
+				} else if( !native::allow_http( action ) ) {
+					return false;
+				} else {
+					endpoint.assign( current_client( ).region( ) );
+					endpoint.append( ".queue.amazonaws.com" );
+				}
+			} catch( ... ) {
+				fprintf( stderr, "%s: out of memory\n", action );
+				return false;
+			}
+			retry_call attempt( retries( ) );
+			while( true ) {
+				if( unlikely( !native::request( connections( ), endpoint, "sqs", path, "application/x-www-form-urlencoded; charset=utf-8", NULL, payload, response ) ) ) {
+					if( attempt.again( RETRY_NETWORK ) ) {
+						continue;
+					}
+					return false;
+				}
+				if( likely( response.status == 200 ) ) {
+					attempt.succeeded( );
+					return true;
+				}
+				string_t code;
+				size_t pos = 0;
+				if( !native::xml_value( response.body, "Code", pos, response.body.size( ), code ) ) {
+					code.clear( ); // (not an AWS error response)
+				}
+				if( attempt.again( retry_from_code( code.c_str( ), response.status ) ) ) {
+					continue;
+				}
+				string_t message;
+				pos = 0;
+				if( !native::xml_value( response.body, "Message", pos, response.body.size( ), message ) ) {
+					message.clear( );
+				}
+				fprintf( stderr, "botoc: %s threw %d %.*s: %.*s\n", action, response.status, SIZED_STRING(code), SIZED_STRING(message) );
+				return false;
+			}
+		}
+		
+		static size_t send_group( const const_string_t &path, const char *const action, const const_string_t &params, const size_t count, const size_t offset, std::vector<bool> *const succeeded ) _noexcept {
+			/*
+			 * POST [path] Action=[action]&[params]
+			 * failed = [int( e.Id ) for e in BatchResultErrorEntry]
+			 */
+			
+			native::http_response response;
+			if( unlikely( !call( path, action, params, response ) ) ) {
+				return 0;
+			}
+			
+			bool failed[MAX_BATCH_COUNT] = { false };
+			const string_t &xml = response.body;
+			size_t pos = 0;
+			size_t a;
+			size_t b;
+			string_t id;
+			while( native::xml_find( xml, "BatchResultErrorEntry", pos, xml.size( ), a, b ) ) {
+				if( native::xml_value( xml, "Id", a, b, id ) ) {
+					const int n = atoi( id.c_str( ) );
+					if( likely( n >= 0 && (size_t) n < count ) ) {
+						failed[n] = true;
+					}
+				}
+			}
+			
+			size_t r = 0;
+			for( size_t i = 0; i < count; ++ i ) {
+				if( !failed[i] ) {
+					if( succeeded != NULL ) {
+						(*succeeded)[offset + i] = true;
+					}
+					++ r;
+				}
+			}
+			return r;
+		}
+		
+		static bool read_messages( const const_string_t &xml, message_list_t &messages ) _noexcept {
+			/*
+			 * for m in Message:
+			 *   body = base64decode( m.Body ), handle = m.ReceiptHandle
+			 */
+			
+			size_t pos = 0;
+			size_t a;
+			size_t b;
+			string_t receipt;
+			string_t encoded;
+			while( native::xml_find( xml, "Message", pos, xml.size( ), a, b ) ) {
+				size_t p = a;
+				if( unlikely( !native::xml_value( xml, "ReceiptHandle", p, b, receipt ) ) ) {
+					continue;
+				}
+				p = a;
+				if( unlikely( !native::xml_value( xml, "Body", p, b, encoded ) ) ) {
+					// skip it; the message will become visible again after lockSeconds
+					continue;
+				}
+				try {
+					messages.push_back( message( ) );
+					message &m = messages.back( );
+					m.handle = NULL;
+					if( unlikely( !decode_binary( encoded, m.body ) ) ) {
+						messages.pop_back( );
+						return false;
+					}
+					m.handle = (handle_t) new string_t( receipt );
+				} catch( ... ) {
+					if( !messages.empty( ) && messages.back( ).handle == NULL ) {
+						messages.pop_back( );
+					}
+					return false;
+				}
+			}
+			return true;
+		}
+		
+		static bool put( const const_string_t &queue_name, const const_string_t &message ) _noexcept {
+			/*
+			 * POST [queue] Action=SendMessage&MessageBody=[base64( message )]
+			 */
+			
+			const string_t *path = prep( queue_name );
+			if( unlikely( path == NULL ) ) {
+				return false;
+			}
+			native::http_response response;
+			try {
+				string_t body;
+				string_t params;
+				if( unlikely( !encode_binary( message.data( ), message.size( ), body ) ) ) {
+					return false;
+				}
+				native::form_param( params, "MessageBody", body );
+				return call( *path, "SendMessage", params, response );
+			} catch( ... ) {
+				return false;
+			}
+		}
+		
+		static size_t put_batch( const const_string_t &queue_name, const string_list_t &messages, std::vector<bool> *const sent ) _noexcept {
+			/*
+			 * for each group of up to 10 messages (and 256KB):
+			 *   POST [queue] Action=SendMessageBatch
+			 *     &SendMessageBatchRequestEntry.1.Id=0&SendMessageBatchRequestEntry.1.MessageBody=[base64( message0 )]
+			 *     ...
+			 */
+			
+			if( sent != NULL ) {
+				try {
+					sent->assign( messages.size( ), false );
+				} catch( ... ) {
+					return 0;
+				}
+			}
+			
+			const string_t *path = prep( queue_name );
+			if( unlikely( path == NULL ) ) {
+				return 0;
+			}
+			
+			size_t r = 0;
+			try {
+				string_t params;
+				string_t body;
+				std::vector<bool> groupSent;
+				size_t indices[MAX_BATCH_COUNT];
+				size_t n = 0;
+				size_t bytes = 0;
+				char name[64];
+				char id[16];
+				for( size_t i = 0, e = messages.size( ); i <= e; ++ i ) {
+					size_t size = 0;
+					if( i < e ) {
+						if( unlikely( !encode_binary( messages[i].data( ), messages[i].size( ), body ) ) ) {
+							continue;
+						}
+						size = body.size( );
+						if( unlikely( size > MAX_BATCH_BYTES ) ) {
+							fprintf( stderr, "message %d is too large for SQS (%d bytes)\n", (int) i, (int) size );
+							continue;
+						}
+					}
+					
+					if( n > 0 && (i == e || n == MAX_BATCH_COUNT || bytes + size > MAX_BATCH_BYTES) ) {
+						groupSent.assign( n, false );
+						r += send_group( *path, "SendMessageBatch", params, n, 0, &groupSent );
+						if( sent != NULL ) {
+							for( size_t j = 0; j < n; ++ j ) {
+								(*sent)[indices[j]] = groupSent[j];
+							}
+						}
+						params.clear( );
+						bytes = 0;
+						n = 0;
+					}
+					if( i == e ) {
+						break;
+					}
+					
+					snprintf( name, sizeof( name ), "SendMessageBatchRequestEntry.%d.Id", (int) n + 1 );
+					snprintf( id, sizeof( id ), "%d", (int) n );
+					native::form_param( params, name, id );
+					snprintf( name, sizeof( name ), "SendMessageBatchRequestEntry.%d.MessageBody", (int) n + 1 );
+					native::form_param( params, name, body );
+					indices[n] = i;
+					bytes += size;
+					++ n;
+				}
+			} catch( ... ) {
+				fprintf( stderr, "put_batch: out of memory\n" );
+			}
+			return r;
+		}
+		
+		static handle_t get( const const_string_t &queue_name, string_t &body, const int lockSeconds, const int waitSeconds ) _noexcept {
+			/*
+			 * POST [queue] Action=ReceiveMessage&MaxNumberOfMessages=1&VisibilityTimeout=[lockSeconds]&WaitTimeSeconds=[waitSeconds]
+			 */
+			
+			body.clear( );
+			
+			message_list_t messages;
+			if( unlikely( !get_batch( queue_name, 1, lockSeconds, waitSeconds, messages ) || messages.empty( ) ) ) {
+				return NULL;
+			}
+			body.swap( messages[0].body );
+			return messages[0].handle;
+		}
+		
+		static bool get_batch( const const_string_t &queue_name, int maxCount, const int lockSeconds, const int waitSeconds, message_list_t &messages ) _noexcept {
+			/*
+			 * POST [queue] Action=ReceiveMessage&MaxNumberOfMessages=[maxCount]&VisibilityTimeout=[lockSeconds]&WaitTimeSeconds=[waitSeconds]
+			 */
+			
+			messages.clear( );
+			
+			if( maxCount > MAX_BATCH_COUNT ) {
+				maxCount = MAX_BATCH_COUNT;
+			} else if( maxCount < 1 ) {
+				maxCount = 1;
+			}
+			
+			const string_t *path = prep( queue_name );
+			if( unlikely( path == NULL ) ) {
+				return false;
+			}
+			
+			native::http_response response;
+			try {
+				char value[16];
+				string_t params;
+				snprintf( value, sizeof( value ), "%d", maxCount );
+				native::form_param( params, "MaxNumberOfMessages", value );
+				if( lockSeconds > 0 ) {
+					snprintf( value, sizeof( value ), "%d", lockSeconds );
+					native::form_param( params, "VisibilityTimeout", value );
+				}
+				if( waitSeconds > 0 ) {
+					snprintf( value, sizeof( value ), "%d", waitSeconds );
+					native::form_param( params, "WaitTimeSeconds", value );
+				}
+				if( unlikely( !call( *path, "ReceiveMessage", params, response ) ) ) {
+					return false;
+				}
+				messages.reserve( (size_t) maxCount );
+			} catch( ... ) {
+				return false;
+			}
+			return read_messages( response.body, messages );
+		}
+		
+		static bool remove( const const_string_t &queue_name, handle_t handle ) _noexcept {
+			/*
+			 * POST [queue] Action=DeleteMessage&ReceiptHandle=[handle]
+			 */
+			
+			if( unlikely( handle == NULL ) ) {
+				return false;
+			}
+			bool r = false;
+			const string_t *path = prep( queue_name );
+			if( likely( path != NULL ) ) {
+				native::http_response response;
+				try {
+					string_t params;
+					native::form_param( params, "ReceiptHandle", *(const string_t *) handle );
+					r = call( *path, "DeleteMessage", params, response );
+				} catch( ... ) {
+				}
+			}
+			release( handle );
+			return r;
+		}
+		
+		static size_t remove_batch( const const_string_t &queue_name, const handle_list_t &handles, std::vector<bool> *removed ) _noexcept {
+			/*
+			 * for each group of up to 10 handles:
+			 *   POST [queue] Action=DeleteMessageBatch
+			 *     &DeleteMessageBatchRequestEntry.1.Id=0&DeleteMessageBatchRequestEntry.1.ReceiptHandle=[handle0]
+			 *     ...
+			 */
+			
+			const size_t e = handles.size( );
+			if( removed != NULL ) {
+				try {
+					removed->assign( e, false );
+				} catch( ... ) {
+					removed = NULL;
+				}
+			}
+			if( e == 0 ) {
+				return 0;
+			}
+			
+			// like remove, every handle is released whether or not it could be removed
+			size_t r = 0;
+			const string_t *path = prep( queue_name );
+			if( likely( path != NULL ) ) {
+				try {
+					string_t params;
+					char name[64];
+					char id[16];
+					for( size_t i = 0; i < e; i += MAX_BATCH_COUNT ) {
+						const size_t n = (e - i < MAX_BATCH_COUNT) ? (e - i) : (size_t) MAX_BATCH_COUNT;
+						params.clear( );
+						for( size_t j = 0; j < n; ++ j ) {
+							snprintf( name, sizeof( name ), "DeleteMessageBatchRequestEntry.%d.Id", (int) j + 1 );
+							snprintf( id, sizeof( id ), "%d", (int) j );
+							native::form_param( params, name, id );
+							snprintf( name, sizeof( name ), "DeleteMessageBatchRequestEntry.%d.ReceiptHandle", (int) j + 1 );
+							native::form_param( params, name, *(const string_t *) handles[i + j] );
+						}
+						r += send_group( *path, "DeleteMessageBatch", params, n, i, removed );
+					}
+				} catch( ... ) {
+					fprintf( stderr, "remove_batch: out of memory\n" );
+				}
+			}
+			for( size_t i = 0; i < e; ++ i ) {
+				release( handles[i] );
+			}
+			return r;
+		}
+		
+		static bool extend( const const_string_t &queue_name, handle_t handle, const int lockSeconds ) _noexcept {
+			/*
+			 * POST [queue] Action=ChangeMessageVisibility&ReceiptHandle=[handle]&VisibilityTimeout=[lockSeconds]
+			 */
+			
+			if( unlikely( handle == NULL ) ) {
+				return false;
+			}
+			const string_t *path = prep( queue_name );
+			if( unlikely( path == NULL ) ) {
+				return false;
+			}
+			native::http_response response;
+			try {
+				char value[16];
+				string_t params;
+				native::form_param( params, "ReceiptHandle", *(const string_t *) handle );
+				snprintf( value, sizeof( value ), "%d", lockSeconds );
+				native::form_param( params, "VisibilityTimeout", value );
+				return call( *path, "ChangeMessageVisibility", params, response );
+			} catch( ... ) {
+				return false;
+			}
+		}
 		
-		__attribute__((always_inline,unused))
-		static inline void disconnect( void ) _noexcept;
+		static size_t extend_batch( const const_string_t &queue_name, const handle_list_t &handles, const int lockSeconds, std::vector<bool> *extended ) _noexcept {
+			/*
+			 * for each group of up to 10 handles:
+			 *   POST [queue] Action=ChangeMessageVisibilityBatch
+			 *     &ChangeMessageVisibilityBatchRequestEntry.1.Id=0
+			 *     &ChangeMessageVisibilityBatchRequestEntry.1.ReceiptHandle=[handle0]
+			 *     &ChangeMessageVisibilityBatchRequestEntry.1.VisibilityTimeout=[lockSeconds]
+			 *     ...
+			 */
+			
+			const size_t e = handles.size( );
+			if( extended != NULL ) {
+				try {
+					extended->assign( e, false );
+				} catch( ... ) {
+					extended = NULL;
+				}
+			}
+			if( e == 0 ) {
+				return 0;
+			}
+			
+			const string_t *path = prep( queue_name );
+			if( unlikely( path == NULL ) ) {
+				return 0;
+			}
+			
+			size_t r = 0;
+			try {
+				string_t params;
+				char name[80];
+				char id[16];
+				char lock[16];
+				snprintf( lock, sizeof( lock ), "%d", lockSeconds );
+				for( size_t i = 0; i < e; i += MAX_BATCH_COUNT ) {
+					const size_t n = (e - i < MAX_BATCH_COUNT) ? (e - i) : (size_t) MAX_BATCH_COUNT;
+					params.clear( );
+					for( size_t j = 0; j < n; ++ j ) {
+						snprintf( name, sizeof( name ), "ChangeMessageVisibilityBatchRequestEntry.%d.Id", (int) j + 1 );
+						snprintf( id, sizeof( id ), "%d", (int) j );
+						native::form_param( params, name, id );
+						snprintf( name, sizeof( name ), "ChangeMessageVisibilityBatchRequestEntry.%d.ReceiptHandle", (int) j + 1 );
+						native::form_param( params, name, *(const string_t *) handles[i + j] );
+						snprintf( name, sizeof( name ), "ChangeMessageVisibilityBatchRequestEntry.%d.VisibilityTimeout", (int) j + 1 );
+						native::form_param( params, name, lock );
+					}
+					r += send_group( *path, "ChangeMessageVisibilityBatch", params, n, i, extended );
+				}
+			} catch( ... ) {
+				fprintf( stderr, "extend_batch: out of memory\n" );
+			}
+			return r;
+		}
 		
-		/* internal prototypes */
+		static void release( handle_t handle ) _noexcept {
+			/*
+			 * (handles are receipt handles allocated by get / get_batch)
+			 */
+			
+			delete (string_t *) handle;
+		}
 		
-		__attribute__((warn_unused_result))
-		static PyObject *prep( const const_string_t &queue_name, bool disconnect = false ) _noexcept;
+		static inline void disconnect( void ) _noexcept {
+			forget_queues( );
+			connections( ).close( );
+			retry_refill( retries( ) );
+		}
 		
-		/* implementation */
+		static void release_client( client &c ) _noexcept {
+			client_scope use( c );
+			disconnect( );
+		}
+#else
+		static void release_queue( queue_ref &q ) _noexcept {
+			py_release( q.delete_message );
+			py_release( q.get_messages );
+			py_release( q.new_message );
+			py_release( q.write );
+			py_release( q.queue );
+			memset( &q, 0, sizeof( q ) );
+		}
+		
+		static void release_connection( void *const connection ) _noexcept {
+			py_gil gil;
+			
+			connection_ref *conn = (connection_ref *) connection;
+			py_release( conn->connection );
+			for( std::map<string_t,queue_ref>::iterator i = conn->queues.begin( ); i != conn->queues.end( ); ++ i ) {
+				release_queue( i->second );
+			}
+			delete conn;
+		}
 		
-		static PyObject *prep( const const_string_t &queue_name, const bool disconnect ) _noexcept {
+		static const queue_ref *prep( pool_lease &lease, const const_string_t &queue_name ) _noexcept {
 			/*
 			 * import boto.regioninfo
 			 * import boto.sqs.connection
@@ -66,91 +1166,93 @@ namespace botoc {
 			 * )
 			 *
 			 * queue = conn.get_queue( [queue_name] )
+			 * (with queue.write, queue.new_message, etc. kept alongside)
 			 */
 			
-			static bool tried = false;
-			static PyObject *connection = NULL;
-			static std::map<string_t,PyObject*> map;
-			
-			if( disconnect ) {
-				if( connection == NULL ) {
-					return NULL;
-				}
-				
-				py_release( connection );
-				connection = NULL;
-				for( std::map<string_t,PyObject*>::iterator i = map.begin( ); i != map.end( ); ++ i ) {
-					py_release( i->second );
-				}
-				map.clear( );
-				tried = false;
-				
+			if( unlikely( !lease.ok( ) ) ) {
 				return NULL;
 			}
-			
-			if( !tried ) {
-				if( unlikely( region.size( ) <= 0 ) ) {
+			connection_ref *conn = (connection_ref *) lease.get( );
+			if( conn == NULL ) {
+				const client &c = current_client( );
+				if( unlikely( c.region( ).size( ) <= 0 ) ) {
 					fprintf( stderr, "attempted to connect to SQS without a region\n" );
 					return NULL;
 				}
-				if( unlikely( user_key.size( ) <= 0 || user_secret.size( ) <= 0 ) ) {
+				if( unlikely( c.key( ).size( ) <= 0 || c.secret( ).size( ) <= 0 ) ) {
 					fprintf( stderr, "attempted to connect to SQS without a valid IAM user\n" );
 					return NULL;
 				}
-				tried = true;
-				
 				if( unlikely( !py_init( ) ) ) {
 					return NULL;
 				}
 				
-				PyObject *regioninfo_mod = py_import( "boto.regioninfo" );
-				PyObject *sqs_mod = py_import( "boto.sqs.connection" );
-				
 				string_t endpoint;
 				try {
-					endpoint.assign( region );
+					conn = new connection_ref( );
+					endpoint.assign( c.region( ) );
 					endpoint.append( ".queue.amazonaws.com" );
 				} catch( ... ) {
-					py_release( regioninfo_mod );
-					py_release( sqs_mod );
+					delete conn;
 					return NULL;
 				}
-				connection = py_construct( sqs_mod, "SQSConnection",
-					"aws_access_key_id", py_string( user_key ),
-					"aws_secret_access_key", py_string( user_secret ),
+				
+				PyObject *regioninfo_mod = py_import( "boto.regioninfo" );
+				PyObject *sqs_mod = py_import( "boto.sqs.connection" );
+				
+				conn->connection = py_construct( sqs_mod, "SQSConnection",
+					"aws_access_key_id", py_string( c.key( ) ),
+					"aws_secret_access_key", py_string( c.secret( ) ),
 					"region", py_construct( regioninfo_mod, "RegionInfo",
-						"name", py_string( region ),
+						"name", py_string( c.region( ) ),
 						"endpoint", py_string( endpoint ),
 					NULL ),
 				NULL );
 				
 				py_release( regioninfo_mod );
 				py_release( sqs_mod );
-				if( unlikely( connection == NULL ) ) {
+				if( unlikely( conn->connection == NULL ) ) {
 					fprintf( stderr, "could not connect to SQS\n" );
+					delete conn;
 					return NULL;
 				}
-			} else if( unlikely( connection == NULL ) ) {
-				return NULL;
+				lease.set( conn );
 			}
 			
-			std::map<string_t,PyObject*>::iterator ind = map.find( queue_name );
+			std::map<string_t,queue_ref> &map = conn->queues;
+			std::map<string_t,queue_ref>::iterator ind = map.find( queue_name );
 			if( ind != map.end( ) ) {
-				return ind->second;
+				return (ind->second.queue != NULL) ? &ind->second : NULL;
 			}
-			PyObject *queue = py_callfunc( connection, "get_queue",
+			queue_ref q;
+			memset( &q, 0, sizeof( q ) );
+			q.queue = py_callfunc( conn->connection, "get_queue",
 				"", py_string( queue_name ),
 			NULL );
-			if( unlikely( queue == NULL ) ) {
+			if( unlikely( q.queue == NULL ) ) {
 				fprintf( stderr, "get_queue failed: %.*s\n", SIZED_STRING(queue_name) );
 			}
-			if( !PyObject_HasAttrString( queue, "name" ) ) {
-				Py_DECREF( queue );
-				queue = NULL;
+			if( !PyObject_HasAttrString( q.queue, "name" ) ) {
+				Py_DECREF( q.queue );
+				q.queue = NULL;
 				fprintf( stderr, "queue not found: %.*s\n", SIZED_STRING(queue_name) );
 			}
-			map.insert( std::pair<string_t,PyObject*>( string_t( queue_name ), queue ) );
-			return queue;
+			if( q.queue != NULL ) {
+				q.write = py_method( q.queue, "write" );
+				q.new_message = py_method( q.queue, "new_message" );
+				q.get_messages = py_method( q.queue, "get_messages" );
+				q.delete_message = py_method( q.queue, "delete_message" );
+				if( unlikely( q.write == NULL || q.new_message == NULL || q.get_messages == NULL || q.delete_message == NULL ) ) {
+					release_queue( q );
+				}
+			}
+			try {
+				ind = map.insert( std::pair<string_t,queue_ref>( string_t( queue_name ), q ) ).first;
+			} catch( ... ) {
+				release_queue( q );
+				return NULL;
+			}
+			return (q.queue != NULL) ? &ind->second : NULL;
 		}
 		
 		static bool put( const const_string_t &queue_name, const const_string_t &message ) _noexcept {
@@ -158,29 +1260,175 @@ namespace botoc {
 			 * queue.write( queue.new_message( [message] ) )
 			 */
 			
-			PyObject *queue = prep( queue_name );
-			if( unlikely( queue == NULL ) ) {
+			py_gil gil;
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const queue_ref *q = prep( lease, queue_name );
+			if( unlikely( q == NULL ) ) {
 				return false;
 			}
-			return py_release_success( py_callfunc( queue, "write",
-				"", py_callfunc( queue, "new_message",
+			return py_release_success( py_call_retry( retries( ), q->write, "write",
+				"", py_call( q->new_message, "new_message",
 					"", py_string( message ),
 				NULL ),
 			NULL ) );
 		}
+		static bool read_batch_errors( PyObject *ret, const char *const stage, bool *const failed, const size_t count ) _noexcept {
+			/*
+			 * for e in ret.errors:
+			 *   failed[int( e['id'] )] = True
+			 */
+			
+			PyObject *errors = PyObject_GetAttrString( ret, "errors" );
+			if( unlikely( py_error( stage, " errors" ) || errors == NULL ) ) {
+				py_release( errors );
+				return false;
+			}
+			for( Py_ssize_t i = 0, e = PyList_Size( errors ); i < e; ++ i ) {
+				PyObject *id = PyDict_GetItemString( PyList_GET_ITEM( errors, i ), "id" ); // borrowed
+				const int n = (id != NULL) ? atoi( py_cstring( id ) ) : -1;
+				if( likely( n >= 0 && (size_t) n < count ) ) {
+					failed[n] = true;
+				}
+			}
+			Py_DECREF( errors );
+			return true;
+		}
+		static size_t send_batch( PyObject *queue, PyObject *batch, const size_t *const indices, std::vector<bool> *const sent ) _noexcept {
+			/*
+			 * ret = queue.write_batch( [batch] )
+			 * failed = [int( e['id'] ) for e in ret.errors]
+			 */
+			
+			const Py_ssize_t count = PyList_Size( batch );
+			PyObject *ret = py_callfunc_retry( retries( ), queue, "write_batch",
+				"", batch,
+			NULL );
+			if( unlikely( ret == NULL ) ) {
+				return 0;
+			}
+			
+			bool failed[MAX_BATCH_COUNT] = { false };
+			const bool ok = read_batch_errors( ret, "write_batch", failed, (size_t) count );
+			Py_DECREF( ret );
+			if( unlikely( !ok ) ) {
+				return 0;
+			}
+			
+			size_t r = 0;
+			for( Py_ssize_t i = 0; i < count; ++ i ) {
+				if( !failed[i] ) {
+					if( sent != NULL ) {
+						(*sent)[indices[i]] = true;
+					}
+					++ r;
+				}
+			}
+			return r;
+		}
+		static size_t put_batch( const const_string_t &queue_name, const string_list_t &messages, std::vector<bool> *const sent ) _noexcept {
+			/*
+			 * for each group of up to 10 messages (and 256KB):
+			 *   queue.write_batch( [
+			 *     ( '0', queue.new_message( [message0] ).get_body_encoded( ), 0 ),
+			 *     ( '1', queue.new_message( [message1] ).get_body_encoded( ), 0 ),
+			 *     ...
+			 *   ] )
+			 */
+			
+			py_gil gil;
+			
+			if( sent != NULL ) {
+				try {
+					sent->assign( messages.size( ), false );
+				} catch( ... ) {
+					return 0;
+				}
+			}
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const queue_ref *q = prep( lease, queue_name );
+			if( unlikely( q == NULL ) ) {
+				return 0;
+			}
+			PyObject *queue = q->queue;
+			
+			size_t r = 0;
+			size_t indices[MAX_BATCH_COUNT];
+			size_t bytes = 0;
+			PyObject *batch = PyList_New( 0 );
+			for( size_t i = 0, e = messages.size( ); i < e; ++ i ) {
+				// the queue's message class decides the wire format (base64 by default)
+				PyObject *msg = py_call( q->new_message, "new_message",
+					"", py_string( messages[i] ),
+				NULL );
+				PyObject *body = py_callfunc( msg, "get_body_encoded", NULL );
+				py_release( msg );
+				if( unlikely( body == NULL ) ) {
+					continue;
+				}
+				const size_t size = (size_t) PyString_Size( body );
+				if( unlikely( size > MAX_BATCH_BYTES ) ) {
+					fprintf( stderr, "message %d is too large for SQS (%d bytes)\n", (int) i, (int) size );
+					Py_DECREF( body );
+					continue;
+				}
+				
+				Py_ssize_t n = PyList_Size( batch );
+				if( n == MAX_BATCH_COUNT || bytes + size > MAX_BATCH_BYTES ) {
+					r += send_batch( queue, batch, indices, sent );
+					batch = PyList_New( 0 );
+					bytes = 0;
+					n = 0;
+				}
+				
+				PyObject *entry = PyTuple_New( 3 );
+				PyTuple_SET_ITEM( entry, 0, PyString_FromFormat( "%d", (int) n ) );
+				PyTuple_SET_ITEM( entry, 1, body );
+				PyTuple_SET_ITEM( entry, 2, PyInt_FromLong( 0 ) );
+				PyList_Append( batch, entry );
+				Py_DECREF( entry );
+				indices[n] = i;
+				bytes += size;
+			}
+			if( PyList_Size( batch ) > 0 ) {
+				r += send_batch( queue, batch, indices, sent );
+			} else {
+				Py_DECREF( batch );
+			}
+			return r;
+		}
+		static bool read_body( PyObject *msg, string_t &body ) _noexcept {
+			PyObject *bod = py_callfunc( msg, "get_body", NULL );
+			if( unlikely( bod == NULL ) ) {
+				return false;
+			}
+			try {
+				body.assign( py_cstring( bod ) );
+			} catch( ... ) {
+				Py_DECREF( bod );
+				return false;
+			}
+			Py_DECREF( bod );
+			return true;
+		}
+		
 		static handle_t get( const const_string_t &queue_name, string_t &body, const int lockSeconds, const int waitSeconds ) _noexcept {
 			/*
 			 * handle = queue.get_messages( visibility_timeout = [lockSeconds], wait_time_seconds = [waitSeconds] )[0]
 			 * body = handle.get_body( )
 			 */
 			
+			py_gil gil;
+			
 			body.clear( );
 			
-			PyObject *queue = prep( queue_name );
-			if( unlikely( queue == NULL ) ) {
+			pool_lease lease( connections( ), pooled_connection );
+			const queue_ref *q = prep( lease, queue_name );
+			if( unlikely( q == NULL ) ) {
 				return NULL;
 			}
-			PyObject *msg = py_listitem_tmp( py_callfunc( queue, "get_messages",
+			PyObject *msg = py_listitem_tmp( py_call_retry( retries( ), q->get_messages, "get_messages",
 				(lockSeconds > 0) ? "visibility_timeout" : "-", PyInt_FromLong( (long) lockSeconds ),
 #if BOTO_SUPPORTS_WAIT_TIME_SECONDS
 				(waitSeconds > 0) ? "wait_time_seconds" : "-", PyInt_FromLong( (long) waitSeconds ),
@@ -191,27 +1439,186 @@ namespace botoc {
 			(void) waitSeconds;
 #endif
 			
-			PyObject *bod = py_callfunc( msg, "get_body", NULL );
-			if( unlikely( bod == NULL ) ) {
-				py_release( msg );
+			if( unlikely( msg == NULL ) ) {
 				return NULL;
 			}
-			try {
-				body.assign( py_cstring( bod ) );
-			} catch( ... ) {
-				Py_DECREF( bod );
+			if( unlikely( !read_body( msg, body ) ) ) {
 				Py_DECREF( msg );
 				return NULL;
 			}
-			Py_DECREF( bod );
 			
 			return (handle_t) msg;
 		}
+		static bool get_batch( const const_string_t &queue_name, int maxCount, const int lockSeconds, const int waitSeconds, message_list_t &messages ) _noexcept {
+			/*
+			 * handles = queue.get_messages( num_messages = [maxCount], visibility_timeout = [lockSeconds], wait_time_seconds = [waitSeconds] )
+			 * for handle in handles:
+			 *   body = handle.get_body( )
+			 */
+			
+			py_gil gil;
+			
+			messages.clear( );
+			
+			if( maxCount > MAX_BATCH_COUNT ) {
+				maxCount = MAX_BATCH_COUNT;
+			} else if( maxCount < 1 ) {
+				maxCount = 1;
+			}
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const queue_ref *q = prep( lease, queue_name );
+			if( unlikely( q == NULL ) ) {
+				return false;
+			}
+			PyObject *list = py_call_retry( retries( ), q->get_messages, "get_messages",
+				"num_messages", PyInt_FromLong( (long) maxCount ),
+				(lockSeconds > 0) ? "visibility_timeout" : "-", PyInt_FromLong( (long) lockSeconds ),
+#if BOTO_SUPPORTS_WAIT_TIME_SECONDS
+				(waitSeconds > 0) ? "wait_time_seconds" : "-", PyInt_FromLong( (long) waitSeconds ),
+#endif
+			NULL );
+			
+#if !BOTO_SUPPORTS_WAIT_TIME_SECONDS
+			(void) waitSeconds;
+#endif
+			
+			if( unlikely( list == NULL ) ) {
+				return false;
+			}
+			
+			const Py_ssize_t count = PyList_Size( list );
+			try {
+				messages.reserve( (size_t) count );
+			} catch( ... ) {
+				Py_DECREF( list );
+				return false;
+			}
+			for( Py_ssize_t i = 0; i < count; ++ i ) {
+				PyObject *msg = PyList_GET_ITEM( list, i ); // borrowed
+				Py_INCREF( msg );
+				messages.push_back( message( ) ); // cannot throw after reserve
+				message &m = messages.back( );
+				if( unlikely( !read_body( msg, m.body ) ) ) {
+					// skip it; the message will become visible again after lockSeconds
+					Py_DECREF( msg );
+					messages.pop_back( );
+					continue;
+				}
+				m.handle = (handle_t) msg;
+			}
+			Py_DECREF( list );
+			
+			return true;
+		}
 		static bool remove( const const_string_t &queue_name, handle_t handle ) _noexcept {
 			/*
-			 * handle.delete( )
+			 * queue.delete_message( handle )
+			 * (or handle.delete( ) if the queue is unknown)
+			 */
+			
+			py_gil gil;
+			
+			if( unlikely( handle == NULL ) ) {
+				return false;
+			}
+			if( unlikely( !Py_IsInitialized( ) ) ) {
+				fprintf( stderr, "python has not been initialised\n" );
+				return false;
+			}
+			pool_lease lease( connections( ), pooled_connection );
+			const queue_ref *q = prep( lease, queue_name );
+			if( q == NULL ) {
+				PyObject *ret = py_callfunc_retry( retries( ), (PyObject *) handle, "delete", NULL );
+				Py_DECREF( (PyObject *) handle );
+				return py_release_success( ret );
+			}
+			return py_release_success( py_call_retry( retries( ), q->delete_message, "delete_message",
+				"", (PyObject *) handle, // steals our reference
+			NULL ) );
+		}
+		static size_t remove_group( PyObject *queue, const handle_t *const handles, const size_t count, const size_t offset, std::vector<bool> *const removed ) _noexcept {
+			/*
+			 * ret = queue.delete_message_batch( [handles] )
+			 * failed = [int( e['id'] ) for e in ret.errors]
+			 */
+			
+			PyObject *list = PyList_New( (Py_ssize_t) count );
+			for( size_t i = 0; i < count; ++ i ) {
+				PyList_SET_ITEM( list, i, (PyObject *) handles[i] ); // steals our reference
+			}
+			PyObject *ret = py_callfunc_retry( retries( ), queue, "delete_message_batch",
+				"", list,
+			NULL );
+			if( unlikely( ret == NULL ) ) {
+				return 0;
+			}
+			
+			bool failed[MAX_BATCH_COUNT] = { false };
+			const bool ok = read_batch_errors( ret, "delete_message_batch", failed, count );
+			Py_DECREF( ret );
+			if( unlikely( !ok ) ) {
+				return 0;
+			}
+			
+			size_t r = 0;
+			for( size_t i = 0; i < count; ++ i ) {
+				if( !failed[i] ) {
+					if( removed != NULL ) {
+						(*removed)[offset + i] = true;
+					}
+					++ r;
+				}
+			}
+			return r;
+		}
+		static size_t remove_batch( const const_string_t &queue_name, const handle_list_t &handles, std::vector<bool> *removed ) _noexcept {
+			/*
+			 * for each group of up to 10 handles:
+			 *   queue.delete_message_batch( [handle0, handle1, ...] )
 			 */
 			
+			py_gil gil;
+			
+			const size_t e = handles.size( );
+			if( removed != NULL ) {
+				try {
+					removed->assign( e, false );
+				} catch( ... ) {
+					removed = NULL;
+				}
+			}
+			if( e == 0 ) {
+				return 0;
+			}
+			
+			// like remove, every handle is released whether or not it could be removed
+			pool_lease lease( connections( ), pooled_connection );
+			const queue_ref *q = prep( lease, queue_name );
+			PyObject *queue = (q != NULL) ? q->queue : NULL;
+			if( unlikely( queue == NULL ) ) {
+				if( Py_IsInitialized( ) ) {
+					for( size_t i = 0; i < e; ++ i ) {
+						py_release( (PyObject *) handles[i] );
+					}
+				}
+				return 0;
+			}
+			
+			size_t r = 0;
+			for( size_t i = 0; i < e; i += MAX_BATCH_COUNT ) {
+				const size_t n = (e - i < MAX_BATCH_COUNT) ? (e - i) : (size_t) MAX_BATCH_COUNT;
+				r += remove_group( queue, &handles[i], n, i, removed );
+			}
+			return r;
+		}
+		static bool extend( const const_string_t &queue_name, handle_t handle, const int lockSeconds ) _noexcept {
+			/*
+			 * handle.change_visibility( [lockSeconds] )
+			 */
+			
+			py_gil gil;
+			
 			(void) queue_name;
 			
 			if( unlikely( handle == NULL ) ) {
@@ -221,13 +1628,123 @@ namespace botoc {
 				fprintf( stderr, "python has not been initialised\n" );
 				return false;
 			}
-			PyObject *ret = py_callfunc( (PyObject *) handle, "delete", NULL );
-			Py_DECREF( (PyObject *) handle );
-			return py_release_success( ret );
+			return py_release_success( py_callfunc_retry( retries( ), (PyObject *) handle, "change_visibility",
+				"", PyInt_FromLong( (long) lockSeconds ),
+			NULL ) );
+		}
+		static size_t extend_group( PyObject *queue, const handle_t *const handles, const size_t count, const size_t offset, const int lockSeconds, std::vector<bool> *const extended ) _noexcept {
+			/*
+			 * ret = queue.change_message_visibility_batch( [(handle, lockSeconds), ...] )
+			 * failed = [int( e['id'] ) for e in ret.errors]
+			 */
+			
+			PyObject *list = PyList_New( (Py_ssize_t) count );
+			for( size_t i = 0; i < count; ++ i ) {
+				PyObject *entry = PyTuple_New( 2 );
+				Py_INCREF( (PyObject *) handles[i] ); // the caller keeps its handles
+				PyTuple_SET_ITEM( entry, 0, (PyObject *) handles[i] );
+				PyTuple_SET_ITEM( entry, 1, PyInt_FromLong( (long) lockSeconds ) );
+				PyList_SET_ITEM( list, i, entry );
+			}
+			PyObject *ret = py_callfunc_retry( retries( ), queue, "change_message_visibility_batch",
+				"", list,
+			NULL );
+			if( unlikely( ret == NULL ) ) {
+				return 0;
+			}
+			
+			bool failed[MAX_BATCH_COUNT] = { false };
+			const bool ok = read_batch_errors( ret, "change_message_visibility_batch", failed, count );
+			Py_DECREF( ret );
+			if( unlikely( !ok ) ) {
+				return 0;
+			}
+			
+			size_t r = 0;
+			for( size_t i = 0; i < count; ++ i ) {
+				if( !failed[i] ) {
+					if( extended != NULL ) {
+						(*extended)[offset + i] = true;
+					}
+					++ r;
+				}
+			}
+			return r;
+		}
+		static size_t extend_batch( const const_string_t &queue_name, const handle_list_t &handles, const int lockSeconds, std::vector<bool> *extended ) _noexcept {
+			/*
+			 * for each group of up to 10 handles:
+			 *   queue.change_message_visibility_batch( [(handle0, lockSeconds), ...] )
+			 */
+			
+			py_gil gil;
+			
+			const size_t e = handles.size( );
+			if( extended != NULL ) {
+				try {
+					extended->assign( e, false );
+				} catch( ... ) {
+					extended = NULL;
+				}
+			}
+			if( e == 0 ) {
+				return 0;
+			}
+			
+			pool_lease lease( connections( ), pooled_connection );
+			const queue_ref *q = prep( lease, queue_name );
+			PyObject *queue = (q != NULL) ? q->queue : NULL;
+			if( unlikely( queue == NULL ) ) {
+				return 0;
+			}
+			
+			size_t r = 0;
+			for( size_t i = 0; i < e; i += MAX_BATCH_COUNT ) {
+				const size_t n = (e - i < MAX_BATCH_COUNT) ? (e - i) : (size_t) MAX_BATCH_COUNT;
+				r += extend_group( queue, &handles[i], n, i, lockSeconds, extended );
+			}
+			return r;
+		}
+		static void release( handle_t handle ) _noexcept {
+			/*
+			 * del handle
+			 */
+			
+			py_gil gil;
+			
+			if( handle != NULL && Py_IsInitialized( ) ) {
+				Py_DECREF( (PyObject *) handle );
+			}
 		}
 		static inline void disconnect( void ) _noexcept {
-			const const_string_t t;
-			(void) prep( t, true );
+			py_gil gil;
+			connections( ).close( );
+			retry_refill( retries( ) );
+		}
+#endif
+		
+		static inline retry_state &retries( void ) _noexcept {
+			return current_client( ).retries( SLOT_SQS );
+		}
+		
+		static inline connection_pool &connections( void ) _noexcept {
+			return current_client( ).pool( SLOT_SQS );
+		}
+		
+		static void set_retry_policy( const retry_policy &policy ) _noexcept {
+			retry_configure( retries( ), policy );
+		}
+		
+		static void get_retry_stats( retry_stats &stats ) _noexcept {
+			retry_snapshot( retries( ), stats );
+		}
+		
+		static void set_pool_policy( const pool_policy &policy ) _noexcept {
+			connections( ).set_policy( policy );
+		}
+		
+		static void get_pool_stats( pool_stats &stats ) _noexcept {
+			connections( ).get_stats( stats );
 		}
 	}
 }
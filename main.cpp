@@ -16,9 +16,11 @@
 
 void print_key_values( FILE *fp, const botoc::ddb::item_list_t &items ) throw( );
 void print_keys( FILE *fp, const botoc::ddb::item_list_t &items ) throw( );
+bool print_page( botoc::ddb::record_list_t &page, void *context ) throw( );
 
 void test_sqs( const botoc::const_string_t &queue ) throw( );
 void test_ddb( const botoc::const_string_t &database ) throw( );
+void test_ddb_range( const botoc::const_string_t &database ) throw( );
 
 
 /* implementation */
@@ -48,12 +50,18 @@ int main( void ) {
 	 * 	{
 	 * 		"Sid": "MyDatabasePermissions",
 	 * 		"Action": [
+	 * 			"dynamodb:BatchGetItem",
+	 * 			"dynamodb:BatchWriteItem",
+	 * 			"dynamodb:DescribeTable",
 	 * 			"dynamodb:GetItem",
+	 * 			"dynamodb:Query",
+	 * 			"dynamodb:Scan",
 	 * 			"dynamodb:UpdateItem"
 	 * 		],
 	 * 		"Effect": "Allow",
 	 * 		"Resource": [
-	 * 			"arn:aws:dynamodb:eu-west-1:*:table/mytestdatabase"
+	 * 			"arn:aws:dynamodb:eu-west-1:*:table/mytestdatabase",
+	 * 			"arn:aws:dynamodb:eu-west-1:*:table/mytestevents"
 	 * 		]
 	 * 	}
 	 * 	]
@@ -62,6 +70,7 @@ int main( void ) {
 	
 	test_sqs( "mytestqueue" );
 	test_ddb( "mytestdatabase" );
+	test_ddb_range( "mytestevents" ); // (hash key "User", range key "Time" (a number))
 	
 	fprintf( stdout, "done.\n\n" );
 	fflush( stdout );
@@ -89,6 +98,27 @@ void test_sqs( const botoc::const_string_t &queue ) throw( ) {
 		}
 	}
 	
+	LOCALBLOCK {
+		fprintf( stdout, "botoc::sqs::get_batch( \"%.*s\", 10, 10, 4, messages )\n", SIZED_STRING(queue) );
+		botoc::sqs::message_list_t messages;
+		if( botoc::sqs::get_batch( queue, 10, 10, 4, messages ) ) {
+			fprintf( stdout, "  ok. %d results\n", (int) messages.size( ) );
+			botoc::sqs::handle_list_t handles;
+			for( std::size_t i = 0, e = messages.size( ); i < e; ++ i ) {
+				fprintf( stdout, "  result = %.*s\n", SIZED_STRING(messages[i].body) );
+				handles.push_back( messages[i].handle );
+			}
+			fprintf( stdout, "botoc::sqs::remove_batch( \"%.*s\", handles )\n", SIZED_STRING(queue) );
+			if( botoc::sqs::remove_batch( queue, handles ) == handles.size( ) ) {
+				fprintf( stdout, "  ok.\n" );
+			} else {
+				fprintf( stdout, "  fail.\n" );
+			}
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+	}
+	
 	LOCALBLOCK {
 		fprintf( stdout, "botoc::sqs::put( \"%.*s\", \"Hello World\" )\n", SIZED_STRING(queue) );
 		if( botoc::sqs::put( queue, "Hello World" ) ) {
@@ -98,6 +128,42 @@ void test_sqs( const botoc::const_string_t &queue ) throw( ) {
 		}
 	}
 	
+	LOCALBLOCK {
+		botoc::string_list_t messages;
+		messages.push_back( "Hello" );
+		messages.push_back( "World" );
+		messages.push_back( "Again" );
+		std::vector<bool> sent;
+		fprintf( stdout, "botoc::sqs::put_batch( \"%.*s\", [\"Hello\", \"World\", \"Again\"], &sent )\n", SIZED_STRING(queue) );
+		const std::size_t count = botoc::sqs::put_batch( queue, messages, &sent );
+		if( count == messages.size( ) ) {
+			fprintf( stdout, "  ok.\n" );
+		} else {
+			fprintf( stdout, "  fail. %d of %d sent\n", (int) count, (int) messages.size( ) );
+		}
+	}
+	
+	LOCALBLOCK {
+		fprintf( stdout, "botoc::sqs::consumer( \"%.*s\", 20, 10, 4 )\n", SIZED_STRING(queue) );
+		botoc::sqs::consumer consumer( queue, 20, 10, 4 );
+		if( consumer.start( ) ) {
+			botoc::sqs::message message;
+			while( consumer.pop( message, 5000 ) ) {
+				fprintf( stdout, "  result = %.*s\n", SIZED_STRING(message.body) );
+				if( !consumer.ack( message.handle ) ) {
+					fprintf( stdout, "  ack fail.\n" );
+				}
+			}
+			consumer.stop( );
+			if( consumer.failed_acks( ) > 0 ) {
+				fprintf( stdout, "  %llu acks failed.\n", consumer.failed_acks( ) );
+			}
+			fprintf( stdout, "  ok.\n" );
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+	}
+	
 	fprintf( stdout, "done SQS.\n\n" );
 	fflush( stdout );
 }
@@ -397,10 +463,190 @@ void test_ddb( const botoc::const_string_t &database ) throw( ) {
 		fprintf( stdout, "\n" );
 	}
 	
+	LOCALBLOCK {
+		botoc::ddb::item_map_t records;
+		for( int i = 3; i <= 5; ++ i ) {
+			char key[16];
+			snprintf( key, sizeof( key ), "mykey%d", i );
+			botoc::ddb::item_list_t &items = records[key];
+			items.push_back( botoc::ddb::item( "Name", "Batch" ) );
+			items.push_back( botoc::ddb::item( "Age", 20 + i ) );
+		}
+		
+		fprintf( stdout, "botoc::ddb::batch_put( \"%.*s\", { \"mykey3\", \"mykey4\", \"mykey5\" } ):\n", SIZED_STRING(database) );
+		const size_t written = botoc::ddb::batch_put( database, records );
+		if( written == records.size( ) ) {
+			fprintf( stdout, "  ok.\n" );
+		} else {
+			fprintf( stdout, "  fail. (%d written)\n", (int) written );
+		}
+		fprintf( stdout, "\n" );
+	}
+	
+	LOCALBLOCK {
+		botoc::string_list_t keys;
+		keys.push_back( "mykey1" );
+		keys.push_back( "mykey3" );
+		keys.push_back( "mykey4" );
+		keys.push_back( "mykey5" );
+		keys.push_back( "mykeyGone" );
+		botoc::ddb::item_list_t attributes;
+		attributes.push_back( botoc::ddb::item( "Name" ) );
+		attributes.push_back( botoc::ddb::item( "Age" ) );
+		botoc::ddb::item_map_t results;
+		
+		fprintf( stdout, "botoc::ddb::batch_get( \"%.*s\", { \"mykey1\", \"mykey3\", \"mykey4\", \"mykey5\", \"mykeyGone\" }, ", SIZED_STRING(database) );
+		print_keys( stdout, attributes );
+		fprintf( stdout, ", true ):\n" );
+		if( botoc::ddb::batch_get( database, keys, attributes, true, results ) ) {
+			fprintf( stdout, "  ok. %d found\n", (int) results.size( ) );
+			for( botoc::ddb::item_map_t::const_iterator i = results.begin( ); i != results.end( ); ++ i ) {
+				fprintf( stdout, "  \"%.*s\" = ", SIZED_STRING(i->first) );
+				print_key_values( stdout, i->second );
+				fprintf( stdout, "\n" );
+			}
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+		fprintf( stdout, "\n" );
+	}
+	
+	LOCALBLOCK {
+		size_t count = 0;
+		fprintf( stdout, "botoc::ddb::parallel_scan( \"%.*s\", 2, NULL, print_page ):\n", SIZED_STRING(database) );
+		if( botoc::ddb::parallel_scan( database, 2, NULL, &print_page, &count ) ) {
+			fprintf( stdout, "  ok. %d records\n", (int) count );
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+		fprintf( stdout, "\n" );
+	}
+	
+	LOCALBLOCK {
+		botoc::string_list_t keys;
+		keys.push_back( "mykey3" );
+		keys.push_back( "mykey4" );
+		keys.push_back( "mykey5" );
+		
+		fprintf( stdout, "botoc::ddb::batch_delete( \"%.*s\", { \"mykey3\", \"mykey4\", \"mykey5\" } ):\n", SIZED_STRING(database) );
+		const size_t deleted = botoc::ddb::batch_delete( database, keys );
+		if( deleted == keys.size( ) ) {
+			fprintf( stdout, "  ok.\n" );
+		} else {
+			fprintf( stdout, "  fail. (%d deleted)\n", (int) deleted );
+		}
+		fprintf( stdout, "\n" );
+	}
+	
+	LOCALBLOCK {
+		fprintf( stdout, "botoc::ddb::set_cache( 1 MB, 60 seconds )\n" );
+		botoc::ddb::set_cache( 1 << 20, 60.0 );
+		for( int i = 0; i < 2; ++ i ) {
+			botoc::ddb::item_list_t items;
+			fprintf( stdout, "botoc::ddb::get( \"%.*s\", \"mykey1\", false, ", SIZED_STRING(database) );
+			print_keys( stdout, items );
+			fprintf( stdout, " ):\n" );
+			if( botoc::ddb::get( database, "mykey1", false, items ) ) {
+				fprintf( stdout, "  ok. values = " );
+				print_key_values( stdout, items );
+				fprintf( stdout, "\n" );
+			} else {
+				fprintf( stdout, "  fail.\n" );
+			}
+		}
+		botoc::ddb::cache_stats stats;
+		botoc::ddb::get_cache_stats( stats );
+		fprintf( stdout, "botoc::ddb::get_cache_stats( ):\n" );
+		if( stats.hits == 1 && stats.misses == 1 ) {
+			fprintf( stdout, "  ok. 1 hit, 1 miss\n" );
+		} else {
+			fprintf( stdout, "  fail. %llu hits, %llu misses\n", stats.hits, stats.misses );
+		}
+		
+		// keys must be a string, number or binary (not a set)
+		botoc::ddb::item set( "", botoc::ddb::STRINGSET );
+		(void) set.add_item( "mykey1" );
+		botoc::ddb::item_list_t items;
+		fprintf( stdout, "botoc::ddb::get( \"%.*s\", ( [SS] \"mykey1\" ), false, [] ):\n", SIZED_STRING(database) );
+		if( !botoc::ddb::get( database, botoc::ddb::item_key( set ), false, items ) ) {
+			fprintf( stdout, "  ok. (rejected)\n" );
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+		botoc::ddb::set_cache( 0, 0.0 );
+		fprintf( stdout, "\n" );
+	}
+	
 	fprintf( stdout, "done DDB.\n\n" );
 	fflush( stdout );
 }
 
+void test_ddb_range( const botoc::const_string_t &database ) throw( ) {
+	fprintf( stdout, "begin DDB (range keys).\n" );
+	
+	LOCALBLOCK {
+		fprintf( stdout, "botoc::ddb::update( \"%.*s\", ( \"Fred\", 1000 ... 1009 ), { \"Score\" } ):\n", SIZED_STRING(database) );
+		bool ok = true;
+		for( int i = 0; i < 10; ++ i ) {
+			botoc::ddb::item_list_t items;
+			items.push_back( botoc::ddb::item( "Score", i * 10 ) );
+			const botoc::ddb::item_key key( botoc::ddb::item( "", "Fred" ), botoc::ddb::item( "", 1000 + i ) );
+			if( !botoc::ddb::update( database, key, items ) ) {
+				ok = false;
+			}
+		}
+		if( ok ) {
+			fprintf( stdout, "  ok.\n" );
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+		fprintf( stdout, "\n" );
+	}
+	
+	LOCALBLOCK {
+		botoc::ddb::item_list_t items;
+		const botoc::ddb::item_key key( botoc::ddb::item( "", "Fred" ), botoc::ddb::item( "", 1003 ) );
+		fprintf( stdout, "botoc::ddb::get( \"%.*s\", ( \"Fred\", 1003 ), true, ", SIZED_STRING(database) );
+		print_keys( stdout, items );
+		fprintf( stdout, " ):\n" );
+		if( botoc::ddb::get( database, key, true, items ) ) {
+			fprintf( stdout, "  ok. values = " );
+			print_key_values( stdout, items );
+			fprintf( stdout, "\n" );
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+		fprintf( stdout, "\n" );
+	}
+	
+	LOCALBLOCK {
+		size_t count = 0;
+		const botoc::ddb::range_condition condition( botoc::ddb::item( "", 1002 ), botoc::ddb::item( "", 1006 ) );
+		fprintf( stdout, "botoc::ddb::query( \"%.*s\", \"Fred\", BETWEEN 1002 AND 1006, 0, print_page, consistent, backwards ):\n", SIZED_STRING(database) );
+		if( botoc::ddb::query( database, "Fred", condition, 0, &print_page, &count, true, false ) ) {
+			fprintf( stdout, "  ok. %d records\n", (int) count );
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+		fprintf( stdout, "\n" );
+	}
+	
+	LOCALBLOCK {
+		size_t count = 0;
+		const botoc::ddb::range_condition condition( botoc::ddb::GT, botoc::ddb::item( "", 1004 ) );
+		fprintf( stdout, "botoc::ddb::query( \"%.*s\", \"Fred\", > 1004, 3, print_page ):\n", SIZED_STRING(database) );
+		if( botoc::ddb::query( database, "Fred", condition, 3, &print_page, &count ) ) {
+			fprintf( stdout, "  ok. %d records\n", (int) count );
+		} else {
+			fprintf( stdout, "  fail.\n" );
+		}
+		fprintf( stdout, "\n" );
+	}
+	
+	fprintf( stdout, "done DDB (range keys).\n\n" );
+	fflush( stdout );
+}
+
 /* helper functions */
 
 void print_key_values( FILE *fp, const botoc::ddb::item_list_t &items ) throw( ) {
@@ -437,3 +683,14 @@ void print_keys( FILE *fp, const botoc::ddb::item_list_t &items ) throw( ) {
 		fprintf( fp, "[]" );
 	}
 }
+
+bool print_page( botoc::ddb::record_list_t &page, void *context ) throw( ) {
+	// context counts the records
+	for( std::size_t i = 0, e = page.size( ); i < e; ++ i ) {
+		fprintf( stdout, "  record = " );
+		print_key_values( stdout, page[i] );
+		fprintf( stdout, "\n" );
+	}
+	*(size_t *) context += page.size( );
+	return true;
+}